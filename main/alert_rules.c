@@ -0,0 +1,281 @@
+#include "alert_rules.h"
+#include "aqi.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define MAX_TOKENS 10
+#define DEFAULT_HYSTERESIS 0.1f // fraction of the threshold an ABOVE/BELOW level must recede by
+
+static const char* s_field_names[ALERT_NUM_FIELDS] = {
+    "temperature_mcp9808",
+    "pm1p0",
+    "pm2p5",
+    "pm4p0",
+    "pm10p0",
+    "humidity",
+    "temperature",
+    "voc_index",
+    "nox_index",
+    "aqi",
+};
+
+const char* alert_field_name(int field)
+{
+    return (field >= 0 && field < ALERT_NUM_FIELDS) ? s_field_names[field] : "unknown";
+}
+
+float alert_field_value(const struct sensor_data* sd, int field)
+{
+    if (field >= 0 && field < SENSOR_NUM_FIELDS) {
+        return sensor_to_float(field, sd->sample.value[field]);
+    }
+    if (field == ALERT_FIELD_AQI) {
+        return sd->aqi == AQI_INVALID ? NAN : (float)sd->aqi;
+    }
+    return NAN;
+}
+
+static bool parse_number(const char* tok, float* out)
+{
+    char* end = NULL;
+    float v = strtof(tok, &end);
+    if (end == tok || *end != '\0' || !isfinite(v)) {
+        return false;
+    }
+    *out = v;
+    return true;
+}
+
+// "90", "90s", "5m", "1h"
+static bool parse_duration(const char* tok, uint32_t* msec)
+{
+    char* end = NULL;
+    double v = strtod(tok, &end);
+    if (end == tok || v < 0) {
+        return false;
+    }
+    double scale = 1000.0;
+    if (*end == 'm' && end[1] == '\0') {
+        scale = 60000.0;
+    } else if (*end == 'h' && end[1] == '\0') {
+        scale = 3600000.0;
+    } else if (!(*end == '\0' || (*end == 's' && end[1] == '\0'))) {
+        return false;
+    }
+    v *= scale;
+    if (v > ALERT_MAX_WINDOW_MSEC) {
+        return false;
+    }
+    *msec = (uint32_t)v;
+    return true;
+}
+
+static bool fail(char* err, size_t err_size, const char* msg, const char* tok)
+{
+    if (tok != NULL) {
+        snprintf(err, err_size, "%s '%s'", msg, tok);
+    } else {
+        snprintf(err, err_size, "%s", msg);
+    }
+    return false;
+}
+
+bool alert_rule_compile(const char* expr, alert_rule_t* rule, char* err, size_t err_size)
+{
+    char buf[64];
+    if (expr == NULL || strlen(expr) >= sizeof(buf)) {
+        return fail(err, err_size, "Expression too long", NULL);
+    }
+    strcpy(&buf[0], expr);
+
+    char* tok[MAX_TOKENS];
+    int n = 0;
+    char* save = NULL;
+    for (char* t = strtok_r(&buf[0], " \t", &save); t != NULL; t = strtok_r(NULL, " \t", &save)) {
+        if (n == MAX_TOKENS) {
+            return fail(err, err_size, "Too many terms", NULL);
+        }
+        tok[n++] = t;
+    }
+    if (n < 3) {
+        return fail(err, err_size, "Expected '<field> <op> <value>'", NULL);
+    }
+
+    memset(rule, 0, sizeof(alert_rule_t));
+    int field = -1;
+    for (int f = 0; f < ALERT_NUM_FIELDS; f++) {
+        if (strcasecmp(tok[0], s_field_names[f]) == 0) {
+            field = f;
+            break;
+        }
+    }
+    if (field < 0) {
+        return fail(err, err_size, "Unknown field", tok[0]);
+    }
+    rule->field = (uint8_t)field;
+
+    int i = 1;
+    if (strcmp(tok[i], ">") == 0 || strcmp(tok[i], ">=") == 0) {
+        rule->kind = ALERT_KIND_ABOVE;
+        rule->inclusive = tok[i][1] == '=';
+    } else if (strcmp(tok[i], "<") == 0 || strcmp(tok[i], "<=") == 0) {
+        rule->kind = ALERT_KIND_BELOW;
+        rule->inclusive = tok[i][1] == '=';
+    } else if (strcasecmp(tok[i], "rises") == 0) {
+        rule->kind = ALERT_KIND_RISES;
+    } else if (strcasecmp(tok[i], "falls") == 0) {
+        rule->kind = ALERT_KIND_FALLS;
+    } else {
+        return fail(err, err_size, "Unknown operator", tok[i]);
+    }
+    i++;
+
+    bool change = rule->kind == ALERT_KIND_RISES || rule->kind == ALERT_KIND_FALLS;
+    if (change) {
+        if (i >= n || strcasecmp(tok[i], "by") != 0) {
+            return fail(err, err_size, "Expected 'by' after", tok[i - 1]);
+        }
+        i++;
+    }
+    if (i >= n || !parse_number(tok[i], &rule->threshold)) {
+        return fail(err, err_size, "Expected a number", i < n ? tok[i] : NULL);
+    }
+    i++;
+    if (change) {
+        if (rule->threshold <= 0.0f) {
+            return fail(err, err_size, "Change must be positive", tok[i - 1]);
+        }
+        if (i + 1 >= n || strcasecmp(tok[i], "in") != 0 || !parse_duration(tok[i + 1], &rule->window_msec)
+            || rule->window_msec == 0) {
+            return fail(err, err_size, "Expected 'in <duration>'", NULL);
+        }
+        i += 2;
+        rule->clear = rule->threshold * 0.5f;
+    } else {
+        float margin = fabsf(rule->threshold) * DEFAULT_HYSTERESIS;
+        rule->clear = rule->kind == ALERT_KIND_ABOVE ? rule->threshold - margin : rule->threshold + margin;
+    }
+
+    while (i < n) {
+        if (!change && strcasecmp(tok[i], "for") == 0 && i + 1 < n) {
+            if (!parse_duration(tok[i + 1], &rule->hold_msec)) {
+                return fail(err, err_size, "Invalid duration", tok[i + 1]);
+            }
+        } else if (strcasecmp(tok[i], "clear") == 0 && i + 1 < n) {
+            if (!parse_number(tok[i + 1], &rule->clear)) {
+                return fail(err, err_size, "Invalid clear level", tok[i + 1]);
+            }
+        } else {
+            return fail(err, err_size, "Unexpected", tok[i]);
+        }
+        i += 2;
+    }
+
+    // The clear level has to sit on the far side of the trigger, or the alert would flap
+    bool valid_clear = true;
+    switch (rule->kind) {
+    case ALERT_KIND_ABOVE: valid_clear = rule->clear <= rule->threshold; break;
+    case ALERT_KIND_BELOW: valid_clear = rule->clear >= rule->threshold; break;
+    default: valid_clear = rule->clear >= 0.0f && rule->clear <= rule->threshold; break;
+    }
+    if (!valid_clear) {
+        return fail(err, err_size, "Clear level must be on the other side of the trigger", NULL);
+    }
+    return true;
+}
+
+void alert_state_reset(alert_state_t* st)
+{
+    memset(st, 0, sizeof(alert_state_t));
+    for (int b = 0; b < ALERT_HISTORY_BUCKETS; b++) {
+        st->extreme[b] = NAN;
+    }
+}
+
+// The look-back window is split into buckets that each keep the lowest (RISES) or highest
+// (FALLS) value seen, so a rule costs a fixed amount of memory and work whatever the sample rate.
+static float window_change(const alert_rule_t* rule, alert_state_t* st, float value, int64_t usec_now)
+{
+    bool rises = rule->kind == ALERT_KIND_RISES;
+    int64_t bucket_usec = (int64_t)rule->window_msec * 1000 / ALERT_HISTORY_BUCKETS;
+    if (st->bucket_usec == 0) {
+        st->bucket_usec = usec_now;
+    }
+    int advance = 0;
+    while (usec_now - st->bucket_usec >= bucket_usec && advance < ALERT_HISTORY_BUCKETS) {
+        st->bucket_usec += bucket_usec;
+        st->bucket = (st->bucket + 1) % ALERT_HISTORY_BUCKETS;
+        st->extreme[st->bucket] = NAN;
+        advance++;
+    }
+    if (advance == ALERT_HISTORY_BUCKETS) {
+        st->bucket_usec = usec_now;
+    }
+
+    float* cur = &st->extreme[st->bucket];
+    if (isnan(*cur) || (rises ? value < *cur : value > *cur)) {
+        *cur = value;
+    }
+    float ref = value;
+    for (int b = 0; b < ALERT_HISTORY_BUCKETS; b++) {
+        float e = st->extreme[b];
+        if (!isnan(e) && (rises ? e < ref : e > ref)) {
+            ref = e;
+        }
+    }
+    return rises ? value - ref : ref - value;
+}
+
+bool alert_rule_eval(const alert_rule_t* rule, alert_state_t* st, float value, int64_t usec_now)
+{
+    if (isnan(value)) {
+        return false;
+    }
+
+    bool trigger;
+    bool clear;
+    switch (rule->kind) {
+    case ALERT_KIND_ABOVE:
+        trigger = rule->inclusive ? value >= rule->threshold : value > rule->threshold;
+        clear = value < rule->clear;
+        break;
+    case ALERT_KIND_BELOW:
+        trigger = rule->inclusive ? value <= rule->threshold : value < rule->threshold;
+        clear = value > rule->clear;
+        break;
+    default:
+        value = window_change(rule, st, value, usec_now);
+        trigger = value >= rule->threshold;
+        clear = value < rule->clear;
+        break;
+    }
+    st->value = value;
+
+    if (st->active) {
+        if (clear) {
+            st->active = false;
+            st->changed_usec = usec_now;
+            return true;
+        }
+        return false;
+    }
+
+    if (!trigger) {
+        st->pending_usec = 0;
+        return false;
+    }
+    if (st->pending_usec == 0) {
+        st->pending_usec = usec_now;
+    }
+    if (usec_now - st->pending_usec < (int64_t)rule->hold_msec * 1000) {
+        return false;
+    }
+    st->active = true;
+    st->pending_usec = 0;
+    st->changed_usec = usec_now;
+    return true;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "sensor_data.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ALERT_HISTORY_BUCKETS 8
+#define ALERT_MAX_WINDOW_MSEC (24 * 3600 * 1000)
+
+// The measured fields are the sensor_field values, followed by the derived ones
+enum alert_field {
+    ALERT_FIELD_TEMPERATURE_MCP9808 = SENSOR_TEMPERATURE_MCP9808,
+    ALERT_FIELD_PM1P0 = SENSOR_PM1P0,
+    ALERT_FIELD_PM2P5 = SENSOR_PM2P5,
+    ALERT_FIELD_PM4P0 = SENSOR_PM4P0,
+    ALERT_FIELD_PM10P0 = SENSOR_PM10P0,
+    ALERT_FIELD_HUMIDITY = SENSOR_HUMIDITY,
+    ALERT_FIELD_TEMPERATURE = SENSOR_TEMPERATURE,
+    ALERT_FIELD_VOC_INDEX = SENSOR_VOC_INDEX,
+    ALERT_FIELD_NOX_INDEX = SENSOR_NOX_INDEX,
+    ALERT_FIELD_AQI = SENSOR_NUM_FIELDS,
+    ALERT_NUM_FIELDS
+};
+
+enum alert_kind {
+    ALERT_KIND_ABOVE,   // field > (>=) threshold [for hold]
+    ALERT_KIND_BELOW,   // field < (<=) threshold [for hold]
+    ALERT_KIND_RISES,   // field rises by threshold in window
+    ALERT_KIND_FALLS,   // field falls by threshold in window
+};
+
+// Compiled rule. Every rule is a flat record, evaluation is a switch on kind with no parsing
+// or allocation per sample.
+typedef struct alert_rule {
+    uint8_t field;
+    uint8_t kind;
+    bool inclusive;         // ABOVE/BELOW: the threshold itself triggers (>=, <=)
+    float threshold;        // level for ABOVE/BELOW, change for RISES/FALLS
+    float clear;            // an active alert clears once the level or change is back past this
+    uint32_t hold_msec;     // ABOVE/BELOW: condition must hold this long before the alert fires
+    uint32_t window_msec;   // RISES/FALLS: look-back window
+} alert_rule_t;
+
+typedef struct alert_state {
+    bool active;
+    int64_t pending_usec;   // when the condition started to hold, 0 when it does not
+    int64_t changed_usec;   // last activation or clear
+    float value;            // last evaluated level or change
+    int64_t bucket_usec;    // start of the current history bucket
+    uint8_t bucket;
+    float extreme[ALERT_HISTORY_BUCKETS];  // per-bucket min (RISES) or max (FALLS)
+} alert_state_t;
+
+const char* alert_field_name(int field);
+// NAN when the field has no valid reading in this sample
+float alert_field_value(const struct sensor_data* sd, int field);
+
+// Compile an expression such as "pm2p5 > 35 for 60s", "aqi rises by 50 in 5m" or
+// "voc_index > 250 clear 200". Returns false and fills err on a syntax error.
+bool alert_rule_compile(const char* expr, alert_rule_t* rule, char* err, size_t err_size);
+void alert_state_reset(alert_state_t* st);
+// Returns true when the rule changed between active and clear on this sample
+bool alert_rule_eval(const alert_rule_t* rule, alert_state_t* st, float value, int64_t usec_now);
+
+#ifdef __cplusplus
+}
+#endif
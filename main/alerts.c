@@ -0,0 +1,442 @@
+#include "alerts.h"
+#include "task_plan.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_http_client.h"
+#include "mqtt_client.h"
+#include "nvs.h"
+
+#include "cJSON.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char* TAG = "aqm-alerts";
+
+#define ALERTS_NVS_NAMESPACE "aqm"
+#define ALERTS_NVS_KEY "alerts"
+#define ALERTS_EVENT_QUEUE_LEN 16
+#define ALERTS_WEBHOOK_TIMEOUT_MSEC 3000
+
+typedef struct alert_event {
+    char expr[ALERT_EXPR_LEN];
+    uint8_t field;
+    uint8_t sinks;
+    bool active;
+    float value;
+    int64_t usec;
+} alert_event_t;
+
+static const char* s_sink_names[] = { "lcd", "webhook", "mqtt" };
+#define NUM_SINKS (sizeof(s_sink_names) / sizeof(s_sink_names[0]))
+
+static alerts_config_t s_cfg;
+static alert_rule_t s_rules[ALERT_MAX_RULES];
+static alert_state_t s_states[ALERT_MAX_RULES];
+static int s_banner = -1;
+static alerts_stats_t s_stats;
+static SemaphoreHandle_t s_lock = NULL;
+static StaticSemaphore_t s_lock_buf;
+static QueueHandle_t s_events = NULL;
+static esp_mqtt_client_handle_t s_mqtt = NULL;
+static char s_mqtt_uri[ALERT_URL_LEN];
+
+static void alerts_defaults(alerts_config_t* cfg)
+{
+    memset(cfg, 0, sizeof(alerts_config_t));
+    cfg->version = ALERTS_BLOB_VERSION;
+    cfg->num_rules = 1;
+    strlcpy(&cfg->rules[0].expr[0], "pm2p5 > 35 for 60s", ALERT_EXPR_LEN);
+    cfg->rules[0].sinks = ALERT_SINK_LCD;
+    strlcpy(&cfg->mqtt_topic[0], "esper-aqm/alerts", ALERT_TOPIC_LEN);
+}
+
+static bool compile_all(const alerts_config_t* cfg, alert_rule_t* rules, char* err, size_t err_size)
+{
+    for (uint8_t i = 0; i < cfg->num_rules; i++) {
+        char msg[64];
+        if (!alert_rule_compile(&cfg->rules[i].expr[0], &rules[i], &msg[0], sizeof(msg))) {
+            snprintf(err, err_size, "Rule %d: %s", i, &msg[0]);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Caller holds s_lock
+static void apply_config(const alerts_config_t* cfg, const alert_rule_t* rules)
+{
+    memcpy(&s_cfg, cfg, sizeof(alerts_config_t));
+    memcpy(&s_rules[0], rules, sizeof(alert_rule_t) * cfg->num_rules);
+    for (uint8_t i = 0; i < ALERT_MAX_RULES; i++) {
+        alert_state_reset(&s_states[i]);
+    }
+    s_banner = -1;
+}
+
+static esp_err_t alerts_save(const alerts_config_t* cfg)
+{
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(ALERTS_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_set_blob(nvs, ALERTS_NVS_KEY, cfg, sizeof(alerts_config_t));
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    return err;
+}
+
+static char* event_to_json(const alert_event_t* ev)
+{
+    cJSON* root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "rule", &ev->expr[0]);
+    cJSON_AddStringToObject(root, "field", alert_field_name(ev->field));
+    cJSON_AddStringToObject(root, "state", ev->active ? "active" : "cleared");
+    cJSON_AddNumberToObject(root, "value", ev->value);
+    cJSON_AddNumberToObject(root, "timestamp", ev->usec);
+    char* json = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return json;
+}
+
+static esp_err_t send_webhook(const char* url, const char* json)
+{
+    esp_http_client_config_t config = {
+        .url = url,
+        .method = HTTP_METHOD_POST,
+        .timeout_ms = ALERTS_WEBHOOK_TIMEOUT_MSEC,
+    };
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    if (client == NULL) {
+        return ESP_FAIL;
+    }
+    esp_http_client_set_header(client, "Content-Type", "application/json");
+    esp_http_client_set_post_field(client, json, strlen(json));
+    esp_err_t err = esp_http_client_perform(client);
+    if (err == ESP_OK && esp_http_client_get_status_code(client) >= 300) {
+        err = ESP_FAIL;
+    }
+    esp_http_client_cleanup(client);
+    return err;
+}
+
+// The MQTT client is (re)created on the notifier task when the configured broker changes
+static void mqtt_update(const char* uri)
+{
+    if (strcmp(uri, &s_mqtt_uri[0]) == 0) {
+        return;
+    }
+    if (s_mqtt != NULL) {
+        esp_mqtt_client_stop(s_mqtt);
+        esp_mqtt_client_destroy(s_mqtt);
+        s_mqtt = NULL;
+    }
+    strlcpy(&s_mqtt_uri[0], uri, sizeof(s_mqtt_uri));
+    if (uri[0] == '\0') {
+        return;
+    }
+    esp_mqtt_client_config_t config = {
+        .uri = uri,
+        .task_prio = AQM_PRIO_MQTT,
+    };
+    s_mqtt = esp_mqtt_client_init(&config);
+    if (s_mqtt == NULL || esp_mqtt_client_start(s_mqtt) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start MQTT client for %s", uri);
+    }
+}
+
+// Network sinks run on their own task so a slow webhook never holds up sample processing
+static void notifier_task(void* arg)
+{
+    alert_event_t ev;
+    char url[ALERT_URL_LEN];
+    char uri[ALERT_URL_LEN];
+    char topic[ALERT_TOPIC_LEN];
+    while (1) {
+        if (xQueueReceive(s_events, &ev, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        strlcpy(&url[0], &s_cfg.webhook_url[0], sizeof(url));
+        strlcpy(&uri[0], &s_cfg.mqtt_uri[0], sizeof(uri));
+        strlcpy(&topic[0], &s_cfg.mqtt_topic[0], sizeof(topic));
+        xSemaphoreGive(s_lock);
+
+        ESP_LOGW(TAG, "Alert %s: %s (%.1f)", ev.active ? "active" : "cleared", &ev.expr[0], ev.value);
+        char* json = event_to_json(&ev);
+        if (json == NULL) {
+            continue;
+        }
+        if ((ev.sinks & ALERT_SINK_WEBHOOK) && url[0] != '\0') {
+            if (send_webhook(&url[0], json) == ESP_OK) {
+                s_stats.webhook_sent++;
+            } else {
+                s_stats.webhook_errors++;
+            }
+        }
+        if (ev.sinks & ALERT_SINK_MQTT) {
+            mqtt_update(&uri[0]);
+            if (s_mqtt != NULL && esp_mqtt_client_publish(s_mqtt, &topic[0], json, 0, 1, 0) >= 0) {
+                s_stats.mqtt_sent++;
+            } else {
+                s_stats.mqtt_errors++;
+            }
+        }
+        free(json);
+    }
+}
+
+esp_err_t alerts_init(void)
+{
+    if (s_lock == NULL) {
+        s_lock = xSemaphoreCreateMutexStatic(&s_lock_buf);
+    }
+
+    alerts_config_t* cfg = malloc(sizeof(alerts_config_t));
+    alert_rule_t* rules = malloc(sizeof(alert_rule_t) * ALERT_MAX_RULES);
+    if (cfg == NULL || rules == NULL) {
+        free(cfg);
+        free(rules);
+        return ESP_ERR_NO_MEM;
+    }
+
+    bool loaded = false;
+    nvs_handle_t nvs;
+    if (nvs_open(ALERTS_NVS_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK) {
+        size_t size = sizeof(alerts_config_t);
+        esp_err_t err = nvs_get_blob(nvs, ALERTS_NVS_KEY, cfg, &size);
+        nvs_close(nvs);
+        char msg[80];
+        loaded = err == ESP_OK && size == sizeof(alerts_config_t) && cfg->version == ALERTS_BLOB_VERSION
+            && cfg->num_rules <= ALERT_MAX_RULES && compile_all(cfg, rules, &msg[0], sizeof(msg));
+    }
+    if (!loaded) {
+        alerts_defaults(cfg);
+        char msg[80];
+        compile_all(cfg, rules, &msg[0], sizeof(msg));
+    }
+    ESP_LOGI(TAG, "%d alert rule(s)%s", cfg->num_rules, loaded ? " loaded from NVS" : " (defaults)");
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    apply_config(cfg, rules);
+    xSemaphoreGive(s_lock);
+    free(cfg);
+    free(rules);
+
+    s_events = xQueueCreate(ALERTS_EVENT_QUEUE_LEN, sizeof(alert_event_t));
+    if (s_events == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    xTaskCreatePinnedToCore(&notifier_task, "aqm-alerts", AQM_STACK_ALERTS, NULL,
+        AQM_PRIO_ALERTS, NULL, AQM_CORE_NET);
+    return ESP_OK;
+}
+
+void alerts_evaluate(const struct sensor_data* sd)
+{
+    int64_t start = esp_timer_get_time();
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (uint8_t i = 0; i < s_cfg.num_rules; i++) {
+        const alert_rule_t* rule = &s_rules[i];
+        alert_state_t* st = &s_states[i];
+        if (!alert_rule_eval(rule, st, alert_field_value(sd, rule->field), sd->timestamp)) {
+            continue;
+        }
+
+        uint8_t sinks = s_cfg.rules[i].sinks;
+        if (sinks & ALERT_SINK_LCD) {
+            if (st->active) {
+                s_banner = i;
+            } else if (s_banner == i) {
+                s_banner = -1;
+                for (uint8_t j = 0; j < s_cfg.num_rules; j++) {
+                    if (s_states[j].active && (s_cfg.rules[j].sinks & ALERT_SINK_LCD)) {
+                        s_banner = j;
+                    }
+                }
+            }
+        }
+
+        alert_event_t ev;
+        strlcpy(&ev.expr[0], &s_cfg.rules[i].expr[0], sizeof(ev.expr));
+        ev.field = rule->field;
+        ev.sinks = sinks;
+        ev.active = st->active;
+        ev.value = st->value;
+        ev.usec = sd->timestamp;
+        s_stats.num_events++;
+        if (xQueueSend(s_events, &ev, 0) != pdTRUE) {
+            s_stats.num_dropped++;
+        }
+    }
+    int64_t elapsed = esp_timer_get_time() - start;
+    s_stats.num_evals++;
+    s_stats.sum_eval_usec += elapsed;
+    if (elapsed > s_stats.max_eval_usec) {
+        s_stats.max_eval_usec = elapsed;
+    }
+    xSemaphoreGive(s_lock);
+}
+
+bool alerts_get_banner(char* buf, size_t size)
+{
+    bool active = false;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (s_banner >= 0) {
+        strlcpy(buf, &s_cfg.rules[s_banner].expr[0], size);
+        active = true;
+    }
+    xSemaphoreGive(s_lock);
+    return active;
+}
+
+const alerts_stats_t* alerts_get_stats(void)
+{
+    return &s_stats;
+}
+
+void alerts_to_json(struct cJSON* root)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    cJSON* rules = cJSON_AddArrayToObject(root, "rules");
+    for (uint8_t i = 0; i < s_cfg.num_rules; i++) {
+        const alert_state_t* st = &s_states[i];
+        cJSON* rule = cJSON_CreateObject();
+        cJSON_AddStringToObject(rule, "expr", &s_cfg.rules[i].expr[0]);
+        cJSON* sinks = cJSON_AddArrayToObject(rule, "sinks");
+        for (size_t s = 0; s < NUM_SINKS; s++) {
+            if (s_cfg.rules[i].sinks & (1 << s)) {
+                cJSON_AddItemToArray(sinks, cJSON_CreateString(s_sink_names[s]));
+            }
+        }
+        cJSON_AddBoolToObject(rule, "active", st->active);
+        cJSON_AddNumberToObject(rule, "value", st->value);
+        cJSON_AddNumberToObject(rule, "changed", st->changed_usec);
+        cJSON_AddItemToArray(rules, rule);
+    }
+    cJSON_AddStringToObject(root, "webhook_url", &s_cfg.webhook_url[0]);
+    cJSON_AddStringToObject(root, "mqtt_uri", &s_cfg.mqtt_uri[0]);
+    cJSON_AddStringToObject(root, "mqtt_topic", &s_cfg.mqtt_topic[0]);
+
+    cJSON* stats = cJSON_AddObjectToObject(root, "stats");
+    cJSON_AddNumberToObject(stats, "num_evals", s_stats.num_evals);
+    cJSON_AddNumberToObject(stats, "avg_eval_usec", s_stats.num_evals ? (double)s_stats.sum_eval_usec / s_stats.num_evals : 0);
+    cJSON_AddNumberToObject(stats, "max_eval_usec", s_stats.max_eval_usec);
+    cJSON_AddNumberToObject(stats, "num_events", s_stats.num_events);
+    cJSON_AddNumberToObject(stats, "num_dropped", s_stats.num_dropped);
+    cJSON_AddNumberToObject(stats, "webhook_sent", s_stats.webhook_sent);
+    cJSON_AddNumberToObject(stats, "webhook_errors", s_stats.webhook_errors);
+    cJSON_AddNumberToObject(stats, "mqtt_sent", s_stats.mqtt_sent);
+    cJSON_AddNumberToObject(stats, "mqtt_errors", s_stats.mqtt_errors);
+    xSemaphoreGive(s_lock);
+}
+
+static bool parse_sinks(const cJSON* item, uint8_t* sinks)
+{
+    if (item == NULL) {
+        *sinks = ALERT_SINK_LCD;
+        return true;
+    }
+    if (!cJSON_IsArray(item)) {
+        return false;
+    }
+    *sinks = 0;
+    const cJSON* name;
+    cJSON_ArrayForEach(name, item) {
+        size_t s = 0;
+        while (s < NUM_SINKS && !(cJSON_IsString(name) && strcmp(name->valuestring, s_sink_names[s]) == 0)) {
+            s++;
+        }
+        if (s == NUM_SINKS) {
+            return false;
+        }
+        *sinks |= 1 << s;
+    }
+    return true;
+}
+
+static bool copy_string(const cJSON* root, const char* key, char* dst, size_t size, char* err, size_t err_size)
+{
+    const cJSON* item = cJSON_GetObjectItem(root, key);
+    if (item == NULL) {
+        return true;
+    }
+    if (!cJSON_IsString(item) || strlen(item->valuestring) >= size) {
+        snprintf(err, err_size, "'%s' must be a string shorter than %d characters", key, (int)size);
+        return false;
+    }
+    strlcpy(dst, item->valuestring, size);
+    return true;
+}
+
+esp_err_t alerts_update_json(const struct cJSON* root, char* err, size_t err_size)
+{
+    if (!cJSON_IsObject(root)) {
+        snprintf(err, err_size, "Expected a JSON object");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    alerts_config_t* cfg = malloc(sizeof(alerts_config_t));
+    alert_rule_t* rules = malloc(sizeof(alert_rule_t) * ALERT_MAX_RULES);
+    if (cfg == NULL || rules == NULL) {
+        free(cfg);
+        free(rules);
+        return ESP_ERR_NO_MEM;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    memcpy(cfg, &s_cfg, sizeof(alerts_config_t));
+    xSemaphoreGive(s_lock);
+
+    esp_err_t ret = ESP_ERR_INVALID_ARG;
+    const cJSON* items = cJSON_GetObjectItem(root, "rules");
+    if (items != NULL) {
+        if (!cJSON_IsArray(items) || cJSON_GetArraySize(items) > ALERT_MAX_RULES) {
+            snprintf(err, err_size, "'rules' must be an array of at most %d rules", ALERT_MAX_RULES);
+            goto done;
+        }
+        cfg->num_rules = 0;
+        const cJSON* item;
+        cJSON_ArrayForEach(item, items) {
+            const cJSON* expr = cJSON_GetObjectItem(item, "expr");
+            uint8_t i = cfg->num_rules;
+            if (!cJSON_IsString(expr) || strlen(expr->valuestring) >= ALERT_EXPR_LEN) {
+                snprintf(err, err_size, "Rule %d: 'expr' must be a string shorter than %d characters", i, ALERT_EXPR_LEN);
+                goto done;
+            }
+            if (!parse_sinks(cJSON_GetObjectItem(item, "sinks"), &cfg->rules[i].sinks)) {
+                snprintf(err, err_size, "Rule %d: 'sinks' must be an array of lcd, webhook, mqtt", i);
+                goto done;
+            }
+            strlcpy(&cfg->rules[i].expr[0], expr->valuestring, ALERT_EXPR_LEN);
+            cfg->num_rules++;
+        }
+    }
+    if (!copy_string(root, "webhook_url", &cfg->webhook_url[0], ALERT_URL_LEN, err, err_size)
+        || !copy_string(root, "mqtt_uri", &cfg->mqtt_uri[0], ALERT_URL_LEN, err, err_size)
+        || !copy_string(root, "mqtt_topic", &cfg->mqtt_topic[0], ALERT_TOPIC_LEN, err, err_size)
+        || !compile_all(cfg, rules, err, err_size)) {
+        goto done;
+    }
+
+    ret = alerts_save(cfg);
+    if (ret == ESP_OK) {
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        apply_config(cfg, rules);
+        xSemaphoreGive(s_lock);
+        ESP_LOGI(TAG, "%d alert rule(s) saved", cfg->num_rules);
+    }
+
+done:
+    free(cfg);
+    free(rules);
+    return ret;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "esp_err.h"
+#include "alert_rules.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ALERTS_BLOB_VERSION 1
+#define ALERT_MAX_RULES 32
+#define ALERT_EXPR_LEN 48
+#define ALERT_URL_LEN 128
+#define ALERT_TOPIC_LEN 64
+
+#define ALERT_SINK_LCD      0x01
+#define ALERT_SINK_WEBHOOK  0x02
+#define ALERT_SINK_MQTT     0x04
+
+// Rule expressions and sink endpoints, persisted to NVS as a single blob. Rules are compiled
+// from their expressions at load time.
+typedef struct alerts_config {
+    uint32_t version;
+    uint8_t num_rules;
+    struct {
+        char expr[ALERT_EXPR_LEN];
+        uint8_t sinks;
+    } rules[ALERT_MAX_RULES];
+    char webhook_url[ALERT_URL_LEN];
+    char mqtt_uri[ALERT_URL_LEN];
+    char mqtt_topic[ALERT_TOPIC_LEN];
+} alerts_config_t;
+
+typedef struct alerts_stats {
+    uint32_t num_evals;
+    int64_t sum_eval_usec;
+    int64_t max_eval_usec;
+    uint32_t num_events;
+    uint32_t num_dropped;
+    uint32_t webhook_sent;
+    uint32_t webhook_errors;
+    uint32_t mqtt_sent;
+    uint32_t mqtt_errors;
+} alerts_stats_t;
+
+struct cJSON;
+
+esp_err_t alerts_init(void);
+// Evaluate every rule against a sample; called once per sample by the reporter
+void alerts_evaluate(const struct sensor_data* sd);
+// Copies the expression of the most recent active LCD alert, false if there is none
+bool alerts_get_banner(char* buf, size_t size);
+const alerts_stats_t* alerts_get_stats(void);
+
+void alerts_to_json(struct cJSON* root);
+// Validate and apply an update. "rules" replaces the whole rule table; on failure nothing is
+// changed and err holds the reason.
+esp_err_t alerts_update_json(const struct cJSON* root, char* err, size_t err_size);
+
+#ifdef __cplusplus
+}
+#endif
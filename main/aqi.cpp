@@ -1,92 +1,255 @@
 #include "aqi.h"
 
+#include <math.h>
+#include <strings.h>
+
+#define BREAKPOINTS(arr) AQI::Breakpoints{ &arr[0], sizeof(arr) / sizeof(arr[0]) }
+#define NO_BREAKPOINTS AQI::Breakpoints{ nullptr, 0 }
+
+namespace {
+
+// From the EPA PM NAAQS revision: https://www.epa.gov/system/files/documents/2024-02/pm-naaqs-air-quality-index-fact-sheet.pdf
+// The 301-400 and 401-500 categories were merged into a single 301-500 segment.
+const AQI::Breakpoint kEpaPm25[] = {
+    {0.0f, 9.0f, 0, 50},
+    {9.1f, 35.4f, 51, 100},
+    {35.5f, 55.4f, 101, 150},
+    {55.5f, 125.4f, 151, 200},
+    {125.5f, 225.4f, 201, 300},
+    {225.5f, 325.4f, 301, 500},
+};
+const AQI::Breakpoint kEpaPm10[] = {
+    {0.0f, 54.0f, 0, 50},
+    {55.0f, 154.0f, 51, 100},
+    {155.0f, 254.0f, 101, 150},
+    {255.0f, 354.0f, 151, 200},
+    {355.0f, 424.0f, 201, 300},
+    {425.0f, 604.0f, 301, 500},
+};
+
+// China MEP HJ 633-2012, 24-hour IAQI. Segments are contiguous, and the standard rounds every
+// IAQI up to the next integer.
+const AQI::Breakpoint kMepPm25[] = {
+    {0.0f, 35.0f, 0, 50},
+    {35.0f, 75.0f, 50, 100},
+    {75.0f, 115.0f, 100, 150},
+    {115.0f, 150.0f, 150, 200},
+    {150.0f, 250.0f, 200, 300},
+    {250.0f, 350.0f, 300, 400},
+    {350.0f, 500.0f, 400, 500},
+};
+const AQI::Breakpoint kMepPm10[] = {
+    {0.0f, 50.0f, 0, 50},
+    {50.0f, 150.0f, 50, 100},
+    {150.0f, 250.0f, 100, 150},
+    {250.0f, 350.0f, 150, 200},
+    {350.0f, 420.0f, 200, 300},
+    {420.0f, 500.0f, 300, 400},
+    {500.0f, 600.0f, 400, 500},
+};
+
+// EU CAQI, hourly background grid. Anything above the last segment is reported as 100 ("very high").
+const AQI::Breakpoint kCaqiPm25[] = {
+    {0.0f, 15.0f, 0, 25},
+    {15.0f, 30.0f, 25, 50},
+    {30.0f, 55.0f, 50, 75},
+    {55.0f, 110.0f, 75, 100},
+};
+const AQI::Breakpoint kCaqiPm10[] = {
+    {0.0f, 25.0f, 0, 25},
+    {25.0f, 50.0f, 25, 50},
+    {50.0f, 90.0f, 50, 75},
+    {90.0f, 180.0f, 75, 100},
+};
+
+// UK DAQI bands 1-10
+const AQI::Breakpoint kDaqiPm25[] = {
+    {0.0f, 11.0f, 1, 1},
+    {12.0f, 23.0f, 2, 2},
+    {24.0f, 35.0f, 3, 3},
+    {36.0f, 41.0f, 4, 4},
+    {42.0f, 47.0f, 5, 5},
+    {48.0f, 53.0f, 6, 6},
+    {54.0f, 58.0f, 7, 7},
+    {59.0f, 64.0f, 8, 8},
+    {65.0f, 70.0f, 9, 9},
+    {71.0f, 1000.0f, 10, 10},
+};
+const AQI::Breakpoint kDaqiPm10[] = {
+    {0.0f, 16.0f, 1, 1},
+    {17.0f, 33.0f, 2, 2},
+    {34.0f, 50.0f, 3, 3},
+    {51.0f, 58.0f, 4, 4},
+    {59.0f, 66.0f, 5, 5},
+    {67.0f, 75.0f, 6, 6},
+    {76.0f, 83.0f, 7, 7},
+    {84.0f, 91.0f, 8, 8},
+    {92.0f, 100.0f, 9, 9},
+    {101.0f, 1000.0f, 10, 10},
+};
+
+// India CPCB National AQI
+const AQI::Breakpoint kNaqiPm25[] = {
+    {0.0f, 30.0f, 0, 50},
+    {31.0f, 60.0f, 51, 100},
+    {61.0f, 90.0f, 101, 200},
+    {91.0f, 120.0f, 201, 300},
+    {121.0f, 250.0f, 301, 400},
+    {251.0f, 380.0f, 401, 500},
+};
+const AQI::Breakpoint kNaqiPm10[] = {
+    {0.0f, 50.0f, 0, 50},
+    {51.0f, 100.0f, 51, 100},
+    {101.0f, 250.0f, 101, 200},
+    {251.0f, 350.0f, 201, 300},
+    {351.0f, 430.0f, 301, 400},
+    {431.0f, 600.0f, 401, 500},
+};
+
+// Indexed by AQI::Algorithm, columns ordered as AQI::Pollutant:
+// PM1, PM2.5, PM4, PM10, VOC, NOx
+const AQI::AlgorithmTable kAlgorithms[AQI::kNumAlgorithms] = {
+    { "epa",  false, { NO_BREAKPOINTS, BREAKPOINTS(kEpaPm25),  NO_BREAKPOINTS, BREAKPOINTS(kEpaPm10),  NO_BREAKPOINTS, NO_BREAKPOINTS } },
+    { "mep",  true,  { NO_BREAKPOINTS, BREAKPOINTS(kMepPm25),  NO_BREAKPOINTS, BREAKPOINTS(kMepPm10),  NO_BREAKPOINTS, NO_BREAKPOINTS } },
+    { "caqi", false, { NO_BREAKPOINTS, BREAKPOINTS(kCaqiPm25), NO_BREAKPOINTS, BREAKPOINTS(kCaqiPm10), NO_BREAKPOINTS, NO_BREAKPOINTS } },
+    { "daqi", false, { NO_BREAKPOINTS, BREAKPOINTS(kDaqiPm25), NO_BREAKPOINTS, BREAKPOINTS(kDaqiPm10), NO_BREAKPOINTS, NO_BREAKPOINTS } },
+    { "naqi", false, { NO_BREAKPOINTS, BREAKPOINTS(kNaqiPm25), NO_BREAKPOINTS, BREAKPOINTS(kNaqiPm10), NO_BREAKPOINTS, NO_BREAKPOINTS } },
+};
+
+const char* kPollutantNames[AQI::kNumPollutants] = {
+    "pm1p0", "pm2p5", "pm4p0", "pm10p0", "voc_index", "nox_index"
+};
+
+int evaluate(const AQI::Breakpoints& table, float concentration, float precision, bool roundUp)
+{
+    if (table.count == 0 || isnan(concentration) || concentration < 0.0f) {
+        return AQI_INVALID;
+    }
+
+    // Truncate to the pollutant's reporting precision, as the EPA technical guidance requires
+    float c = floorf(concentration / precision + 1e-4f) * precision;
+
+    const AQI::Breakpoint* bp = &table.bp[0];
+    for (uint8_t i = 0; i < table.count; i++, bp++) {
+        if (c > bp->conHi) {
+            continue;
+        }
+        // Value falls in the gap between two segments: snap to the nearest edge
+        if (c < bp->conLo && i > 0) {
+            const AQI::Breakpoint* prev = bp - 1;
+            if (c - prev->conHi < bp->conLo - c) {
+                bp = prev;
+                c = prev->conHi;
+            } else {
+                c = bp->conLo;
+            }
+        }
+        break;
+    }
+
+    // Above the last segment, cap at the top of the scale
+    if (bp == &table.bp[table.count]) {
+        bp--;
+        c = bp->conHi;
+    }
+
+    float span = bp->conHi - bp->conLo;
+    if (span <= 0.0f || bp->idxHi == bp->idxLo) {
+        return bp->idxLo;
+    }
+    float value = (float)(bp->idxHi - bp->idxLo) / span * (c - bp->conLo) + (float)bp->idxLo;
+
+    // The tolerance keeps float error in an exact result from rounding it up a whole point
+    return static_cast<int>(roundUp ? ceilf(value - 1e-3f) : value + 0.5f);
+}
+
+} // namespace
+
 AQI::AQI(Algorithm algo)
-: _algo(algo)
+: _algo(Algorithm::EPA),
+  _table(&kAlgorithms[0])
 {
-    initIndices();
-    initAlgos();
+    SetAlgorithm(algo);
 }
 
-int AQI::GetIntermediateIndex(const Concentration& con)
+void AQI::SetAlgorithm(Algorithm algo)
 {
-    if (_algos.find(_algo) == _algos.end()) {
-        return -1;
-    }
-
-    // Get pollutant-to-breakpoints map for specified algorithm
-    BreakpointsMap breakpointsMap = _algos[_algo];
-    Pollutant pollutant = std::get<0>(con);
-    if (breakpointsMap.find(pollutant) == breakpointsMap.end()) {
-        return -2;
-    }
-
-    // Get breakpoints for specified pollutant
-    Breakpoints breakpoints = breakpointsMap[pollutant];
-    float concentration = std::get<1>(con);
-    float bpLo = 0.0f;
-    float bpHi = 1.0f;
-    int idx = 0;
-    for (auto bp : breakpoints) {
-        if (concentration >= std::get<0>(bp) && concentration <= std::get<1>(bp)) {
-            bpLo = std::get<0>(bp);
-            bpHi = std::get<1>(bp);
-            break;
-        }
-        idx++;
+    if (algo >= Algorithm::Count) {
+        return;
     }
+    _algo = algo;
+    _table = &GetTable(algo);
+}
 
-    // Get air quality index
-    if (idx >= _indices.size()) {
-        idx = _indices.size()-1;
+bool AQI::Supports(Pollutant p) const
+{
+    if (p >= Pollutant::Count) {
+        return false;
     }
-    auto aqi = _indices[idx];
-    float aqiLo = std::get<0>(aqi);
-    float aqiHi = std::get<1>(aqi);
-    float value = (aqiHi - aqiLo) / (bpHi - bpLo) * (concentration - bpLo) + aqiLo;
-
-    return static_cast<int>(value);
+    return _table->pollutants[static_cast<size_t>(p)].count > 0;
 }
 
-int AQI::GetIndex(const Concentrations& concentrations)
+int AQI::GetIntermediateIndex(Pollutant p, float concentration) const
 {
-    int idx = 0;
-    for (auto c : concentrations) {
-        int iidx = GetIntermediateIndex(c);
-        if (iidx > idx)
-            idx = iidx;
+    if (p >= Pollutant::Count) {
+        return AQI_INVALID;
     }
-    return idx;
+    return evaluate(_table->pollutants[static_cast<size_t>(p)], concentration, GetPrecision(p), _table->roundUp);
 }
 
-float AQI::GetConcentration(int intermediate)
+int AQI::GetIndex(const Concentrations& con, Indices* subIndices, Pollutant* dominant) const
 {
-    float cons = 0.0f;
-    return cons;
+    // Single pass over every pollutant; the overall index is the worst sub-index
+    int idx = AQI_INVALID;
+    size_t worst = kNumPollutants;
+    for (size_t i = 0; i < kNumPollutants; i++) {
+        Pollutant p = static_cast<Pollutant>(i);
+        int iidx = evaluate(_table->pollutants[i], con[i], GetPrecision(p), _table->roundUp);
+        if (subIndices != nullptr) {
+            (*subIndices)[i] = static_cast<int16_t>(iidx);
+        }
+        if (iidx > idx) {
+            idx = iidx;
+            worst = i;
+        }
+    }
+    if (dominant != nullptr) {
+        *dominant = static_cast<Pollutant>(worst);
+    }
+    return idx;
 }
 
-float AQI::GetMaxConcentration(Pollutant p)
+float AQI::GetMaxConcentration(Pollutant p) const
 {
-    if (_algos.find(_algo) == _algos.end()) {
+    if (!Supports(p)) {
         return 0.0f;
     }
+    const Breakpoints& table = _table->pollutants[static_cast<size_t>(p)];
+    return table.bp[table.count - 1].conHi;
+}
 
-    // Get pollutant-to-breakpoints map for specified algorithm
-    BreakpointsMap breakpointsMap = _algos[_algo];
-    if (breakpointsMap.find(p) == breakpointsMap.end()) {
-        return 0.0f;
+const AQI::AlgorithmTable& AQI::GetTable(Algorithm algo)
+{
+    if (algo >= Algorithm::Count) {
+        return kAlgorithms[0];
     }
+    return kAlgorithms[static_cast<size_t>(algo)];
+}
 
-    // Get breakpoints for specified pollutant
-    Breakpoints breakpoints = breakpointsMap[p];
-    auto bp = breakpoints[breakpoints.size()-1];
-    return std::get<1>(bp);
+const char* AQI::GetName(Algorithm algo)
+{
+    return GetTable(algo).name;
 }
 
 float AQI::GetPrecision(Pollutant p)
 {
     switch (p) {
-    case Pollutant::PM10: return 1.0f;
-    case Pollutant::PM25: return 0.1f;
+    case Pollutant::PM1:
+    case Pollutant::PM25:
+    case Pollutant::PM4: return 0.1f;
+    case Pollutant::PM10:
+    case Pollutant::VOC:
+    case Pollutant::NOX:
     default:
         return 1.0f;
     }
@@ -97,8 +260,12 @@ float AQI::GetPrecision(Pollutant p)
 const char* AQI::GetUnits(Pollutant p)
 {
     switch (p) {
+    case Pollutant::PM1:
+    case Pollutant::PM25:
+    case Pollutant::PM4:
     case Pollutant::PM10: return "µg/m³";
-    case Pollutant::PM25: return "µg/m³";
+    case Pollutant::VOC:
+    case Pollutant::NOX: return "index";
     default:
         return NULL;
     }
@@ -106,82 +273,36 @@ const char* AQI::GetUnits(Pollutant p)
     return NULL;
 }
 
-void AQI::initIndices()
+extern "C" int aqi_algorithm_count(void)
 {
-    // From EPA AQI guidelines: https://www.govinfo.gov/content/pkg/FR-2013-01-15/pdf/2012-30946.pdf
-    // Breakpoints are the same for EPA and MEP algorithms.
-    _indices.clear();
-    _indices.push_back(Breakpoint{0.0f, 50.0f});
-    _indices.push_back(Breakpoint{51.0f, 100.0f});
-    _indices.push_back(Breakpoint{101.0f, 150.0f});
-    _indices.push_back(Breakpoint{151.0f, 200.0f});
-    _indices.push_back(Breakpoint{201.0f, 300.0f});
-    _indices.push_back(Breakpoint{301.0f, 400.0f});
-    _indices.push_back(Breakpoint{401.0f, 500.0f});
+    return static_cast<int>(AQI::kNumAlgorithms);
 }
 
-void AQI::initAlgos()
+extern "C" const char* aqi_algorithm_name(int algo)
 {
-    _algos.clear();
-
-    // EPA algorithm data
-    BreakpointsMap epaBreakpoints;
-    // PM10
-    Breakpoints epa_bp_pm10 = {
-        {0.0f, 54.0f},
-        {55.0f, 154.0f},
-        {155.0f, 254.0f},
-        {255.0f, 354.0f},
-        {355.0f, 424.0f},
-        {425.0f, 504.0f},
-        {505.0f, 604.0f},
-    };
-    epaBreakpoints.emplace(BreakpointEntry{
-       Pollutant::PM10, epa_bp_pm10
-    });
-
-    // PM2.5
-    Breakpoints epa_bp_pm25 = {
-        {0.0f, 12.0f},
-        {12.1f, 35.4f},
-        {35.5f, 55.4f},
-        {55.5f, 150.4f},
-        {150.5f, 250.4f},
-        {250.5f, 350.4f},
-        {350.5f, 500.4f},
-    };
-    epaBreakpoints.emplace(BreakpointEntry{
-        Pollutant::PM25, epa_bp_pm25
-    });
-    _algos.emplace(std::pair<Algorithm, BreakpointsMap>{Algorithm::EPA, epaBreakpoints});
-
-    // MEP algorithm data
-    BreakpointsMap mepBreakpoints;
-    // PM10
-    Breakpoints mep_bp_pm10 = {
-        {0.0f, 50.0f},
-        {51.0f, 150.0f},
-        {151.0f, 250.0f},
-        {251.0f, 350.0f},
-        {351.0f, 420.0f},
-        {421.0f, 500.0f},
-        {501.0f, 600.0f},
-    };
-    mepBreakpoints.emplace(BreakpointEntry{
-        Pollutant::PM10, mep_bp_pm10
-    });
-    // PM2.5
-    Breakpoints mep_bp_pm25 = {
-        {0.0f, 35.0f},
-        {36.0f, 75.0f},
-        {76.0f, 115.0f},
-        {116.0f, 150.0f},
-        {151.0f, 250.0f},
-        {251.0f, 350.0f},
-        {351.0f, 500.0f,}
-    };
-    mepBreakpoints.emplace(BreakpointEntry{
-        Pollutant::PM25, mep_bp_pm25
-    });
-    _algos.emplace(std::pair<Algorithm, BreakpointsMap>{Algorithm::MEP, mepBreakpoints});
+    if (algo < 0 || algo >= aqi_algorithm_count()) {
+        return NULL;
+    }
+    return AQI::GetName(static_cast<AQI::Algorithm>(algo));
+}
+
+extern "C" int aqi_algorithm_from_name(const char* name)
+{
+    if (name == NULL) {
+        return AQI_INVALID;
+    }
+    for (int i = 0; i < aqi_algorithm_count(); i++) {
+        if (strcasecmp(name, kAlgorithms[i].name) == 0) {
+            return i;
+        }
+    }
+    return AQI_INVALID;
+}
+
+extern "C" const char* aqi_pollutant_name(int pollutant)
+{
+    if (pollutant < 0 || pollutant >= AQI_NUM_POLLUTANTS) {
+        return NULL;
+    }
+    return kPollutantNames[pollutant];
 }
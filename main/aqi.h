@@ -18,45 +18,99 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 
 #pragma once
 
-#include <map>
-#include <vector>
+#include <stdint.h>
+
+#define AQI_NUM_POLLUTANTS 6
+#define AQI_NUM_ALGORITHMS 5
+#define AQI_INVALID -1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// C interface for selecting the algorithm at runtime (e.g. from the HTTP server)
+int aqi_algorithm_count(void);
+const char* aqi_algorithm_name(int algo);
+int aqi_algorithm_from_name(const char* name);
+const char* aqi_pollutant_name(int pollutant);
+
+#ifdef __cplusplus
+}
+
+#include <array>
+#include <stddef.h>
 
 class AQI {
 public:
-    enum class Pollutant {
-        None,
+    enum class Pollutant : uint8_t {
+        PM1,
+        PM25,
+        PM4,
         PM10,
-        PM25
+        VOC,
+        NOX,
+        Count
+    };
+
+    enum class Algorithm : uint8_t {
+        EPA,    // US EPA, 2024 PM2.5 NAAQS revision
+        MEP,    // China MEP HJ 633-2012
+        CAQI,   // EU Common Air Quality Index (hourly)
+        DAQI,   // UK Daily Air Quality Index (banded 1-10)
+        NAQI,   // India National Air Quality Index
+        Count
+    };
+
+    static constexpr size_t kNumPollutants = static_cast<size_t>(Pollutant::Count);
+    static constexpr size_t kNumAlgorithms = static_cast<size_t>(Algorithm::Count);
+
+    // Maps concentrations in [conLo, conHi] linearly onto [idxLo, idxHi].
+    // Banded indices (e.g. DAQI) use idxLo == idxHi.
+    struct Breakpoint {
+        float conLo;
+        float conHi;
+        int16_t idxLo;
+        int16_t idxHi;
     };
 
-    enum class Algorithm {
-        None,
-        EPA,
-        MEP
+    struct Breakpoints {
+        const Breakpoint* bp;
+        uint8_t count;
     };
 
-    using Breakpoint = std::pair<float, float>;
-    using Breakpoints = std::vector<Breakpoint>;
-    using BreakpointEntry = std::pair<Pollutant, Breakpoints>;
-    using BreakpointsMap = std::map<Pollutant, Breakpoints>;
+    // One row per algorithm, one breakpoint table per pollutant.
+    // Pollutants an algorithm does not define have count == 0. None of the supported standards
+    // define PM1.0, PM4.0 or the Sensirion VOC/NOx indices, so only PM2.5 and PM10 are evaluated.
+    struct AlgorithmTable {
+        const char* name;
+        bool roundUp;   // sub-indices are rounded up (MEP) rather than to the nearest integer
+        Breakpoints pollutants[kNumPollutants];
+    };
 
-    using Concentration = std::pair<Pollutant, float>;
-    using Concentrations = std::vector<Concentration>;
+    using Concentrations = std::array<float, kNumPollutants>;
+    using Indices = std::array<int16_t, kNumPollutants>;
 
     AQI(Algorithm algo=Algorithm::EPA);
 
-    int GetIntermediateIndex(const Concentration& con);
-    int GetIndex(const Concentrations& con);
-    float GetConcentration(int intermediate);
-    float GetMaxConcentration(Pollutant p);
+    void SetAlgorithm(Algorithm algo);
+    Algorithm GetAlgorithm() const { return _algo; }
+    bool Supports(Pollutant p) const;
+
+    int GetIntermediateIndex(Pollutant p, float concentration) const;
+    int GetIndex(const Concentrations& con, Indices* subIndices=nullptr, Pollutant* dominant=nullptr) const;
+    float GetMaxConcentration(Pollutant p) const;
+
+    static const AlgorithmTable& GetTable(Algorithm algo);
+    static const char* GetName(Algorithm algo);
     static float GetPrecision(Pollutant p);
     static const char* GetUnits(Pollutant p);
 
 private:
-    void initIndices();
-    void initAlgos();
-
     Algorithm _algo;
-    Breakpoints _indices;
-    std::map<Algorithm, BreakpointsMap> _algos;
+    const AlgorithmTable* _table;
 };
+
+static_assert(AQI::kNumPollutants == AQI_NUM_POLLUTANTS, "AQI_NUM_POLLUTANTS out of sync with AQI::Pollutant");
+static_assert(AQI::kNumAlgorithms == AQI_NUM_ALGORITHMS, "AQI_NUM_ALGORITHMS out of sync with AQI::Algorithm");
+
+#endif
@@ -0,0 +1,179 @@
+#include "arena.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+
+#include "cJSON.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const char* TAG = "aqm-arena";
+
+#define ARENA_ALIGN 8
+
+#if CONFIG_AQM_STATIC_ALLOC
+static uint8_t s_arena[CONFIG_AQM_ARENA_SIZE] __attribute__((aligned(ARENA_ALIGN)));
+static size_t s_arena_used = 0;
+#endif
+static portMUX_TYPE s_arena_mux = portMUX_INITIALIZER_UNLOCKED;
+
+typedef struct arena_watch {
+    TaskHandle_t task;
+    const char* name;
+    uint32_t allocs;
+    uint32_t steady_base;   // allocs when the task reached steady state, UINT32_MAX before that
+} arena_watch_t;
+
+static arena_watch_t s_watched[ARENA_MAX_WATCHED];
+static volatile int s_num_watched = 0;
+
+void* arena_alloc(size_t size)
+{
+#if CONFIG_AQM_STATIC_ALLOC
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    void* ptr = NULL;
+    portENTER_CRITICAL(&s_arena_mux);
+    if (s_arena_used + size <= sizeof(s_arena)) {
+        ptr = &s_arena[s_arena_used];
+        s_arena_used += size;
+    }
+    portEXIT_CRITICAL(&s_arena_mux);
+    if (ptr == NULL) {
+        ESP_LOGE(TAG, "Arena exhausted allocating %u bytes (%u of %u used), raise CONFIG_AQM_ARENA_SIZE",
+            (unsigned)size, (unsigned)s_arena_used, (unsigned)sizeof(s_arena));
+    }
+    // The arena is in .bss, so it is already zeroed and never reused
+    return ptr;
+#else
+    return calloc(1, size);
+#endif
+}
+
+void arena_free(void* ptr)
+{
+#if CONFIG_AQM_STATIC_ALLOC
+    if ((uint8_t*)ptr >= &s_arena[0] && (uint8_t*)ptr < &s_arena[sizeof(s_arena)]) {
+        return;
+    }
+#endif
+    free(ptr);
+}
+
+size_t arena_used(void)
+{
+#if CONFIG_AQM_STATIC_ALLOC
+    return s_arena_used;
+#else
+    return 0;
+#endif
+}
+
+size_t arena_size(void)
+{
+#if CONFIG_AQM_STATIC_ALLOC
+    return sizeof(s_arena);
+#else
+    return 0;
+#endif
+}
+
+static arena_watch_t* find_watch(TaskHandle_t task)
+{
+    int n = s_num_watched;
+    for (int i = 0; i < n; i++) {
+        if (s_watched[i].task == task) {
+            return &s_watched[i];
+        }
+    }
+    return NULL;
+}
+
+void arena_watch_task(const char* name)
+{
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    // Tasks register concurrently at startup, so finding, claiming and publishing a slot is one
+    // step. The allocation hook reads without the lock and only scans entries below s_num_watched.
+    portENTER_CRITICAL(&s_arena_mux);
+    if (find_watch(task) == NULL && s_num_watched < ARENA_MAX_WATCHED) {
+        arena_watch_t* w = &s_watched[s_num_watched];
+        w->name = name;
+        w->allocs = 0;
+        w->steady_base = UINT32_MAX;
+        w->task = task;
+        s_num_watched++;
+    }
+    portEXIT_CRITICAL(&s_arena_mux);
+}
+
+void arena_mark_steady(void)
+{
+    arena_watch_t* w = find_watch(xTaskGetCurrentTaskHandle());
+    if (w != NULL && w->steady_base == UINT32_MAX) {
+        w->steady_base = w->allocs;
+    }
+}
+
+uint32_t arena_steady_allocs(void)
+{
+    arena_watch_t* w = find_watch(xTaskGetCurrentTaskHandle());
+    return (w != NULL && w->steady_base != UINT32_MAX) ? w->allocs - w->steady_base : 0;
+}
+
+void arena_to_json(struct cJSON* root)
+{
+    cJSON_AddBoolToObject(root, "static", arena_size() != 0);
+    cJSON_AddNumberToObject(root, "used", arena_used());
+    cJSON_AddNumberToObject(root, "size", arena_size());
+#if CONFIG_AQM_ALLOC_TRACKING
+    cJSON_AddBoolToObject(root, "tracking", true);
+#else
+    cJSON_AddBoolToObject(root, "tracking", false);
+#endif
+    cJSON* tasks = cJSON_AddObjectToObject(root, "tasks");
+    int n = s_num_watched;
+    for (int i = 0; i < n; i++) {
+        const arena_watch_t* w = &s_watched[i];
+        cJSON* entry = cJSON_AddObjectToObject(tasks, w->name);
+        cJSON_AddNumberToObject(entry, "allocs", w->allocs);
+        cJSON_AddNumberToObject(entry, "steady_allocs", w->steady_base != UINT32_MAX ? w->allocs - w->steady_base : 0);
+    }
+}
+
+#if CONFIG_AQM_ALLOC_TRACKING
+// Linked with -Wl,--wrap (see CMakeLists.txt), so this sees the allocations of every component
+// and of libstdc++'s operator new. Must not allocate or log.
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t n, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+static inline void count_alloc(void)
+{
+    if (s_num_watched == 0) {
+        return;
+    }
+    arena_watch_t* w = find_watch(xTaskGetCurrentTaskHandle());
+    if (w != NULL) {
+        w->allocs++;
+    }
+}
+
+void* __wrap_malloc(size_t size)
+{
+    count_alloc();
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t n, size_t size)
+{
+    count_alloc();
+    return __real_calloc(n, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size)
+{
+    count_alloc();
+    return __real_realloc(ptr, size);
+}
+#endif
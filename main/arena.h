@@ -0,0 +1,36 @@
+#pragma once
+
+#include "sdkconfig.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ARENA_MAX_WATCHED 6
+
+// Long-lived objects (created once at boot, kept until restart). With CONFIG_AQM_STATIC_ALLOC
+// they come from a static arena sized at compile time and never touch the heap; otherwise this
+// is calloc(). Memory is zeroed and 8-byte aligned. Returns NULL when the arena is exhausted.
+void* arena_alloc(size_t size);
+// No-op for arena memory, free() for heap memory
+void arena_free(void* ptr);
+size_t arena_used(void);
+size_t arena_size(void);
+
+// Allocation counting (CONFIG_AQM_ALLOC_TRACKING): malloc/calloc/realloc are wrapped at link time
+// and every allocation made by a watched task is counted. A task calls arena_mark_steady() once
+// its loop is warmed up; any allocation after that is a steady-state allocation.
+void arena_watch_task(const char* name);
+void arena_mark_steady(void);
+// Steady-state allocations of the calling task, 0 if it is not watched or tracking is off
+uint32_t arena_steady_allocs(void);
+
+struct cJSON;
+void arena_to_json(struct cJSON* root);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,172 @@
+#include "boot.h"
+#include "task_plan.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "cJSON.h"
+
+static const char* TAG = "aqm-boot";
+
+static struct {
+    boot_step_t steps[BOOT_MAX_STEPS];
+    int num_steps;
+    uint32_t finished;      // done, failed or skipped
+    uint32_t failed;        // failed or skipped
+    int64_t first_sample_usec;
+} s_boot;
+
+static SemaphoreHandle_t s_lock = NULL;
+static StaticSemaphore_t s_lock_buf;
+static EventGroupHandle_t s_done = NULL;
+static StaticEventGroup_t s_done_buf;
+
+static void step_task(void* arg);
+
+// Caller holds s_lock
+static void launch_ready(void)
+{
+    bool progress = true;
+    while (progress) {
+        progress = false;
+        for (int i = 0; i < s_boot.num_steps; i++) {
+            boot_step_t* step = &s_boot.steps[i];
+            uint32_t bit = 1u << i;
+            if (step->state != BOOT_STEP_PENDING || (step->deps & ~s_boot.finished) != 0) {
+                continue;
+            }
+            if (step->deps & s_boot.failed) {
+                step->state = BOOT_STEP_SKIPPED;
+                step->err = ESP_ERR_INVALID_STATE;
+                s_boot.finished |= bit;
+                s_boot.failed |= bit;
+                xEventGroupSetBits(s_done, bit);
+                ESP_LOGW(TAG, "%s skipped, a dependency failed", step->name);
+                progress = true;
+                continue;
+            }
+            step->state = BOOT_STEP_RUNNING;
+            if (xTaskCreatePinnedToCore(&step_task, step->name, AQM_STACK_BOOT, step, AQM_PRIO_BOOT, NULL,
+                    tskNO_AFFINITY) != pdPASS) {
+                step->state = BOOT_STEP_FAILED;
+                step->err = ESP_ERR_NO_MEM;
+                s_boot.finished |= bit;
+                s_boot.failed |= bit;
+                xEventGroupSetBits(s_done, bit);
+                progress = true;
+            }
+        }
+    }
+}
+
+static void step_task(void* arg)
+{
+    boot_step_t* step = (boot_step_t*)arg;
+    uint32_t bit = 1u << (step - &s_boot.steps[0]);
+
+    step->start_usec = esp_timer_get_time();
+    esp_err_t err = step->fn(step->arg);
+    step->end_usec = esp_timer_get_time();
+    step->err = err;
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "[%6lld ms] %s done in %lld ms", step->end_usec / 1000, step->name,
+            (step->end_usec - step->start_usec) / 1000);
+    } else {
+        ESP_LOGE(TAG, "[%6lld ms] %s failed: %s", step->end_usec / 1000, step->name, esp_err_to_name(err));
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    step->state = err == ESP_OK ? BOOT_STEP_DONE : BOOT_STEP_FAILED;
+    s_boot.finished |= bit;
+    if (err != ESP_OK) {
+        s_boot.failed |= bit;
+    }
+    launch_ready();
+    xSemaphoreGive(s_lock);
+
+    xEventGroupSetBits(s_done, bit);
+    vTaskDelete(NULL);
+}
+
+uint32_t boot_add_step(const char* name, boot_fn_t fn, void* arg, uint32_t deps)
+{
+    if (s_boot.num_steps >= BOOT_MAX_STEPS) {
+        ESP_LOGE(TAG, "Too many boot steps, %s not added", name);
+        return 0;
+    }
+    boot_step_t* step = &s_boot.steps[s_boot.num_steps];
+    step->name = name;
+    step->fn = fn;
+    step->arg = arg;
+    step->deps = deps;
+    step->state = BOOT_STEP_PENDING;
+    step->err = ESP_OK;
+    return 1u << s_boot.num_steps++;
+}
+
+void boot_start(void)
+{
+    if (s_lock == NULL) {
+        s_lock = xSemaphoreCreateMutexStatic(&s_lock_buf);
+        s_done = xEventGroupCreateStatic(&s_done_buf);
+    }
+    ESP_LOGI(TAG, "[%6lld ms] starting %d steps", esp_timer_get_time() / 1000, s_boot.num_steps);
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    launch_ready();
+    xSemaphoreGive(s_lock);
+}
+
+esp_err_t boot_wait(uint32_t steps)
+{
+    xEventGroupWaitBits(s_done, steps, pdFALSE, pdTRUE, portMAX_DELAY);
+    for (int i = 0; i < s_boot.num_steps; i++) {
+        if ((steps & (1u << i)) && s_boot.steps[i].err != ESP_OK) {
+            return s_boot.steps[i].err;
+        }
+    }
+    return ESP_OK;
+}
+
+void boot_mark_first_sample(void)
+{
+    if (s_boot.first_sample_usec == 0) {
+        s_boot.first_sample_usec = esp_timer_get_time();
+        ESP_LOGI(TAG, "[%6lld ms] first sample", s_boot.first_sample_usec / 1000);
+    }
+}
+
+const boot_step_t* boot_get_step(int index)
+{
+    return (index >= 0 && index < s_boot.num_steps) ? &s_boot.steps[index] : NULL;
+}
+
+int boot_num_steps(void)
+{
+    return s_boot.num_steps;
+}
+
+int64_t boot_first_sample_usec(void)
+{
+    return s_boot.first_sample_usec;
+}
+
+void boot_to_json(struct cJSON* root)
+{
+    static const char* state_names[] = { "pending", "running", "done", "failed", "skipped" };
+    cJSON_AddNumberToObject(root, "first_sample_msec", s_boot.first_sample_usec / 1000);
+    cJSON* steps = cJSON_AddObjectToObject(root, "steps");
+    for (int i = 0; i < s_boot.num_steps; i++) {
+        const boot_step_t* step = &s_boot.steps[i];
+        cJSON* entry = cJSON_AddObjectToObject(steps, step->name);
+        cJSON_AddStringToObject(entry, "state", state_names[step->state]);
+        cJSON_AddNumberToObject(entry, "start_msec", step->start_usec / 1000);
+        cJSON_AddNumberToObject(entry, "end_msec", step->end_usec / 1000);
+        if (step->err != ESP_OK) {
+            cJSON_AddStringToObject(entry, "error", esp_err_to_name(step->err));
+        }
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "esp_err.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BOOT_MAX_STEPS 16
+
+typedef esp_err_t (*boot_fn_t)(void* arg);
+
+enum boot_step_state {
+    BOOT_STEP_PENDING,
+    BOOT_STEP_RUNNING,
+    BOOT_STEP_DONE,
+    BOOT_STEP_FAILED,
+    BOOT_STEP_SKIPPED,      // a dependency failed
+};
+
+typedef struct boot_step {
+    const char* name;
+    boot_fn_t fn;
+    void* arg;
+    uint32_t deps;          // bits of the steps that must be done first
+    enum boot_step_state state;
+    esp_err_t err;
+    int64_t start_usec;     // esp_timer time, i.e. since the app started
+    int64_t end_usec;
+} boot_step_t;
+
+// Init as a dependency graph. Every step runs in its own task as soon as its dependencies are
+// done, so independent steps (Wi-Fi, display, sensor warm-up) overlap. Steps keep running in the
+// background after boot_wait() returns for the ones the caller needs.
+// Returns the step's bit for use in deps, 0 if the graph is full. Add all steps before boot_start().
+uint32_t boot_add_step(const char* name, boot_fn_t fn, void* arg, uint32_t deps);
+void boot_start(void);
+// Blocks until all the given steps finished; returns the first error among them
+esp_err_t boot_wait(uint32_t steps);
+// Called by the sampler once its first record is published
+void boot_mark_first_sample(void);
+
+const boot_step_t* boot_get_step(int index);
+int boot_num_steps(void);
+int64_t boot_first_sample_usec(void);
+
+struct cJSON;
+void boot_to_json(struct cJSON* root);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,103 @@
+#include "deadband.h"
+#include "alert_rules.h"
+
+#include <stdio.h>
+#include <string.h>
+
+typedef struct deadband_band {
+    int16_t abs;                    // fixed point
+    uint8_t rel_pct;                // of the last reported value, 0 for none
+} deadband_band_t;
+
+// About the sensors' accuracy: changes inside these are noise to anyone reading the feed
+static const deadband_band_t s_bands[SENSOR_NUM_FIELDS] = {
+    [SENSOR_TEMPERATURE_MCP9808] = { 2, 0 },    // 0.125 °C
+    [SENSOR_PM1P0] = { 10, 5 },                 // 1 µg/m³ or 5%
+    [SENSOR_PM2P5] = { 10, 5 },
+    [SENSOR_PM4P0] = { 10, 5 },
+    [SENSOR_PM10P0] = { 10, 5 },
+    [SENSOR_HUMIDITY] = { 50, 0 },              // 0.5 %RH
+    [SENSOR_TEMPERATURE] = { 20, 0 },           // 0.1 °C
+    [SENSOR_VOC_INDEX] = { 50, 5 },             // 5 or 5%
+    [SENSOR_NOX_INDEX] = { 20, 5 },             // 2 or 5%
+};
+
+void deadband_init(deadband_t* db, bool enabled, uint32_t heartbeat_msec)
+{
+    memset(db, 0, sizeof(deadband_t));
+    for (int f = 0; f < SENSOR_NUM_FIELDS; f++) {
+        db->last.value[f] = SENSOR_NONE;
+    }
+    db->enabled = enabled;
+    db->heartbeat_msec = heartbeat_msec;
+}
+
+int16_t deadband_abs(int field)
+{
+    return (field >= 0 && field < SENSOR_NUM_FIELDS) ? s_bands[field].abs : 0;
+}
+
+static bool moved(int field, int16_t last, int16_t v)
+{
+    if ((last == SENSOR_NONE) != (v == SENSOR_NONE)) {
+        return true;
+    }
+    if (v == SENSOR_NONE) {
+        return false;
+    }
+    int32_t band = s_bands[field].abs;
+    int32_t mag = last < 0 ? -(int32_t)last : last;
+    int32_t rel = mag * s_bands[field].rel_pct / 100;
+    band = rel > band ? rel : band;
+    int32_t d = (int32_t)v - last;
+    return d > band || d < -band;
+}
+
+uint32_t deadband_check(deadband_t* db, const struct sensor_data* sd)
+{
+    db->stats.samples++;
+    uint32_t mask = 0;
+    if (!db->enabled || db->last_usec == 0
+        || sd->timestamp - db->last_usec >= (int64_t)db->heartbeat_msec * 1000) {
+        mask = DEADBAND_ALL_FIELDS;
+        db->stats.heartbeats += db->enabled && db->last_usec != 0;
+    } else {
+        for (int f = 0; f < SENSOR_NUM_FIELDS; f++) {
+            if (moved(f, db->last.value[f], sd->sample.value[f])) {
+                mask |= 1u << f;
+            }
+        }
+        if (mask == 0) {
+            return 0;
+        }
+    }
+    for (int f = 0; f < SENSOR_NUM_FIELDS; f++) {
+        if (mask & (1u << f)) {
+            db->last.value[f] = sd->sample.value[f];
+            db->stats.fields_sent++;
+        }
+    }
+    db->last_usec = sd->timestamp;
+    db->stats.reports++;
+    return mask;
+}
+
+size_t deadband_format_json(char* buf, size_t size, uint32_t time, const struct sensor_data* sd, uint32_t mask)
+{
+    int n = snprintf(buf, size, "{\"time\":%u", (unsigned)time);
+    size_t len = n > 0 && (size_t)n < size ? (size_t)n : 0;
+    for (int f = 0; f < SENSOR_NUM_FIELDS; f++) {
+        if (!(mask & (1u << f))) {
+            continue;
+        }
+        n = snprintf(&buf[len], size - len, ",\"%s\":", alert_field_name(f));
+        if (n < 0 || (size_t)n + SENSOR_FORMAT_MAX + 1 >= size - len) {
+            break;
+        }
+        len += (size_t)n;
+        len += sensor_format(&buf[len], size - len, f, sd->sample.value[f]);
+    }
+    buf[len++] = '}';
+    buf[len] = '\0';
+    return len;
+}
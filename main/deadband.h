@@ -0,0 +1,46 @@
+#pragma once
+
+#include "sensor_data.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DEADBAND_ALL_FIELDS ((1u << SENSOR_NUM_FIELDS) - 1)
+#define DEADBAND_JSON_MAX 256       // longest deadband_format_json() output with its terminator
+
+typedef struct deadband_stats {
+    uint32_t samples;
+    uint32_t reports;               // including heartbeats
+    uint32_t heartbeats;            // reports sent only because the device had been silent
+    uint32_t fields_sent;
+} deadband_stats_t;
+
+// Report-by-exception filter. A field is reported when it leaves the band around its last
+// reported value, which is the larger of the field's absolute and relative deadbands, or when
+// it gains or loses a reading. A report carries the fields that moved. If nothing has moved for
+// the heartbeat interval, every field is reported so a receiver can tell the device is alive.
+typedef struct deadband {
+    sensor_sample_t last;           // last reported value per field
+    int64_t last_usec;              // time of the last report, 0 before the first
+    uint32_t heartbeat_msec;
+    bool enabled;                   // false reports every field of every sample
+    deadband_stats_t stats;
+} deadband_t;
+
+void deadband_init(deadband_t* db, bool enabled, uint32_t heartbeat_msec);
+// Absolute deadband of a field, fixed point; also the swinging-door deviation for history
+int16_t deadband_abs(int field);
+// Bit per field to report for this sample, 0 if the sample is not reported
+uint32_t deadband_check(deadband_t* db, const struct sensor_data* sd);
+// Compact JSON object with "time" and the fields in mask under their alert names. Returns the
+// length, size should be DEADBAND_JSON_MAX.
+size_t deadband_format_json(char* buf, size_t size, uint32_t time, const struct sensor_data* sd, uint32_t mask);
+
+#ifdef __cplusplus
+}
+#endif
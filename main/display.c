@@ -0,0 +1,116 @@
+#include "display.h"
+#include "lcd_ascii.h"
+
+#include "sdkconfig.h"
+#include "esp_log.h"
+
+static const char* TAG = "aqm-display";
+
+#define CHECK_ARG(VAL) do { if (!(VAL)) return ESP_ERR_INVALID_ARG; } while (0)
+
+#define I2C_ADDR_PCF8574 0x27
+#define I2C_ADDR_PCF8574A 0x3f
+#define I2C_ADDR_OLED 0x3c
+#define I2C_ADDR_OLED_ALT 0x3d
+#define OLED_MAX_FREQ_HZ I2C_BUS_FREQ_FAST
+
+static const char* s_type_names[DISPLAY_NUM_TYPES] = {
+    [DISPLAY_HD44780] = "hd44780",
+    [DISPLAY_SSD1306] = "ssd1306",
+    [DISPLAY_SH1106] = "sh1106",
+};
+
+const char* display_type_name(enum display_type type)
+{
+    if (type < 0 || type >= DISPLAY_NUM_TYPES) {
+        return "unknown";
+    }
+    return s_type_names[type];
+}
+
+// Both controllers answer at the same address. The low nibble of the status byte reads 0x0 or
+// 0x8 on SH1106 modules and the controller ID (e.g. 0x3) on SSD1306 ones.
+static bool oled_is_sh1106(i2c_bus_dev_t* dev)
+{
+#if CONFIG_AQM_OLED_SH1106
+    return true;
+#elif CONFIG_AQM_OLED_SSD1306
+    return false;
+#else
+    uint8_t status = 0;
+    if (i2c_bus_read(dev, &status, 1) != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to read OLED status, assuming SSD1306");
+        return false;
+    }
+    status &= 0x0f;
+    return status == 0x00 || status == 0x08;
+#endif
+}
+
+display_t* display_probe(const bool found[128])
+{
+    static const uint8_t lcd_addrs[] = { I2C_ADDR_PCF8574, I2C_ADDR_PCF8574A };
+    static const uint8_t oled_addrs[] = { I2C_ADDR_OLED, I2C_ADDR_OLED_ALT };
+
+    for (size_t i = 0; i < sizeof(lcd_addrs); i++) {
+        if (found[lcd_addrs[i]]) {
+            i2c_bus_dev_t* dev = i2c_bus_add_device(lcd_addrs[i], LCD_PCF8574_MAX_FREQ_HZ, I2C_BUS_PRIO_LOW);
+            ESP_LOGI(TAG, "HD44780 %dx%d at 0x%02x", CONFIG_AQM_LCD_COLS, CONFIG_AQM_LCD_ROWS, lcd_addrs[i]);
+            return dev != NULL ? display_hd44780_create(dev, CONFIG_AQM_LCD_ROWS, CONFIG_AQM_LCD_COLS) : NULL;
+        }
+    }
+    for (size_t i = 0; i < sizeof(oled_addrs); i++) {
+        if (found[oled_addrs[i]]) {
+            i2c_bus_dev_t* dev = i2c_bus_add_device(oled_addrs[i], OLED_MAX_FREQ_HZ, I2C_BUS_PRIO_LOW);
+            if (dev == NULL) {
+                return NULL;
+            }
+            bool sh1106 = oled_is_sh1106(dev);
+            ESP_LOGI(TAG, "%s at 0x%02x", sh1106 ? "SH1106" : "SSD1306", oled_addrs[i]);
+            return display_ssd1306_create(dev, sh1106);
+        }
+    }
+    return NULL;
+}
+
+void display_free(display_t* disp)
+{
+    if (disp != NULL) {
+        disp->ops->free(disp);
+    }
+}
+
+esp_err_t display_clear(display_t* disp)
+{
+    CHECK_ARG(disp);
+    return disp->ops->clear(disp);
+}
+
+esp_err_t display_write(display_t* disp, uint8_t col, uint8_t row, const char* text, size_t len)
+{
+    CHECK_ARG(disp && text && row < disp->rows && col < disp->cols);
+    if (len > (size_t)(disp->cols - col)) {
+        len = disp->cols - col;
+    }
+    return disp->ops->write(disp, col, row, text, len);
+}
+
+esp_err_t display_define_glyph(display_t* disp, uint8_t slot, uint8_t first_row, const uint8_t* rows, size_t count)
+{
+    CHECK_ARG(disp && rows && slot < DISPLAY_GLYPH_SLOTS && first_row + count <= DISPLAY_GLYPH_ROWS);
+    return disp->ops->define_glyph(disp, slot, first_row, rows, count);
+}
+
+esp_err_t display_flush(display_t* disp)
+{
+    CHECK_ARG(disp);
+    esp_err_t err = disp->ops->flush(disp);
+    uint32_t bytes = disp->stats.bytes_sent - disp->bytes_at_flush;
+    disp->bytes_at_flush = disp->stats.bytes_sent;
+    disp->stats.refreshes++;
+    disp->stats.last_refresh_bytes = bytes;
+    if (bytes > disp->stats.max_refresh_bytes) {
+        disp->stats.max_refresh_bytes = bytes;
+    }
+    return err;
+}
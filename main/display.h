@@ -0,0 +1,72 @@
+#pragma once
+
+#include "esp_err.h"
+#include "i2c_bus.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DISPLAY_GLYPH_SLOTS 8   // custom characters 0-7, 5x8 pixels, bit 4 is the leftmost column
+#define DISPLAY_GLYPH_ROWS 8
+
+enum display_type {
+    DISPLAY_HD44780,    // character LCD behind a PCF8574 backpack
+    DISPLAY_SSD1306,    // 128x64 OLED
+    DISPLAY_SH1106,     // 128x64 OLED in 132 column RAM
+    DISPLAY_NUM_TYPES
+};
+
+typedef struct display_stats {
+    uint32_t bytes_sent;            // I2C payload bytes
+    uint32_t refreshes;
+    uint32_t last_refresh_bytes;
+    uint32_t max_refresh_bytes;
+} display_stats_t;
+
+struct display;
+
+// Backends draw on a character grid. Character LCDs write through immediately; framebuffer
+// backends collect changes and send the dirty part of each page on flush.
+typedef struct display_ops {
+    esp_err_t (*clear)(struct display* disp);
+    esp_err_t (*write)(struct display* disp, uint8_t col, uint8_t row, const char* text, size_t len);
+    esp_err_t (*define_glyph)(struct display* disp, uint8_t slot, uint8_t first_row, const uint8_t* rows, size_t count);
+    esp_err_t (*flush)(struct display* disp);
+    void (*free)(struct display* disp);
+} display_ops_t;
+
+// Embedded as the first member of each backend's state
+typedef struct display {
+    const display_ops_t* ops;
+    enum display_type type;
+    uint8_t rows;
+    uint8_t cols;
+    display_stats_t stats;
+    uint32_t bytes_at_flush;
+} display_t;
+
+// Picks a backend from the I2C scan and registers its device on the bus. NULL if no supported
+// display was found.
+display_t* display_probe(const bool found[128]);
+void display_free(display_t* disp);
+const char* display_type_name(enum display_type type);
+
+esp_err_t display_clear(display_t* disp);
+// Text is clipped at the end of the row. Codes 0-7 show custom glyphs.
+esp_err_t display_write(display_t* disp, uint8_t col, uint8_t row, const char* text, size_t len);
+// Writes count rows of glyph slot starting at first_row. Characters already showing the glyph change with it.
+esp_err_t display_define_glyph(display_t* disp, uint8_t slot, uint8_t first_row, const uint8_t* rows, size_t count);
+// Ends a refresh: pushes pending changes and records the bytes it took
+esp_err_t display_flush(display_t* disp);
+
+display_t* display_hd44780_create(i2c_bus_dev_t* dev, uint8_t rows, uint8_t cols);
+display_t* display_ssd1306_create(i2c_bus_dev_t* dev, bool sh1106);
+
+#ifdef __cplusplus
+}
+#endif
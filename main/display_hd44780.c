@@ -0,0 +1,81 @@
+#include "display.h"
+#include "lcd_ascii.h"
+#include "arena.h"
+
+#include <stdlib.h>
+
+typedef struct display_hd44780 {
+    display_t base;
+    lcd_ascii_t* lcd;
+} display_hd44780_t;
+
+// The LCD driver counts its own I2C traffic
+static esp_err_t sync_bytes(display_hd44780_t* hd, esp_err_t err)
+{
+    hd->base.stats.bytes_sent = hd->lcd->bytes_sent;
+    return err;
+}
+
+static esp_err_t hd44780_clear(display_t* disp)
+{
+    display_hd44780_t* hd = (display_hd44780_t*)disp;
+    return sync_bytes(hd, lcd_clear(hd->lcd));
+}
+
+static esp_err_t hd44780_write(display_t* disp, uint8_t col, uint8_t row, const char* text, size_t len)
+{
+    display_hd44780_t* hd = (display_hd44780_t*)disp;
+    esp_err_t err = lcd_cursor_pos(hd->lcd, col, row);
+    if (err == ESP_OK) {
+        err = lcd_write(hd->lcd, text, len);
+    }
+    return sync_bytes(hd, err);
+}
+
+static esp_err_t hd44780_define_glyph(display_t* disp, uint8_t slot, uint8_t first_row, const uint8_t* rows, size_t count)
+{
+    display_hd44780_t* hd = (display_hd44780_t*)disp;
+    return sync_bytes(hd, lcd_write_cgram(hd->lcd, slot, first_row, rows, count));
+}
+
+// Characters go out as they are written
+static esp_err_t hd44780_flush(display_t* disp)
+{
+    return ESP_OK;
+}
+
+static void hd44780_free(display_t* disp)
+{
+    display_hd44780_t* hd = (display_hd44780_t*)disp;
+    lcd_free(hd->lcd);
+    arena_free(hd);
+}
+
+static const display_ops_t s_hd44780_ops = {
+    .clear = hd44780_clear,
+    .write = hd44780_write,
+    .define_glyph = hd44780_define_glyph,
+    .flush = hd44780_flush,
+    .free = hd44780_free,
+};
+
+display_t* display_hd44780_create(i2c_bus_dev_t* dev, uint8_t rows, uint8_t cols)
+{
+    display_hd44780_t* hd = arena_alloc(sizeof(display_hd44780_t));
+    if (hd == NULL) {
+        return NULL;
+    }
+    hd->lcd = lcd_init(dev, rows, cols, LCD_CHAR_SIZE_SMALL);
+    if (hd->lcd == NULL) {
+        arena_free(hd);
+        return NULL;
+    }
+    lcd_backlight(hd->lcd, LCD_BACKLIGHT_ON);
+    hd->base.ops = &s_hd44780_ops;
+    hd->base.type = DISPLAY_HD44780;
+    hd->base.rows = rows;
+    hd->base.cols = cols;
+    sync_bytes(hd, ESP_OK);
+    hd->base.bytes_at_flush = hd->base.stats.bytes_sent;
+    return &hd->base;
+}
@@ -0,0 +1,287 @@
+#include "display.h"
+#include "arena.h"
+
+#include "esp_log.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const char* TAG = "aqm-ssd1306";
+
+#define OLED_WIDTH 128
+#define OLED_PAGES 8            // 8 pixel rows per page, one character row each
+#define OLED_CELL_WIDTH 6       // 5 pixel glyph and a blank column
+#define OLED_COLS (OLED_WIDTH / OLED_CELL_WIDTH)
+#define OLED_ROWS OLED_PAGES
+#define SH1106_COL_OFFSET 2     // 128 visible columns centered in 132 columns of RAM
+
+#define OLED_CONTROL_CMD 0x00
+#define OLED_CONTROL_DATA 0x40
+#define OLED_DISPLAY_ON 0xaf
+#define OLED_SET_PAGE 0xb0
+#define OLED_SET_COL_LO 0x00
+#define OLED_SET_COL_HI 0x10
+
+#define FONT_FIRST ' '
+#define FONT_LAST '~'
+#define CHAR_FULL_BLOCK 0xff
+
+// 5x7 ASCII font, one byte per column, bit 0 at the top
+static const uint8_t s_font[FONT_LAST - FONT_FIRST + 1][5] = {
+    { 0x00, 0x00, 0x00, 0x00, 0x00 }, { 0x00, 0x00, 0x5f, 0x00, 0x00 }, { 0x00, 0x07, 0x00, 0x07, 0x00 },
+    { 0x14, 0x7f, 0x14, 0x7f, 0x14 }, { 0x24, 0x2a, 0x7f, 0x2a, 0x12 }, { 0x23, 0x13, 0x08, 0x64, 0x62 },
+    { 0x36, 0x49, 0x55, 0x22, 0x50 }, { 0x00, 0x05, 0x03, 0x00, 0x00 }, { 0x00, 0x1c, 0x22, 0x41, 0x00 },
+    { 0x00, 0x41, 0x22, 0x1c, 0x00 }, { 0x08, 0x2a, 0x1c, 0x2a, 0x08 }, { 0x08, 0x08, 0x3e, 0x08, 0x08 },
+    { 0x00, 0x50, 0x30, 0x00, 0x00 }, { 0x08, 0x08, 0x08, 0x08, 0x08 }, { 0x00, 0x60, 0x60, 0x00, 0x00 },
+    { 0x20, 0x10, 0x08, 0x04, 0x02 }, { 0x3e, 0x51, 0x49, 0x45, 0x3e }, { 0x00, 0x42, 0x7f, 0x40, 0x00 },
+    { 0x42, 0x61, 0x51, 0x49, 0x46 }, { 0x21, 0x41, 0x45, 0x4b, 0x31 }, { 0x18, 0x14, 0x12, 0x7f, 0x10 },
+    { 0x27, 0x45, 0x45, 0x45, 0x39 }, { 0x3c, 0x4a, 0x49, 0x49, 0x30 }, { 0x01, 0x71, 0x09, 0x05, 0x03 },
+    { 0x36, 0x49, 0x49, 0x49, 0x36 }, { 0x06, 0x49, 0x49, 0x29, 0x1e }, { 0x00, 0x36, 0x36, 0x00, 0x00 },
+    { 0x00, 0x56, 0x36, 0x00, 0x00 }, { 0x08, 0x14, 0x22, 0x41, 0x00 }, { 0x14, 0x14, 0x14, 0x14, 0x14 },
+    { 0x00, 0x41, 0x22, 0x14, 0x08 }, { 0x02, 0x01, 0x51, 0x09, 0x06 }, { 0x32, 0x49, 0x79, 0x41, 0x3e },
+    { 0x7e, 0x11, 0x11, 0x11, 0x7e }, { 0x7f, 0x49, 0x49, 0x49, 0x36 }, { 0x3e, 0x41, 0x41, 0x41, 0x22 },
+    { 0x7f, 0x41, 0x41, 0x22, 0x1c }, { 0x7f, 0x49, 0x49, 0x49, 0x41 }, { 0x7f, 0x09, 0x09, 0x09, 0x01 },
+    { 0x3e, 0x41, 0x49, 0x49, 0x7a }, { 0x7f, 0x08, 0x08, 0x08, 0x7f }, { 0x00, 0x41, 0x7f, 0x41, 0x00 },
+    { 0x20, 0x40, 0x41, 0x3f, 0x01 }, { 0x7f, 0x08, 0x14, 0x22, 0x41 }, { 0x7f, 0x40, 0x40, 0x40, 0x40 },
+    { 0x7f, 0x02, 0x0c, 0x02, 0x7f }, { 0x7f, 0x04, 0x08, 0x10, 0x7f }, { 0x3e, 0x41, 0x41, 0x41, 0x3e },
+    { 0x7f, 0x09, 0x09, 0x09, 0x06 }, { 0x3e, 0x41, 0x51, 0x21, 0x5e }, { 0x7f, 0x09, 0x19, 0x29, 0x46 },
+    { 0x46, 0x49, 0x49, 0x49, 0x31 }, { 0x01, 0x01, 0x7f, 0x01, 0x01 }, { 0x3f, 0x40, 0x40, 0x40, 0x3f },
+    { 0x1f, 0x20, 0x40, 0x20, 0x1f }, { 0x3f, 0x40, 0x38, 0x40, 0x3f }, { 0x63, 0x14, 0x08, 0x14, 0x63 },
+    { 0x07, 0x08, 0x70, 0x08, 0x07 }, { 0x61, 0x51, 0x49, 0x45, 0x43 }, { 0x00, 0x7f, 0x41, 0x41, 0x00 },
+    { 0x02, 0x04, 0x08, 0x10, 0x20 }, { 0x00, 0x41, 0x41, 0x7f, 0x00 }, { 0x04, 0x02, 0x01, 0x02, 0x04 },
+    { 0x40, 0x40, 0x40, 0x40, 0x40 }, { 0x00, 0x01, 0x02, 0x04, 0x00 }, { 0x20, 0x54, 0x54, 0x54, 0x78 },
+    { 0x7f, 0x48, 0x44, 0x44, 0x38 }, { 0x38, 0x44, 0x44, 0x44, 0x20 }, { 0x38, 0x44, 0x44, 0x48, 0x7f },
+    { 0x38, 0x54, 0x54, 0x54, 0x18 }, { 0x08, 0x7e, 0x09, 0x01, 0x02 }, { 0x0c, 0x52, 0x52, 0x52, 0x3e },
+    { 0x7f, 0x08, 0x04, 0x04, 0x78 }, { 0x00, 0x44, 0x7d, 0x40, 0x00 }, { 0x20, 0x40, 0x44, 0x3d, 0x00 },
+    { 0x7f, 0x10, 0x28, 0x44, 0x00 }, { 0x00, 0x41, 0x7f, 0x40, 0x00 }, { 0x7c, 0x04, 0x18, 0x04, 0x78 },
+    { 0x7c, 0x08, 0x04, 0x04, 0x78 }, { 0x38, 0x44, 0x44, 0x44, 0x38 }, { 0x7c, 0x14, 0x14, 0x14, 0x08 },
+    { 0x08, 0x14, 0x14, 0x18, 0x7c }, { 0x7c, 0x08, 0x04, 0x04, 0x08 }, { 0x48, 0x54, 0x54, 0x54, 0x20 },
+    { 0x04, 0x3f, 0x44, 0x40, 0x20 }, { 0x3c, 0x40, 0x40, 0x20, 0x7c }, { 0x1c, 0x20, 0x40, 0x20, 0x1c },
+    { 0x3c, 0x40, 0x30, 0x40, 0x3c }, { 0x44, 0x28, 0x10, 0x28, 0x44 }, { 0x0c, 0x50, 0x50, 0x50, 0x3c },
+    { 0x44, 0x64, 0x54, 0x4c, 0x44 }, { 0x00, 0x08, 0x36, 0x41, 0x00 }, { 0x00, 0x00, 0x7f, 0x00, 0x00 },
+    { 0x00, 0x41, 0x36, 0x08, 0x00 }, { 0x08, 0x04, 0x08, 0x10, 0x08 },
+};
+
+static const uint8_t s_init_ssd1306[] = {
+    OLED_CONTROL_CMD,
+    0xae,           // display off
+    0xd5, 0x80,     // clock divide
+    0xa8, 0x3f,     // multiplex 64
+    0xd3, 0x00,     // display offset
+    0x40,           // start line 0
+    0x8d, 0x14,     // charge pump on
+    0x20, 0x02,     // page addressing
+    0xa1,           // segment remap
+    0xc8,           // COM scan descending
+    0xda, 0x12,     // COM pins
+    0x81, 0xcf,     // contrast
+    0xd9, 0xf1,     // precharge
+    0xdb, 0x40,     // VCOMH
+    0xa4,           // resume to RAM content
+    0xa6,           // normal, not inverted
+};
+
+static const uint8_t s_init_sh1106[] = {
+    OLED_CONTROL_CMD,
+    0xae,
+    0xd5, 0x80,
+    0xa8, 0x3f,
+    0xd3, 0x00,
+    0x40,
+    0xad, 0x8b,     // DC-DC on
+    0xa1,
+    0xc8,
+    0xda, 0x12,
+    0x81, 0xcf,
+    0xd9, 0x22,
+    0xdb, 0x40,
+    0xa4,
+    0xa6,
+};
+
+typedef struct display_oled {
+    display_t base;
+    i2c_bus_dev_t* dev;
+    bool sh1106;
+    char text[OLED_ROWS][OLED_COLS];
+    uint8_t glyphs[DISPLAY_GLYPH_SLOTS][DISPLAY_GLYPH_ROWS];
+    uint8_t fb[OLED_PAGES][OLED_WIDTH];
+    // Columns [dirty_x0, dirty_x1) of each page differ from the panel's RAM
+    uint8_t dirty_x0[OLED_PAGES];
+    uint8_t dirty_x1[OLED_PAGES];
+} display_oled_t;
+
+static esp_err_t oled_send(display_oled_t* oled, const uint8_t* data, size_t len)
+{
+    oled->base.stats.bytes_sent += len;
+    return i2c_bus_write(oled->dev, data, len);
+}
+
+static void mark_dirty(display_oled_t* oled, int page, int x0, int x1)
+{
+    if (oled->dirty_x0[page] >= oled->dirty_x1[page]) {
+        oled->dirty_x0[page] = x0;
+        oled->dirty_x1[page] = x1;
+        return;
+    }
+    if (x0 < oled->dirty_x0[page]) {
+        oled->dirty_x0[page] = x0;
+    }
+    if (x1 > oled->dirty_x1[page]) {
+        oled->dirty_x1[page] = x1;
+    }
+}
+
+// Renders one character cell into the framebuffer, extending the page's dirty span only over
+// columns that actually changed
+static void render_cell(display_oled_t* oled, uint8_t col, uint8_t row)
+{
+    uint8_t c = (uint8_t)oled->text[row][col];
+    uint8_t cols[OLED_CELL_WIDTH];
+    memset(&cols[0], 0, sizeof(cols));
+    if (c < DISPLAY_GLYPH_SLOTS) {
+        for (int x = 0; x < 5; x++) {
+            for (int y = 0; y < DISPLAY_GLYPH_ROWS; y++) {
+                if (oled->glyphs[c][y] & (0x10 >> x)) {
+                    cols[x] |= 1 << y;
+                }
+            }
+        }
+    } else if (c == CHAR_FULL_BLOCK) {
+        memset(&cols[0], 0xff, 5);
+    } else if (c >= FONT_FIRST && c <= FONT_LAST) {
+        memcpy(&cols[0], &s_font[c - FONT_FIRST][0], 5);
+    }
+
+    uint8_t* fb = &oled->fb[row][col * OLED_CELL_WIDTH];
+    int x0 = -1;
+    int x1 = -1;
+    for (int x = 0; x < OLED_CELL_WIDTH; x++) {
+        if (fb[x] != cols[x]) {
+            fb[x] = cols[x];
+            if (x0 < 0) {
+                x0 = x;
+            }
+            x1 = x + 1;
+        }
+    }
+    if (x0 >= 0) {
+        mark_dirty(oled, row, col * OLED_CELL_WIDTH + x0, col * OLED_CELL_WIDTH + x1);
+    }
+}
+
+static esp_err_t oled_clear(display_t* disp)
+{
+    display_oled_t* oled = (display_oled_t*)disp;
+    for (uint8_t row = 0; row < OLED_ROWS; row++) {
+        for (uint8_t col = 0; col < OLED_COLS; col++) {
+            oled->text[row][col] = ' ';
+            render_cell(oled, col, row);
+        }
+    }
+    return ESP_OK;
+}
+
+static esp_err_t oled_write(display_t* disp, uint8_t col, uint8_t row, const char* text, size_t len)
+{
+    display_oled_t* oled = (display_oled_t*)disp;
+    for (size_t i = 0; i < len; i++) {
+        oled->text[row][col + i] = text[i];
+        render_cell(oled, col + i, row);
+    }
+    return ESP_OK;
+}
+
+static esp_err_t oled_define_glyph(display_t* disp, uint8_t slot, uint8_t first_row, const uint8_t* rows, size_t count)
+{
+    display_oled_t* oled = (display_oled_t*)disp;
+    memcpy(&oled->glyphs[slot][first_row], rows, count);
+    // Like CGRAM, characters already showing the glyph change with it
+    for (uint8_t row = 0; row < OLED_ROWS; row++) {
+        for (uint8_t col = 0; col < OLED_COLS; col++) {
+            if (oled->text[row][col] == (char)slot) {
+                render_cell(oled, col, row);
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+static esp_err_t oled_flush(display_t* disp)
+{
+    display_oled_t* oled = (display_oled_t*)disp;
+    uint8_t buf[1 + OLED_WIDTH];
+    for (int page = 0; page < OLED_PAGES; page++) {
+        int x0 = oled->dirty_x0[page];
+        int x1 = oled->dirty_x1[page];
+        if (x0 >= x1) {
+            continue;
+        }
+        int ram_x = x0 + (oled->sh1106 ? SH1106_COL_OFFSET : 0);
+        uint8_t cmd[] = {
+            OLED_CONTROL_CMD,
+            (uint8_t)(OLED_SET_PAGE | page),
+            (uint8_t)(OLED_SET_COL_LO | (ram_x & 0x0f)),
+            (uint8_t)(OLED_SET_COL_HI | (ram_x >> 4)),
+        };
+        esp_err_t err = oled_send(oled, &cmd[0], sizeof(cmd));
+        if (err == ESP_OK) {
+            buf[0] = OLED_CONTROL_DATA;
+            memcpy(&buf[1], &oled->fb[page][x0], x1 - x0);
+            err = oled_send(oled, &buf[0], 1 + x1 - x0);
+        }
+        if (err != ESP_OK) {
+            // The span stays dirty and is sent again on the next flush
+            return err;
+        }
+        oled->dirty_x0[page] = 0;
+        oled->dirty_x1[page] = 0;
+    }
+    return ESP_OK;
+}
+
+static void oled_free(display_t* disp)
+{
+    arena_free(disp);
+}
+
+static const display_ops_t s_oled_ops = {
+    .clear = oled_clear,
+    .write = oled_write,
+    .define_glyph = oled_define_glyph,
+    .flush = oled_flush,
+    .free = oled_free,
+};
+
+display_t* display_ssd1306_create(i2c_bus_dev_t* dev, bool sh1106)
+{
+    display_oled_t* oled = arena_alloc(sizeof(display_oled_t));
+    if (oled == NULL) {
+        return NULL;
+    }
+    oled->base.ops = &s_oled_ops;
+    oled->base.type = sh1106 ? DISPLAY_SH1106 : DISPLAY_SSD1306;
+    oled->base.rows = OLED_ROWS;
+    oled->base.cols = OLED_COLS;
+    oled->dev = dev;
+    oled->sh1106 = sh1106;
+    memset(&oled->text[0][0], ' ', sizeof(oled->text));
+
+    esp_err_t err = sh1106 ? oled_send(oled, &s_init_sh1106[0], sizeof(s_init_sh1106))
+                           : oled_send(oled, &s_init_ssd1306[0], sizeof(s_init_ssd1306));
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Init failed: %s", esp_err_to_name(err));
+        arena_free(oled);
+        return NULL;
+    }
+
+    // RAM content is undefined after power-up: clear all of it once before turning the panel on
+    for (int page = 0; page < OLED_PAGES; page++) {
+        mark_dirty(oled, page, 0, OLED_WIDTH);
+    }
+    oled_flush(&oled->base);
+    static const uint8_t on[] = { OLED_CONTROL_CMD, OLED_DISPLAY_ON };
+    oled_send(oled, &on[0], sizeof(on));
+    oled->base.bytes_at_flush = oled->base.stats.bytes_sent;
+    return &oled->base;
+}
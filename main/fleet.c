@@ -0,0 +1,451 @@
+#include "fleet.h"
+#include "task_plan.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_timer.h"
+#include "esp_http_client.h"
+#include "mdns.h"
+
+#include "cJSON.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char* TAG = "aqm-fleet";
+
+#define FLEET_HTTP_PORT 80
+#define FLEET_POLL_TIMEOUT_MSEC 2000
+#define FLEET_RESPONSE_BUFSIZE 1024
+#define FLEET_EVICT_STALE_FACTOR 10 // discovered peers are dropped after this many stale periods
+
+static char s_hostname[24];
+
+#if CONFIG_AQM_GATEWAY
+
+// Fields aggregated across the fleet, in fleet_peer_t.values order
+static const uint8_t s_fields[FLEET_NUM_FIELDS] = {
+    ALERT_FIELD_AQI,
+    ALERT_FIELD_PM2P5,
+    ALERT_FIELD_PM10P0,
+    ALERT_FIELD_VOC_INDEX,
+    ALERT_FIELD_NOX_INDEX,
+    ALERT_FIELD_TEMPERATURE,
+    ALERT_FIELD_HUMIDITY,
+};
+
+static fleet_peer_t s_peers[FLEET_MAX_PEERS];
+static uint8_t s_num_peers = 0;
+static fleet_dist_t s_dist[FLEET_NUM_FIELDS];
+static fleet_stats_t s_stats;
+static SemaphoreHandle_t s_lock = NULL;
+static StaticSemaphore_t s_lock_buf;
+
+static void dist_insert(fleet_dist_t* d, float v)
+{
+    int i = d->count;
+    while (i > 0 && d->sorted[i - 1] > v) {
+        d->sorted[i] = d->sorted[i - 1];
+        i--;
+    }
+    d->sorted[i] = v;
+    d->count++;
+    d->sum += v;
+}
+
+static void dist_remove(fleet_dist_t* d, float v)
+{
+    for (int i = 0; i < d->count; i++) {
+        if (d->sorted[i] == v) {
+            memmove(&d->sorted[i], &d->sorted[i + 1], (d->count - i - 1) * sizeof(float));
+            d->count--;
+            d->sum -= v;
+            return;
+        }
+    }
+}
+
+static float dist_percentile(const fleet_dist_t* d, float p)
+{
+    if (d->count == 0) {
+        return NAN;
+    }
+    float rank = p * (float)(d->count - 1);
+    int lo = (int)rank;
+    int hi = lo + 1 < d->count ? lo + 1 : lo;
+    return d->sorted[lo] + (d->sorted[hi] - d->sorted[lo]) * (rank - (float)lo);
+}
+
+// Caller holds s_lock. Replaces a peer's contribution to the distributions.
+static void peer_update(fleet_peer_t* peer, const float* values, bool fresh)
+{
+    for (int f = 0; f < FLEET_NUM_FIELDS; f++) {
+        if (peer->fresh && !isnan(peer->values[f])) {
+            dist_remove(&s_dist[f], peer->values[f]);
+        }
+        if (values != NULL) {
+            peer->values[f] = values[f];
+        }
+        if (fresh && !isnan(peer->values[f])) {
+            dist_insert(&s_dist[f], peer->values[f]);
+        }
+    }
+    peer->fresh = fresh;
+}
+
+static fleet_peer_t* add_peer(const char* name, const char* host, uint16_t port, bool configured)
+{
+    fleet_peer_t* peer = NULL;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (uint8_t i = 0; i < s_num_peers; i++) {
+        if (strcmp(&s_peers[i].host[0], host) == 0 && s_peers[i].port == port) {
+            xSemaphoreGive(s_lock);
+            return &s_peers[i];
+        }
+    }
+    if (s_num_peers < FLEET_MAX_PEERS) {
+        peer = &s_peers[s_num_peers++];
+        memset(peer, 0, sizeof(fleet_peer_t));
+        strlcpy(&peer->name[0], name, sizeof(peer->name));
+        strlcpy(&peer->host[0], host, sizeof(peer->host));
+        peer->port = port;
+        peer->configured = configured;
+        for (int f = 0; f < FLEET_NUM_FIELDS; f++) {
+            peer->values[f] = NAN;
+        }
+        if (!configured) {
+            // Counts from discovery, so a peer that never answers is evicted once stale, not at once
+            peer->last_seen_usec = esp_timer_get_time();
+            s_stats.num_discovered++;
+        }
+    }
+    xSemaphoreGive(s_lock);
+    if (peer == NULL) {
+        ESP_LOGW(TAG, "Fleet table full, ignoring %s:%d", host, port);
+    } else {
+        ESP_LOGI(TAG, "Peer %s at %s:%d", name, host, port);
+    }
+    return peer;
+}
+
+static void add_configured_peers(void)
+{
+    char list[] = CONFIG_AQM_FLEET_PEERS;
+    char* save = NULL;
+    for (char* tok = strtok_r(&list[0], ", ", &save); tok != NULL; tok = strtok_r(NULL, ", ", &save)) {
+        uint16_t port = FLEET_HTTP_PORT;
+        char* sep = strchr(tok, ':');
+        if (sep != NULL) {
+            *sep = '\0';
+            port = (uint16_t)atoi(sep + 1);
+        }
+        add_peer(tok, tok, port, true);
+    }
+}
+
+#if CONFIG_AQM_FLEET_MDNS
+static void discover_peers(const char* self_ip)
+{
+    mdns_result_t* results = NULL;
+    if (mdns_query_ptr(FLEET_SERVICE_TYPE, FLEET_SERVICE_PROTO, 3000, FLEET_MAX_PEERS, &results) != ESP_OK) {
+        return;
+    }
+    for (mdns_result_t* r = results; r != NULL; r = r->next) {
+        for (mdns_ip_addr_t* a = r->addr; a != NULL; a = a->next) {
+            if (a->addr.type != ESP_IPADDR_TYPE_V4) {
+                continue;
+            }
+            char ip[16];
+            snprintf(&ip[0], sizeof(ip), IPSTR, IP2STR(&a->addr.u_addr.ip4));
+            if (strcmp(&ip[0], self_ip) != 0) {
+                add_peer(r->hostname != NULL ? r->hostname : &ip[0], &ip[0], r->port, false);
+            }
+            break;
+        }
+    }
+    mdns_query_results_free(results);
+}
+#endif
+
+// Fetch a peer's /api/v1/sensor into values. The response is small enough to read in one buffer.
+static esp_err_t poll_peer(const char* host, uint16_t port, char* buf, float* values, size_t* bytes)
+{
+    char url[80];
+    snprintf(&url[0], sizeof(url), "http://%s:%d/api/v1/sensor", host, port);
+    esp_http_client_config_t config = {
+        .url = &url[0],
+        .timeout_ms = FLEET_POLL_TIMEOUT_MSEC,
+    };
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    if (client == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t err = esp_http_client_open(client, 0);
+    int len = 0;
+    if (err == ESP_OK) {
+        esp_http_client_fetch_headers(client);
+        int n;
+        while (len < FLEET_RESPONSE_BUFSIZE - 1
+            && (n = esp_http_client_read(client, buf + len, FLEET_RESPONSE_BUFSIZE - 1 - len)) > 0) {
+            len += n;
+        }
+        if (esp_http_client_get_status_code(client) != 200) {
+            err = ESP_FAIL;
+        }
+        esp_http_client_close(client);
+    }
+    esp_http_client_cleanup(client);
+    if (err != ESP_OK) {
+        return err;
+    }
+    buf[len] = '\0';
+    *bytes = len;
+
+    cJSON* root = cJSON_Parse(buf);
+    if (root == NULL) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    struct sensor_data sd;
+    sensor_data_init(&sd);
+    // Peers report engineering units, except the indices which are sent as the raw x10 value
+    static const struct { const char* key; int field; bool raw; } keys[] = {
+        { "mass_concentration_pm2p5", SENSOR_PM2P5, false },
+        { "mass_concentration_pm10p0", SENSOR_PM10P0, false },
+        { "ambient_humidity", SENSOR_HUMIDITY, false },
+        { "ambient_temperature", SENSOR_TEMPERATURE, false },
+        { "voc_index", SENSOR_VOC_INDEX, true },
+        { "nox_index", SENSOR_NOX_INDEX, true },
+    };
+    for (size_t k = 0; k < sizeof(keys) / sizeof(keys[0]); k++) {
+        const cJSON* item = cJSON_GetObjectItem(root, keys[k].key);
+        if (!cJSON_IsNumber(item)) {
+            continue;
+        }
+        int field = keys[k].field;
+        sd.sample.value[field] = keys[k].raw ? (int16_t)item->valueint : sensor_from_float(field, (float)item->valuedouble);
+    }
+    const cJSON* aqi = cJSON_GetObjectItem(root, "aqi");
+    if (cJSON_IsNumber(aqi)) {
+        sd.aqi = (int16_t)aqi->valueint;
+    }
+    cJSON_Delete(root);
+
+    for (int f = 0; f < FLEET_NUM_FIELDS; f++) {
+        values[f] = alert_field_value(&sd, s_fields[f]);
+    }
+    return ESP_OK;
+}
+
+static void sweep_stale(int64_t now)
+{
+    const int64_t stale = CONFIG_AQM_FLEET_STALE_SEC * 1000000LL;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (uint8_t i = 0; i < s_num_peers; i++) {
+        fleet_peer_t* peer = &s_peers[i];
+        int64_t age = now - peer->last_seen_usec;
+        if (peer->fresh && age > stale) {
+            peer_update(peer, NULL, false);
+        }
+        if (!peer->local && !peer->configured && age > stale * FLEET_EVICT_STALE_FACTOR) {
+            ESP_LOGI(TAG, "Evicting peer %s", &peer->name[0]);
+            memmove(peer, peer + 1, (s_num_peers - i - 1) * sizeof(fleet_peer_t));
+            s_num_peers--;
+            i--;
+        }
+    }
+    xSemaphoreGive(s_lock);
+}
+
+static void poll_task(void* arg)
+{
+    const char* self_ip = (const char*)arg;
+    char* buf = malloc(FLEET_RESPONSE_BUFSIZE);
+    uint32_t cycle = 0;
+    while (buf != NULL) {
+#if CONFIG_AQM_FLEET_MDNS
+        if (cycle % CONFIG_AQM_FLEET_DISCOVERY_CYCLES == 0) {
+            discover_peers(self_ip);
+        }
+#else
+        (void)self_ip;
+#endif
+        cycle++;
+
+        // Only this task adds or evicts remote peers, so indices stay valid while polling unlocked
+        for (uint8_t i = 0; i < s_num_peers; i++) {
+            char host[sizeof(s_peers[i].host)];
+            xSemaphoreTake(s_lock, portMAX_DELAY);
+            bool local = s_peers[i].local;
+            strlcpy(&host[0], &s_peers[i].host[0], sizeof(host));
+            uint16_t port = s_peers[i].port;
+            xSemaphoreGive(s_lock);
+            if (local) {
+                continue;
+            }
+
+            float values[FLEET_NUM_FIELDS];
+            size_t bytes = 0;
+            int64_t start = esp_timer_get_time();
+            esp_err_t err = poll_peer(&host[0], port, buf, &values[0], &bytes);
+            int64_t end = esp_timer_get_time();
+
+            xSemaphoreTake(s_lock, portMAX_DELAY);
+            fleet_peer_t* peer = &s_peers[i];
+            peer->num_polls++;
+            s_stats.num_polls++;
+            s_stats.sum_poll_usec += end - start;
+            s_stats.bytes += bytes;
+            if (err == ESP_OK) {
+                peer->last_seen_usec = end;
+                peer_update(peer, &values[0], true);
+            } else {
+                peer->num_errors++;
+                s_stats.num_errors++;
+            }
+            xSemaphoreGive(s_lock);
+        }
+
+        sweep_stale(esp_timer_get_time());
+        vTaskDelay(pdMS_TO_TICKS(CONFIG_AQM_FLEET_POLL_INTERVAL_SEC * 1000));
+    }
+    ESP_LOGE(TAG, "Out of memory, fleet polling stopped");
+    vTaskDelete(NULL);
+}
+
+void fleet_update_local(const struct sensor_data* sd)
+{
+    if (s_lock == NULL) {
+        return;
+    }
+    float values[FLEET_NUM_FIELDS];
+    for (int f = 0; f < FLEET_NUM_FIELDS; f++) {
+        values[f] = alert_field_value(sd, s_fields[f]);
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    fleet_peer_t* peer = &s_peers[0];
+    peer->last_seen_usec = esp_timer_get_time();
+    peer->num_polls++;
+    peer_update(peer, &values[0], true);
+    xSemaphoreGive(s_lock);
+}
+
+static void add_dist(cJSON* parent, const char* name, const fleet_dist_t* d)
+{
+    cJSON* obj = cJSON_AddObjectToObject(parent, name);
+    cJSON_AddNumberToObject(obj, "count", d->count);
+    if (d->count == 0) {
+        return;
+    }
+    cJSON_AddNumberToObject(obj, "min", d->sorted[0]);
+    cJSON_AddNumberToObject(obj, "mean", d->sum / d->count);
+    cJSON_AddNumberToObject(obj, "p50", dist_percentile(d, 0.5f));
+    cJSON_AddNumberToObject(obj, "p90", dist_percentile(d, 0.9f));
+    cJSON_AddNumberToObject(obj, "max", d->sorted[d->count - 1]);
+}
+
+void fleet_to_json(struct cJSON* root)
+{
+    int64_t now = esp_timer_get_time();
+    cJSON_AddBoolToObject(root, "gateway", true);
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+
+    // The building is as good as its worst room
+    const fleet_dist_t* aqi = &s_dist[0];
+    if (aqi->count > 0) {
+        cJSON_AddNumberToObject(root, "building_aqi", aqi->sorted[aqi->count - 1]);
+    }
+    cJSON* building = cJSON_AddObjectToObject(root, "building");
+    for (int f = 0; f < FLEET_NUM_FIELDS; f++) {
+        add_dist(building, alert_field_name(s_fields[f]), &s_dist[f]);
+    }
+
+    cJSON* peers = cJSON_AddArrayToObject(root, "peers");
+    for (uint8_t i = 0; i < s_num_peers; i++) {
+        const fleet_peer_t* peer = &s_peers[i];
+        cJSON* p = cJSON_CreateObject();
+        cJSON_AddStringToObject(p, "name", &peer->name[0]);
+        cJSON_AddStringToObject(p, "host", &peer->host[0]);
+        cJSON_AddNumberToObject(p, "port", peer->port);
+        cJSON_AddBoolToObject(p, "fresh", peer->fresh);
+        if (peer->last_seen_usec != 0) {
+            cJSON_AddNumberToObject(p, "age_sec", (double)(now - peer->last_seen_usec) / 1000000.0);
+        }
+        cJSON_AddNumberToObject(p, "num_polls", peer->num_polls);
+        cJSON_AddNumberToObject(p, "num_errors", peer->num_errors);
+        for (int f = 0; f < FLEET_NUM_FIELDS; f++) {
+            if (!isnan(peer->values[f])) {
+                cJSON_AddNumberToObject(p, alert_field_name(s_fields[f]), peer->values[f]);
+            }
+        }
+        cJSON_AddItemToArray(peers, p);
+    }
+
+    double elapsed = (double)(now - s_stats.start_usec) / 1000000.0;
+    cJSON* stats = cJSON_AddObjectToObject(root, "stats");
+    cJSON_AddNumberToObject(stats, "num_peers", s_num_peers);
+    cJSON_AddNumberToObject(stats, "num_polls", s_stats.num_polls);
+    cJSON_AddNumberToObject(stats, "num_errors", s_stats.num_errors);
+    cJSON_AddNumberToObject(stats, "num_discovered", s_stats.num_discovered);
+    cJSON_AddNumberToObject(stats, "polls_per_sec", elapsed > 0 ? s_stats.num_polls / elapsed : 0);
+    cJSON_AddNumberToObject(stats, "bytes_per_sec", elapsed > 0 ? s_stats.bytes / elapsed : 0);
+    cJSON_AddNumberToObject(stats, "avg_poll_usec", s_stats.num_polls ? s_stats.sum_poll_usec / s_stats.num_polls : 0);
+    cJSON_AddNumberToObject(stats, "bytes_per_peer", sizeof(fleet_peer_t) + FLEET_NUM_FIELDS * sizeof(float));
+    xSemaphoreGive(s_lock);
+}
+
+#else
+
+void fleet_update_local(const struct sensor_data* sd)
+{
+}
+
+void fleet_to_json(struct cJSON* root)
+{
+    cJSON_AddBoolToObject(root, "gateway", false);
+    cJSON_AddStringToObject(root, "hostname", &s_hostname[0]);
+}
+
+#endif // CONFIG_AQM_GATEWAY
+
+esp_err_t fleet_init(const char* ip_str)
+{
+    uint8_t mac[6];
+    esp_read_mac(&mac[0], ESP_MAC_WIFI_STA);
+    snprintf(&s_hostname[0], sizeof(s_hostname), "esper-aqm-%02x%02x%02x", mac[3], mac[4], mac[5]);
+
+    // Every monitor advertises itself so a gateway on the same network can find it
+    esp_err_t err = mdns_init();
+    if (err == ESP_OK) {
+        mdns_hostname_set(&s_hostname[0]);
+        mdns_instance_name_set(&s_hostname[0]);
+        err = mdns_service_add(NULL, FLEET_SERVICE_TYPE, FLEET_SERVICE_PROTO, FLEET_HTTP_PORT, NULL, 0);
+    }
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Advertising %s.local", &s_hostname[0]);
+    } else {
+        // Configured peers can still be polled without mDNS
+        ESP_LOGE(TAG, "mDNS init failed (%s)", esp_err_to_name(err));
+    }
+
+#if CONFIG_AQM_GATEWAY
+    s_lock = xSemaphoreCreateMutexStatic(&s_lock_buf);
+    memset(&s_stats, 0, sizeof(fleet_stats_t));
+    s_stats.start_usec = esp_timer_get_time();
+
+    fleet_peer_t* self = add_peer(&s_hostname[0], ip_str, FLEET_HTTP_PORT, true);
+    self->local = true;
+    add_configured_peers();
+
+    static char self_ip[16];
+    strlcpy(&self_ip[0], ip_str, sizeof(self_ip));
+    xTaskCreatePinnedToCore(&poll_task, "aqm-fleet", AQM_STACK_FLEET, &self_ip[0],
+        AQM_PRIO_FLEET, NULL, AQM_CORE_NET);
+    ESP_LOGI(TAG, "Gateway mode, polling every %ds", CONFIG_AQM_FLEET_POLL_INTERVAL_SEC);
+#endif
+    return ESP_OK;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "esp_err.h"
+#include "sensor_data.h"
+#include "alert_rules.h"
+#include "sdkconfig.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FLEET_SERVICE_TYPE "_esper-aqm"
+#define FLEET_SERVICE_PROTO "_tcp"
+#define FLEET_NUM_FIELDS 7
+
+#if CONFIG_AQM_GATEWAY
+#define FLEET_MAX_PEERS CONFIG_AQM_FLEET_MAX_PEERS
+#else
+#define FLEET_MAX_PEERS 1
+#endif
+
+typedef struct fleet_peer {
+    char name[32];
+    char host[40];
+    uint16_t port;
+    bool local;             // this device, fed from the reporter instead of polled
+    bool configured;        // from CONFIG_AQM_FLEET_PEERS, never evicted
+    bool fresh;
+    int64_t last_seen_usec; // last answer, or discovery until the first one; 0 if neither
+    uint32_t num_polls;
+    uint32_t num_errors;
+    float values[FLEET_NUM_FIELDS];
+} fleet_peer_t;
+
+// Running distribution of one field over the fresh peers, kept sorted so percentiles are a
+// lookup. Updated as each peer reports rather than recomputed per request.
+typedef struct fleet_dist {
+    float sorted[FLEET_MAX_PEERS];
+    uint8_t count;
+    double sum;
+} fleet_dist_t;
+
+typedef struct fleet_stats {
+    int64_t start_usec;
+    uint32_t num_polls;
+    uint32_t num_errors;
+    uint64_t bytes;
+    int64_t sum_poll_usec;
+    uint32_t num_discovered;
+} fleet_stats_t;
+
+struct cJSON;
+
+// Advertises this device over mDNS and, in gateway mode, starts discovering and polling peers
+esp_err_t fleet_init(const char* ip_str);
+// Feeds this device's own sample into the fleet table (gateway mode only)
+void fleet_update_local(const struct sensor_data* sd);
+void fleet_to_json(struct cJSON* root);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,421 @@
+#include "health.h"
+#include "alert_rules.h"
+#include "sample_bus.h"
+#include "task_plan.h"
+
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "nvs.h"
+
+#include "cJSON.h"
+
+#include <math.h>
+#include <string.h>
+
+static const char* TAG = "aqm-health";
+
+#define HEALTH_NVS_NAMESPACE "aqm"
+#define HEALTH_NVS_KEY "health"
+#define HEALTH_SAVE_INTERVAL_SEC 3600
+#define HEALTH_MAX_GAP_USEC (60 * 1000000LL)        // longer gaps are idle time (power save, sensor off)
+#define HEALTH_SHORT_TAU_USEC (15 * 60 * 1000000LL)
+#define HEALTH_LONG_TAU_USEC (24 * 3600 * 1000000LL)
+#define HEALTH_QUIET_HOLD_USEC (10 * 60 * 1000000LL)
+#define HEALTH_CLEAN_RETRY_USEC (3600 * 1000000LL)
+#define HEALTH_VOC_BASELINE 100.0f                  // the VOC index averages 100 over the past day
+#define HEALTH_DRIFT_MIN_SAMPLES 100
+#define HEALTH_DRIFT_MIN_Z 4.0f
+#define HEALTH_PM_RATIO_MIN_PM2P5 5.0f
+
+static const struct {
+    uint32_t bit;
+    const char* name;
+} s_flags[] = {
+    { SEN5X_STATUS_FAN_SPEED, "fan_speed_warning" },
+    { SEN5X_STATUS_FAN_CLEANING, "fan_cleaning" },
+    { SEN5X_STATUS_GAS_ERROR, "gas_error" },
+    { SEN5X_STATUS_RHT_ERROR, "rht_error" },
+    { SEN5X_STATUS_LASER_ERROR, "laser_error" },
+    { SEN5X_STATUS_FAN_ERROR, "fan_error" },
+};
+#define NUM_FLAGS (sizeof(s_flags) / sizeof(s_flags[0]))
+#define SEN5X_STATUS_ERRORS (SEN5X_STATUS_GAS_ERROR | SEN5X_STATUS_RHT_ERROR | SEN5X_STATUS_LASER_ERROR | SEN5X_STATUS_FAN_ERROR)
+
+static const char* s_drift_names[HEALTH_NUM_DRIFT] = {
+    [HEALTH_DRIFT_TEMPERATURE_OFFSET] = "temperature_offset",
+    [HEALTH_DRIFT_PM_RATIO] = "pm1p0_pm2p5_ratio",
+};
+// Smallest change of a channel's window mean against its baseline that counts as drift
+static const float s_drift_threshold[HEALTH_NUM_DRIFT] = {
+    [HEALTH_DRIFT_TEMPERATURE_OFFSET] = 1.0f,
+    [HEALTH_DRIFT_PM_RATIO] = 0.15f,
+};
+
+typedef struct health_drift {
+    health_stat_t window;
+    float delta;        // last closed window mean minus baseline mean
+    float z;
+    bool drifting;
+} health_drift_t;
+
+static struct {
+    health_record_t rec;
+    uint64_t saved_sec;         // operating_sec at the last save
+    int64_t last_usec;
+    int64_t operating_usec;     // sub-second remainder of operating time
+    uint32_t status;
+    int16_t read_error;
+    uint32_t flag_counts[NUM_FLAGS];
+    uint32_t read_errors;
+    uint32_t samples;
+    float pm_short, pm_long, voc_short;
+    bool have_ewma;
+    int64_t quiet_since_usec;   // 0 when not quiet
+    int64_t clean_retry_usec;
+    uint32_t clean_failures;
+    int64_t window_start_usec;
+    uint32_t windows;
+    health_drift_t drift[HEALTH_NUM_DRIFT];
+} s_health;
+
+static sample_bus_t* s_bus = NULL;
+static sample_sub_t* s_sub = NULL;
+static bool s_clean_requested = false;  // set by the health task, taken by the sampler
+static int s_clean_result = 0;          // 1 started, -1 failed, written by the sampler
+static SemaphoreHandle_t s_lock = NULL;
+static StaticSemaphore_t s_lock_buf;
+
+static void stat_add(health_stat_t* st, float v)
+{
+    st->n++;
+    float d = v - st->mean;
+    st->mean += d / (float)st->n;
+    st->m2 += d * (v - st->mean);
+}
+
+static float stat_var(const health_stat_t* st)
+{
+    return st->n > 1 ? st->m2 / (float)(st->n - 1) : 0.0f;
+}
+
+static esp_err_t health_save(void)
+{
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(HEALTH_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_set_blob(nvs, HEALTH_NVS_KEY, &s_health.rec, sizeof(health_record_t));
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    if (err == ESP_OK) {
+        s_health.saved_sec = s_health.rec.operating_sec;
+    } else {
+        ESP_LOGE(TAG, "Failed to save health record: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+static void health_load(void)
+{
+    memset(&s_health.rec, 0, sizeof(health_record_t));
+    s_health.rec.version = HEALTH_BLOB_VERSION;
+
+    nvs_handle_t nvs;
+    if (nvs_open(HEALTH_NVS_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK) {
+        health_record_t stored;
+        size_t size = sizeof(health_record_t);
+        esp_err_t err = nvs_get_blob(nvs, HEALTH_NVS_KEY, &stored, &size);
+        nvs_close(nvs);
+        if (err == ESP_OK && size == sizeof(health_record_t) && stored.version == HEALTH_BLOB_VERSION) {
+            memcpy(&s_health.rec, &stored, sizeof(health_record_t));
+        }
+    }
+    s_health.saved_sec = s_health.rec.operating_sec;
+    ESP_LOGI(TAG, "SEN5x operating hours %.1f, %u fan cleanings",
+        s_health.rec.operating_sec / 3600.0, s_health.rec.clean_count);
+}
+
+static void close_drift_window(void)
+{
+    bool save = false;
+    for (int ch = 0; ch < HEALTH_NUM_DRIFT; ch++) {
+        health_drift_t* d = &s_health.drift[ch];
+        health_stat_t* base = &s_health.rec.baseline[ch];
+        if (d->window.n >= HEALTH_DRIFT_MIN_SAMPLES) {
+            if (base->n == 0) {
+                // The first full window after install becomes the reference
+                *base = d->window;
+                save = true;
+            } else {
+                float se = sqrtf(stat_var(base) / base->n + stat_var(&d->window) / d->window.n);
+                d->delta = d->window.mean - base->mean;
+                d->z = se > 0.0f ? d->delta / se : 0.0f;
+                bool drifting = fabsf(d->delta) > s_drift_threshold[ch] && fabsf(d->z) > HEALTH_DRIFT_MIN_Z;
+                if (drifting && !d->drifting) {
+                    ESP_LOGW(TAG, "Drift in %s: %.3f from baseline %.3f", s_drift_names[ch], d->delta, base->mean);
+                }
+                d->drifting = drifting;
+            }
+        }
+        memset(&d->window, 0, sizeof(health_stat_t));
+    }
+    s_health.windows++;
+    if (save) {
+        health_save();
+    }
+}
+
+static void update_drift(const struct sensor_data* sd)
+{
+    if (s_health.window_start_usec == 0) {
+        s_health.window_start_usec = sd->timestamp;
+    }
+
+    float temperature = alert_field_value(sd, ALERT_FIELD_TEMPERATURE);
+    float reference = alert_field_value(sd, ALERT_FIELD_TEMPERATURE_MCP9808);
+    if (sd->sen5x_error == 0 && !(sd->sen5x_status & SEN5X_STATUS_RHT_ERROR) && !isnan(temperature) && !isnan(reference)) {
+        stat_add(&s_health.drift[HEALTH_DRIFT_TEMPERATURE_OFFSET].window, temperature - reference);
+    }
+    float pm1p0 = alert_field_value(sd, ALERT_FIELD_PM1P0);
+    float pm2p5 = alert_field_value(sd, ALERT_FIELD_PM2P5);
+    if (sd->sen5x_error == 0 && !(sd->sen5x_status & SEN5X_STATUS_PM_INVALID) && !isnan(pm1p0)
+        && pm2p5 >= HEALTH_PM_RATIO_MIN_PM2P5) {
+        stat_add(&s_health.drift[HEALTH_DRIFT_PM_RATIO].window, pm1p0 / pm2p5);
+    }
+
+    if (sd->timestamp - s_health.window_start_usec >= (int64_t)CONFIG_AQM_HEALTH_DRIFT_WINDOW_HOURS * 3600 * 1000000LL) {
+        close_drift_window();
+        s_health.window_start_usec = sd->timestamp;
+    }
+}
+
+// Low activity: PM2.5 at or below its daily average and VOC below the sensor's own baseline,
+// held for a while
+static void update_activity(const struct sensor_data* sd, int64_t dt)
+{
+    float pm = alert_field_value(sd, ALERT_FIELD_PM2P5);
+    float voc = alert_field_value(sd, ALERT_FIELD_VOC_INDEX);
+    if (sd->sen5x_error != 0 || (sd->sen5x_status & SEN5X_STATUS_PM_INVALID) || isnan(pm) || isnan(voc)) {
+        return;
+    }
+    if (!s_health.have_ewma) {
+        s_health.pm_short = s_health.pm_long = pm;
+        s_health.voc_short = voc;
+        s_health.have_ewma = true;
+    } else {
+        float a_short = fminf(1.0f, (float)dt / HEALTH_SHORT_TAU_USEC);
+        float a_long = fminf(1.0f, (float)dt / HEALTH_LONG_TAU_USEC);
+        s_health.pm_short += a_short * (pm - s_health.pm_short);
+        s_health.voc_short += a_short * (voc - s_health.voc_short);
+        s_health.pm_long += a_long * (pm - s_health.pm_long);
+    }
+
+    bool quiet = s_health.pm_short <= s_health.pm_long && s_health.voc_short < HEALTH_VOC_BASELINE;
+    if (!quiet) {
+        s_health.quiet_since_usec = 0;
+    } else if (s_health.quiet_since_usec == 0) {
+        s_health.quiet_since_usec = sd->timestamp;
+    }
+}
+
+static bool low_activity(int64_t now)
+{
+    return s_health.quiet_since_usec != 0 && now - s_health.quiet_since_usec >= HEALTH_QUIET_HOLD_USEC;
+}
+
+static uint64_t sec_since_clean(void)
+{
+    return s_health.rec.operating_sec - s_health.rec.last_clean_sec;
+}
+
+static void schedule_cleaning(int64_t now)
+{
+    int result = __atomic_exchange_n(&s_clean_result, 0, __ATOMIC_ACQ_REL);
+    if (result > 0) {
+        ESP_LOGI(TAG, "Fan cleaning started after %.1f operating hours", sec_since_clean() / 3600.0);
+        s_health.rec.last_clean_sec = s_health.rec.operating_sec;
+        s_health.rec.clean_count++;
+        health_save();
+    } else if (result < 0) {
+        ESP_LOGW(TAG, "Fan cleaning command failed, retrying later");
+        s_health.clean_failures++;
+        s_health.clean_retry_usec = now + HEALTH_CLEAN_RETRY_USEC;
+    }
+
+    const uint64_t interval = (uint64_t)CONFIG_AQM_FAN_CLEAN_INTERVAL_HOURS * 3600;
+    const uint64_t overdue = interval + (uint64_t)CONFIG_AQM_FAN_CLEAN_GRACE_HOURS * 3600;
+    uint64_t since = sec_since_clean();
+    if (since < interval || now < s_health.clean_retry_usec || __atomic_load_n(&s_clean_requested, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+    if (low_activity(now) || since >= overdue) {
+        __atomic_store_n(&s_clean_requested, true, __ATOMIC_RELEASE);
+    }
+}
+
+static void process(const struct sensor_data* sd)
+{
+    int64_t dt = s_health.last_usec != 0 ? sd->timestamp - s_health.last_usec : 0;
+    s_health.last_usec = sd->timestamp;
+    s_health.samples++;
+    s_health.status = sd->sen5x_status;
+    s_health.read_error = sd->sen5x_error;
+
+    if (sd->sen5x_error != 0) {
+        s_health.read_errors++;
+    } else {
+        for (size_t i = 0; i < NUM_FLAGS; i++) {
+            if (sd->sen5x_status & s_flags[i].bit) {
+                s_health.flag_counts[i]++;
+            }
+        }
+        if (dt > 0 && dt <= HEALTH_MAX_GAP_USEC) {
+            s_health.operating_usec += dt;
+            s_health.rec.operating_sec += s_health.operating_usec / 1000000;
+            s_health.operating_usec %= 1000000;
+        }
+    }
+
+    update_activity(sd, dt);
+    update_drift(sd);
+    schedule_cleaning(sd->timestamp);
+
+    if (s_health.rec.operating_sec - s_health.saved_sec >= HEALTH_SAVE_INTERVAL_SEC) {
+        health_save();
+    }
+}
+
+static void health_task(void* arg)
+{
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        const struct sensor_data* sd;
+        while ((sd = sample_bus_next(s_bus, s_sub)) != NULL) {
+            // Copied out so the ring slot is not held across the analysis
+            struct sensor_data copy = *sd;
+            if (sample_bus_release(s_bus, s_sub)) {
+                xSemaphoreTake(s_lock, portMAX_DELAY);
+                process(&copy);
+                xSemaphoreGive(s_lock);
+            }
+        }
+    }
+}
+
+esp_err_t health_init(struct sample_bus* bus)
+{
+    if (s_lock == NULL) {
+        s_lock = xSemaphoreCreateMutexStatic(&s_lock_buf);
+    }
+    health_load();
+
+    TaskHandle_t task = NULL;
+    if (xTaskCreatePinnedToCore(&health_task, "aqm-health", AQM_STACK_HEALTH, NULL,
+            AQM_PRIO_HEALTH, &task, AQM_CORE_NET) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_bus = bus;
+    s_sub = sample_bus_subscribe(bus, "health", task);
+    return s_sub != NULL ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+bool health_take_clean_request(void)
+{
+    return __atomic_exchange_n(&s_clean_requested, false, __ATOMIC_ACQ_REL);
+}
+
+void health_fan_cleaning_started(bool ok)
+{
+    __atomic_store_n(&s_clean_result, ok ? 1 : -1, __ATOMIC_RELEASE);
+}
+
+bool health_field_valid(const struct sensor_data* sd, int field)
+{
+    if (sd->sample.value[field] == SENSOR_NONE) {
+        return false;
+    }
+    if (field == SENSOR_TEMPERATURE_MCP9808) {
+        return true;
+    }
+    if (sd->sen5x_error != 0) {
+        return false;
+    }
+    if (field >= SENSOR_PM1P0 && field <= SENSOR_PM10P0) {
+        return !(sd->sen5x_status & SEN5X_STATUS_PM_INVALID);
+    }
+    return true;
+}
+
+static const char* overall_status(void)
+{
+    if (s_health.read_error != 0 || (s_health.status & SEN5X_STATUS_ERRORS)) {
+        return "error";
+    }
+    bool drifting = false;
+    for (int ch = 0; ch < HEALTH_NUM_DRIFT; ch++) {
+        drifting |= s_health.drift[ch].drifting;
+    }
+    uint64_t overdue = ((uint64_t)CONFIG_AQM_FAN_CLEAN_INTERVAL_HOURS + CONFIG_AQM_FAN_CLEAN_GRACE_HOURS) * 3600;
+    if ((s_health.status & SEN5X_STATUS_FAN_SPEED) || drifting || sec_since_clean() > overdue) {
+        return "warning";
+    }
+    return "ok";
+}
+
+void health_to_json(struct cJSON* root)
+{
+    if (s_lock == NULL) {
+        cJSON_AddStringToObject(root, "status", "unavailable");
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    cJSON_AddStringToObject(root, "status", overall_status());
+    cJSON_AddNumberToObject(root, "device_status", s_health.status);
+    cJSON_AddNumberToObject(root, "read_error", s_health.read_error);
+    cJSON_AddNumberToObject(root, "read_errors", s_health.read_errors);
+    cJSON_AddNumberToObject(root, "samples", s_health.samples);
+    cJSON_AddNumberToObject(root, "operating_hours", s_health.rec.operating_sec / 3600.0);
+
+    cJSON* flags = cJSON_AddObjectToObject(root, "flags");
+    for (size_t i = 0; i < NUM_FLAGS; i++) {
+        cJSON* entry = cJSON_AddObjectToObject(flags, s_flags[i].name);
+        cJSON_AddBoolToObject(entry, "active", (s_health.status & s_flags[i].bit) != 0);
+        cJSON_AddNumberToObject(entry, "count", s_health.flag_counts[i]);
+    }
+
+    cJSON* clean = cJSON_AddObjectToObject(root, "fan_cleaning");
+    cJSON_AddNumberToObject(clean, "count", s_health.rec.clean_count);
+    cJSON_AddNumberToObject(clean, "hours_since", sec_since_clean() / 3600.0);
+    cJSON_AddNumberToObject(clean, "interval_hours", CONFIG_AQM_FAN_CLEAN_INTERVAL_HOURS);
+    cJSON_AddBoolToObject(clean, "due", sec_since_clean() >= (uint64_t)CONFIG_AQM_FAN_CLEAN_INTERVAL_HOURS * 3600);
+    cJSON_AddBoolToObject(clean, "requested", __atomic_load_n(&s_clean_requested, __ATOMIC_ACQUIRE));
+    cJSON_AddBoolToObject(clean, "low_activity", low_activity(s_health.last_usec));
+    cJSON_AddNumberToObject(clean, "failures", s_health.clean_failures);
+
+    cJSON* drift = cJSON_AddObjectToObject(root, "drift");
+    cJSON_AddNumberToObject(drift, "window_hours", CONFIG_AQM_HEALTH_DRIFT_WINDOW_HOURS);
+    cJSON_AddNumberToObject(drift, "windows", s_health.windows);
+    for (int ch = 0; ch < HEALTH_NUM_DRIFT; ch++) {
+        const health_drift_t* d = &s_health.drift[ch];
+        const health_stat_t* base = &s_health.rec.baseline[ch];
+        cJSON* entry = cJSON_AddObjectToObject(drift, s_drift_names[ch]);
+        cJSON_AddNumberToObject(entry, "baseline_n", base->n);
+        if (base->n > 0) {
+            cJSON_AddNumberToObject(entry, "baseline_mean", base->mean);
+        }
+        cJSON_AddNumberToObject(entry, "window_n", d->window.n);
+        if (d->window.n > 0) {
+            cJSON_AddNumberToObject(entry, "window_mean", d->window.mean);
+        }
+        cJSON_AddNumberToObject(entry, "delta", d->delta);
+        cJSON_AddNumberToObject(entry, "z", d->z);
+        cJSON_AddBoolToObject(entry, "drifting", d->drifting);
+    }
+    xSemaphoreGive(s_lock);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "esp_err.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// SEN5x device status register
+#define SEN5X_STATUS_FAN_SPEED      (1u << 21)  // warning: fan speed out of range
+#define SEN5X_STATUS_FAN_CLEANING   (1u << 19)  // fan cleaning in progress, values are frozen
+#define SEN5X_STATUS_GAS_ERROR      (1u << 7)   // VOC/NOx sensor
+#define SEN5X_STATUS_RHT_ERROR      (1u << 6)   // humidity/temperature sensor communication
+#define SEN5X_STATUS_LASER_ERROR    (1u << 5)
+#define SEN5X_STATUS_FAN_ERROR      (1u << 4)   // fan blocked or broken
+
+// PM values are not usable while these are set
+#define SEN5X_STATUS_PM_INVALID (SEN5X_STATUS_FAN_CLEANING | SEN5X_STATUS_LASER_ERROR | SEN5X_STATUS_FAN_ERROR)
+
+#define HEALTH_BLOB_VERSION 1
+
+enum health_drift_channel {
+    HEALTH_DRIFT_TEMPERATURE_OFFSET,    // SEN55 minus MCP9808 temperature
+    HEALTH_DRIFT_PM_RATIO,              // PM1.0 / PM2.5 at meaningful concentrations
+    HEALTH_NUM_DRIFT
+};
+
+// Running mean and variance (Welford)
+typedef struct health_stat {
+    uint32_t n;
+    float mean;
+    float m2;
+} health_stat_t;
+
+// Persisted to NVS
+typedef struct health_record {
+    uint32_t version;
+    uint32_t clean_count;
+    uint64_t operating_sec;             // SEN55 time spent measuring
+    uint64_t last_clean_sec;            // operating_sec at the last fan cleaning
+    health_stat_t baseline[HEALTH_NUM_DRIFT];
+} health_record_t;
+
+struct sample_bus;
+struct sensor_data;
+struct cJSON;
+
+// Subscribes the health task to the sample bus; call before the sampler starts publishing
+esp_err_t health_init(struct sample_bus* bus);
+// Polled by the sampler once per tick. True once when a fan cleaning should be started now;
+// report the outcome with health_fan_cleaning_started.
+bool health_take_clean_request(void);
+void health_fan_cleaning_started(bool ok);
+void health_to_json(struct cJSON* root);
+// True if the sample has a usable reading of the sensor field: present, and not from a SEN5x
+// that failed to read or, for PM, reported a status that invalidates the mass concentrations
+bool health_field_valid(const struct sensor_data* sd, int field);
+
+#ifdef __cplusplus
+}
+#endif
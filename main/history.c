@@ -0,0 +1,609 @@
+#include "history.h"
+#include "alert_rules.h"
+#include "health.h"
+#include "sample_bus.h"
+#include "task_plan.h"
+#include "utils.h"
+
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_timer.h"
+
+#include "cJSON.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+
+static const char* TAG = "aqm-history";
+
+#define HISTORY_HEAD_MAGIC 0x54534948   // "HIST"
+#define HISTORY_SEAL_MAGIC 0x4c414553   // "SEAL"
+#define HISTORY_TALLY_BYTES 64
+#define HISTORY_MAX_ROWS (HISTORY_TALLY_BYTES * 8)
+
+// Flash layout of a block. The head is written when the block is opened and the payload is
+// appended as rows arrive, so everything up to the last tally mark survives a reset. Flash bits
+// only go from 1 to 0 without an erase: the tally clears one bit per durable row and the seal
+// stays erased until the block is closed.
+typedef struct history_block_head {
+    uint32_t magic;
+    uint32_t seq;                           // increasing, the block lives at seq % num_blocks
+    uint32_t start_time;
+    uint16_t version;
+    uint16_t channels;
+    uint8_t tally[HISTORY_TALLY_BYTES];     // bit n cleared once row n is fully written
+} history_block_head_t;
+
+typedef struct history_block_seal {
+    uint32_t magic;
+    uint32_t end_time;
+    uint16_t count;
+    uint16_t bytes;                         // payload bytes
+    int16_t min[HISTORY_NUM_CHANNELS];      // for skipping blocks in range queries, min > max if no value
+    int16_t max[HISTORY_NUM_CHANNELS];
+} history_block_seal_t;
+
+typedef struct history_block_index {
+    history_block_head_t head;
+    history_block_seal_t seal;
+} history_block_index_t;
+
+#define HISTORY_PAYLOAD_SIZE (HISTORY_BLOCK_SIZE - sizeof(history_block_index_t))
+#define HISTORY_RAW_ROW_BYTES sizeof(history_row_t)
+
+// Channels are the sensor fields, stored at the sensors' own fixed-point resolution. Rollup means
+// are rounded to that resolution, so the deltas between successive rows stay short.
+_Static_assert(HISTORY_NUM_CHANNELS == SENSOR_NUM_FIELDS, "history channels are the sensor fields");
+_Static_assert(HISTORY_NO_VALUE == SENSOR_NONE, "history and samples mark missing readings alike");
+
+static struct {
+    const esp_partition_t* part;
+    uint32_t num_blocks;
+    uint32_t oldest_seq;                    // 0 while empty
+    uint32_t newest_seq;
+    uint32_t open_seq;                      // block being appended to, 0 if none
+    uint32_t open_start;
+    uint32_t last_time;                     // newest row stored
+    uint32_t durable;                       // rows of the open block marked in its tally
+    uint32_t flushed;                       // payload bytes of the open block written to flash
+    uint8_t tally[HISTORY_TALLY_BYTES];
+    history_encoder_t enc;
+    history_stats_t stats;
+} s_history;
+
+static uint8_t s_payload[HISTORY_PAYLOAD_SIZE];
+
+static struct {
+    uint32_t start;                         // start of the current rollup period, 0 if none
+    int64_t sum[HISTORY_NUM_CHANNELS];      // readings times the msec each stands for
+    uint32_t weight_msec[HISTORY_NUM_CHANNELS];
+} s_rollup;
+
+static sample_bus_t* s_bus = NULL;
+static sample_sub_t* s_sub = NULL;
+static SemaphoreHandle_t s_lock = NULL;
+static StaticSemaphore_t s_lock_buf;
+
+_Static_assert(HISTORY_PAYLOAD_SIZE < 0x10000, "payload size must fit the seal");
+
+static size_t block_offset(uint32_t seq)
+{
+    return (size_t)(seq % s_history.num_blocks) * HISTORY_BLOCK_SIZE;
+}
+
+static esp_err_t read_index(uint32_t seq, history_block_index_t* index)
+{
+    return esp_partition_read(s_history.part, block_offset(seq), index, sizeof(history_block_index_t));
+}
+
+static bool head_valid(const history_block_head_t* head)
+{
+    return head->magic == HISTORY_HEAD_MAGIC && head->version == HISTORY_FORMAT_VERSION
+        && head->channels == HISTORY_NUM_CHANNELS && head->seq != 0;
+}
+
+static uint32_t tally_count(const uint8_t* tally)
+{
+    uint32_t n = 0;
+    while (n < HISTORY_MAX_ROWS && !(tally[n / 8] & (1u << (n % 8)))) {
+        n++;
+    }
+    return n;
+}
+
+static esp_err_t write_seal(uint32_t seq, uint32_t end_time, uint32_t count, uint32_t bytes,
+    const int16_t* min, const int16_t* max)
+{
+    history_block_seal_t seal;
+    seal.magic = HISTORY_SEAL_MAGIC;
+    seal.end_time = end_time;
+    seal.count = (uint16_t)count;
+    seal.bytes = (uint16_t)bytes;
+    memcpy(&seal.min[0], min, sizeof(seal.min));
+    memcpy(&seal.max[0], max, sizeof(seal.max));
+    return esp_partition_write(s_history.part, block_offset(seq) + offsetof(history_block_index_t, seal),
+        &seal, sizeof(seal));
+}
+
+static esp_err_t flush_open(void)
+{
+    const history_encoder_t* enc = &s_history.enc;
+    uint32_t complete = enc->bits / 8;
+    size_t base = block_offset(s_history.open_seq) + sizeof(history_block_index_t);
+    if (complete > s_history.flushed) {
+        esp_err_t err = esp_partition_write(s_history.part, base + s_history.flushed,
+            &s_payload[s_history.flushed], complete - s_history.flushed);
+        if (err != ESP_OK) {
+            return err;
+        }
+        s_history.stats.payload_bytes += complete - s_history.flushed;
+        s_history.flushed = complete;
+    }
+
+    // A row is durable once all of its bits are in complete bytes. Every row is longer than a
+    // byte, so only the newest one can still be waiting.
+    uint32_t durable = (enc->bits % 8) == 0 ? enc->count : enc->count - 1;
+    if (durable > s_history.durable) {
+        for (uint32_t n = s_history.durable; n < durable; n++) {
+            s_history.tally[n / 8] &= ~(1u << (n % 8));
+        }
+        uint32_t first = s_history.durable / 8;
+        uint32_t last = (durable - 1) / 8;
+        esp_err_t err = esp_partition_write(s_history.part,
+            block_offset(s_history.open_seq) + offsetof(history_block_head_t, tally) + first,
+            &s_history.tally[first], last - first + 1);
+        if (err != ESP_OK) {
+            return err;
+        }
+        s_history.durable = durable;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t seal_open(void)
+{
+    const history_encoder_t* enc = &s_history.enc;
+    uint32_t bytes = history_encoder_bytes(enc);
+    size_t base = block_offset(s_history.open_seq) + sizeof(history_block_index_t);
+    esp_err_t err = ESP_OK;
+    if (bytes > s_history.flushed) {
+        err = esp_partition_write(s_history.part, base + s_history.flushed,
+            &s_payload[s_history.flushed], bytes - s_history.flushed);
+        s_history.stats.payload_bytes += bytes - s_history.flushed;
+    }
+    if (err == ESP_OK) {
+        err = write_seal(s_history.open_seq, enc->prev_time, enc->count, bytes, &enc->min[0], &enc->max[0]);
+    }
+    s_history.open_seq = 0;
+    return err;
+}
+
+// Forgets the oldest block before its sector is reused
+static void drop_oldest(void)
+{
+    history_block_index_t index;
+    if (read_index(s_history.oldest_seq, &index) == ESP_OK && head_valid(&index.head)
+        && index.head.seq == s_history.oldest_seq && index.seal.magic == HISTORY_SEAL_MAGIC) {
+        s_history.stats.rows -= index.seal.count;
+        s_history.stats.payload_bytes -= index.seal.bytes;
+        s_history.stats.blocks_used--;
+    }
+    s_history.oldest_seq++;
+}
+
+static esp_err_t open_block(uint32_t start_time)
+{
+    uint32_t seq = s_history.newest_seq + 1;
+    if (s_history.oldest_seq != 0 && seq - s_history.oldest_seq >= s_history.num_blocks) {
+        drop_oldest();
+    }
+    esp_err_t err = esp_partition_erase_range(s_history.part, block_offset(seq), HISTORY_BLOCK_SIZE);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    history_block_head_t head;
+    memset(&head, 0xff, sizeof(head));
+    head.magic = HISTORY_HEAD_MAGIC;
+    head.seq = seq;
+    head.start_time = start_time;
+    head.version = HISTORY_FORMAT_VERSION;
+    head.channels = HISTORY_NUM_CHANNELS;
+    err = esp_partition_write(s_history.part, block_offset(seq), &head, sizeof(head));
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    s_history.newest_seq = seq;
+    if (s_history.oldest_seq == 0) {
+        s_history.oldest_seq = seq;
+    }
+    s_history.open_seq = seq;
+    s_history.open_start = start_time;
+    s_history.durable = 0;
+    s_history.flushed = 0;
+    memset(&s_history.tally[0], 0xff, sizeof(s_history.tally));
+    history_encoder_init(&s_history.enc, &s_payload[0], sizeof(s_payload));
+    s_history.stats.blocks_used++;
+    return ESP_OK;
+}
+
+static esp_err_t append_row(const history_row_t* row)
+{
+    esp_err_t err = ESP_OK;
+    if (s_history.open_seq == 0) {
+        err = open_block(row->time);
+    } else if (s_history.enc.count >= HISTORY_MAX_ROWS || !history_encoder_append(&s_history.enc, row)) {
+        err = seal_open();
+        if (err == ESP_OK) {
+            err = open_block(row->time);
+        }
+    } else {
+        s_history.stats.rows++;
+        return flush_open();
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+    // An empty block always has room for one row
+    history_encoder_append(&s_history.enc, row);
+    s_history.stats.rows++;
+    return flush_open();
+}
+
+// Seals a block that was open at reset with the rows its tally vouches for. Later bytes may
+// already be programmed, so appending to it is not safe.
+static void recover_block(const history_block_index_t* index)
+{
+    uint32_t count = tally_count(&index->head.tally[0]);
+    esp_partition_read(s_history.part, block_offset(index->head.seq) + sizeof(history_block_index_t),
+        &s_payload[0], sizeof(s_payload));
+
+    int16_t min[HISTORY_NUM_CHANNELS], max[HISTORY_NUM_CHANNELS];
+    for (int ch = 0; ch < HISTORY_NUM_CHANNELS; ch++) {
+        min[ch] = INT16_MAX;
+        max[ch] = INT16_MIN;
+    }
+    history_decoder_t dec;
+    history_decoder_init(&dec, &s_payload[0], sizeof(s_payload), count);
+    history_row_t row;
+    uint32_t rows = 0, end_time = index->head.start_time;
+    while (history_decoder_next(&dec, &row)) {
+        for (int ch = 0; ch < HISTORY_NUM_CHANNELS; ch++) {
+            int16_t v = row.value[ch];
+            if (v != HISTORY_NO_VALUE) {
+                min[ch] = v < min[ch] ? v : min[ch];
+                max[ch] = v > max[ch] ? v : max[ch];
+            }
+        }
+        end_time = row.time;
+        rows++;
+    }
+    uint32_t bytes = (history_decoder_bits(&dec) + 7) / 8;
+    write_seal(index->head.seq, end_time, rows, bytes, &min[0], &max[0]);
+    s_history.stats.rows += rows;
+    s_history.stats.payload_bytes += bytes;
+    ESP_LOGI(TAG, "Recovered %u rows of block %u", rows, index->head.seq);
+}
+
+static esp_err_t history_mount(void)
+{
+    s_history.part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+        HISTORY_PARTITION_LABEL);
+    if (s_history.part == NULL) {
+        ESP_LOGW(TAG, "No '%s' partition, history disabled", HISTORY_PARTITION_LABEL);
+        return ESP_ERR_NOT_FOUND;
+    }
+    s_history.num_blocks = s_history.part->size / HISTORY_BLOCK_SIZE;
+    s_history.stats.blocks_total = s_history.num_blocks;
+
+    int64_t start = esp_timer_get_time();
+    uint32_t oldest = 0, newest = 0;
+    for (uint32_t b = 0; b < s_history.num_blocks; b++) {
+        history_block_index_t index;
+        if (esp_partition_read(s_history.part, (size_t)b * HISTORY_BLOCK_SIZE, &index, sizeof(index)) != ESP_OK
+            || !head_valid(&index.head) || index.head.seq % s_history.num_blocks != b) {
+            continue;
+        }
+        if (index.seal.magic == HISTORY_SEAL_MAGIC) {
+            s_history.stats.rows += index.seal.count;
+            s_history.stats.payload_bytes += index.seal.bytes;
+            if (index.seal.count > 0 && index.seal.end_time > s_history.last_time) {
+                s_history.last_time = index.seal.end_time;
+            }
+        } else {
+            recover_block(&index);
+            read_index(index.head.seq, &index);
+            if (index.seal.count > 0 && index.seal.end_time > s_history.last_time) {
+                s_history.last_time = index.seal.end_time;
+            }
+        }
+        s_history.stats.blocks_used++;
+        if (oldest == 0 || index.head.seq < oldest) {
+            oldest = index.head.seq;
+        }
+        if (index.head.seq > newest) {
+            newest = index.head.seq;
+        }
+    }
+    s_history.oldest_seq = oldest;
+    s_history.newest_seq = newest;
+    ESP_LOGI(TAG, "%u of %u blocks used, %u rows, scanned in %lld ms", s_history.stats.blocks_used,
+        s_history.num_blocks, s_history.stats.rows, (esp_timer_get_time() - start) / 1000);
+    return ESP_OK;
+}
+
+static void emit_rollup(void)
+{
+    history_row_t row;
+    row.time = s_rollup.start;
+    bool any = false;
+    for (int ch = 0; ch < HISTORY_NUM_CHANNELS; ch++) {
+        row.value[ch] = sensor_mean(s_rollup.sum[ch], s_rollup.weight_msec[ch]);
+        any |= s_rollup.weight_msec[ch] > 0;
+    }
+    memset(&s_rollup, 0, sizeof(s_rollup));
+    if (!any) {
+        return;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (row.time <= s_history.last_time) {
+        s_history.stats.rows_dropped++;
+    } else {
+        int64_t start = esp_timer_get_time();
+        esp_err_t err = append_row(&row);
+        uint32_t usec = (uint32_t)(esp_timer_get_time() - start);
+        s_history.stats.last_encode_usec = usec;
+        if (usec > s_history.stats.max_encode_usec) {
+            s_history.stats.max_encode_usec = usec;
+        }
+        if (err == ESP_OK) {
+            s_history.last_time = row.time;
+        } else {
+            ESP_LOGE(TAG, "Failed to store history row: %s", esp_err_to_name(err));
+            s_history.stats.rows_dropped++;
+            s_history.open_seq = 0;
+        }
+    }
+    xSemaphoreGive(s_lock);
+}
+
+static void add_sample(const struct sensor_data* sd)
+{
+    uint32_t now = wall_time_sec();
+    if (now == 0) {
+        return;
+    }
+    uint32_t period = now / CONFIG_AQM_HISTORY_ROLLUP_SEC * CONFIG_AQM_HISTORY_ROLLUP_SEC;
+    if (s_rollup.start != 0 && period != s_rollup.start) {
+        emit_rollup();
+    }
+    s_rollup.start = period;
+    // Time-weighted, as the adaptive sampler spaces readings further apart while the air is calm
+    uint32_t w = sd->interval_msec > 0 ? sd->interval_msec : 1;
+    for (int ch = 0; ch < HISTORY_NUM_CHANNELS; ch++) {
+        int16_t v = sd->sample.value[ch];
+        if (health_field_valid(sd, ch)) {
+            s_rollup.sum[ch] += (int64_t)v * w;
+            s_rollup.weight_msec[ch] += w;
+        }
+    }
+}
+
+static void history_task(void* arg)
+{
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        const struct sensor_data* sd;
+        while ((sd = sample_bus_next(s_bus, s_sub)) != NULL) {
+            struct sensor_data copy = *sd;
+            if (sample_bus_release(s_bus, s_sub)) {
+                add_sample(&copy);
+            }
+        }
+    }
+}
+
+esp_err_t history_init(struct sample_bus* bus)
+{
+    if (s_lock == NULL) {
+        s_lock = xSemaphoreCreateMutexStatic(&s_lock_buf);
+    }
+    esp_err_t err = history_mount();
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    TaskHandle_t task = NULL;
+    if (xTaskCreatePinnedToCore(&history_task, "aqm-history", AQM_STACK_HISTORY, NULL,
+            AQM_PRIO_HISTORY, &task, AQM_CORE_NET) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_bus = bus;
+    s_sub = sample_bus_subscribe(bus, "history", task);
+    return s_sub != NULL ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+// The query's filter range in the channel's fixed point, inclusive
+typedef struct filter_range {
+    int32_t lo;
+    int32_t hi;
+} filter_range_t;
+
+static filter_range_t filter_range(const history_query_t* q)
+{
+    filter_range_t r = { INT32_MIN, INT32_MAX };
+    if (q->filter >= 0) {
+        float scale = (float)sensor_scale(q->filter);
+        float lo = ceilf(q->min * scale);
+        float hi = floorf(q->max * scale);
+        r.lo = lo <= (float)INT16_MIN ? INT16_MIN : lo >= (float)INT16_MAX ? INT16_MAX : (int32_t)lo;
+        r.hi = hi >= (float)INT16_MAX ? INT16_MAX - 1 : hi <= (float)INT16_MIN ? INT16_MIN - 1 : (int32_t)hi;
+    }
+    return r;
+}
+
+static bool block_excluded(const history_query_t* q, const filter_range_t* r, uint32_t end_time,
+    const int16_t* min, const int16_t* max)
+{
+    if (end_time < q->from) {
+        return true;
+    }
+    if (q->filter >= 0) {
+        int f = q->filter;
+        return min[f] > max[f] || max[f] < r->lo || min[f] > r->hi;
+    }
+    return false;
+}
+
+esp_err_t history_query(const history_query_t* query, uint8_t* buf, history_row_cb cb, void* arg)
+{
+    if (s_history.part == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (query->from > query->to || query->filter >= HISTORY_NUM_CHANNELS
+        || (query->filter >= 0 && !(query->min <= query->max))) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    filter_range_t range = filter_range(query);
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    uint32_t first = s_history.oldest_seq;
+    uint32_t last = s_history.newest_seq;
+    s_history.stats.queries++;
+    xSemaphoreGive(s_lock);
+
+    for (uint32_t seq = first; seq != 0 && seq <= last; seq++) {
+        uint32_t start_time, count = 0, bytes = 0;
+        bool skip = false;
+        esp_err_t err = ESP_OK;
+
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        if (seq < s_history.oldest_seq) {
+            // Overwritten since the query started
+            skip = true;
+            start_time = 0;
+        } else if (seq == s_history.open_seq) {
+            const history_encoder_t* enc = &s_history.enc;
+            start_time = s_history.open_start;
+            skip = block_excluded(query, &range, enc->prev_time, &enc->min[0], &enc->max[0]);
+            if (!skip) {
+                count = enc->count;
+                bytes = history_encoder_bytes(enc);
+                memcpy(buf, &s_payload[0], bytes);
+            }
+        } else {
+            history_block_index_t index;
+            err = read_index(seq, &index);
+            start_time = index.head.start_time;
+            if (err != ESP_OK || !head_valid(&index.head) || index.head.seq != seq
+                || index.seal.magic != HISTORY_SEAL_MAGIC || index.seal.bytes > HISTORY_PAYLOAD_SIZE) {
+                skip = true;
+                start_time = 0;
+            } else {
+                skip = block_excluded(query, &range, index.seal.end_time, &index.seal.min[0], &index.seal.max[0]);
+            }
+            if (!skip && start_time <= query->to) {
+                count = index.seal.count;
+                bytes = index.seal.bytes;
+                err = esp_partition_read(s_history.part, block_offset(seq) + sizeof(history_block_index_t),
+                    buf, bytes);
+            }
+        }
+        xSemaphoreGive(s_lock);
+
+        // A block that reads back but is not a sealed block is skipped; a failed read ends the query
+        if (err != ESP_OK) {
+            return err;
+        }
+        if (start_time > query->to) {
+            break;
+        }
+        if (skip) {
+            s_history.stats.blocks_skipped++;
+            continue;
+        }
+        s_history.stats.blocks_scanned++;
+
+        history_decoder_t dec;
+        history_decoder_init(&dec, buf, bytes, count);
+        history_row_t row;
+        while (history_decoder_next(&dec, &row)) {
+            if (row.time < query->from) {
+                continue;
+            }
+            if (row.time > query->to) {
+                return ESP_OK;
+            }
+            if (query->filter >= 0) {
+                int16_t v = row.value[query->filter];
+                if (v == HISTORY_NO_VALUE || v < range.lo || v > range.hi) {
+                    continue;
+                }
+            }
+            s_history.stats.rows_returned++;
+            if (!cb(&row, arg)) {
+                return ESP_OK;
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+const char* history_channel_name(int ch)
+{
+    return (ch >= 0 && ch < HISTORY_NUM_CHANNELS) ? alert_field_name(ch) : "unknown";
+}
+
+int history_channel_from_name(const char* name)
+{
+    for (int ch = 0; ch < HISTORY_NUM_CHANNELS; ch++) {
+        if (strcmp(name, alert_field_name(ch)) == 0) {
+            return ch;
+        }
+    }
+    return -1;
+}
+
+const history_stats_t* history_get_stats(void)
+{
+    return &s_history.stats;
+}
+
+void history_to_json(struct cJSON* root)
+{
+    if (s_history.part == NULL) {
+        cJSON_AddBoolToObject(root, "enabled", false);
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    const history_stats_t* st = &s_history.stats;
+    cJSON_AddBoolToObject(root, "enabled", true);
+    cJSON_AddNumberToObject(root, "rollup_sec", CONFIG_AQM_HISTORY_ROLLUP_SEC);
+    cJSON_AddNumberToObject(root, "blocks_total", st->blocks_total);
+    cJSON_AddNumberToObject(root, "blocks_used", st->blocks_used);
+    cJSON_AddNumberToObject(root, "rows", st->rows);
+    cJSON_AddNumberToObject(root, "payload_bytes", st->payload_bytes);
+    if (st->rows > 0 && st->payload_bytes > 0) {
+        double bytes_per_row = (double)st->payload_bytes / st->rows;
+        cJSON_AddNumberToObject(root, "bytes_per_row", bytes_per_row);
+        cJSON_AddNumberToObject(root, "compression_ratio", HISTORY_RAW_ROW_BYTES / bytes_per_row);
+        cJSON_AddNumberToObject(root, "capacity_days",
+            (double)st->blocks_total * HISTORY_PAYLOAD_SIZE / bytes_per_row * CONFIG_AQM_HISTORY_ROLLUP_SEC / 86400.0);
+    }
+    cJSON_AddNumberToObject(root, "newest_time", s_history.last_time);
+    cJSON_AddNumberToObject(root, "rows_dropped", st->rows_dropped);
+    cJSON_AddNumberToObject(root, "last_encode_usec", st->last_encode_usec);
+    cJSON_AddNumberToObject(root, "max_encode_usec", st->max_encode_usec);
+    cJSON_AddNumberToObject(root, "queries", st->queries);
+    cJSON_AddNumberToObject(root, "blocks_scanned", st->blocks_scanned);
+    cJSON_AddNumberToObject(root, "blocks_skipped", st->blocks_skipped);
+    cJSON_AddNumberToObject(root, "rows_returned", st->rows_returned);
+    xSemaphoreGive(s_lock);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "history_codec.h"
+
+#include "esp_err.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HISTORY_PARTITION_LABEL "history"
+#define HISTORY_BLOCK_SIZE 4096     // one flash sector
+#define HISTORY_FORMAT_VERSION 2
+
+typedef struct history_query {
+    uint32_t from;                  // unix time, inclusive
+    uint32_t to;                    // unix time, inclusive
+    int filter;                     // channel rows are filtered on, -1 for none
+    float min;                      // filter range in engineering units, inclusive
+    float max;
+} history_query_t;
+
+typedef struct history_stats {
+    uint32_t blocks_total;          // blocks in the partition
+    uint32_t blocks_used;
+    uint32_t rows;                  // rows in all blocks still stored
+    uint64_t payload_bytes;         // compressed row bytes in those blocks
+    uint32_t rows_dropped;          // rollups lost to flash errors or a clock running backwards
+    uint32_t last_encode_usec;      // encoding and flushing the last row
+    uint32_t max_encode_usec;
+    uint32_t queries;
+    uint32_t blocks_scanned;        // blocks decoded by queries
+    uint32_t blocks_skipped;        // blocks ruled out by their header
+    uint32_t rows_returned;
+} history_stats_t;
+
+// Called for every matching row, oldest first, outside the history lock. Return false to stop.
+typedef bool (*history_row_cb)(const history_row_t* row, void* arg);
+
+struct sample_bus;
+struct cJSON;
+
+// Mounts the history partition, recovers the block that was open at reset and subscribes the
+// history task to the sample bus. Rows are only recorded once SNTP has set the clock.
+esp_err_t history_init(struct sample_bus* bus);
+// Streams the rows within the query to cb. buf must hold HISTORY_BLOCK_SIZE bytes.
+// ESP_ERR_INVALID_ARG for an empty time or filter range, or the flash error that ended the scan.
+esp_err_t history_query(const history_query_t* query, uint8_t* buf, history_row_cb cb, void* arg);
+
+// Channel n holds sensor field n, rows carry its fixed-point value
+const char* history_channel_name(int ch);
+int history_channel_from_name(const char* name);
+
+const history_stats_t* history_get_stats(void);
+void history_to_json(struct cJSON* root);
+
+#ifdef __cplusplus
+}
+#endif
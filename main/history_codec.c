@@ -0,0 +1,292 @@
+#include "history_codec.h"
+
+#include <string.h>
+
+// Delta-of-delta buckets: prefix, prefix length, payload bits
+#define DOD_BITS_7  7
+#define DOD_BITS_9  9
+#define DOD_BITS_12 12
+// Values are 16 bits wide: the window's leading zeros and length (minus one) fit 4 bits each
+#define VALUE_BITS 16
+#define WINDOW_FIELD_BITS 4
+
+// Signed deltas interleaved so small steps either way have few significant bits
+static inline uint16_t zigzag(uint16_t value, uint16_t prev)
+{
+    int16_t delta = (int16_t)(uint16_t)(value - prev);
+    return (uint16_t)(((uint16_t)delta << 1) ^ (uint16_t)(delta >> 15));
+}
+
+static inline uint16_t unzigzag(uint16_t x, uint16_t prev)
+{
+    return (uint16_t)(prev + (uint16_t)((x >> 1) ^ (uint16_t)-(x & 1)));
+}
+
+static void put_bits(history_encoder_t* enc, uint32_t value, int n)
+{
+    if (enc->overflow || enc->bits + n > enc->size * 8) {
+        enc->overflow = true;
+        return;
+    }
+    while (n > 0) {
+        int room = 8 - (enc->bits & 7);
+        int take = n < room ? n : room;
+        uint32_t chunk = (value >> (n - take)) & ((1u << take) - 1);
+        enc->buf[enc->bits >> 3] |= (uint8_t)(chunk << (room - take));
+        enc->bits += take;
+        n -= take;
+    }
+}
+
+static bool get_bits(history_decoder_t* dec, int n, uint32_t* out)
+{
+    if (dec->pos + n > dec->size_bits) {
+        return false;
+    }
+    uint32_t value = 0;
+    while (n > 0) {
+        int room = 8 - (dec->pos & 7);
+        int take = n < room ? n : room;
+        uint32_t byte = dec->buf[dec->pos >> 3];
+        value = (value << take) | ((byte >> (room - take)) & ((1u << take) - 1));
+        dec->pos += take;
+        n -= take;
+    }
+    *out = value;
+    return true;
+}
+
+static void put_time(history_encoder_t* enc, uint32_t time)
+{
+    if (enc->count == 0) {
+        put_bits(enc, time, 32);
+        return;
+    }
+    int32_t delta = (int32_t)(time - enc->prev_time);
+    int32_t dod = delta - enc->prev_delta;
+    if (dod == 0) {
+        put_bits(enc, 0x0, 1);
+    } else if (dod >= -63 && dod <= 64) {
+        put_bits(enc, 0x2, 2);
+        put_bits(enc, (uint32_t)(dod + 63), DOD_BITS_7);
+    } else if (dod >= -255 && dod <= 256) {
+        put_bits(enc, 0x6, 3);
+        put_bits(enc, (uint32_t)(dod + 255), DOD_BITS_9);
+    } else if (dod >= -2047 && dod <= 2048) {
+        put_bits(enc, 0xe, 4);
+        put_bits(enc, (uint32_t)(dod + 2047), DOD_BITS_12);
+    } else {
+        put_bits(enc, 0xf, 4);
+        put_bits(enc, (uint32_t)dod, 32);
+    }
+    enc->prev_delta = delta;
+}
+
+static void put_value(history_encoder_t* enc, int ch, uint16_t value)
+{
+    if (enc->count == 0) {
+        put_bits(enc, value, VALUE_BITS);
+        enc->prev_value[ch] = value;
+        return;
+    }
+    uint32_t x = zigzag(value, enc->prev_value[ch]);
+    enc->prev_value[ch] = value;
+    if (x == 0) {
+        put_bits(enc, 0x0, 1);
+        return;
+    }
+    int lead = __builtin_clz(x) - (32 - VALUE_BITS);
+    int trail = __builtin_ctz(x);
+    int len = enc->prev_len[ch];
+    if (len != 0 && lead >= enc->prev_lead[ch] && trail >= VALUE_BITS - enc->prev_lead[ch] - len) {
+        // Fits the previous window
+        put_bits(enc, 0x2, 2);
+        put_bits(enc, x >> (VALUE_BITS - enc->prev_lead[ch] - len), len);
+        return;
+    }
+    len = VALUE_BITS - lead - trail;
+    put_bits(enc, 0x3, 2);
+    put_bits(enc, (uint32_t)lead, WINDOW_FIELD_BITS);
+    put_bits(enc, (uint32_t)(len - 1), WINDOW_FIELD_BITS);
+    put_bits(enc, x >> trail, len);
+    enc->prev_lead[ch] = (uint8_t)lead;
+    enc->prev_len[ch] = (uint8_t)len;
+}
+
+void history_encoder_init(history_encoder_t* enc, uint8_t* buf, uint32_t size)
+{
+    memset(enc, 0, sizeof(history_encoder_t));
+    enc->buf = buf;
+    enc->size = size;
+    memset(buf, 0, size);
+    for (int ch = 0; ch < HISTORY_NUM_CHANNELS; ch++) {
+        enc->min[ch] = INT16_MAX;
+        enc->max[ch] = INT16_MIN;
+    }
+}
+
+bool history_encoder_append(history_encoder_t* enc, const history_row_t* row)
+{
+    if (enc->count > 0 && row->time <= enc->prev_time) {
+        return false;
+    }
+
+    history_encoder_t saved = *enc;
+    put_time(enc, row->time);
+    for (int ch = 0; ch < HISTORY_NUM_CHANNELS; ch++) {
+        put_value(enc, ch, (uint16_t)row->value[ch]);
+    }
+    if (enc->overflow) {
+        // Clear the bits written past the old end, they would be ORed into the next row
+        uint32_t byte = saved.bits >> 3;
+        if (saved.bits & 7) {
+            enc->buf[byte] &= (uint8_t)(0xff << (8 - (saved.bits & 7)));
+            byte++;
+        }
+        uint32_t end = (enc->bits + 7) / 8;
+        if (end > byte) {
+            memset(&enc->buf[byte], 0, end - byte);
+        }
+        *enc = saved;
+        return false;
+    }
+
+    for (int ch = 0; ch < HISTORY_NUM_CHANNELS; ch++) {
+        int16_t v = row->value[ch];
+        if (v == HISTORY_NO_VALUE) {
+            continue;
+        }
+        if (v < enc->min[ch]) {
+            enc->min[ch] = v;
+        }
+        if (v > enc->max[ch]) {
+            enc->max[ch] = v;
+        }
+    }
+    enc->prev_time = row->time;
+    enc->count++;
+    return true;
+}
+
+void history_decoder_init(history_decoder_t* dec, const uint8_t* buf, uint32_t size, uint32_t count)
+{
+    memset(dec, 0, sizeof(history_decoder_t));
+    dec->buf = buf;
+    dec->size_bits = size * 8;
+    dec->remaining = count;
+    dec->first = true;
+}
+
+static bool get_time(history_decoder_t* dec, uint32_t* time)
+{
+    if (dec->first) {
+        return get_bits(dec, 32, time);
+    }
+    uint32_t bit;
+    int prefix = 0;
+    // Up to four leading ones select the bucket
+    while (prefix < 4) {
+        if (!get_bits(dec, 1, &bit)) {
+            return false;
+        }
+        if (bit == 0) {
+            break;
+        }
+        prefix++;
+    }
+    uint32_t raw = 0;
+    int32_t dod = 0;
+    switch (prefix) {
+    case 0:
+        break;
+    case 1:
+        if (!get_bits(dec, DOD_BITS_7, &raw)) {
+            return false;
+        }
+        dod = (int32_t)raw - 63;
+        break;
+    case 2:
+        if (!get_bits(dec, DOD_BITS_9, &raw)) {
+            return false;
+        }
+        dod = (int32_t)raw - 255;
+        break;
+    case 3:
+        if (!get_bits(dec, DOD_BITS_12, &raw)) {
+            return false;
+        }
+        dod = (int32_t)raw - 2047;
+        break;
+    default:
+        if (!get_bits(dec, 32, &raw)) {
+            return false;
+        }
+        dod = (int32_t)raw;
+        break;
+    }
+    dec->prev_delta += dod;
+    *time = dec->prev_time + (uint32_t)dec->prev_delta;
+    return true;
+}
+
+static bool get_value(history_decoder_t* dec, int ch, uint16_t* value)
+{
+    uint32_t raw;
+    if (dec->first) {
+        if (!get_bits(dec, VALUE_BITS, &raw)) {
+            return false;
+        }
+        *value = (uint16_t)raw;
+        dec->prev_value[ch] = *value;
+        return true;
+    }
+    uint32_t ctrl;
+    if (!get_bits(dec, 1, &ctrl)) {
+        return false;
+    }
+    if (ctrl == 0) {
+        *value = dec->prev_value[ch];
+        return true;
+    }
+    if (!get_bits(dec, 1, &ctrl)) {
+        return false;
+    }
+    if (ctrl == 1) {
+        uint32_t lead, len;
+        if (!get_bits(dec, WINDOW_FIELD_BITS, &lead) || !get_bits(dec, WINDOW_FIELD_BITS, &len)
+            || lead + len + 1 > VALUE_BITS) {
+            return false;
+        }
+        dec->prev_lead[ch] = (uint8_t)lead;
+        dec->prev_len[ch] = (uint8_t)(len + 1);
+    } else if (dec->prev_len[ch] == 0) {
+        return false;
+    }
+    uint32_t x;
+    int len = dec->prev_len[ch];
+    if (!get_bits(dec, len, &x)) {
+        return false;
+    }
+    *value = unzigzag((uint16_t)(x << (VALUE_BITS - dec->prev_lead[ch] - len)), dec->prev_value[ch]);
+    dec->prev_value[ch] = *value;
+    return true;
+}
+
+bool history_decoder_next(history_decoder_t* dec, history_row_t* row)
+{
+    if (dec->remaining == 0 || !get_time(dec, &row->time)) {
+        return false;
+    }
+    for (int ch = 0; ch < HISTORY_NUM_CHANNELS; ch++) {
+        uint16_t value;
+        if (!get_value(dec, ch, &value)) {
+            dec->remaining = 0;
+            return false;
+        }
+        row->value[ch] = (int16_t)value;
+    }
+    dec->prev_time = row->time;
+    dec->first = false;
+    dec->remaining--;
+    return true;
+}
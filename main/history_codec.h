@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HISTORY_NUM_CHANNELS 9
+#define HISTORY_NO_VALUE INT16_MAX
+
+typedef struct history_row {
+    uint32_t time;                          // unix time in seconds, strictly increasing
+    int16_t value[HISTORY_NUM_CHANNELS];    // fixed point, HISTORY_NO_VALUE where the channel had no reading
+} history_row_t;
+
+// Bit-packed encoder for one block of rows (Gorilla, Pelkonen et al. 2015). Timestamps are stored
+// as delta-of-delta. Values are integers, so in place of Gorilla's float XOR each channel stores
+// the zigzag-coded delta from its previous value, reusing the previous leading/trailing zero
+// window when it still fits. Rows are interleaved so a block can be flushed after every append;
+// each channel keeps its own state.
+typedef struct history_encoder {
+    uint8_t* buf;                           // zero-filled by init, bits are ORed in
+    uint32_t size;                          // bytes
+    uint32_t bits;                          // bits used
+    uint32_t count;                         // rows
+    uint32_t prev_time;
+    int32_t prev_delta;
+    uint16_t prev_value[HISTORY_NUM_CHANNELS];
+    uint8_t prev_lead[HISTORY_NUM_CHANNELS];
+    uint8_t prev_len[HISTORY_NUM_CHANNELS]; // meaningful bits of the last window, 0 if none yet
+    int16_t min[HISTORY_NUM_CHANNELS];      // min > max until the channel has a value
+    int16_t max[HISTORY_NUM_CHANNELS];
+    bool overflow;
+} history_encoder_t;
+
+typedef struct history_decoder {
+    const uint8_t* buf;
+    uint32_t size_bits;
+    uint32_t pos;
+    uint32_t remaining;
+    uint32_t prev_time;
+    int32_t prev_delta;
+    uint16_t prev_value[HISTORY_NUM_CHANNELS];
+    uint8_t prev_lead[HISTORY_NUM_CHANNELS];
+    uint8_t prev_len[HISTORY_NUM_CHANNELS];
+    bool first;
+} history_decoder_t;
+
+void history_encoder_init(history_encoder_t* enc, uint8_t* buf, uint32_t size);
+// Appends the row, or leaves the encoder untouched and returns false if it does not fit
+bool history_encoder_append(history_encoder_t* enc, const history_row_t* row);
+static inline uint32_t history_encoder_bytes(const history_encoder_t* enc)
+{
+    return (enc->bits + 7) / 8;
+}
+
+void history_decoder_init(history_decoder_t* dec, const uint8_t* buf, uint32_t size, uint32_t count);
+// False once count rows were returned or the data is truncated
+bool history_decoder_next(history_decoder_t* dec, history_row_t* row);
+// Bits consumed so far
+static inline uint32_t history_decoder_bits(const history_decoder_t* dec)
+{
+    return dec->pos;
+}
+
+#ifdef __cplusplus
+}
+#endif
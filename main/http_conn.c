@@ -0,0 +1,187 @@
+#include "http_conn.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lwip/sockets.h"
+
+#include "cJSON.h"
+
+#include <string.h>
+
+static const char* TAG = "aqm-http-conn";
+
+#define HTTP_CONN_SWEEP_PERIOD_USEC (1000 * 1000)
+// Dead peers (powered-off tablets) are dropped by TCP before the idle sweep would notice
+#define HTTP_CONN_KEEPALIVE_IDLE_SEC 15
+#define HTTP_CONN_KEEPALIVE_INTERVAL_SEC 5
+#define HTTP_CONN_KEEPALIVE_COUNT 3
+
+static struct {
+    http_conn_t conns[HTTP_CONN_MAX];
+    http_conn_stats_t stats;
+    esp_timer_handle_t sweep_timer;
+    bool sweep_queued;
+} s_http_conn = {
+    .conns = { [0 ... HTTP_CONN_MAX - 1] = { .fd = -1 } },
+};
+
+static http_conn_t* find_conn(int fd)
+{
+    for (int i = 0; i < HTTP_CONN_MAX; i++) {
+        if (s_http_conn.conns[i].fd == fd) {
+            return &s_http_conn.conns[i];
+        }
+    }
+    return NULL;
+}
+
+esp_err_t http_conn_open(httpd_handle_t server, int fd)
+{
+    int on = 1;
+    int idle = HTTP_CONN_KEEPALIVE_IDLE_SEC;
+    int interval = HTTP_CONN_KEEPALIVE_INTERVAL_SEC;
+    int count = HTTP_CONN_KEEPALIVE_COUNT;
+    setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof(on));
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle));
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof(interval));
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &count, sizeof(count));
+    // Responses are written in as few sends as possible, no need to wait for coalescing
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+    http_conn_stats_t* st = &s_http_conn.stats;
+    st->accepted++;
+    st->open++;
+    if (st->open > st->peak_open) {
+        st->peak_open = st->open;
+    }
+
+    http_conn_t* conn = find_conn(-1);
+    if (conn == NULL) {
+        return ESP_OK; // more sockets than slots, counted but not tracked
+    }
+    memset(conn, 0, sizeof(http_conn_t));
+    conn->fd = fd;
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    if (getpeername(fd, (struct sockaddr*)&addr, &len) == 0 && addr.sin_family == AF_INET) {
+        conn->peer_addr = addr.sin_addr.s_addr;
+        conn->peer_port = ntohs(addr.sin_port);
+    }
+    conn->opened_usec = esp_timer_get_time();
+    conn->last_usec = conn->opened_usec;
+    return ESP_OK;
+}
+
+// Setting close_fn makes closing the socket our job
+void http_conn_close(httpd_handle_t server, int fd)
+{
+    http_conn_t* conn = find_conn(fd);
+    if (conn != NULL) {
+        conn->fd = -1;
+    }
+    s_http_conn.stats.closed++;
+    s_http_conn.stats.open--;
+    close(fd);
+}
+
+void http_conn_record_request(int fd, uint32_t latency_usec, esp_err_t err)
+{
+    s_http_conn.stats.requests++;
+    http_conn_t* conn = find_conn(fd);
+    if (conn == NULL) {
+        return;
+    }
+    if (conn->requests > 0) {
+        s_http_conn.stats.reused++;
+    }
+    conn->requests++;
+    if (err != ESP_OK) {
+        conn->errors++;
+    }
+    conn->sum_latency_usec += latency_usec;
+    if (latency_usec > conn->max_latency_usec) {
+        conn->max_latency_usec = latency_usec;
+    }
+    conn->last_usec = esp_timer_get_time();
+}
+
+static void sweep_work(void* arg)
+{
+    httpd_handle_t server = (httpd_handle_t)arg;
+    s_http_conn.sweep_queued = false;
+    int64_t idle_limit = esp_timer_get_time() - CONFIG_AQM_HTTP_IDLE_TIMEOUT_SEC * 1000000LL;
+    for (int i = 0; i < HTTP_CONN_MAX; i++) {
+        http_conn_t* conn = &s_http_conn.conns[i];
+        if (conn->fd >= 0 && conn->last_usec < idle_limit) {
+            if (httpd_sess_trigger_close(server, conn->fd) == ESP_OK) {
+                s_http_conn.stats.idle_closed++;
+                conn->last_usec = INT64_MAX; // the close itself is queued, count it once
+            }
+        }
+    }
+}
+
+static void sweep_timer_cb(void* arg)
+{
+    // The sweep runs on the server task, where the connection table is owned
+    if (!s_http_conn.sweep_queued) {
+        s_http_conn.sweep_queued = httpd_queue_work((httpd_handle_t)arg, &sweep_work, arg) == ESP_OK;
+    }
+}
+
+esp_err_t http_conn_start_idle_sweep(httpd_handle_t server)
+{
+    const esp_timer_create_args_t args = {
+        .callback = &sweep_timer_cb,
+        .arg = server,
+        .name = "http-idle",
+    };
+    esp_err_t err = esp_timer_create(&args, &s_http_conn.sweep_timer);
+    if (err == ESP_OK) {
+        err = esp_timer_start_periodic(s_http_conn.sweep_timer, HTTP_CONN_SWEEP_PERIOD_USEC);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start the idle sweep: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+const http_conn_stats_t* http_conn_get_stats(void)
+{
+    return &s_http_conn.stats;
+}
+
+void http_conn_to_json(struct cJSON* root)
+{
+    const http_conn_stats_t* st = &s_http_conn.stats;
+    cJSON_AddNumberToObject(root, "max_sockets", HTTP_CONN_MAX);
+    cJSON_AddNumberToObject(root, "accepted", st->accepted);
+    cJSON_AddNumberToObject(root, "closed", st->closed);
+    cJSON_AddNumberToObject(root, "idle_closed", st->idle_closed);
+    cJSON_AddNumberToObject(root, "open", st->open);
+    cJSON_AddNumberToObject(root, "peak_open", st->peak_open);
+    cJSON_AddNumberToObject(root, "requests", st->requests);
+    cJSON_AddNumberToObject(root, "reused", st->reused);
+
+    int64_t now = esp_timer_get_time();
+    cJSON* conns = cJSON_AddArrayToObject(root, "connections");
+    for (int i = 0; i < HTTP_CONN_MAX; i++) {
+        const http_conn_t* conn = &s_http_conn.conns[i];
+        if (conn->fd < 0) {
+            continue;
+        }
+        char peer[24];
+        const uint8_t* ip = (const uint8_t*)&conn->peer_addr;
+        snprintf(&peer[0], sizeof(peer), "%u.%u.%u.%u:%u", ip[0], ip[1], ip[2], ip[3], conn->peer_port);
+        cJSON* entry = cJSON_CreateObject();
+        cJSON_AddNumberToObject(entry, "fd", conn->fd);
+        cJSON_AddStringToObject(entry, "peer", &peer[0]);
+        cJSON_AddNumberToObject(entry, "age_msec", (now - conn->opened_usec) / 1000);
+        cJSON_AddNumberToObject(entry, "idle_msec", conn->last_usec <= now ? (now - conn->last_usec) / 1000 : 0);
+        cJSON_AddNumberToObject(entry, "requests", conn->requests);
+        cJSON_AddNumberToObject(entry, "errors", conn->errors);
+        cJSON_AddNumberToObject(entry, "avg_latency_usec", conn->requests ? conn->sum_latency_usec / conn->requests : 0);
+        cJSON_AddNumberToObject(entry, "max_latency_usec", conn->max_latency_usec);
+        cJSON_AddItemToArray(conns, entry);
+    }
+}
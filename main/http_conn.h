@@ -0,0 +1,53 @@
+#pragma once
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "sdkconfig.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HTTP_CONN_MAX CONFIG_AQM_HTTP_MAX_SOCKETS
+
+typedef struct http_conn {
+    int fd;                     // -1 when the slot is free
+    uint32_t peer_addr;         // IPv4, network order
+    uint16_t peer_port;
+    int64_t opened_usec;
+    int64_t last_usec;          // end of the last request, or the accept
+    uint32_t requests;
+    uint32_t errors;            // handlers that returned an error
+    uint32_t max_latency_usec;
+    uint64_t sum_latency_usec;
+} http_conn_t;
+
+typedef struct http_conn_stats {
+    uint32_t accepted;
+    uint32_t closed;            // by the client, the LRU purge or the idle sweep
+    uint32_t idle_closed;       // by the idle sweep
+    uint32_t open;
+    uint32_t peak_open;
+    uint32_t requests;
+    uint32_t reused;            // requests served on an already used connection
+} http_conn_stats_t;
+
+// Connection bookkeeping for the HTTP server. All of these run on the server task: open/close
+// are the httpd open_fn/close_fn, requests are recorded by the dispatcher, the idle sweep is
+// queued with httpd_queue_work().
+esp_err_t http_conn_open(httpd_handle_t server, int fd);
+void http_conn_close(httpd_handle_t server, int fd);
+void http_conn_record_request(int fd, uint32_t latency_usec, esp_err_t err);
+// Closes keep-alive connections idle for longer than CONFIG_AQM_HTTP_IDLE_TIMEOUT_SEC
+esp_err_t http_conn_start_idle_sweep(httpd_handle_t server);
+
+const http_conn_stats_t* http_conn_get_stats(void);
+
+struct cJSON;
+void http_conn_to_json(struct cJSON* root);
+
+#ifdef __cplusplus
+}
+#endif
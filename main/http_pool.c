@@ -0,0 +1,96 @@
+#include "http_pool.h"
+
+#include "cJSON.h"
+
+_Static_assert(CONFIG_AQM_HTTP_SMALL_BUFS <= 32 && CONFIG_AQM_HTTP_LARGE_BUFS <= 32, "one free bit per buffer");
+
+static char s_small[CONFIG_AQM_HTTP_SMALL_BUFS][HTTP_POOL_SMALL_SIZE] __attribute__((aligned(4)));
+static char s_large[CONFIG_AQM_HTTP_LARGE_BUFS][HTTP_POOL_LARGE_SIZE] __attribute__((aligned(4)));
+
+typedef struct http_pool {
+    char* base;
+    uint32_t size;
+    uint32_t count;
+    uint32_t free;          // bit per buffer, set while it is free
+    http_pool_stats_t stats;
+} http_pool_t;
+
+static http_pool_t s_pools[HTTP_POOL_NUM_CLASSES] = {
+    [HTTP_POOL_SMALL] = {
+        .base = &s_small[0][0],
+        .size = HTTP_POOL_SMALL_SIZE,
+        .count = CONFIG_AQM_HTTP_SMALL_BUFS,
+        .free = (uint32_t)((1ull << CONFIG_AQM_HTTP_SMALL_BUFS) - 1),
+        .stats = { .count = CONFIG_AQM_HTTP_SMALL_BUFS, .size = HTTP_POOL_SMALL_SIZE },
+    },
+    [HTTP_POOL_LARGE] = {
+        .base = &s_large[0][0],
+        .size = HTTP_POOL_LARGE_SIZE,
+        .count = CONFIG_AQM_HTTP_LARGE_BUFS,
+        .free = (uint32_t)((1ull << CONFIG_AQM_HTTP_LARGE_BUFS) - 1),
+        .stats = { .count = CONFIG_AQM_HTTP_LARGE_BUFS, .size = HTTP_POOL_LARGE_SIZE },
+    },
+};
+
+char* http_pool_lease(http_pool_class_t cls)
+{
+    http_pool_t* pool = &s_pools[cls];
+    uint32_t free = __atomic_load_n(&pool->free, __ATOMIC_ACQUIRE);
+    while (free != 0) {
+        uint32_t bit = free & -free;
+        if (__atomic_compare_exchange_n(&pool->free, &free, free & ~bit, true, __ATOMIC_ACQUIRE,
+                __ATOMIC_ACQUIRE)) {
+            __atomic_fetch_add(&pool->stats.leases, 1, __ATOMIC_RELAXED);
+            uint32_t in_use = __atomic_add_fetch(&pool->stats.in_use, 1, __ATOMIC_RELAXED);
+            uint32_t peak = __atomic_load_n(&pool->stats.peak_in_use, __ATOMIC_RELAXED);
+            while (in_use > peak && !__atomic_compare_exchange_n(&pool->stats.peak_in_use, &peak, in_use, true,
+                    __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            }
+            return pool->base + (size_t)__builtin_ctz(bit) * pool->size;
+        }
+        // free was reloaded by the failed exchange
+    }
+    __atomic_fetch_add(&pool->stats.exhausted, 1, __ATOMIC_RELAXED);
+    return NULL;
+}
+
+void http_pool_release(char* buf)
+{
+    if (buf == NULL) {
+        return;
+    }
+    for (int cls = 0; cls < HTTP_POOL_NUM_CLASSES; cls++) {
+        http_pool_t* pool = &s_pools[cls];
+        if (buf >= pool->base && buf < pool->base + (size_t)pool->count * pool->size) {
+            uint32_t index = (uint32_t)(buf - pool->base) / pool->size;
+            __atomic_fetch_sub(&pool->stats.in_use, 1, __ATOMIC_RELAXED);
+            __atomic_fetch_or(&pool->free, 1u << index, __ATOMIC_RELEASE);
+            return;
+        }
+    }
+}
+
+size_t http_pool_buf_size(http_pool_class_t cls)
+{
+    return s_pools[cls].size;
+}
+
+const http_pool_stats_t* http_pool_get_stats(http_pool_class_t cls)
+{
+    return &s_pools[cls].stats;
+}
+
+void http_pool_to_json(struct cJSON* root)
+{
+    static const char* class_names[HTTP_POOL_NUM_CLASSES] = { "small", "large" };
+    for (int cls = 0; cls < HTTP_POOL_NUM_CLASSES; cls++) {
+        const http_pool_stats_t* st = &s_pools[cls].stats;
+        cJSON* entry = cJSON_AddObjectToObject(root, class_names[cls]);
+        cJSON_AddNumberToObject(entry, "count", st->count);
+        cJSON_AddNumberToObject(entry, "size", st->size);
+        cJSON_AddNumberToObject(entry, "leases", st->leases);
+        cJSON_AddNumberToObject(entry, "exhausted", st->exhausted);
+        cJSON_AddNumberToObject(entry, "in_use", st->in_use);
+        cJSON_AddNumberToObject(entry, "peak_in_use", st->peak_in_use);
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "history.h"
+#include "sdkconfig.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Request buffers leased per request instead of one shared scratch buffer in the server context.
+// Small buffers take JSON request bodies (AQI, settings, OTA pull). Large buffers hold one history
+// block plus a response chunk, or an alert rule set. esp_http_server runs every handler in its
+// single httpd task, one request at a time, so one buffer per class is all it can lease; more
+// only help if handlers are ever moved to worker tasks.
+typedef enum http_pool_class {
+    HTTP_POOL_SMALL,
+    HTTP_POOL_LARGE,
+    HTTP_POOL_NUM_CLASSES
+} http_pool_class_t;
+
+#define HTTP_POOL_SMALL_SIZE 1024
+#define HTTP_POOL_LARGE_SIZE (HISTORY_BLOCK_SIZE + 2048)
+
+typedef struct http_pool_stats {
+    uint32_t count;         // buffers in the class
+    uint32_t size;
+    uint32_t leases;
+    uint32_t exhausted;     // leases refused because every buffer was taken
+    uint32_t in_use;
+    uint32_t peak_in_use;
+} http_pool_stats_t;
+
+// Lock-free, so it stays safe if leases ever come from more than one task. Returns NULL when
+// every buffer of the class is leased.
+char* http_pool_lease(http_pool_class_t cls);
+void http_pool_release(char* buf);
+size_t http_pool_buf_size(http_pool_class_t cls);
+const http_pool_stats_t* http_pool_get_stats(http_pool_class_t cls);
+
+struct cJSON;
+void http_pool_to_json(struct cJSON* root);
+
+#ifdef __cplusplus
+}
+#endif
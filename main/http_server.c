@@ -1,12 +1,39 @@
 #include "http_server.h"
 #include "sensor_data.h"
+#include "sample_bus.h"
 #include "system.h"
+#include "aqi.h"
+#include "power.h"
+#include "ota.h"
+#include "settings.h"
+#include "task_plan.h"
+#include "sample_rate.h"
+#include "i2c_bus.h"
+#include "lcd_layout.h"
+#include "alerts.h"
+#include "fleet.h"
+#include "health.h"
+#include "history.h"
+#include "stats.h"
+#include "telemetry.h"
+#include "swinging_door.h"
+#include "deadband.h"
+#include "www.h"
+#include "boot.h"
+#include "wifi.h"
+#include "arena.h"
+#include "http_pool.h"
+#include "http_conn.h"
 
 #include "esp_log.h"
 #include "esp_system.h"
+#include "esp_timer.h"
 
 #include "cJSON.h"
 
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <fcntl.h>
 
@@ -57,6 +84,147 @@ static esp_err_t get_system_info_handler(httpd_req_t* req)
         cJSON_AddNumberToObject(root, "cpu_revision", rest_server->sys->chip_info.revision);
         cJSON_AddNumberToObject(root, "cpu_full_revision", rest_server->sys->chip_info.full_revision);
         cJSON_AddStringToObject(root, "cpu_model", get_cpu_model_string(rest_server->sys->chip_info.model));
+
+        const power_stats_t* ps = power_get_stats();
+        cJSON* power = cJSON_AddObjectToObject(root, "power");
+        cJSON_AddBoolToObject(power, "power_save", power_save_enabled());
+        cJSON_AddNumberToObject(power, "num_samples", ps->num_samples);
+        cJSON_AddNumberToObject(power, "avg_active_usec", power_avg_active_usec());
+        cJSON_AddNumberToObject(power, "last_active_usec", ps->last_tick_usec);
+        cJSON_AddNumberToObject(power, "est_avg_current_ma", power_estimate_avg_current_ma());
+
+        const sampler_stats_t* ss = task_plan_get_stats();
+        cJSON* sampler = cJSON_AddObjectToObject(root, "sampler");
+        cJSON_AddNumberToObject(sampler, "num_periods", ss->num_periods);
+        cJSON_AddNumberToObject(sampler, "target_period_usec", ss->target_usec);
+        if (ss->num_periods > 0) {
+            cJSON_AddNumberToObject(sampler, "min_period_usec", ss->min_period_usec);
+            cJSON_AddNumberToObject(sampler, "max_period_usec", ss->max_period_usec);
+        }
+        cJSON_AddNumberToObject(sampler, "avg_abs_jitter_usec", task_plan_avg_abs_jitter_usec());
+        cJSON_AddNumberToObject(sampler, "max_abs_jitter_usec", ss->max_abs_jitter_usec);
+        cJSON_AddBoolToObject(sampler, "overlap_io", task_plan_overlap_io_enabled());
+        cJSON_AddNumberToObject(sampler, "num_ticks", ss->num_ticks);
+        cJSON_AddNumberToObject(sampler, "last_busy_usec", ss->last_busy_usec);
+        cJSON_AddNumberToObject(sampler, "avg_busy_usec", task_plan_avg_busy_usec());
+        cJSON_AddNumberToObject(sampler, "max_busy_usec", ss->max_busy_usec);
+        cJSON_AddBoolToObject(sampler, "adaptive", task_plan_adaptive_enabled());
+        if (rest_server->sample_rate != NULL) {
+            const sample_rate_t* sr = rest_server->sample_rate;
+            cJSON_AddNumberToObject(sampler, "interval_msec", sr->interval_msec);
+            cJSON_AddNumberToObject(sampler, "activity", sr->activity);
+            cJSON_AddNumberToObject(sampler, "samples_per_hour", sample_rate_per_hour(sr));
+            cJSON_AddNumberToObject(sampler, "tightened", sr->stats.tightened);
+            cJSON_AddNumberToObject(sampler, "widened", sr->stats.widened);
+            if (sr->stats.sampled_msec > 0) {
+                cJSON_AddNumberToObject(sampler, "fastest_fraction",
+                    (double)sr->stats.fastest_msec / (double)sr->stats.sampled_msec);
+            }
+        }
+
+        if (rest_server->samples != NULL) {
+            const sample_bus_t* bus = rest_server->samples;
+            cJSON* sample_bus = cJSON_AddObjectToObject(root, "sample_bus");
+            cJSON_AddNumberToObject(sample_bus, "published", sample_bus_published(bus));
+            uint32_t num_subs = __atomic_load_n(&bus->num_subs, __ATOMIC_ACQUIRE);
+            for (uint32_t i = 0; i < num_subs; i++) {
+                const sample_sub_t* sub = &bus->subs[i];
+                cJSON* entry = cJSON_AddObjectToObject(sample_bus, sub->name);
+                cJSON_AddNumberToObject(entry, "delivered", sub->delivered);
+                cJSON_AddNumberToObject(entry, "skipped", sub->skipped);
+                cJSON_AddNumberToObject(entry, "torn", sub->torn);
+                cJSON_AddNumberToObject(entry, "lag", sample_bus_published(bus) + 1 - sub->cursor);
+            }
+        }
+
+        if (rest_server->lcd_layout != NULL) {
+            const lcd_layout_t* layout = rest_server->lcd_layout;
+            const lcd_layout_stats_t* ls = &layout->stats;
+            const display_stats_t* ds = &layout->disp->stats;
+            cJSON* lcd = cJSON_AddObjectToObject(root, "lcd");
+            cJSON_AddStringToObject(lcd, "type", display_type_name(layout->disp->type));
+            cJSON_AddNumberToObject(lcd, "rows", layout->disp->rows);
+            cJSON_AddNumberToObject(lcd, "cols", layout->disp->cols);
+            cJSON_AddStringToObject(lcd, "screen", layout->screen->name);
+            cJSON_AddNumberToObject(lcd, "renders", ls->renders);
+            cJSON_AddNumberToObject(lcd, "redraws", ls->redraws);
+            cJSON_AddNumberToObject(lcd, "fields_drawn", ls->fields_drawn);
+            cJSON_AddNumberToObject(lcd, "fields_skipped", ls->fields_skipped);
+            cJSON_AddNumberToObject(lcd, "chars_written", ls->chars_written);
+            cJSON_AddNumberToObject(lcd, "last_render_usec", ls->last_render_usec);
+            cJSON_AddNumberToObject(lcd, "max_render_usec", ls->max_render_usec);
+            cJSON_AddNumberToObject(lcd, "bytes_sent", ds->bytes_sent);
+            cJSON_AddNumberToObject(lcd, "last_refresh_bytes", ds->last_refresh_bytes);
+            cJSON_AddNumberToObject(lcd, "max_refresh_bytes", ds->max_refresh_bytes);
+            const lcd_glyph_stats_t* gs = &layout->glyphs.stats;
+            cJSON* glyphs = cJSON_AddObjectToObject(lcd, "glyphs");
+            cJSON_AddNumberToObject(glyphs, "hits", gs->hits);
+            cJSON_AddNumberToObject(glyphs, "misses", gs->misses);
+            cJSON_AddNumberToObject(glyphs, "full", gs->full);
+            cJSON_AddNumberToObject(glyphs, "rows_written", gs->rows_written);
+            cJSON_AddNumberToObject(glyphs, "rows_skipped", gs->rows_skipped);
+        }
+
+        static const char* prio_names[I2C_BUS_NUM_PRIOS] = { "sensor", "display" };
+        const i2c_bus_stats_t* bs = i2c_bus_get_stats();
+        cJSON* i2c = cJSON_AddObjectToObject(root, "i2c");
+        cJSON_AddNumberToObject(i2c, "freq_hz", bs->freq_hz);
+        cJSON_AddNumberToObject(i2c, "utilization", i2c_bus_utilization());
+        cJSON_AddNumberToObject(i2c, "busy_usec", bs->busy_usec);
+        for (int p = 0; p < I2C_BUS_NUM_PRIOS; p++) {
+            const i2c_bus_prio_stats_t* ps = &bs->prio[p];
+            cJSON* prio = cJSON_AddObjectToObject(i2c, prio_names[p]);
+            cJSON_AddNumberToObject(prio, "num_txns", ps->num_txns);
+            cJSON_AddNumberToObject(prio, "num_errors", ps->num_errors);
+            cJSON_AddNumberToObject(prio, "bytes", ps->bytes);
+            cJSON_AddNumberToObject(prio, "avg_latency_usec", ps->num_txns ? ps->sum_latency_usec / ps->num_txns : 0);
+            cJSON_AddNumberToObject(prio, "max_latency_usec", ps->max_latency_usec);
+        }
+
+        history_to_json(cJSON_AddObjectToObject(root, "history"));
+        stats_to_json(cJSON_AddObjectToObject(root, "stats"));
+        telemetry_to_json(cJSON_AddObjectToObject(root, "telemetry"));
+        boot_to_json(cJSON_AddObjectToObject(root, "boot"));
+        arena_to_json(cJSON_AddObjectToObject(root, "arena"));
+        http_pool_to_json(cJSON_AddObjectToObject(root, "http_pool"));
+        http_conn_to_json(cJSON_AddObjectToObject(root, "http"));
+
+        const wifi_stats_t* wf = wifi_get_stats();
+        char bssid[18];
+        snprintf(&bssid[0], sizeof(bssid), MACSTR, MAC2STR(wf->bssid));
+        cJSON* wifi = cJSON_AddObjectToObject(root, "wifi");
+        cJSON_AddStringToObject(wifi, "bssid", &bssid[0]);
+        cJSON_AddNumberToObject(wifi, "channel", wf->channel);
+        cJSON_AddNumberToObject(wifi, "rssi", wf->rssi);
+        cJSON_AddBoolToObject(wifi, "static_ip", wf->static_ip);
+        cJSON_AddNumberToObject(wifi, "connects", wf->connects);
+        cJSON_AddNumberToObject(wifi, "fast_connects", wf->fast_connects);
+        cJSON_AddNumberToObject(wifi, "fast_fallbacks", wf->fast_fallbacks);
+        cJSON_AddNumberToObject(wifi, "backoff_retries", wf->backoff_retries);
+        cJSON_AddNumberToObject(wifi, "disconnects", wf->disconnects);
+        cJSON_AddNumberToObject(wifi, "roam_scans", wf->roam_scans);
+        cJSON_AddNumberToObject(wifi, "roams", wf->roams);
+        cJSON_AddNumberToObject(wifi, "last_time_to_ip_usec", wf->last_time_to_ip_usec);
+        cJSON_AddNumberToObject(wifi, "min_time_to_ip_usec", wf->min_time_to_ip_usec);
+        cJSON_AddNumberToObject(wifi, "max_time_to_ip_usec", wf->max_time_to_ip_usec);
+        cJSON_AddNumberToObject(wifi, "avg_time_to_ip_usec", wf->connects ? wf->sum_time_to_ip_usec / wf->connects : 0);
+
+        const www_stats_t* ws = www_get_stats();
+        uint32_t served = ws->requests - ws->not_modified;
+        cJSON* www = cJSON_AddObjectToObject(root, "www");
+        cJSON_AddBoolToObject(www, "mounted", www_mounted());
+        cJSON_AddNumberToObject(www, "files", ws->files);
+        cJSON_AddNumberToObject(www, "image_bytes", ws->image_bytes);
+        cJSON_AddNumberToObject(www, "requests", ws->requests);
+        cJSON_AddNumberToObject(www, "not_modified", ws->not_modified);
+        cJSON_AddNumberToObject(www, "not_found", ws->not_found);
+        cJSON_AddNumberToObject(www, "bytes_sent", ws->bytes_sent);
+        cJSON_AddNumberToObject(www, "max_active", ws->max_active);
+        cJSON_AddNumberToObject(www, "avg_ttfb_usec", served ? ws->sum_ttfb_usec / served : 0);
+        cJSON_AddNumberToObject(www, "last_ttfb_usec", ws->last_ttfb_usec);
+        cJSON_AddNumberToObject(www, "max_ttfb_usec", ws->max_ttfb_usec);
+        cJSON_AddNumberToObject(www, "last_heap_bytes", ws->last_heap_bytes);
+        cJSON_AddNumberToObject(www, "max_heap_bytes", ws->max_heap_bytes);
     }
     const char* json = cJSON_Print(root);
     httpd_resp_sendstr(req, json);
@@ -70,16 +238,91 @@ static esp_err_t get_sensor_data_handler(httpd_req_t* req)
     httpd_resp_set_type(req, "application/json");
     cJSON* root = cJSON_CreateObject();
     rest_server_context_t* rest_server = (rest_server_context_t*)req->user_ctx;
-    if (rest_server != NULL && rest_server->sensors != NULL) {
-        cJSON_AddNumberToObject(root, "temperature_mcp9808", rest_server->sensors->temperature_mcp9808);
-        cJSON_AddNumberToObject(root, "mass_concentration_pm1p0", rest_server->sensors->mass_concentration_pm1p0);
-        cJSON_AddNumberToObject(root, "mass_concentration_pm2p5", rest_server->sensors->mass_concentration_pm2p5);
-        cJSON_AddNumberToObject(root, "mass_concentration_pm4p0", rest_server->sensors->mass_concentration_pm4p0);
-        cJSON_AddNumberToObject(root, "mass_concentration_pm10p0", rest_server->sensors->mass_concentration_pm10p0);
-        cJSON_AddNumberToObject(root, "ambient_humidity", rest_server->sensors->ambient_humidity);
-        cJSON_AddNumberToObject(root, "ambient_temperature", rest_server->sensors->ambient_temperature);
-        cJSON_AddNumberToObject(root, "voc_index", rest_server->sensors->voc_index);
-        cJSON_AddNumberToObject(root, "nox_index", rest_server->sensors->nox_index);
+    struct sensor_data sd;
+    if (rest_server != NULL && rest_server->samples != NULL && sample_bus_read_latest(rest_server->samples, &sd)) {
+        // Readings go straight from fixed point to text; the indices stay raw x10 as always
+        static const char* const keys[SENSOR_VOC_INDEX] = {
+            "temperature_mcp9808",
+            "mass_concentration_pm1p0",
+            "mass_concentration_pm2p5",
+            "mass_concentration_pm4p0",
+            "mass_concentration_pm10p0",
+            "ambient_humidity",
+            "ambient_temperature",
+        };
+        char text[SENSOR_FORMAT_MAX];
+        for (int f = 0; f < SENSOR_VOC_INDEX; f++) {
+            sensor_format(&text[0], sizeof(text), f, sd.sample.value[f]);
+            cJSON_AddRawToObject(root, keys[f], &text[0]);
+        }
+        cJSON_AddNumberToObject(root, "voc_index", sd.sample.value[SENSOR_VOC_INDEX]);
+        cJSON_AddNumberToObject(root, "nox_index", sd.sample.value[SENSOR_NOX_INDEX]);
+        cJSON_AddNumberToObject(root, "aqi", sd.aqi);
+        cJSON_AddStringToObject(root, "aqi_algorithm", aqi_algorithm_name(sd.aqi_algorithm));
+    }
+    const char* json = cJSON_Print(root);
+    httpd_resp_sendstr(req, json);
+    free((void*)json);
+    cJSON_Delete(root);
+    return ESP_OK;
+}
+
+static esp_err_t read_request_body(httpd_req_t* req, char* buf, size_t size)
+{
+    int total_len = req->content_len;
+    int cur_len = 0;
+    if (total_len < 0 || (size_t)total_len >= size) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Content too long");
+        return ESP_FAIL;
+    }
+    while (cur_len < total_len) {
+        int received = httpd_req_recv(req, buf + cur_len, total_len - cur_len);
+        if (received <= 0) {
+            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to receive request body");
+            return ESP_FAIL;
+        }
+        cur_len += received;
+    }
+    buf[total_len] = '\0';
+    return ESP_OK;
+}
+
+// Leases a request buffer, answering 503 when all of the class are taken. Handlers run one at a
+// time in the httpd task, so this only happens when a handler leaked its buffer.
+static char* lease_buffer(httpd_req_t* req, http_pool_class_t cls)
+{
+    char* buf = http_pool_lease(cls);
+    if (buf == NULL) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_hdr(req, "Retry-After", "1");
+        httpd_resp_sendstr(req, "Server busy");
+    }
+    return buf;
+}
+
+static esp_err_t get_aqi_handler(httpd_req_t* req)
+{
+    httpd_resp_set_type(req, "application/json");
+    cJSON* root = cJSON_CreateObject();
+    rest_server_context_t* rest_server = (rest_server_context_t*)req->user_ctx;
+    struct sensor_data latest;
+    if (rest_server != NULL && rest_server->samples != NULL && sample_bus_read_latest(rest_server->samples, &latest)) {
+        const struct sensor_data* sd = &latest;
+        cJSON_AddStringToObject(root, "algorithm", aqi_algorithm_name(sd->aqi_algorithm));
+        cJSON_AddNumberToObject(root, "aqi", sd->aqi);
+        if (sd->aqi != AQI_INVALID) {
+            cJSON_AddStringToObject(root, "dominant", aqi_pollutant_name(sd->aqi_dominant));
+        }
+        cJSON* sub = cJSON_AddObjectToObject(root, "sub_indices");
+        for (int i = 0; i < AQI_NUM_POLLUTANTS; i++) {
+            if (sd->aqi_sub[i] != AQI_INVALID) {
+                cJSON_AddNumberToObject(sub, aqi_pollutant_name(i), sd->aqi_sub[i]);
+            }
+        }
+        cJSON* algos = cJSON_AddArrayToObject(root, "algorithms");
+        for (int i = 0; i < aqi_algorithm_count(); i++) {
+            cJSON_AddItemToArray(algos, cJSON_CreateString(aqi_algorithm_name(i)));
+        }
     }
     const char* json = cJSON_Print(root);
     httpd_resp_sendstr(req, json);
@@ -88,6 +331,524 @@ static esp_err_t get_sensor_data_handler(httpd_req_t* req)
     return ESP_OK;
 }
 
+static esp_err_t put_aqi_handler(httpd_req_t* req)
+{
+    char* buf = lease_buffer(req, HTTP_POOL_SMALL);
+    if (buf == NULL) {
+        return ESP_FAIL;
+    }
+    if (read_request_body(req, buf, HTTP_POOL_SMALL_SIZE) != ESP_OK) {
+        http_pool_release(buf);
+        return ESP_FAIL;
+    }
+
+    cJSON* root = cJSON_Parse(buf);
+    http_pool_release(buf);
+    const cJSON* algo = cJSON_GetObjectItem(root, "algorithm");
+    int idx = cJSON_IsString(algo) ? aqi_algorithm_from_name(algo->valuestring) : AQI_INVALID;
+    cJSON_Delete(root);
+    if (idx == AQI_INVALID) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Unknown AQI algorithm");
+        return ESP_FAIL;
+    }
+
+    if (settings_set_aqi_algorithm(idx) != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to save settings");
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "AQI algorithm set to %s", aqi_algorithm_name(idx));
+    return get_aqi_handler(req);
+}
+
+static esp_err_t get_settings_handler(httpd_req_t* req)
+{
+    char query[32];
+    char value[8];
+    bool with_schema = httpd_req_get_url_query_str(req, &query[0], sizeof(query)) == ESP_OK
+        && httpd_query_key_value(&query[0], "schema", &value[0], sizeof(value)) == ESP_OK
+        && strcmp(&value[0], "0") != 0;
+
+    httpd_resp_set_type(req, "application/json");
+    cJSON* root = cJSON_CreateObject();
+    settings_to_json(root, with_schema);
+    const char* json = cJSON_Print(root);
+    httpd_resp_sendstr(req, json);
+    free((void*)json);
+    cJSON_Delete(root);
+    return ESP_OK;
+}
+
+static esp_err_t put_settings_handler(httpd_req_t* req)
+{
+    char* buf = lease_buffer(req, HTTP_POOL_SMALL);
+    if (buf == NULL) {
+        return ESP_FAIL;
+    }
+    if (read_request_body(req, buf, HTTP_POOL_SMALL_SIZE) != ESP_OK) {
+        http_pool_release(buf);
+        return ESP_FAIL;
+    }
+
+    char err_msg[96] = { 0 };
+    bool reboot_required = false;
+    cJSON* body = cJSON_Parse(buf);
+    http_pool_release(buf);
+    esp_err_t err = settings_update_json(body, &reboot_required, &err_msg[0], sizeof(err_msg));
+    cJSON_Delete(body);
+    if (err == ESP_ERR_INVALID_ARG) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, &err_msg[0]);
+        return ESP_FAIL;
+    } else if (err != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to save settings");
+        return ESP_FAIL;
+    }
+
+    httpd_resp_set_type(req, "application/json");
+    cJSON* root = cJSON_CreateObject();
+    settings_to_json(root, false);
+    cJSON_AddBoolToObject(root, "reboot_required", reboot_required);
+    const char* json = cJSON_Print(root);
+    httpd_resp_sendstr(req, json);
+    free((void*)json);
+    cJSON_Delete(root);
+    return ESP_OK;
+}
+
+static esp_err_t send_alerts(httpd_req_t* req)
+{
+    httpd_resp_set_type(req, "application/json");
+    cJSON* root = cJSON_CreateObject();
+    alerts_to_json(root);
+    const char* json = cJSON_Print(root);
+    httpd_resp_sendstr(req, json);
+    free((void*)json);
+    cJSON_Delete(root);
+    return ESP_OK;
+}
+
+static esp_err_t get_alerts_handler(httpd_req_t* req)
+{
+    return send_alerts(req);
+}
+
+static esp_err_t put_alerts_handler(httpd_req_t* req)
+{
+    char* buf = lease_buffer(req, HTTP_POOL_LARGE);
+    if (buf == NULL) {
+        return ESP_FAIL;
+    }
+    if (read_request_body(req, buf, HTTP_POOL_LARGE_SIZE) != ESP_OK) {
+        http_pool_release(buf);
+        return ESP_FAIL;
+    }
+
+    char err_msg[96] = { 0 };
+    cJSON* body = cJSON_Parse(buf);
+    http_pool_release(buf);
+    esp_err_t err = alerts_update_json(body, &err_msg[0], sizeof(err_msg));
+    cJSON_Delete(body);
+    if (err == ESP_ERR_INVALID_ARG) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, &err_msg[0]);
+        return ESP_FAIL;
+    } else if (err != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to save alert rules");
+        return ESP_FAIL;
+    }
+    return send_alerts(req);
+}
+
+static esp_err_t get_fleet_handler(httpd_req_t* req)
+{
+    httpd_resp_set_type(req, "application/json");
+    cJSON* root = cJSON_CreateObject();
+    fleet_to_json(root);
+    const char* json = cJSON_Print(root);
+    httpd_resp_sendstr(req, json);
+    free((void*)json);
+    cJSON_Delete(root);
+    return ESP_OK;
+}
+
+static esp_err_t get_health_handler(httpd_req_t* req)
+{
+    httpd_resp_set_type(req, "application/json");
+    cJSON* root = cJSON_CreateObject();
+    health_to_json(root);
+    const char* json = cJSON_Print(root);
+    httpd_resp_sendstr(req, json);
+    free((void*)json);
+    cJSON_Delete(root);
+    return ESP_OK;
+}
+
+// Rows are collected in a large pool buffer behind the block being decoded and sent in chunks,
+// so a query over the whole partition never holds more than one block and one chunk
+#define HISTORY_ROW_MAX_CHARS 192
+
+typedef struct history_writer {
+    httpd_req_t* req;
+    char* buf;
+    size_t len;
+    size_t cap;
+    uint32_t fields;        // bit per channel
+    uint32_t rows;
+    esp_err_t err;
+    bool sent;              // a chunk, and with it the 200 status, has gone out
+    swinging_door_t* door;  // NULL when rows are sent uncompressed
+} history_writer_t;
+
+static bool history_writer_flush(history_writer_t* w)
+{
+    if (w->len > 0 && w->err == ESP_OK) {
+        w->err = httpd_resp_send_chunk(w->req, w->buf, w->len);
+        w->sent = true;
+    }
+    w->len = 0;
+    return w->err == ESP_OK;
+}
+
+static bool history_emit_row(history_writer_t* w, const history_row_t* row)
+{
+    if (w->cap - w->len < HISTORY_ROW_MAX_CHARS && !history_writer_flush(w)) {
+        return false;
+    }
+    w->len += snprintf(&w->buf[w->len], w->cap - w->len, "%s[%u", w->rows > 0 ? ",\n" : "\n", row->time);
+    for (int ch = 0; ch < HISTORY_NUM_CHANNELS; ch++) {
+        if (!(w->fields & (1u << ch))) {
+            continue;
+        }
+        w->buf[w->len++] = ',';
+        w->len += sensor_format(&w->buf[w->len], w->cap - w->len, ch, row->value[ch]);
+    }
+    w->buf[w->len++] = ']';
+    w->rows++;
+    return true;
+}
+
+static bool history_write_row(const history_row_t* row, void* arg)
+{
+    history_writer_t* w = (history_writer_t*)arg;
+    history_row_t kept;
+    if (w->door != NULL) {
+        if (!swinging_door_push(w->door, row, &kept)) {
+            return true;
+        }
+        row = &kept;
+    }
+    return history_emit_row(w, row);
+}
+
+// GET /api/v1/history?from=<unix>&to=<unix>&fields=pm2p5,voc_index&filter=pm2p5&min=35&max=1000
+//     &compress=sdt&dev=0.5
+// compress=sdt drops the rows that linear interpolation between the rows kept recovers to within
+// each field's telemetry deadband, or dev in engineering units for every field.
+static esp_err_t get_history_handler(httpd_req_t* req)
+{
+    if (history_get_stats()->blocks_total == 0) {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "History not available");
+        return ESP_FAIL;
+    }
+
+    history_query_t q = { .from = 0, .to = UINT32_MAX, .filter = -1, .min = -INFINITY, .max = INFINITY };
+    uint32_t fields = (1u << HISTORY_NUM_CHANNELS) - 1;
+    bool compress = false;
+    float dev = NAN;
+    char query[192];
+    char value[128];
+    if (httpd_req_get_url_query_str(req, &query[0], sizeof(query)) == ESP_OK) {
+        if (httpd_query_key_value(&query[0], "from", &value[0], sizeof(value)) == ESP_OK) {
+            q.from = strtoul(&value[0], NULL, 10);
+        }
+        if (httpd_query_key_value(&query[0], "to", &value[0], sizeof(value)) == ESP_OK) {
+            q.to = strtoul(&value[0], NULL, 10);
+        }
+        if (httpd_query_key_value(&query[0], "fields", &value[0], sizeof(value)) == ESP_OK) {
+            fields = 0;
+            char* save = NULL;
+            for (char* tok = strtok_r(&value[0], ",", &save); tok != NULL; tok = strtok_r(NULL, ",", &save)) {
+                int ch = history_channel_from_name(tok);
+                if (ch < 0) {
+                    httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Unknown history field");
+                    return ESP_FAIL;
+                }
+                fields |= 1u << ch;
+            }
+        }
+        if (httpd_query_key_value(&query[0], "filter", &value[0], sizeof(value)) == ESP_OK) {
+            q.filter = history_channel_from_name(&value[0]);
+            if (q.filter < 0) {
+                httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Unknown history field");
+                return ESP_FAIL;
+            }
+        }
+        if (httpd_query_key_value(&query[0], "min", &value[0], sizeof(value)) == ESP_OK) {
+            q.min = strtof(&value[0], NULL);
+        }
+        if (httpd_query_key_value(&query[0], "max", &value[0], sizeof(value)) == ESP_OK) {
+            q.max = strtof(&value[0], NULL);
+        }
+        if (httpd_query_key_value(&query[0], "compress", &value[0], sizeof(value)) == ESP_OK) {
+            if (strcmp(&value[0], "sdt") != 0) {
+                httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Unknown compression");
+                return ESP_FAIL;
+            }
+            compress = true;
+        }
+        if (httpd_query_key_value(&query[0], "dev", &value[0], sizeof(value)) == ESP_OK) {
+            dev = strtof(&value[0], NULL);
+            if (!(dev >= 0.0f)) {
+                httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid deviation");
+                return ESP_FAIL;
+            }
+        }
+    }
+
+    swinging_door_t door;
+    if (compress) {
+        int16_t devs[HISTORY_NUM_CHANNELS];
+        for (int ch = 0; ch < HISTORY_NUM_CHANNELS; ch++) {
+            devs[ch] = isnan(dev) ? deadband_abs(ch) : sensor_from_float(ch, dev);
+        }
+        // Rollups more than one period apart are a gap in the recording, not a slope
+        swinging_door_init(&door, fields, &devs[0], 2 * CONFIG_AQM_HISTORY_ROLLUP_SEC);
+    }
+
+    char* buf = lease_buffer(req, HTTP_POOL_LARGE);
+    if (buf == NULL) {
+        return ESP_FAIL;
+    }
+    httpd_resp_set_type(req, "application/json");
+    history_writer_t w = {
+        .req = req,
+        .buf = &buf[HISTORY_BLOCK_SIZE],
+        .len = 0,
+        .cap = HTTP_POOL_LARGE_SIZE - HISTORY_BLOCK_SIZE,
+        .fields = fields,
+        .rows = 0,
+        .err = ESP_OK,
+        .sent = false,
+        .door = compress ? &door : NULL
+    };
+    w.len += snprintf(&w.buf[0], w.cap, "{\"fields\":[\"time\"");
+    for (int ch = 0; ch < HISTORY_NUM_CHANNELS; ch++) {
+        if (fields & (1u << ch)) {
+            w.len += snprintf(&w.buf[w.len], w.cap - w.len, ",\"%s\"", history_channel_name(ch));
+        }
+    }
+    w.len += snprintf(&w.buf[w.len], w.cap - w.len, "],\"rows\":[");
+
+    esp_err_t err = history_query(&q, (uint8_t*)&buf[0], history_write_row, &w);
+    if (err != ESP_OK) {
+        http_pool_release(buf);
+        ESP_LOGW(TAG, "History query failed after %u rows: %s", w.rows, esp_err_to_name(err));
+        // Once rows have gone out the status is sent, so the truncated response is all the client gets
+        if (!w.sent) {
+            if (err == ESP_ERR_INVALID_ARG) {
+                httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid history range");
+            } else {
+                httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "History read failed");
+            }
+        }
+        return ESP_FAIL;
+    }
+    history_row_t last;
+    if (compress && swinging_door_finish(&door, &last) && w.err == ESP_OK) {
+        history_emit_row(&w, &last);
+    }
+    if (w.err == ESP_OK) {
+        if (compress) {
+            w.len += snprintf(&w.buf[w.len], w.cap - w.len, "\n],\"rows_scanned\":%u}\n", door.rows_in);
+        } else {
+            w.len += snprintf(&w.buf[w.len], w.cap - w.len, "\n]}\n");
+        }
+        history_writer_flush(&w);
+    }
+    http_pool_release(buf);
+    if (w.err != ESP_OK) {
+        ESP_LOGW(TAG, "History response aborted after %u rows", w.rows);
+        return ESP_FAIL;
+    }
+    httpd_resp_send_chunk(req, NULL, 0);
+    return ESP_OK;
+}
+
+static void add_ota_status(cJSON* root)
+{
+    const ota_status_t* st = ota_get_status();
+    cJSON_AddStringToObject(root, "state", ota_state_name(st->state));
+    cJSON_AddNumberToObject(root, "image_size", st->image_size);
+    cJSON_AddNumberToObject(root, "bytes_written", st->bytes_written);
+    cJSON_AddNumberToObject(root, "resumes", st->resumes);
+    cJSON_AddNumberToObject(root, "kbps", st->kbps);
+    if (st->state == OTA_STATE_FAILED) {
+        cJSON_AddStringToObject(root, "error", st->error);
+    }
+}
+
+static esp_err_t send_ota_status(httpd_req_t* req)
+{
+    httpd_resp_set_type(req, "application/json");
+    cJSON* root = cJSON_CreateObject();
+    add_ota_status(root);
+    const char* json = cJSON_Print(root);
+    httpd_resp_sendstr(req, json);
+    free((void*)json);
+    cJSON_Delete(root);
+    return ESP_OK;
+}
+
+// GET /api/v1/stats?field=pm2p5&window=hour|day&q=0.5,0.95,0.99
+static esp_err_t get_stats_handler(httpd_req_t* req)
+{
+    int field = -1;
+    int window = STATS_WINDOW_HOUR;
+    float q[STATS_MAX_QUANTILES];
+    int num_q = 0;
+    char query[128];
+    char value[64];
+    if (httpd_req_get_url_query_str(req, &query[0], sizeof(query)) == ESP_OK) {
+        if (httpd_query_key_value(&query[0], "field", &value[0], sizeof(value)) == ESP_OK) {
+            field = stats_field_from_name(&value[0]);
+        }
+        if (httpd_query_key_value(&query[0], "window", &value[0], sizeof(value)) == ESP_OK) {
+            window = stats_window_from_name(&value[0]);
+            if (window < 0) {
+                httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Expected window=hour or window=day");
+                return ESP_FAIL;
+            }
+        }
+        if (httpd_query_key_value(&query[0], "q", &value[0], sizeof(value)) == ESP_OK) {
+            char* save = NULL;
+            for (char* tok = strtok_r(&value[0], ",", &save); tok != NULL; tok = strtok_r(NULL, ",", &save)) {
+                char* end = NULL;
+                float v = strtof(tok, &end);
+                if (end == tok || *end != '\0' || !(v >= 0.0f && v <= 1.0f) || num_q >= STATS_MAX_QUANTILES) {
+                    httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Expected up to 8 quantiles between 0 and 1");
+                    return ESP_FAIL;
+                }
+                q[num_q++] = v;
+            }
+        }
+    }
+    if (field < 0) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Unknown stats field");
+        return ESP_FAIL;
+    }
+
+    cJSON* root = cJSON_CreateObject();
+    if (stats_field_to_json(root, field, window, &q[0], num_q) != ESP_OK) {
+        cJSON_Delete(root);
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Stats not available");
+        return ESP_FAIL;
+    }
+    httpd_resp_set_type(req, "application/json");
+    const char* json = cJSON_Print(root);
+    httpd_resp_sendstr(req, json);
+    free((void*)json);
+    cJSON_Delete(root);
+    return ESP_OK;
+}
+
+static esp_err_t get_ota_handler(httpd_req_t* req)
+{
+    return send_ota_status(req);
+}
+
+static esp_err_t post_ota_handler(httpd_req_t* req)
+{
+    char sha256[65] = { 0 };
+    httpd_req_get_hdr_value_str(req, "X-OTA-SHA256", &sha256[0], sizeof(sha256));
+
+    esp_err_t err = ota_push(req, &sha256[0]);
+    if (err == ESP_ERR_INVALID_STATE) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "OTA update already in progress");
+        return ESP_FAIL;
+    } else if (err == ESP_ERR_INVALID_ARG) {
+        // Malformed X-OTA-SHA256 or an empty body
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, ota_get_status()->error);
+        return ESP_FAIL;
+    } else if (err == ESP_ERR_INVALID_SIZE) {
+        httpd_resp_set_status(req, "413 Payload Too Large");
+        httpd_resp_sendstr(req, ota_get_status()->error);
+        return ESP_FAIL;
+    } else if (err != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, ota_get_status()->error);
+        return ESP_FAIL;
+    }
+    return send_ota_status(req);
+}
+
+static esp_err_t post_ota_pull_handler(httpd_req_t* req)
+{
+    char* buf = lease_buffer(req, HTTP_POOL_SMALL);
+    if (buf == NULL) {
+        return ESP_FAIL;
+    }
+    if (read_request_body(req, buf, HTTP_POOL_SMALL_SIZE) != ESP_OK) {
+        http_pool_release(buf);
+        return ESP_FAIL;
+    }
+
+    cJSON* root = cJSON_Parse(buf);
+    http_pool_release(buf);
+    const cJSON* url = cJSON_GetObjectItem(root, "url");
+    const cJSON* sha256 = cJSON_GetObjectItem(root, "sha256");
+    esp_err_t err = ESP_ERR_INVALID_ARG;
+    if (cJSON_IsString(url)) {
+        err = ota_pull_start(url->valuestring, cJSON_IsString(sha256) ? sha256->valuestring : NULL);
+    }
+    cJSON_Delete(root);
+
+    if (err == ESP_ERR_INVALID_ARG) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Expected {\"url\": ..., \"sha256\": ...}");
+        return ESP_FAIL;
+    } else if (err == ESP_ERR_INVALID_STATE) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "OTA update already in progress");
+        return ESP_FAIL;
+    } else if (err != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, ota_get_status()->error);
+        return ESP_FAIL;
+    }
+    httpd_resp_set_status(req, "202 Accepted");
+    return send_ota_status(req);
+}
+
+#define HTTP_MAX_ROUTES 20
+
+typedef struct http_route {
+    esp_err_t (*handler)(httpd_req_t* req);
+    void* user_ctx;
+} http_route_t;
+
+static http_route_t s_routes[HTTP_MAX_ROUTES];
+static int s_num_routes = 0;
+
+// Every handler runs through here, so requests and their latency are recorded per connection
+static esp_err_t dispatch_handler(httpd_req_t* req)
+{
+    const http_route_t* route = (const http_route_t*)req->user_ctx;
+    req->user_ctx = route->user_ctx;
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = route->handler(req);
+    http_conn_record_request(httpd_req_to_sockfd(req), (uint32_t)(esp_timer_get_time() - start), err);
+    return err;
+}
+
+static esp_err_t register_uri(httpd_handle_t server, const httpd_uri_t* uri)
+{
+    if (s_num_routes >= HTTP_MAX_ROUTES) {
+        ESP_LOGE(TAG, "No route slot for %s", uri->uri);
+        return ESP_ERR_NO_MEM;
+    }
+    http_route_t* route = &s_routes[s_num_routes++];
+    route->handler = uri->handler;
+    route->user_ctx = uri->user_ctx;
+    httpd_uri_t wrapped = *uri;
+    wrapped.handler = dispatch_handler;
+    wrapped.user_ctx = route;
+    return httpd_register_uri_handler(server, &wrapped);
+}
+
 esp_err_t http_server_start(const char* base_path, rest_server_context_t* rest_ctx)
 {
     REST_CHECK(rest_ctx, "REST context is NULL", err);
@@ -97,9 +858,25 @@ esp_err_t http_server_start(const char* base_path, rest_server_context_t* rest_c
     httpd_handle_t server = NULL;
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.uri_match_fn = httpd_uri_match_wildcard;
+    config.max_uri_handlers = HTTP_MAX_ROUTES;
+    config.core_id = AQM_CORE_NET;
+    config.task_priority = AQM_PRIO_HTTP;
+    config.stack_size = AQM_STACK_HTTP;
+    // Dashboards poll over keep-alive connections. When all sockets are taken the least recently
+    // used one is purged rather than refusing the new client, and idle ones are swept.
+    config.max_open_sockets = CONFIG_AQM_HTTP_MAX_SOCKETS;
+    config.backlog_conn = CONFIG_AQM_HTTP_MAX_SOCKETS;
+    config.lru_purge_enable = true;
+    config.open_fn = http_conn_open;
+    config.close_fn = http_conn_close;
+
+    if (www_init() != ESP_OK) {
+        ESP_LOGW(TAG, "Serving the API only");
+    }
 
     ESP_LOGI(TAG, "Starting HTTP server...");
     REST_CHECK(httpd_start(&server, &config) == ESP_OK, "Error starting HTTP server", err);
+    http_conn_start_idle_sweep(server);
 
     httpd_uri_t get_sensor_data_uri = {
         .uri = "/api/v1/sensor",
@@ -107,7 +884,7 @@ esp_err_t http_server_start(const char* base_path, rest_server_context_t* rest_c
         .handler = get_sensor_data_handler,
         .user_ctx = rest_ctx
     };
-    httpd_register_uri_handler(server, &get_sensor_data_uri);
+    register_uri(server, &get_sensor_data_uri);
 
     httpd_uri_t get_system_info_uri = {
         .uri = "/api/v1/system",
@@ -115,7 +892,120 @@ esp_err_t http_server_start(const char* base_path, rest_server_context_t* rest_c
         .handler = get_system_info_handler,
         .user_ctx = rest_ctx
     };
-    httpd_register_uri_handler(server, &get_system_info_uri);
+    register_uri(server, &get_system_info_uri);
+
+    httpd_uri_t get_aqi_uri = {
+        .uri = "/api/v1/aqi",
+        .method = HTTP_GET,
+        .handler = get_aqi_handler,
+        .user_ctx = rest_ctx
+    };
+    register_uri(server, &get_aqi_uri);
+
+    httpd_uri_t put_aqi_uri = {
+        .uri = "/api/v1/aqi",
+        .method = HTTP_PUT,
+        .handler = put_aqi_handler,
+        .user_ctx = rest_ctx
+    };
+    register_uri(server, &put_aqi_uri);
+
+    httpd_uri_t get_settings_uri = {
+        .uri = "/api/v1/config",
+        .method = HTTP_GET,
+        .handler = get_settings_handler,
+        .user_ctx = rest_ctx
+    };
+    register_uri(server, &get_settings_uri);
+
+    httpd_uri_t put_settings_uri = {
+        .uri = "/api/v1/config",
+        .method = HTTP_PUT,
+        .handler = put_settings_handler,
+        .user_ctx = rest_ctx
+    };
+    register_uri(server, &put_settings_uri);
+
+    httpd_uri_t get_alerts_uri = {
+        .uri = "/api/v1/alerts",
+        .method = HTTP_GET,
+        .handler = get_alerts_handler,
+        .user_ctx = rest_ctx
+    };
+    register_uri(server, &get_alerts_uri);
+
+    httpd_uri_t put_alerts_uri = {
+        .uri = "/api/v1/alerts",
+        .method = HTTP_PUT,
+        .handler = put_alerts_handler,
+        .user_ctx = rest_ctx
+    };
+    register_uri(server, &put_alerts_uri);
+
+    httpd_uri_t get_fleet_uri = {
+        .uri = "/api/v1/fleet",
+        .method = HTTP_GET,
+        .handler = get_fleet_handler,
+        .user_ctx = rest_ctx
+    };
+    register_uri(server, &get_fleet_uri);
+
+    httpd_uri_t get_health_uri = {
+        .uri = "/api/v1/health",
+        .method = HTTP_GET,
+        .handler = get_health_handler,
+        .user_ctx = rest_ctx
+    };
+    register_uri(server, &get_health_uri);
+
+    httpd_uri_t get_history_uri = {
+        .uri = "/api/v1/history",
+        .method = HTTP_GET,
+        .handler = get_history_handler,
+        .user_ctx = rest_ctx
+    };
+    register_uri(server, &get_history_uri);
+
+    httpd_uri_t get_stats_uri = {
+        .uri = "/api/v1/stats",
+        .method = HTTP_GET,
+        .handler = get_stats_handler,
+        .user_ctx = rest_ctx
+    };
+    register_uri(server, &get_stats_uri);
+
+    httpd_uri_t get_ota_uri = {
+        .uri = "/api/v1/ota",
+        .method = HTTP_GET,
+        .handler = get_ota_handler,
+        .user_ctx = rest_ctx
+    };
+    register_uri(server, &get_ota_uri);
+
+    httpd_uri_t post_ota_uri = {
+        .uri = "/api/v1/ota",
+        .method = HTTP_POST,
+        .handler = post_ota_handler,
+        .user_ctx = rest_ctx
+    };
+    register_uri(server, &post_ota_uri);
+
+    httpd_uri_t post_ota_pull_uri = {
+        .uri = "/api/v1/ota/pull",
+        .method = HTTP_POST,
+        .handler = post_ota_pull_handler,
+        .user_ctx = rest_ctx
+    };
+    register_uri(server, &post_ota_pull_uri);
+
+    // Registered last: everything not matched above is looked up in the dashboard image
+    httpd_uri_t get_www_uri = {
+        .uri = "/*",
+        .method = HTTP_GET,
+        .handler = http_get_handler,
+        .user_ctx = rest_ctx
+    };
+    register_uri(server, &get_www_uri);
 
     return ESP_OK;
 
@@ -128,7 +1018,90 @@ esp_err_t http_server_stop()
     return ESP_OK;
 }
 
+#define WWW_CHUNK_SIZE 4096
+
+// Sends a file of the dashboard image straight from the flash mapping, in WWW_CHUNK_SIZE pieces.
+// Files are stored pre-compressed and only ever sent as they are.
 esp_err_t http_get_handler(httpd_req_t* req)
 {
-    return ESP_OK;
+    rest_server_context_t* rest_server = (rest_server_context_t*)req->user_ctx;
+    int64_t start = esp_timer_get_time();
+    size_t heap_start = esp_get_free_heap_size();
+
+    // Image paths are relative to base_path; query strings only carry ?v= cache busters
+    const char* uri = req->uri;
+    size_t prefix = strlen(rest_server->base_path);
+    if (prefix > 0 && rest_server->base_path[prefix - 1] == '/') {
+        prefix--;
+    }
+    char path[WWW_PATH_MAX];
+    size_t len = 0;
+    if (strncmp(uri, rest_server->base_path, prefix) == 0) {
+        uri += prefix;
+        len = strcspn(uri, "?#");
+    }
+    const www_entry_t* entry = NULL;
+    if (len > 0 && len < sizeof(path) - strlen("index.html")) {
+        memcpy(&path[0], uri, len);
+        path[len] = '\0';
+        if (path[len - 1] == '/') {
+            strlcat(&path[0], "index.html", sizeof(path));
+        }
+        entry = www_find(&path[0]);
+    }
+    if (entry == NULL) {
+        www_count_not_found();
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "File does not exist");
+        return ESP_FAIL;
+    }
+
+    www_begin_response();
+    httpd_resp_set_hdr(req, "ETag", &entry->etag[0]);
+    httpd_resp_set_hdr(req, "Cache-Control",
+        (entry->flags & WWW_FLAG_IMMUTABLE) ? "public, max-age=31536000, immutable" : "no-cache");
+
+    char value[96];
+    esp_err_t err = httpd_req_get_hdr_value_str(req, "If-None-Match", &value[0], sizeof(value));
+    if ((err == ESP_OK || err == ESP_ERR_HTTPD_RESULT_TRUNC) && strstr(&value[0], &entry->etag[0]) != NULL) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        httpd_resp_send(req, NULL, 0);
+        www_end_response(0, 0, 0, true);
+        return ESP_OK;
+    }
+
+    if (entry->flags & WWW_FLAG_GZIP) {
+        err = httpd_req_get_hdr_value_str(req, "Accept-Encoding", &value[0], sizeof(value));
+        if ((err != ESP_OK && err != ESP_ERR_HTTPD_RESULT_TRUNC) || strstr(&value[0], "gzip") == NULL) {
+            httpd_resp_set_status(req, "406 Not Acceptable");
+            httpd_resp_sendstr(req, "Client must accept gzip encoding");
+            www_end_response(0, (uint32_t)(esp_timer_get_time() - start), 0, false);
+            return ESP_OK;
+        }
+        httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+        httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+    }
+    httpd_resp_set_type(req, &entry->mime[0]);
+
+    const char* data = (const char*)www_data(entry);
+    uint32_t sent = 0;
+    uint32_t ttfb = 0;
+    size_t heap_min = heap_start;
+    err = ESP_OK;
+    while (sent < entry->size && err == ESP_OK) {
+        uint32_t n = entry->size - sent < WWW_CHUNK_SIZE ? entry->size - sent : WWW_CHUNK_SIZE;
+        err = httpd_resp_send_chunk(req, data + sent, n);
+        if (sent == 0) {
+            ttfb = (uint32_t)(esp_timer_get_time() - start);
+        }
+        sent += n;
+        size_t heap = esp_get_free_heap_size();
+        if (heap < heap_min) {
+            heap_min = heap;
+        }
+    }
+    if (err == ESP_OK) {
+        err = httpd_resp_send_chunk(req, NULL, 0);
+    }
+    www_end_response(sent, ttfb, (uint32_t)(heap_start - heap_min), false);
+    return err;
 }
\ No newline at end of file
@@ -9,15 +9,17 @@ extern "C" {
 #endif
 
 #define FILE_PATH_MAX (ESP_VFS_PATH_MAX + 128)
-#define SCRATCH_BUFSIZE (10240)
 
-struct sensor_data;
+struct sample_bus;
+struct lcd_layout;
+struct sample_rate;
 typedef struct system_s system_t;
 
 typedef struct rest_server_context {
     char base_path[ESP_VFS_PATH_MAX + 1];
-    char scratch[SCRATCH_BUFSIZE];
-    struct sensor_data* sensors;
+    struct sample_bus* samples;
+    const struct lcd_layout* lcd_layout;
+    const struct sample_rate* sample_rate;
     system_t* sys;
 } rest_server_context_t;
 
@@ -0,0 +1,368 @@
+#include "i2c_bus.h"
+#include "task_plan.h"
+#include "arena.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static const char* TAG = "aqm-i2c-bus";
+
+#define CHECK_ARG(VAL) do { if (!(VAL)) return ESP_ERR_INVALID_ARG; } while (0)
+#define I2C_BUS_QUEUE_LEN 8
+#define I2C_BUS_TIMEOUT_MSEC 50
+#define I2C_BUS_PROBE_TIMEOUT_MSEC 10
+
+static struct {
+    i2c_port_t port;
+    i2c_config_t cfg;
+    uint32_t freq_limit_hz;
+    uint32_t freq_hz;
+    QueueHandle_t queues[I2C_BUS_NUM_PRIOS];
+    SemaphoreHandle_t pending;  // counts queued transactions across all priorities
+    SemaphoreHandle_t lock;     // guards the device table and stats
+    i2c_bus_dev_t devices[I2C_BUS_MAX_DEVICES];
+    size_t num_devices;
+    i2c_bus_stats_t stats;
+    uint8_t cmd_buf[I2C_LINK_RECOMMENDED_SIZE(3)];
+} s_bus;
+
+static void apply_freq(void)
+{
+    uint32_t freq = s_bus.freq_limit_hz;
+    xSemaphoreTake(s_bus.lock, portMAX_DELAY);
+    for (size_t i = 0; i < s_bus.num_devices; i++) {
+        if (s_bus.devices[i].max_freq_hz < freq) {
+            freq = s_bus.devices[i].max_freq_hz;
+        }
+    }
+    xSemaphoreGive(s_bus.lock);
+    if (freq == s_bus.freq_hz) {
+        return;
+    }
+    s_bus.cfg.master.clk_speed = freq;
+    esp_err_t err = i2c_param_config(s_bus.port, &s_bus.cfg);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to set bus frequency %dHz (%s)", freq, esp_err_to_name(err));
+        return;
+    }
+    s_bus.freq_hz = freq;
+    s_bus.stats.freq_hz = freq;
+    ESP_LOGI(TAG, "I2C bus frequency: %dHz", freq);
+}
+
+// Runs a single transaction: an optional write, then an optional read after a repeated start.
+// An empty transaction addresses the device only, which is how the scan probes for an ACK.
+static esp_err_t execute(i2c_bus_req_t* txn)
+{
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create_static(&s_bus.cmd_buf[0], sizeof(s_bus.cmd_buf));
+    if (cmd == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    i2c_master_start(cmd);
+    if (txn->wlen || !txn->rlen) {
+        i2c_master_write_byte(cmd, (txn->addr << 1) | I2C_MASTER_WRITE, true);
+        if (txn->wlen) {
+            i2c_master_write(cmd, txn->wdata, txn->wlen, true);
+        }
+    }
+    if (txn->rlen) {
+        if (txn->wlen) {
+            i2c_master_start(cmd);
+        }
+        i2c_master_write_byte(cmd, (txn->addr << 1) | I2C_MASTER_READ, true);
+        i2c_master_read(cmd, txn->rdata, txn->rlen, I2C_MASTER_LAST_NACK);
+    }
+    i2c_master_stop(cmd);
+    esp_err_t err = i2c_master_cmd_begin(s_bus.port, cmd, txn->timeout);
+    i2c_cmd_link_delete_static(cmd);
+    return err;
+}
+
+static void record(const i2c_bus_req_t* txn, int64_t busy_usec, int64_t done_usec)
+{
+    int64_t latency = done_usec - txn->submit_usec;
+    xSemaphoreTake(s_bus.lock, portMAX_DELAY);
+    i2c_bus_prio_stats_t* ps = &s_bus.stats.prio[txn->prio];
+    s_bus.stats.busy_usec += busy_usec;
+    ps->num_txns++;
+    ps->bytes += txn->wlen + txn->rlen;
+    ps->sum_latency_usec += latency;
+    if (latency > ps->max_latency_usec) {
+        ps->max_latency_usec = latency;
+    }
+    if (txn->result != ESP_OK) {
+        ps->num_errors++;
+    }
+    xSemaphoreGive(s_bus.lock);
+}
+
+// The worker always drains the high priority queue first, so a sensor read waits for at most
+// the one display transaction already on the wire. Queued transactions run back-to-back
+// without returning to the scheduler in between.
+static void bus_task(void* arg)
+{
+    arena_watch_task("i2c_bus");
+    while (1) {
+        xSemaphoreTake(s_bus.pending, portMAX_DELAY);
+        i2c_bus_req_t* txn = NULL;
+        for (int p = 0; p < I2C_BUS_NUM_PRIOS && txn == NULL; p++) {
+            if (xQueueReceive(s_bus.queues[p], &txn, 0) != pdTRUE) {
+                txn = NULL;
+            }
+        }
+        if (txn == NULL) {
+            continue;
+        }
+        if (txn->reconfig) {
+            apply_freq();
+            txn->result = ESP_OK;
+            xSemaphoreGive(txn->done);
+            continue;
+        }
+        int64_t start = esp_timer_get_time();
+        txn->result = execute(txn);
+        int64_t end = esp_timer_get_time();
+        record(txn, end - start, end);
+        if (txn->cb != NULL) {
+            txn->cb(txn, txn->result, txn->cb_arg);
+        }
+        // The submitter may reuse or release the request as soon as this is given
+        xSemaphoreGive(txn->done);
+        arena_mark_steady();
+    }
+}
+
+static esp_err_t enqueue(i2c_bus_req_t* txn)
+{
+    txn->done = NULL;
+    if (s_bus.pending == NULL) {
+        txn->result = ESP_ERR_INVALID_STATE;
+        return txn->result;
+    }
+    txn->submit_usec = esp_timer_get_time();
+    txn->result = ESP_FAIL;
+    txn->done = xSemaphoreCreateBinaryStatic(&txn->done_buf);
+    xQueueSend(s_bus.queues[txn->prio], &txn, portMAX_DELAY);
+    xSemaphoreGive(s_bus.pending);
+    return ESP_OK;
+}
+
+esp_err_t i2c_bus_wait(i2c_bus_req_t* req)
+{
+    if (req->done != NULL) {
+        xSemaphoreTake(req->done, portMAX_DELAY);
+        vSemaphoreDelete(req->done);
+        req->done = NULL;
+    }
+    return req->result;
+}
+
+bool i2c_bus_done(const i2c_bus_req_t* req)
+{
+    return req->done == NULL || uxSemaphoreGetCount(req->done) > 0;
+}
+
+// The transaction lives on the caller's stack, the caller blocks until the worker is done with it
+static esp_err_t run(i2c_bus_req_t* txn)
+{
+    esp_err_t err = enqueue(txn);
+    return err == ESP_OK ? i2c_bus_wait(txn) : err;
+}
+
+static esp_err_t submit_async(i2c_bus_dev_t* dev, i2c_bus_req_t* req, const uint8_t* wdata, size_t wlen,
+    uint8_t* rdata, size_t rlen, i2c_bus_done_cb_t cb, void* arg)
+{
+    memset(req, 0, sizeof(i2c_bus_req_t));
+    req->addr = dev->addr;
+    req->prio = dev->prio;
+    req->wdata = wdata;
+    req->wlen = wlen;
+    req->rdata = rdata;
+    req->rlen = rlen;
+    req->timeout = pdMS_TO_TICKS(I2C_BUS_TIMEOUT_MSEC);
+    req->cb = cb;
+    req->cb_arg = arg;
+    return enqueue(req);
+}
+
+static esp_err_t submit(uint8_t addr, enum i2c_bus_prio prio, const uint8_t* wdata, size_t wlen,
+    uint8_t* rdata, size_t rlen, uint32_t timeout_msec)
+{
+    i2c_bus_req_t txn = {
+        .addr = addr,
+        .prio = prio,
+        .wdata = wdata,
+        .wlen = wlen,
+        .rdata = rdata,
+        .rlen = rlen,
+        .timeout = pdMS_TO_TICKS(timeout_msec),
+    };
+    return run(&txn);
+}
+
+esp_err_t i2c_bus_init(i2c_port_t port, int sda, int scl, uint32_t freq_limit_hz)
+{
+    ESP_LOGD(TAG, "i2c_bus_init");
+    memset(&s_bus, 0, sizeof(s_bus));
+    s_bus.port = port;
+    s_bus.cfg.mode = I2C_MODE_MASTER;
+    s_bus.cfg.sda_io_num = sda;
+    s_bus.cfg.scl_io_num = scl;
+    s_bus.cfg.sda_pullup_en = GPIO_PULLUP_ENABLE;
+    s_bus.cfg.scl_pullup_en = GPIO_PULLUP_ENABLE;
+    // Scan at standard mode, the bus speeds up once the attached devices are known
+    s_bus.freq_limit_hz = freq_limit_hz;
+    s_bus.freq_hz = freq_limit_hz < I2C_BUS_FREQ_STANDARD ? freq_limit_hz : I2C_BUS_FREQ_STANDARD;
+    s_bus.cfg.master.clk_speed = s_bus.freq_hz;
+
+    esp_err_t err = i2c_param_config(port, &s_bus.cfg);
+    if (err == ESP_OK) {
+        err = i2c_driver_install(port, s_bus.cfg.mode, 0, 0, 0);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to install I2C driver (%s)", esp_err_to_name(err));
+        return err;
+    }
+
+    s_bus.lock = xSemaphoreCreateMutex();
+    s_bus.pending = xSemaphoreCreateCounting(I2C_BUS_QUEUE_LEN * I2C_BUS_NUM_PRIOS, 0);
+    for (int p = 0; p < I2C_BUS_NUM_PRIOS; p++) {
+        s_bus.queues[p] = xQueueCreate(I2C_BUS_QUEUE_LEN, sizeof(i2c_bus_req_t*));
+    }
+    i2c_bus_reset_stats();
+
+    // The worker shares the sampler's core and preempts it, so a blocking read costs the
+    // sampler no more than the transfer itself
+    xTaskCreatePinnedToCore(&bus_task, "aqm-i2c-bus", AQM_STACK_I2C_BUS, NULL,
+        AQM_PRIO_I2C_BUS, NULL, AQM_CORE_SAMPLER);
+
+    ESP_LOGI(TAG, "Configured I2C on pins %d (sda) and %d (scl), frequency limit %dHz", sda, scl, freq_limit_hz);
+    return ESP_OK;
+}
+
+void i2c_bus_scan(bool found[128])
+{
+    printf("Enumerating I2C devices...\n");
+    for (uint8_t addr = 0; addr < 128; addr++) {
+        found[addr] = submit(addr, I2C_BUS_PRIO_HIGH, NULL, 0, NULL, 0, I2C_BUS_PROBE_TIMEOUT_MSEC) == ESP_OK;
+        if (found[addr]) {
+            printf("I2C device found at address 0x%02X\n", addr);
+        }
+    }
+    // Unanswered probes are not bus errors
+    i2c_bus_reset_stats();
+}
+
+i2c_bus_dev_t* i2c_bus_add_device(uint8_t addr, uint32_t max_freq_hz, enum i2c_bus_prio prio)
+{
+    i2c_bus_dev_t* dev = NULL;
+    xSemaphoreTake(s_bus.lock, portMAX_DELAY);
+    if (s_bus.num_devices < I2C_BUS_MAX_DEVICES) {
+        dev = &s_bus.devices[s_bus.num_devices++];
+        dev->addr = addr;
+        dev->max_freq_hz = max_freq_hz;
+        dev->prio = prio;
+    }
+    xSemaphoreGive(s_bus.lock);
+    if (dev == NULL) {
+        ESP_LOGE(TAG, "Too many I2C devices, 0x%02X not added", addr);
+    }
+    // Runs the frequency update on the worker so it never changes under a transfer
+    i2c_bus_set_freq_limit(s_bus.freq_limit_hz);
+    return dev;
+}
+
+i2c_bus_dev_t* i2c_bus_find_device(uint8_t addr)
+{
+    i2c_bus_dev_t* dev = NULL;
+    xSemaphoreTake(s_bus.lock, portMAX_DELAY);
+    for (size_t i = 0; i < s_bus.num_devices; i++) {
+        if (s_bus.devices[i].addr == addr) {
+            dev = &s_bus.devices[i];
+            break;
+        }
+    }
+    xSemaphoreGive(s_bus.lock);
+    return dev;
+}
+
+void i2c_bus_set_freq_limit(uint32_t freq_limit_hz)
+{
+    s_bus.freq_limit_hz = freq_limit_hz;
+    i2c_bus_req_t txn = {
+        .prio = I2C_BUS_PRIO_HIGH,
+        .reconfig = true,
+    };
+    run(&txn);
+}
+
+uint32_t i2c_bus_get_freq(void)
+{
+    return s_bus.freq_hz;
+}
+
+esp_err_t i2c_bus_write(i2c_bus_dev_t* dev, const uint8_t* data, size_t len)
+{
+    CHECK_ARG(dev && data && len);
+    return submit(dev->addr, dev->prio, data, len, NULL, 0, I2C_BUS_TIMEOUT_MSEC);
+}
+
+esp_err_t i2c_bus_read(i2c_bus_dev_t* dev, uint8_t* data, size_t len)
+{
+    CHECK_ARG(dev && data && len);
+    return submit(dev->addr, dev->prio, NULL, 0, data, len, I2C_BUS_TIMEOUT_MSEC);
+}
+
+esp_err_t i2c_bus_write_read(i2c_bus_dev_t* dev, const uint8_t* wdata, size_t wlen, uint8_t* rdata, size_t rlen)
+{
+    CHECK_ARG(dev && wdata && wlen && rdata && rlen);
+    return submit(dev->addr, dev->prio, wdata, wlen, rdata, rlen, I2C_BUS_TIMEOUT_MSEC);
+}
+
+esp_err_t i2c_bus_write_async(i2c_bus_dev_t* dev, i2c_bus_req_t* req, const uint8_t* data, size_t len,
+    i2c_bus_done_cb_t cb, void* arg)
+{
+    CHECK_ARG(dev && req && data && len);
+    return submit_async(dev, req, data, len, NULL, 0, cb, arg);
+}
+
+esp_err_t i2c_bus_read_async(i2c_bus_dev_t* dev, i2c_bus_req_t* req, uint8_t* data, size_t len,
+    i2c_bus_done_cb_t cb, void* arg)
+{
+    CHECK_ARG(dev && req && data && len);
+    return submit_async(dev, req, NULL, 0, data, len, cb, arg);
+}
+
+esp_err_t i2c_bus_write_read_async(i2c_bus_dev_t* dev, i2c_bus_req_t* req, const uint8_t* wdata, size_t wlen,
+    uint8_t* rdata, size_t rlen, i2c_bus_done_cb_t cb, void* arg)
+{
+    CHECK_ARG(dev && req && wdata && wlen && rdata && rlen);
+    return submit_async(dev, req, wdata, wlen, rdata, rlen, cb, arg);
+}
+
+const i2c_bus_stats_t* i2c_bus_get_stats(void)
+{
+    return &s_bus.stats;
+}
+
+float i2c_bus_utilization(void)
+{
+    int64_t elapsed = esp_timer_get_time() - s_bus.stats.start_usec;
+    return elapsed > 0 ? (float)s_bus.stats.busy_usec / (float)elapsed : 0.0f;
+}
+
+void i2c_bus_reset_stats(void)
+{
+    xSemaphoreTake(s_bus.lock, portMAX_DELAY);
+    memset(&s_bus.stats, 0, sizeof(i2c_bus_stats_t));
+    s_bus.stats.freq_hz = s_bus.freq_hz;
+    s_bus.stats.start_usec = esp_timer_get_time();
+    xSemaphoreGive(s_bus.lock);
+}
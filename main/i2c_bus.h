@@ -0,0 +1,103 @@
+#pragma once
+
+#include "esp_err.h"
+#include "driver/i2c.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define I2C_BUS_MAX_DEVICES 8
+#define I2C_BUS_FREQ_STANDARD 100000
+#define I2C_BUS_FREQ_FAST 400000
+
+// Sensor reads are serviced ahead of display refreshes
+enum i2c_bus_prio {
+    I2C_BUS_PRIO_HIGH,
+    I2C_BUS_PRIO_LOW,
+    I2C_BUS_NUM_PRIOS
+};
+
+typedef struct i2c_bus_dev {
+    uint8_t addr;
+    uint32_t max_freq_hz;   // fastest clock the device supports
+    enum i2c_bus_prio prio;
+} i2c_bus_dev_t;
+
+typedef struct i2c_bus_prio_stats {
+    uint32_t num_txns;
+    uint32_t num_errors;
+    uint64_t bytes;
+    int64_t sum_latency_usec;   // submit to completion, including queueing
+    int64_t max_latency_usec;
+} i2c_bus_prio_stats_t;
+
+typedef struct i2c_bus_stats {
+    uint32_t freq_hz;
+    int64_t start_usec;
+    int64_t busy_usec;          // time spent in i2c_master_cmd_begin
+    i2c_bus_prio_stats_t prio[I2C_BUS_NUM_PRIOS];
+} i2c_bus_stats_t;
+
+typedef struct i2c_bus_req i2c_bus_req_t;
+
+// Runs on the bus worker as soon as the transfer is done, before the next one starts, so keep it short
+typedef void (*i2c_bus_done_cb_t)(i2c_bus_req_t* req, esp_err_t result, void* arg);
+
+// An asynchronous transaction. The caller owns it and the buffers it points to from submission
+// until i2c_bus_wait() returns; every submitted request must be waited on before it is reused.
+struct i2c_bus_req {
+    uint8_t addr;
+    enum i2c_bus_prio prio;
+    const uint8_t* wdata;
+    size_t wlen;
+    uint8_t* rdata;
+    size_t rlen;
+    TickType_t timeout;
+    bool reconfig;          // no transfer, re-evaluates the bus frequency between transactions
+    int64_t submit_usec;
+    esp_err_t result;
+    i2c_bus_done_cb_t cb;
+    void* cb_arg;
+    SemaphoreHandle_t done;
+    StaticSemaphore_t done_buf;
+};
+
+// The bus manager owns the port: it installs the driver and runs every transaction from a
+// single worker task, so drivers never reconfigure the port or take their own locks.
+esp_err_t i2c_bus_init(i2c_port_t port, int sda, int scl, uint32_t freq_limit_hz);
+void i2c_bus_scan(bool found[128]);
+i2c_bus_dev_t* i2c_bus_add_device(uint8_t addr, uint32_t max_freq_hz, enum i2c_bus_prio prio);
+i2c_bus_dev_t* i2c_bus_find_device(uint8_t addr);
+void i2c_bus_set_freq_limit(uint32_t freq_limit_hz);
+uint32_t i2c_bus_get_freq(void);
+
+esp_err_t i2c_bus_write(i2c_bus_dev_t* dev, const uint8_t* data, size_t len);
+esp_err_t i2c_bus_read(i2c_bus_dev_t* dev, uint8_t* data, size_t len);
+esp_err_t i2c_bus_write_read(i2c_bus_dev_t* dev, const uint8_t* wdata, size_t wlen, uint8_t* rdata, size_t rlen);
+
+// Queue a transaction and return at once; the calling task is free while the interrupt-driven
+// driver runs it. cb may be NULL. Submission only blocks while the device's queue is full.
+esp_err_t i2c_bus_write_async(i2c_bus_dev_t* dev, i2c_bus_req_t* req, const uint8_t* data, size_t len,
+    i2c_bus_done_cb_t cb, void* arg);
+esp_err_t i2c_bus_read_async(i2c_bus_dev_t* dev, i2c_bus_req_t* req, uint8_t* data, size_t len,
+    i2c_bus_done_cb_t cb, void* arg);
+esp_err_t i2c_bus_write_read_async(i2c_bus_dev_t* dev, i2c_bus_req_t* req, const uint8_t* wdata, size_t wlen,
+    uint8_t* rdata, size_t rlen, i2c_bus_done_cb_t cb, void* arg);
+// Blocks until the transaction (and its callback) has finished and returns its result
+esp_err_t i2c_bus_wait(i2c_bus_req_t* req);
+bool i2c_bus_done(const i2c_bus_req_t* req);
+
+const i2c_bus_stats_t* i2c_bus_get_stats(void);
+float i2c_bus_utilization(void);
+void i2c_bus_reset_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,7 +1,8 @@
 #include "lcd_ascii.h"
+#include "arena.h"
 #include "utils.h"
 
-#include "FreeRTOS/FreeRTOS.h"
+#include "freertos/FreeRTOS.h"
 #include "esp_log.h"
 
 #include <stdio.h>
@@ -10,50 +11,30 @@
 
 static const char* TAG = "aqm-lcd-ascii";
 
-#define I2C_FREQ_HZ 100000
 #define CHECK_ARG(VAL) do { if (!(VAL)) return ESP_ERR_INVALID_ARG; } while (0)
 
-static esp_err_t write_8_nolock(i2c_dev_t *dev, uint8_t val)
+static esp_err_t write_8(lcd_ascii_t* lcd, uint8_t val)
 {
-   return i2c_dev_write(dev, NULL, 0, &val, 1);
-}
-static esp_err_t write_8(i2c_dev_t *dev, uint8_t val)
-{
-    I2C_DEV_TAKE_MUTEX(dev);
-    I2C_DEV_CHECK(dev, write_8_nolock(dev, val));
-    I2C_DEV_GIVE_MUTEX(dev);
-    return ESP_OK;
+    lcd->bytes_sent++;
+    return i2c_bus_write(lcd->dev, &val, 1);
 }
 
-static esp_err_t write_data_nolock(i2c_dev_t *dev, uint8_t* data, size_t size)
-{
-   return i2c_dev_write(dev, NULL, 0, data, size);
-}
-static esp_err_t write_data(i2c_dev_t *dev, uint8_t* data, size_t size)
+static esp_err_t write_data(lcd_ascii_t* lcd, uint8_t* data, size_t size)
 {
-    I2C_DEV_TAKE_MUTEX(dev);
-    I2C_DEV_CHECK(dev, write_data_nolock(dev, data, size));
-    I2C_DEV_GIVE_MUTEX(dev);
-    return ESP_OK;
+    lcd->bytes_sent += size;
+    return i2c_bus_write(lcd->dev, data, size);
 }
 
-lcd_ascii_t* lcd_init(uint8_t addr, i2c_port_t port, i2c_config_t* i2c, int rows, int cols, enum lcd_char_size dots)
+lcd_ascii_t* lcd_init(i2c_bus_dev_t* dev, int rows, int cols, enum lcd_char_size dots)
 {
     ESP_LOGI(TAG, "Initializing ASCII LCD...");
 
-    lcd_ascii_t* lcd = malloc(sizeof(lcd_ascii_t));
-    memset(&lcd->dev, 0, sizeof(i2c_dev_t));
-
-    lcd->dev.port = port;
-    lcd->dev.addr = addr;
-    lcd->dev.cfg.sda_io_num = i2c->sda_io_num;
-    lcd->dev.cfg.scl_io_num = i2c->scl_io_num;
-    lcd->dev.cfg.sda_pullup_en = i2c->sda_pullup_en;
-    lcd->dev.cfg.scl_pullup_en = i2c->scl_pullup_en;
-#if HELPER_TARGET_IS_ESP32
-    lcd->dev.cfg.master.clk_speed = I2C_FREQ_HZ;
-#endif
-    ESP_ERROR_CHECK(i2c_dev_create_mutex(&lcd->dev));
+    lcd_ascii_t* lcd = arena_alloc(sizeof(lcd_ascii_t));
+    if (lcd == NULL) {
+        return NULL;
+    }
+    lcd->dev = dev;
+    lcd->bytes_sent = 0;
 
     lcd->num_rows = rows;
     lcd->num_cols = cols;
@@ -104,8 +85,7 @@ lcd_ascii_t* lcd_init(uint8_t addr, i2c_port_t port, i2c_config_t* i2c, int rows
 void lcd_free(lcd_ascii_t* lcd)
 {
     if (lcd != NULL) {
-        i2c_dev_delete_mutex(&lcd->dev);
-        free(lcd);
+        arena_free(lcd);
         lcd = NULL;
     }
 }
@@ -127,22 +107,29 @@ esp_err_t lcd_home(lcd_ascii_t* lcd)
 esp_err_t lcd_printf(lcd_ascii_t* lcd, const char* fmt, ...)
 {
     CHECK_ARG(lcd);
+    char buf[LCD_MAX_COLS + 1];
     va_list args;
     va_start(args, fmt);
-    char buf[16];
-    memset(&buf[0], 0, 16);
-    sprintf(&buf[0], fmt, args);
+    int len = vsnprintf(&buf[0], sizeof(buf), fmt, args);
     va_end(args);
-    int len = strlen(&buf[0]);
+    if (len < 0)
+        return ESP_ERR_INVALID_ARG;
     if (len > lcd->num_cols)
         len = lcd->num_cols;
-    if (len > 16)
-        len = 16;
-
-    ESP_LOGD(TAG, "LCD Text: %s (%d chars)", &buf[0], len);
-    for (int i = 0; i < len; i++)
-        ESP_ERROR_CHECK(lcd_send(lcd, buf[i], REG_SELECT_BIT));
+    if (len > LCD_MAX_COLS)
+        len = LCD_MAX_COLS;
 
+    ESP_LOGD(TAG, "LCD Text: %.*s (%d chars)", len, &buf[0], len);
+    return lcd_write(lcd, &buf[0], len);
+}
+esp_err_t lcd_write(lcd_ascii_t* lcd, const char* buf, size_t len)
+{
+    CHECK_ARG(lcd && buf);
+    for (size_t i = 0; i < len; i++) {
+        esp_err_t err = lcd_send(lcd, (uint8_t)buf[i], REG_SELECT_BIT);
+        if (err != ESP_OK)
+            return err;
+    }
     return ESP_OK;
 }
 esp_err_t lcd_display_control(lcd_ascii_t* lcd, uint8_t ctrl)
@@ -171,7 +158,7 @@ esp_err_t lcd_cursor_pos(lcd_ascii_t* lcd, uint8_t col, uint8_t row)
 {
     CHECK_ARG(lcd);
     int row_offsets[] = { 0x00, 0x40, 0x14, 0x54 };
-    if (row > lcd->num_rows)
+    if (row >= lcd->num_rows)
         row = lcd->num_rows - 1;
     return lcd_command(lcd, LCD_SETDDRAMADDR | (col + row_offsets[row]));
 }
@@ -197,8 +184,17 @@ esp_err_t lcd_shift_dec(lcd_ascii_t* lcd)
 }
 esp_err_t lcd_create_char(lcd_ascii_t* lcd, uint8_t loc, uint8_t chars[8])
 {
-    CHECK_ARG(lcd);
-    return ESP_OK;
+    return lcd_write_cgram(lcd, loc, 0, chars, 8);
+}
+esp_err_t lcd_write_cgram(lcd_ascii_t* lcd, uint8_t loc, uint8_t row, const uint8_t* rows, size_t count)
+{
+    CHECK_ARG(lcd && rows && loc < 8 && row + count <= 8);
+    // The address counter auto-increments, so a run of rows needs a single address command
+    esp_err_t err = lcd_command(lcd, LCD_SETCGRAMADDR | (loc << 3) | row);
+    for (size_t i = 0; i < count && err == ESP_OK; i++) {
+        err = lcd_send(lcd, rows[i] & 0x1f, REG_SELECT_BIT);
+    }
+    return err;
 }
 esp_err_t lcd_command(lcd_ascii_t* lcd, uint8_t cmd)
 {
@@ -215,13 +211,13 @@ esp_err_t lcd_send(lcd_ascii_t* lcd, uint8_t val, uint8_t flags)
     arr[1] = hi_nib|flags|lcd->backlight;
     arr[2] = lo_nib|flags|lcd->backlight|ENABLE_BIT;
     arr[3] = lo_nib|flags|lcd->backlight;
-    write_data(&lcd->dev, &arr[0], 4);
+    esp_err_t err = write_data(lcd, &arr[0], 4);
     // for (int i = 0; i < 4; i++)
     //     lcd_write_data(lcd, arr[i]);
     sleep_msec(5);
     // ESP_ERROR_CHECK(lcd_write_nibble(lcd, hi_nib|mode));
     // ESP_ERROR_CHECK(lcd_write_nibble(lcd, lo_nib|mode));
-    return ESP_OK;
+    return err;
 }
 esp_err_t lcd_write_nibble(lcd_ascii_t* lcd, uint8_t nib)
 {
@@ -233,7 +229,7 @@ esp_err_t lcd_write_nibble(lcd_ascii_t* lcd, uint8_t nib)
 esp_err_t lcd_write_data(lcd_ascii_t* lcd, uint8_t val)
 {
     CHECK_ARG(lcd);
-    ESP_ERROR_CHECK(write_8(&lcd->dev, val | lcd->backlight));
+    ESP_ERROR_CHECK(write_8(lcd, val | lcd->backlight));
     return ESP_OK;
 }
 esp_err_t lcd_pulse_enable(lcd_ascii_t* lcd, uint8_t data)
@@ -1,6 +1,6 @@
 #pragma once
 
-#include <i2cdev.h>
+#include "i2c_bus.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -39,14 +39,21 @@ enum lcd_char_size {
     LCD_CHAR_SIZE_BIG
 };
 
+// PCF8574 I/O expander backpacks are specified for standard mode only
+#define LCD_PCF8574_MAX_FREQ_HZ I2C_BUS_FREQ_STANDARD
+
+// HD44780 controllers address at most 40 columns per row
+#define LCD_MAX_COLS 40
+
 typedef struct lcd_ascii {
-    i2c_dev_t dev;
+    i2c_bus_dev_t* dev;
     enum lcd_backlight_mode backlight;
     uint8_t display_func;
     uint8_t display_ctrl;
     uint8_t display_mode;
     int num_rows;
     int num_cols;
+    uint32_t bytes_sent;    // I2C payload bytes, four per HD44780 byte in 4-bit mode
 } lcd_ascii_t;
 
 // commands
@@ -95,11 +102,13 @@ typedef struct lcd_ascii {
 #define READ_WRITE_BIT 0b00000010
 #define REG_SELECT_BIT 0b00000001
 
-lcd_ascii_t* lcd_init(uint8_t addr, i2c_port_t port, i2c_config_t* i2c, int rows, int cols, enum lcd_char_size dots);
+lcd_ascii_t* lcd_init(i2c_bus_dev_t* dev, int rows, int cols, enum lcd_char_size dots);
 void lcd_free(lcd_ascii_t* lcd);
 esp_err_t lcd_clear(lcd_ascii_t* lcd);
 esp_err_t lcd_home(lcd_ascii_t* lcd);
 esp_err_t lcd_printf(lcd_ascii_t* lcd, const char* fmt, ...);
+// Writes len characters at the cursor without formatting
+esp_err_t lcd_write(lcd_ascii_t* lcd, const char* buf, size_t len);
 esp_err_t lcd_display_control(lcd_ascii_t* lcd, uint8_t ctrl);
 esp_err_t lcd_display(lcd_ascii_t* lcd, enum lcd_display_mode mode);
 esp_err_t lcd_backlight(lcd_ascii_t* lcd, enum lcd_backlight_mode mode);
@@ -110,6 +119,9 @@ esp_err_t lcd_text_direction(lcd_ascii_t* lcd, enum lcd_text_dir dir);
 esp_err_t lcd_shift_inc(lcd_ascii_t* lcd);
 esp_err_t lcd_shift_dec(lcd_ascii_t* lcd);
 esp_err_t lcd_create_char(lcd_ascii_t* lcd, uint8_t loc, uint8_t chars[8]);
+// Writes count pixel rows of custom character loc (0-7) starting at row. The cursor must be
+// positioned again before writing text.
+esp_err_t lcd_write_cgram(lcd_ascii_t* lcd, uint8_t loc, uint8_t row, const uint8_t* rows, size_t count);
 esp_err_t lcd_command(lcd_ascii_t* lcd, uint8_t cmd);
 esp_err_t lcd_send(lcd_ascii_t* lcd, uint8_t val, uint8_t flags);
 esp_err_t lcd_write_nibble(lcd_ascii_t* lcd, uint8_t nib);
@@ -0,0 +1,97 @@
+#include "lcd_glyphs.h"
+
+#include <string.h>
+
+void lcd_glyphs_init(lcd_glyphs_t* glyphs, display_t* disp)
+{
+    memset(glyphs, 0, sizeof(lcd_glyphs_t));
+    glyphs->disp = disp;
+}
+
+void lcd_glyphs_begin_frame(lcd_glyphs_t* glyphs)
+{
+    glyphs->pinned = 0;
+}
+
+void lcd_glyphs_invalidate(lcd_glyphs_t* glyphs)
+{
+    glyphs->loaded = 0;
+    glyphs->pinned = 0;
+}
+
+static int find_victim(const lcd_glyphs_t* glyphs)
+{
+    int victim = -1;
+    for (int slot = 0; slot < LCD_GLYPH_SLOTS; slot++) {
+        if (glyphs->pinned & (1 << slot)) {
+            continue;
+        }
+        if (!(glyphs->loaded & (1 << slot))) {
+            return slot;
+        }
+        if (victim < 0 || glyphs->last_used[slot] < glyphs->last_used[victim]) {
+            victim = slot;
+        }
+    }
+    return victim;
+}
+
+static esp_err_t upload(lcd_glyphs_t* glyphs, int slot, const uint8_t rows[LCD_GLYPH_ROWS])
+{
+    uint8_t* cur = &glyphs->rows[slot][0];
+    if (!(glyphs->loaded & (1 << slot))) {
+        glyphs->stats.rows_written += LCD_GLYPH_ROWS;
+        return display_define_glyph(glyphs->disp, (uint8_t)slot, 0, &rows[0], LCD_GLYPH_ROWS);
+    }
+
+    // Write each run of changed rows with one address command
+    int row = 0;
+    while (row < LCD_GLYPH_ROWS) {
+        if (cur[row] == rows[row]) {
+            glyphs->stats.rows_skipped++;
+            row++;
+            continue;
+        }
+        int end = row + 1;
+        while (end < LCD_GLYPH_ROWS && cur[end] != rows[end]) {
+            end++;
+        }
+        esp_err_t err = display_define_glyph(glyphs->disp, (uint8_t)slot, (uint8_t)row, &rows[row], end - row);
+        if (err != ESP_OK) {
+            return err;
+        }
+        glyphs->stats.rows_written += end - row;
+        row = end;
+    }
+    return ESP_OK;
+}
+
+int lcd_glyphs_get(lcd_glyphs_t* glyphs, const uint8_t rows[LCD_GLYPH_ROWS])
+{
+    glyphs->clock++;
+    for (int slot = 0; slot < LCD_GLYPH_SLOTS; slot++) {
+        if ((glyphs->loaded & (1 << slot)) && memcmp(&glyphs->rows[slot][0], &rows[0], LCD_GLYPH_ROWS) == 0) {
+            glyphs->stats.hits++;
+            glyphs->last_used[slot] = glyphs->clock;
+            glyphs->pinned |= 1 << slot;
+            return slot;
+        }
+    }
+
+    int slot = find_victim(glyphs);
+    if (slot < 0) {
+        glyphs->stats.full++;
+        return -1;
+    }
+    glyphs->stats.misses++;
+    if (upload(glyphs, slot, rows) != ESP_OK) {
+        // The slot may hold a partial glyph now
+        glyphs->loaded &= ~(1 << slot);
+        return -1;
+    }
+    memcpy(&glyphs->rows[slot][0], &rows[0], LCD_GLYPH_ROWS);
+    glyphs->loaded |= 1 << slot;
+    glyphs->last_used[slot] = glyphs->clock;
+    glyphs->pinned |= 1 << slot;
+    return slot;
+}
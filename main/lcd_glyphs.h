@@ -0,0 +1,46 @@
+#pragma once
+
+#include "display.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LCD_GLYPH_SLOTS DISPLAY_GLYPH_SLOTS
+#define LCD_GLYPH_ROWS DISPLAY_GLYPH_ROWS
+
+typedef struct lcd_glyph_stats {
+    uint32_t hits;          // glyph already in CGRAM
+    uint32_t misses;        // glyph uploaded into an evicted slot
+    uint32_t full;          // a miss with no free slot left in the frame
+    uint32_t rows_written;
+    uint32_t rows_skipped;  // rows of an evicted slot that already matched
+} lcd_glyph_stats_t;
+
+// Glyph slot cache (CGRAM on a character LCD). Slots are evicted least recently used first, and a new glyph only rewrites the
+// rows that differ from what the evicted slot held.
+typedef struct lcd_glyphs {
+    display_t* disp;
+    uint8_t rows[LCD_GLYPH_SLOTS][LCD_GLYPH_ROWS];
+    uint32_t last_used[LCD_GLYPH_SLOTS];
+    uint32_t clock;
+    uint8_t loaded;     // bit per slot, rows[] matches the display
+    uint8_t pinned;     // bit per slot referenced by the frame being drawn
+    lcd_glyph_stats_t stats;
+} lcd_glyphs_t;
+
+void lcd_glyphs_init(lcd_glyphs_t* glyphs, display_t* disp);
+// Starts a frame. Slots handed out during a frame are not evicted until the next one, since
+// rewriting them would change characters already on the display.
+void lcd_glyphs_begin_frame(lcd_glyphs_t* glyphs);
+// Character code (0-7) that shows the glyph, uploading it if needed. -1 if every slot is in use
+// by the current frame or the upload failed.
+int lcd_glyphs_get(lcd_glyphs_t* glyphs, const uint8_t rows[LCD_GLYPH_ROWS]);
+// Forget the slot contents, e.g. after the display was reset
+void lcd_glyphs_invalidate(lcd_glyphs_t* glyphs);
+
+#ifdef __cplusplus
+}
+#endif
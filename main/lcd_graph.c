@@ -0,0 +1,160 @@
+#include "lcd_graph.h"
+
+#include <math.h>
+#include <string.h>
+
+#define LCD_CHAR_BLANK ' '
+#define LCD_CHAR_FULL_BLOCK ((char)0xff)   // HD44780 A00 character ROM, mapped by other backends
+
+void lcd_trend_init(lcd_trend_t* trend, uint32_t window_sec)
+{
+    memset(trend, 0, sizeof(lcd_trend_t));
+    for (int i = 0; i < LCD_TREND_POINTS; i++) {
+        trend->points[i] = NAN;
+    }
+    trend->bucket_usec = (int64_t)window_sec * 1000000 / LCD_TREND_POINTS;
+    if (trend->bucket_usec <= 0) {
+        trend->bucket_usec = 1;
+    }
+}
+
+static void close_bucket(lcd_trend_t* trend)
+{
+    trend->points[trend->head] = trend->count > 0 ? trend->sum / trend->count : NAN;
+    trend->head = (trend->head + 1) % LCD_TREND_POINTS;
+    trend->sum = 0.0f;
+    trend->count = 0;
+    trend->version++;
+}
+
+void lcd_trend_add(lcd_trend_t* trend, int64_t usec, float value)
+{
+    if (trend->bucket_start_usec == 0) {
+        trend->bucket_start_usec = usec;
+    }
+    // Buckets that passed without a sample (e.g. the sensor was off) are recorded as gaps
+    int closed = 0;
+    while (usec - trend->bucket_start_usec >= trend->bucket_usec && closed < LCD_TREND_POINTS) {
+        close_bucket(trend);
+        trend->bucket_start_usec += trend->bucket_usec;
+        closed++;
+    }
+    if (closed == LCD_TREND_POINTS) {
+        trend->bucket_start_usec = usec;
+    }
+    if (!isnan(value)) {
+        trend->sum += value;
+        trend->count++;
+    }
+}
+
+float lcd_trend_point(const lcd_trend_t* trend, int index)
+{
+    return trend->points[(trend->head + index) % LCD_TREND_POINTS];
+}
+
+static bool trend_range(const lcd_trend_t* trend, float* lo, float* hi)
+{
+    *lo = INFINITY;
+    *hi = -INFINITY;
+    for (int i = 0; i < LCD_TREND_POINTS; i++) {
+        float v = trend->points[i];
+        if (!isnan(v)) {
+            *lo = fminf(*lo, v);
+            *hi = fmaxf(*hi, v);
+        }
+    }
+    if (*lo > *hi) {
+        return false;
+    }
+    // A flat trend is drawn along the bottom rather than amplifying noise
+    if (*hi - *lo < 1.0f) {
+        *hi = *lo + 1.0f;
+    }
+    return true;
+}
+
+// Height 0-levels of value within [lo, hi]
+static int level(float value, float lo, float hi, int levels)
+{
+    int l = (int)lroundf((value - lo) / (hi - lo) * levels);
+    return l < 0 ? 0 : (l > levels ? levels : l);
+}
+
+void lcd_graph_sparkline(lcd_glyphs_t* glyphs, const lcd_trend_t* trend, char* out, uint8_t cells)
+{
+    memset(out, LCD_CHAR_BLANK, cells);
+    float lo, hi;
+    if (!trend_range(trend, &lo, &hi)) {
+        return;
+    }
+    if (cells > LCD_GLYPH_SLOTS) {
+        cells = LCD_GLYPH_SLOTS;
+    }
+
+    // The newest point is always in the last pixel column of the last cell
+    int first = LCD_TREND_POINTS - cells * LCD_GRAPH_COLS_PER_CELL;
+    for (uint8_t cell = 0; cell < cells; cell++) {
+        uint8_t rows[LCD_GLYPH_ROWS];
+        memset(&rows[0], 0, sizeof(rows));
+        bool empty = true;
+        for (int x = 0; x < LCD_GRAPH_COLS_PER_CELL; x++) {
+            float v = lcd_trend_point(trend, first + cell * LCD_GRAPH_COLS_PER_CELL + x);
+            if (isnan(v)) {
+                continue;
+            }
+            int y = LCD_GLYPH_ROWS - 1 - level(v, lo, hi, LCD_GLYPH_ROWS - 1);
+            rows[y] |= 1 << (LCD_GRAPH_COLS_PER_CELL - 1 - x);
+            empty = false;
+        }
+        if (!empty) {
+            int code = lcd_glyphs_get(glyphs, rows);
+            if (code >= 0) {
+                out[cell] = (char)code;
+            }
+        }
+    }
+}
+
+void lcd_graph_bars(lcd_glyphs_t* glyphs, const lcd_trend_t* trend, char* out, uint8_t cells)
+{
+    memset(out, LCD_CHAR_BLANK, cells);
+    float lo, hi;
+    if (cells == 0 || !trend_range(trend, &lo, &hi)) {
+        return;
+    }
+
+    for (uint8_t cell = 0; cell < cells; cell++) {
+        int begin = cell * LCD_TREND_POINTS / cells;
+        int end = (cell + 1) * LCD_TREND_POINTS / cells;
+        if (end == begin) {
+            end = begin + 1;
+        }
+        float sum = 0.0f;
+        int count = 0;
+        for (int i = begin; i < end; i++) {
+            float v = lcd_trend_point(trend, i);
+            if (!isnan(v)) {
+                sum += v;
+                count++;
+            }
+        }
+        if (count == 0) {
+            continue;
+        }
+        // Any reading shows at least one row so gaps stay distinguishable from the minimum
+        int height = 1 + level(sum / count, lo, hi, LCD_GLYPH_ROWS - 1);
+        if (height == LCD_GLYPH_ROWS) {
+            out[cell] = LCD_CHAR_FULL_BLOCK;
+        } else {
+            uint8_t rows[LCD_GLYPH_ROWS];
+            for (int y = 0; y < LCD_GLYPH_ROWS; y++) {
+                rows[y] = y >= LCD_GLYPH_ROWS - height ? 0x1f : 0x00;
+            }
+            int code = lcd_glyphs_get(glyphs, rows);
+            if (code >= 0) {
+                out[cell] = (char)code;
+            }
+        }
+    }
+}
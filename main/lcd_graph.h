@@ -0,0 +1,38 @@
+#pragma once
+
+#include "lcd_glyphs.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LCD_GRAPH_COLS_PER_CELL 5
+#define LCD_TREND_POINTS (LCD_GLYPH_SLOTS * LCD_GRAPH_COLS_PER_CELL)
+
+// Fixed-length history of bucket means covering a sliding window, oldest point first
+typedef struct lcd_trend {
+    float points[LCD_TREND_POINTS];     // ring, NAN for buckets without a reading
+    uint8_t head;                       // next point to overwrite, i.e. the oldest
+    int64_t bucket_usec;
+    int64_t bucket_start_usec;
+    float sum;
+    uint32_t count;
+    uint32_t version;                   // bumped whenever a bucket is closed
+} lcd_trend_t;
+
+void lcd_trend_init(lcd_trend_t* trend, uint32_t window_sec);
+void lcd_trend_add(lcd_trend_t* trend, int64_t usec, float value);
+float lcd_trend_point(const lcd_trend_t* trend, int index);
+
+// Both widgets fill out[cells] with character codes; cells holds the display characters to write.
+// Sparkline: one pixel column per point, LCD_GRAPH_COLS_PER_CELL points per cell. Every cell needs
+// its own glyph, so at most LCD_GLYPH_SLOTS cells are drawn.
+void lcd_graph_sparkline(lcd_glyphs_t* glyphs, const lcd_trend_t* trend, char* out, uint8_t cells);
+// Bar graph: the points are averaged down to one 8-level bar per cell. Uses at most 7 glyphs.
+void lcd_graph_bars(lcd_glyphs_t* glyphs, const lcd_trend_t* trend, char* out, uint8_t cells);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,333 @@
+#include "lcd_layout.h"
+#include "alert_rules.h"
+
+#include "sdkconfig.h"
+#include "esp_timer.h"
+
+#include <math.h>
+#include <string.h>
+
+#define CHECK_ARG(VAL) do { if (!(VAL)) return ESP_ERR_INVALID_ARG; } while (0)
+
+#define LCD_LAYOUT_MAX_DECIMALS 4
+
+// 2-row screens, 16 columns. Values are right-aligned in their cells so a changing digit count never leaves
+// stale characters behind.
+static const lcd_field_t s_temperature_fields[] = {
+    LCD_TEXT(0, 0, "MCP:"),
+    LCD_VALUE(4, 0, 8, ALERT_FIELD_TEMPERATURE_MCP9808, 2),
+    LCD_TEXT(12, 0, "C"),
+    LCD_TEXT(0, 1, "SEN:"),
+    LCD_VALUE(4, 1, 8, ALERT_FIELD_TEMPERATURE, 2),
+    LCD_TEXT(12, 1, "C"),
+};
+
+static const lcd_field_t s_humidity_aqi_fields[] = {
+    LCD_TEXT(0, 0, "RH:"),
+    LCD_VALUE(4, 0, 8, ALERT_FIELD_HUMIDITY, 2),
+    LCD_TEXT(12, 0, "%"),
+    LCD_TEXT(0, 1, "AQI:"),
+    LCD_VALUE(4, 1, 8, ALERT_FIELD_AQI, 0),
+};
+
+static const lcd_field_t s_pm_fields[] = {
+    LCD_TEXT(0, 0, "PM10:"),
+    LCD_VALUE(6, 0, 8, ALERT_FIELD_PM10P0, 2),
+    LCD_TEXT(0, 1, "PM2.5:"),
+    LCD_VALUE(6, 1, 8, ALERT_FIELD_PM2P5, 1),
+};
+
+static const lcd_field_t s_pm2p5_trend_fields[] = {
+    LCD_TEXT(0, 0, "PM2.5"),
+    LCD_VALUE(6, 0, 8, ALERT_FIELD_PM2P5, 1),
+    LCD_SPARKLINE(0, 1, 8, LCD_TREND_PM2P5),
+};
+
+static const lcd_field_t s_aqi_trend_fields[] = {
+    LCD_TEXT(0, 0, "AQI"),
+    LCD_VALUE(6, 0, 8, ALERT_FIELD_AQI, 0),
+    LCD_BARS(0, 1, 16, LCD_TREND_AQI),
+};
+
+// 4-row screens, 16 columns
+static const lcd_field_t s_temperature_tall_fields[] = {
+    LCD_TEXT(0, 0, "MCP:"),
+    LCD_VALUE(4, 0, 8, ALERT_FIELD_TEMPERATURE_MCP9808, 2),
+    LCD_TEXT(12, 0, "C"),
+    LCD_TEXT(0, 1, "SEN:"),
+    LCD_VALUE(4, 1, 8, ALERT_FIELD_TEMPERATURE, 2),
+    LCD_TEXT(12, 1, "C"),
+    LCD_TEXT(0, 2, "RH:"),
+    LCD_VALUE(4, 2, 8, ALERT_FIELD_HUMIDITY, 2),
+    LCD_TEXT(12, 2, "%"),
+};
+
+static const lcd_field_t s_humidity_aqi_tall_fields[] = {
+    LCD_TEXT(0, 0, "AQI:"),
+    LCD_VALUE(4, 0, 8, ALERT_FIELD_AQI, 0),
+    LCD_TEXT(0, 1, "VOC:"),
+    LCD_VALUE(4, 1, 8, ALERT_FIELD_VOC_INDEX, 0),
+    LCD_TEXT(0, 2, "NOx:"),
+    LCD_VALUE(4, 2, 8, ALERT_FIELD_NOX_INDEX, 0),
+    LCD_TEXT(0, 3, "RH:"),
+    LCD_VALUE(4, 3, 8, ALERT_FIELD_HUMIDITY, 2),
+};
+
+static const lcd_field_t s_pm_tall_fields[] = {
+    LCD_TEXT(0, 0, "PM1.0:"),
+    LCD_VALUE(6, 0, 8, ALERT_FIELD_PM1P0, 1),
+    LCD_TEXT(0, 1, "PM2.5:"),
+    LCD_VALUE(6, 1, 8, ALERT_FIELD_PM2P5, 1),
+    LCD_TEXT(0, 2, "PM4.0:"),
+    LCD_VALUE(6, 2, 8, ALERT_FIELD_PM4P0, 1),
+    LCD_TEXT(0, 3, "PM10:"),
+    LCD_VALUE(6, 3, 8, ALERT_FIELD_PM10P0, 1),
+};
+
+static const lcd_field_t s_pm2p5_trend_tall_fields[] = {
+    LCD_TEXT(0, 0, "PM2.5"),
+    LCD_VALUE(6, 0, 8, ALERT_FIELD_PM2P5, 1),
+    LCD_SPARKLINE(0, 1, 8, LCD_TREND_PM2P5),
+    LCD_TEXT(0, 3, "PM10"),
+    LCD_VALUE(6, 3, 8, ALERT_FIELD_PM10P0, 1),
+};
+
+static const lcd_field_t s_aqi_trend_tall_fields[] = {
+    LCD_TEXT(0, 0, "AQI"),
+    LCD_VALUE(6, 0, 8, ALERT_FIELD_AQI, 0),
+    LCD_BARS(0, 1, 16, LCD_TREND_AQI),
+    LCD_TEXT(0, 3, "PM2.5"),
+    LCD_VALUE(6, 3, 8, ALERT_FIELD_PM2P5, 1),
+};
+
+#define SCREEN(name, fields) { name, &fields[0], sizeof(fields) / sizeof(fields[0]) }
+
+static const lcd_screen_t s_screens_tall[LCD_NUM_SCREENS] = {
+    [LCD_SCREEN_TEMPERATURE] = SCREEN("temperature", s_temperature_tall_fields),
+    [LCD_SCREEN_HUMIDITY_AQI] = SCREEN("humidity_aqi", s_humidity_aqi_tall_fields),
+    [LCD_SCREEN_PM] = SCREEN("pm", s_pm_tall_fields),
+    [LCD_SCREEN_PM2P5_TREND] = SCREEN("pm2p5_trend", s_pm2p5_trend_tall_fields),
+    [LCD_SCREEN_AQI_TREND] = SCREEN("aqi_trend", s_aqi_trend_tall_fields),
+};
+
+static const lcd_screen_t s_screens[LCD_NUM_SCREENS] = {
+    [LCD_SCREEN_TEMPERATURE] = SCREEN("temperature", s_temperature_fields),
+    [LCD_SCREEN_HUMIDITY_AQI] = SCREEN("humidity_aqi", s_humidity_aqi_fields),
+    [LCD_SCREEN_PM] = SCREEN("pm", s_pm_fields),
+    [LCD_SCREEN_PM2P5_TREND] = SCREEN("pm2p5_trend", s_pm2p5_trend_fields),
+    [LCD_SCREEN_AQI_TREND] = SCREEN("aqi_trend", s_aqi_trend_fields),
+};
+
+static const uint8_t s_trend_sources[LCD_NUM_TRENDS] = {
+    [LCD_TREND_PM2P5] = ALERT_FIELD_PM2P5,
+    [LCD_TREND_AQI] = ALERT_FIELD_AQI,
+};
+
+static const float s_pow10[LCD_LAYOUT_MAX_DECIMALS + 1] = { 1.0f, 10.0f, 100.0f, 1000.0f, 10000.0f };
+
+int lcd_layout_next_screen(int current, uint8_t mask)
+{
+    for (int i = 1; i <= LCD_NUM_SCREENS; i++) {
+        int id = (current + i) % LCD_NUM_SCREENS;
+        if (mask & (1 << id)) {
+            return id;
+        }
+    }
+    return current;
+}
+
+void lcd_layout_init(lcd_layout_t* layout, display_t* disp)
+{
+    memset(layout, 0, sizeof(lcd_layout_t));
+    layout->disp = disp;
+    layout->screens = disp->rows >= 4 ? &s_screens_tall[0] : &s_screens[0];
+    layout->screen = &layout->screens[0];
+    layout->stale = true;
+    lcd_glyphs_init(&layout->glyphs, disp);
+    for (int t = 0; t < LCD_NUM_TRENDS; t++) {
+        lcd_trend_init(&layout->trends[t], CONFIG_AQM_LCD_TREND_MINUTES * 60);
+    }
+}
+
+void lcd_layout_record(lcd_layout_t* layout, const struct sensor_data* sd)
+{
+    for (int t = 0; t < LCD_NUM_TRENDS; t++) {
+        lcd_trend_add(&layout->trends[t], sd->timestamp, alert_field_value(sd, s_trend_sources[t]));
+    }
+}
+
+void lcd_layout_show(lcd_layout_t* layout, int id)
+{
+    if (id < 0 || id >= LCD_NUM_SCREENS) {
+        return;
+    }
+    const lcd_screen_t* screen = &layout->screens[id];
+    if (screen != layout->screen) {
+        layout->screen = screen;
+        layout->stale = true;
+    }
+}
+
+void lcd_layout_invalidate(lcd_layout_t* layout)
+{
+    layout->stale = true;
+}
+
+void lcd_layout_format_fixed(char* out, uint8_t width, int32_t value, uint8_t decimals)
+{
+    memset(out, ' ', width);
+    if (value == INT32_MIN) {
+        for (int i = width - 1; i >= 0 && i >= width - 2; i--) {
+            out[i] = '-';
+        }
+        return;
+    }
+
+    // Build the digits least significant first, then copy them right-aligned
+    char tmp[16];
+    int n = 0;
+    bool negative = value < 0;
+    uint32_t mag = negative ? (uint32_t)(-(int64_t)value) : (uint32_t)value;
+    for (uint8_t d = 0; d < decimals; d++) {
+        tmp[n++] = (char)('0' + mag % 10);
+        mag /= 10;
+    }
+    if (decimals > 0) {
+        tmp[n++] = '.';
+    }
+    do {
+        tmp[n++] = (char)('0' + mag % 10);
+        mag /= 10;
+    } while (mag > 0);
+    if (negative) {
+        tmp[n++] = '-';
+    }
+
+    if (n > width) {
+        memset(out, '#', width);
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        out[width - 1 - i] = tmp[i];
+    }
+}
+
+// Readings are rescaled from the sensor's fixed point to the field's decimals in integer math
+static int32_t field_fixed(const struct sensor_data* sd, const lcd_field_t* f)
+{
+    if (f->source < SENSOR_NUM_FIELDS) {
+        int16_t v = sd->sample.value[f->source];
+        return v == SENSOR_NONE ? INT32_MIN : sensor_rescale(f->source, v, f->decimals);
+    }
+    float v = alert_field_value(sd, f->source);
+    if (isnan(v)) {
+        return INT32_MIN;
+    }
+    v *= s_pow10[f->decimals];
+    if (v >= 2147483520.0f || v <= -2147483520.0f) {
+        return v > 0 ? INT32_MAX : -INT32_MAX;
+    }
+    return (int32_t)lroundf(v);
+}
+
+static esp_err_t draw(lcd_layout_t* layout, const lcd_field_t* f, const char* text)
+{
+    layout->stats.chars_written += f->width;
+    return display_write(layout->disp, f->col, f->row, text, f->width);
+}
+
+static esp_err_t draw_graph(lcd_layout_t* layout, const lcd_field_t* f)
+{
+    char buf[LCD_LAYOUT_MAX_WIDTH];
+    const lcd_trend_t* trend = &layout->trends[f->source];
+    if (f->kind == LCD_FIELD_SPARKLINE) {
+        lcd_graph_sparkline(&layout->glyphs, trend, &buf[0], f->width);
+    } else {
+        lcd_graph_bars(&layout->glyphs, trend, &buf[0], f->width);
+    }
+    return draw(layout, f, &buf[0]);
+}
+
+esp_err_t lcd_layout_render(lcd_layout_t* layout, const struct sensor_data* sd)
+{
+    CHECK_ARG(layout && layout->disp && layout->screen && sd);
+    int64_t usec_start = esp_timer_get_time();
+    const lcd_screen_t* screen = layout->screen;
+    esp_err_t err = ESP_OK;
+
+    if (layout->stale) {
+        layout->stale = false;
+        layout->drawn = 0;
+        layout->stats.redraws++;
+        err = display_clear(layout->disp);
+        for (uint8_t i = 0; i < screen->num_fields && err == ESP_OK; i++) {
+            if (screen->fields[i].kind == LCD_FIELD_TEXT) {
+                err = draw(layout, &screen->fields[i], screen->fields[i].text);
+            }
+        }
+        if (err != ESP_OK) {
+            layout->stale = true;
+        }
+    }
+
+    // Graphs on one screen share the glyph slots, so when any of them changes all are redrawn
+    // within one frame to keep a slot from being reused under a graph that is still shown
+    bool graphs_changed = false;
+    for (uint8_t i = 0; i < screen->num_fields; i++) {
+        const lcd_field_t* f = &screen->fields[i];
+        if ((f->kind == LCD_FIELD_SPARKLINE || f->kind == LCD_FIELD_BARS)
+            && (!(layout->drawn & (1u << i)) || layout->shown[i] != (int32_t)layout->trends[f->source].version)) {
+            graphs_changed = true;
+        }
+    }
+    if (graphs_changed) {
+        lcd_glyphs_begin_frame(&layout->glyphs);
+    }
+
+    for (uint8_t i = 0; i < screen->num_fields && err == ESP_OK; i++) {
+        const lcd_field_t* f = &screen->fields[i];
+        int32_t value;
+        switch (f->kind) {
+        case LCD_FIELD_VALUE: {
+            value = field_fixed(sd, f);
+            if ((layout->drawn & (1u << i)) && layout->shown[i] == value) {
+                layout->stats.fields_skipped++;
+                continue;
+            }
+            char buf[LCD_LAYOUT_MAX_WIDTH];
+            lcd_layout_format_fixed(&buf[0], f->width, value, f->decimals);
+            err = draw(layout, f, &buf[0]);
+            break;
+        }
+        case LCD_FIELD_SPARKLINE:
+        case LCD_FIELD_BARS:
+            value = (int32_t)layout->trends[f->source].version;
+            if (!graphs_changed) {
+                layout->stats.fields_skipped++;
+                continue;
+            }
+            err = draw_graph(layout, f);
+            break;
+        default:
+            continue;
+        }
+        if (err == ESP_OK) {
+            layout->shown[i] = value;
+            layout->drawn |= 1u << i;
+            layout->stats.fields_drawn++;
+        }
+    }
+
+    esp_err_t flush_err = display_flush(layout->disp);
+    if (err == ESP_OK) {
+        err = flush_err;
+    }
+
+    int64_t usec = esp_timer_get_time() - usec_start;
+    layout->stats.renders++;
+    layout->stats.last_render_usec = usec;
+    if (usec > layout->stats.max_render_usec) {
+        layout->stats.max_render_usec = usec;
+    }
+    return err;
+}
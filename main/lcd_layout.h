@@ -0,0 +1,108 @@
+#pragma once
+
+#include "display.h"
+#include "lcd_glyphs.h"
+#include "lcd_graph.h"
+#include "sensor_data.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LCD_LAYOUT_MAX_FIELDS 8
+#define LCD_LAYOUT_MAX_WIDTH 20
+
+enum lcd_screen_id {
+    LCD_SCREEN_TEMPERATURE,
+    LCD_SCREEN_HUMIDITY_AQI,
+    LCD_SCREEN_PM,
+    LCD_SCREEN_PM2P5_TREND,
+    LCD_SCREEN_AQI_TREND,
+    LCD_NUM_SCREENS
+};
+
+#define LCD_SCREENS_ALL ((1 << LCD_NUM_SCREENS) - 1)
+
+enum lcd_field_kind {
+    LCD_FIELD_TEXT,
+    LCD_FIELD_VALUE,
+    LCD_FIELD_SPARKLINE,
+    LCD_FIELD_BARS,
+};
+
+// Trend history is kept for these sources whichever screen is shown
+enum lcd_trend_id {
+    LCD_TREND_PM2P5,
+    LCD_TREND_AQI,
+    LCD_NUM_TRENDS
+};
+
+// A fixed-width cell. Text cells are drawn once when the screen is shown; value cells are bound
+// to a sample field (enum alert_field) and redrawn only when their formatted value changes.
+// Graph cells draw a trend (enum lcd_trend_id) and are redrawn when it gains a point.
+typedef struct lcd_field {
+    uint8_t kind;
+    uint8_t col;
+    uint8_t row;
+    uint8_t width;
+    uint8_t source;
+    uint8_t decimals;
+    const char* text;
+} lcd_field_t;
+
+#define LCD_TEXT(col, row, text) { LCD_FIELD_TEXT, col, row, sizeof(text) - 1, 0, 0, text }
+#define LCD_VALUE(col, row, width, source, decimals) { LCD_FIELD_VALUE, col, row, width, source, decimals, NULL }
+#define LCD_SPARKLINE(col, row, width, trend) { LCD_FIELD_SPARKLINE, col, row, width, trend, 0, NULL }
+#define LCD_BARS(col, row, width, trend) { LCD_FIELD_BARS, col, row, width, trend, 0, NULL }
+
+typedef struct lcd_screen {
+    const char* name;
+    const lcd_field_t* fields;
+    uint8_t num_fields;
+} lcd_screen_t;
+
+typedef struct lcd_layout_stats {
+    uint32_t renders;
+    uint32_t redraws;           // full screen redraws (screen change, after a banner)
+    uint32_t fields_drawn;
+    uint32_t fields_skipped;    // value unchanged since it was last drawn
+    uint32_t chars_written;
+    int64_t last_render_usec;
+    int64_t max_render_usec;
+} lcd_layout_stats_t;
+
+typedef struct lcd_layout {
+    display_t* disp;
+    const lcd_screen_t* screens;    // screen set for the display's size, indexed by enum lcd_screen_id
+    const lcd_screen_t* screen;
+    bool stale;                 // everything must be redrawn on the next render
+    uint32_t drawn;             // bit per field, set once shown[] holds what is on the display
+    int32_t shown[LCD_LAYOUT_MAX_FIELDS];   // formatted value or trend version
+    lcd_glyphs_t glyphs;
+    lcd_trend_t trends[LCD_NUM_TRENDS];
+    lcd_layout_stats_t stats;
+} lcd_layout_t;
+
+// Next screen after current that is enabled in mask, wrapping around. Returns current if no
+// other screen is enabled.
+int lcd_layout_next_screen(int current, uint8_t mask);
+
+// Displays with 4 or more rows get the taller screen set
+void lcd_layout_init(lcd_layout_t* layout, display_t* disp);
+// Feeds the trends; call for every sample, including while something else owns the display
+void lcd_layout_record(lcd_layout_t* layout, const struct sensor_data* sd);
+void lcd_layout_show(lcd_layout_t* layout, int id);
+// Forget what is on the display, e.g. after something else wrote to it
+void lcd_layout_invalidate(lcd_layout_t* layout);
+esp_err_t lcd_layout_render(lcd_layout_t* layout, const struct sensor_data* sd);
+
+// Right-aligns value / 10^decimals into width characters without a terminator. Values that do not
+// fit are shown as '#', INT32_MIN (no reading) as "--".
+void lcd_layout_format_fixed(char* out, uint8_t width, int32_t value, uint8_t decimals);
+
+#ifdef __cplusplus
+}
+#endif
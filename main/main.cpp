@@ -1,95 +1,184 @@
 #include "system.h"
 #include "sensor_data.h"
 #include "sen5x_i2c.h"
-#include "sensirion_i2c_hal.h"
-#include "sensirion_i2c_esp32_config.h"
-#include "lcd_ascii.h"
-#include "mcp9808.h"
+#include "sen5x_async.h"
+#include "sensirion_common.h"
+#include "i2c_bus.h"
+#include "display.h"
+#include "lcd_layout.h"
+#include "temp_mcp9808.h"
 #include "http_server.h"
 #include "utils.h"
 #include "wifi.h"
 #include "aqi.h"
+#include "power.h"
+#include "ota.h"
+#include "settings.h"
+#include "alerts.h"
+#include "fleet.h"
+#include "health.h"
+#include "history.h"
+#include "stats.h"
+#include "sample_rate.h"
+#include "telemetry.h"
+#include "task_plan.h"
+#include "sample_bus.h"
+#include "boot.h"
+#include "arena.h"
 
 #include "sdkconfig.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_log.h"
 #include "esp_timer.h"
+#include "esp_sntp.h"
 #include "rtc.h"
-#include "driver/i2c.h"
 
 #include <stdio.h>
 #include <string.h>
 #include <stdarg.h>
+#include <math.h>
+#include <new>
 
 static constexpr auto TAG = "esper-aqm";
 static constexpr auto kAppVersion = "1.0.0";
 
 #define I2C_MAX_DEVICES 128
-#define I2C_FREQ 100000
-#define I2C_SDA_GPIO_PIN (gpio_num_t)(18)
-#define I2C_SCL_GPIO_PIN (gpio_num_t)(17)
 #define I2C_ADDR_MCP9808 0x18
-#define I2C_ADDR_ASCII_LCD 0x27
 #define I2C_ADDR_SEN5X SEN5X_I2C_ADDRESS // 0x69, defined in CMakeLists
-#define SENSOR_UPDATE_RATE 1000 // msec
-#define ASCII_LCD_MAX_WINDOWS 3
+#define SEN5X_MAX_FREQ_HZ I2C_BUS_FREQ_STANDARD
 
 constexpr double usec_to_sec(int64_t usec) {
     return (double)usec / 1000000.0;
 }
 
-constexpr double c_to_f(double celsius) {
-    return (celsius * 1.8) + 32.0;
+// Fahrenheit in the same fixed point as the celsius reading
+static int16_t c_to_f(int field, int16_t celsius)
+{
+    if (celsius == SENSOR_NONE) {
+        return SENSOR_NONE;
+    }
+    int32_t f = (int32_t)celsius * 9 / 5 + 32 * sensor_scale(field);
+    return (int16_t)(f >= SENSOR_NONE ? SENSOR_NONE - 1 : f < INT16_MIN ? INT16_MIN : f);
+}
+
+// Console text straight from fixed point, "n/a" for a missing reading
+static const char* fixed_text(char* buf, int field, int16_t value, int decimals)
+{
+    if (value == SENSOR_NONE) {
+        return "n/a";
+    }
+    sensor_format_decimals(buf, SENSOR_FORMAT_MAX, field, value, decimals);
+    return buf;
+}
+
+// SEN5x PM words are unsigned with 0xFFFF for "unknown", real readings stay below 10000
+static int16_t pm_fixed(uint16_t raw)
+{
+    return raw >= SENSOR_NONE ? SENSOR_NONE : (int16_t)raw;
 }
 
+// Sample fields feeding each AQI pollutant, in AQI::Pollutant order
+static constexpr int kAqiFields[AQI::kNumPollutants] = {
+    SENSOR_PM1P0, SENSOR_PM2P5, SENSOR_PM4P0, SENSOR_PM10P0, SENSOR_VOC_INDEX, SENSOR_NOX_INDEX,
+};
+
 class esper_aqm {
 public:
-    esper_aqm(int update_rate_msec);
+    esper_aqm();
     ~esper_aqm();
     esp_err_t init();
     void run();
 
 private:
+    static void sampler_task(void* arg);
+    static void display_task(void* arg);
+    static esp_err_t boot_i2c(void* arg);
+    static esp_err_t boot_wifi(void* arg);
+    static esp_err_t boot_display(void* arg);
+    static esp_err_t boot_mcp9808(void* arg);
+    static esp_err_t boot_sen5x(void* arg);
+    static esp_err_t boot_http(void* arg);
+    void sample();
+    void display();
+    void update_aqi();
+    void update_lcd(const sensor_data& sd, int screen);
+    void report(const sensor_data& sd);
+    void apply_settings();
+    void reset_sample_rate();
     void read_sensors();
+    void read_sensors_blocking();
+    void read_sensors_overlapped();
+    void decode_sen5x_values(const uint8_t* data);
+    bool sen5x_duty_cycle(int64_t usec_now, int* wait_msec);
     esp_err_t i2c_init();
-    void i2c_enumerate(i2c_port_t port, i2c_config_t* cfg);
     bool i2c_device_found(uint8_t addr);
 
     system_t* _system;
-    i2c_dev_t _mcp;
-    i2c_dev_t _sen;
-    lcd_ascii_t* _lcd;
-    sensor_data _data;
+    i2c_bus_dev_t* _mcp;
+    display_t* _display;
+    lcd_layout_t _layout;               // display task only
+    char _lcd_banner[ALERT_EXPR_LEN];   // alert banner on the display, empty if none
+    sensor_data _sample;    // written by the sampler task only
+    sample_bus_t _bus;      // sampler (core 1) -> reporter, display and HTTP
+    sample_sub_t* _report_sub;
+    sample_sub_t* _display_sub;
     rest_server_context_t* _rest;
+    aqm_settings_t _settings;   // sampler's copy, refreshed when the generation changes
+    uint32_t _settings_gen;
     int _update_rate_msec;
+    sample_rate_t _rate;    // sampler task only
     bool _i2c_found[I2C_MAX_DEVICES];
     AQI* _aqi;
+    bool _sen5x_measuring;
+    int64_t _sen5x_on_usec;
+    sen5x_async_t _sen5x;   // sampler task only once booted
+    std::array<int64_t, AQI::kNumPollutants> _aqi_acc;  // fixed-point readings times their msec
+    std::array<uint64_t, AQI::kNumPollutants> _aqi_weight_msec;
 };
 
-esper_aqm::esper_aqm(int update_rate_msec)
+esper_aqm::esper_aqm()
 : _system(nullptr),
-  _mcp(),
-  _sen(),
-  _data(),
+  _mcp(nullptr),
+  _display(nullptr),
+  _layout(),
+  _lcd_banner(),
+  _sample(),
+  _report_sub(nullptr),
+  _display_sub(nullptr),
   _rest(nullptr),
-  _update_rate_msec(update_rate_msec)
+  _settings(),
+  _settings_gen(0),
+  _update_rate_msec(0),
+  _rate(),
+  _sen5x_measuring(false),
+  _sen5x_on_usec(0),
+  _sen5x(),
+  _aqi_acc(),
+  _aqi_weight_msec()
 {
-    _rest = new rest_server_context_t();
-    sensor_data_init(&_data);
-    _rest->sensors = &_data;
+    // Long-lived objects come from the static arena in CONFIG_AQM_STATIC_ALLOC builds
+    _rest = static_cast<rest_server_context_t*>(arena_alloc(sizeof(rest_server_context_t)));
+    ESP_ERROR_CHECK(_rest != nullptr ? ESP_OK : ESP_ERR_NO_MEM);
+    sensor_data_init(&_sample);
+    sen5x_async_init(&_sen5x, nullptr);
+    sample_bus_init(&_bus);
+    _rest->samples = &_bus;
+    _rest->sample_rate = &_rate;
 
     for (uint8_t addr = 0; addr < I2C_MAX_DEVICES; addr++) {
         _i2c_found[addr] = false;
     }
 
-    _aqi = new AQI(AQI::Algorithm::EPA);
+    void* aqi = arena_alloc(sizeof(AQI));
+    ESP_ERROR_CHECK(aqi != nullptr ? ESP_OK : ESP_ERR_NO_MEM);
+    _aqi = new (aqi) AQI(AQI::Algorithm::EPA);
 }
 
 esper_aqm::~esper_aqm()
 {
     if (_rest != nullptr) {
-        delete _rest;
+        arena_free(_rest);
         _rest = nullptr;
     }
     system_shutdown(_system);
@@ -111,50 +200,91 @@ esp_err_t esper_aqm::init()
         return ESP_FAIL;
     }
 
+    ESP_ERROR_CHECK(settings_init());
+    settings_get(&_settings);
+    _settings_gen = settings_generation();
+    _update_rate_msec = (int)_settings.sample_rate_msec;
+    reset_sample_rate();
+    _aqi->SetAlgorithm((AQI::Algorithm)_settings.aqi_algorithm);
+
     ESP_ERROR_CHECK(system_get_info(_system));
     ESP_ERROR_CHECK(system_print_info(_system));
-    ESP_ERROR_CHECK(i2c_init());
-
-    system_wifi_init(_system); // TODO: Thread it out
-
-    // HiLetGo HD44780 IIC I2C1602 LCD Display
-    if (i2c_device_found(I2C_ADDR_ASCII_LCD)) {
-        i2c_config_t lcd_i2c;
-        lcd_i2c.sda_io_num = (int)I2C_SDA_GPIO_PIN;
-        lcd_i2c.scl_io_num = (int)I2C_SCL_GPIO_PIN;
-        lcd_i2c.sda_pullup_en = true;
-        lcd_i2c.scl_pullup_en = true;
-        _lcd = lcd_init(I2C_ADDR_ASCII_LCD, I2C_NUM_0, &lcd_i2c, 2, 16, LCD_CHAR_SIZE_SMALL);
-        lcd_backlight(_lcd, LCD_BACKLIGHT_ON);
-        lcd_cursor_pos(_lcd, 0, 0);
-        lcd_printf(_lcd, "esper-aqm 1.0.0");
-        if (_system->wifi->connected) {
-            lcd_cursor_pos(_lcd, 0, 1);
-            lcd_printf(_lcd, _system->wifi->ip_str);
-        }
+    ESP_ERROR_CHECK(power_init());
+    ESP_ERROR_CHECK(ota_init());
+    ESP_ERROR_CHECK(alerts_init());
+    _rest->sys = _system;
+
+    // Wi-Fi association overlaps the display and sensor bring-up; only the steps the sampler
+    // needs are waited for, the network and HTTP server finish in the background
+    uint32_t i2c = boot_add_step("i2c", &esper_aqm::boot_i2c, this, 0);
+    uint32_t wifi = boot_add_step("wifi", &esper_aqm::boot_wifi, this, 0);
+    uint32_t display = boot_add_step("display", &esper_aqm::boot_display, this, i2c);
+    uint32_t mcp = boot_add_step("mcp9808", &esper_aqm::boot_mcp9808, this, i2c);
+    uint32_t sen5x = boot_add_step("sen5x", &esper_aqm::boot_sen5x, this, i2c);
+    boot_add_step("http", &esper_aqm::boot_http, this, wifi);
+    boot_start();
+
+    return boot_wait(display | mcp | sen5x);
+}
+
+esp_err_t esper_aqm::boot_i2c(void* arg)
+{
+    return static_cast<esper_aqm*>(arg)->i2c_init();
+}
+
+esp_err_t esper_aqm::boot_wifi(void* arg)
+{
+    auto self = static_cast<esper_aqm*>(arg);
+    esp_err_t err = system_wifi_init(self->_system, &self->_settings.wifi_ssid[0], &self->_settings.wifi_pass[0]);
+    if (err != ESP_OK) {
+        return err;
+    }
+    fleet_init(&self->_system->wifi->ip_str[0]);
+    // History rows are only recorded once the clock is set
+    if (!sntp_enabled()) {
+        sntp_setoperatingmode(SNTP_OPMODE_POLL);
+        sntp_setservername(0, CONFIG_AQM_HISTORY_NTP_SERVER);
+        sntp_init();
     }
+    return ESP_OK;
+}
 
+esp_err_t esper_aqm::boot_display(void* arg)
+{
+    auto self = static_cast<esper_aqm*>(arg);
+    // HD44780 character LCD (PCF8574 backpack) or SSD1306/SH1106 OLED
+    self->_display = display_probe(&self->_i2c_found[0]);
+    if (self->_display != nullptr) {
+        lcd_layout_init(&self->_layout, self->_display);
+        self->_rest->lcd_layout = &self->_layout;
+        display_write(self->_display, 0, 0, "esper-aqm 1.0.0", 15);
+        display_flush(self->_display);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esper_aqm::boot_mcp9808(void* arg)
+{
+    auto self = static_cast<esper_aqm*>(arg);
     // MCP9808 Temperature Sensor
-    if (i2c_device_found(I2C_ADDR_MCP9808)) {
-        memset(&_mcp, 0, sizeof(i2c_dev_t));
-        ESP_ERROR_CHECK(mcp9808_init_desc(&_mcp, I2C_ADDR_MCP9808, I2C_NUM_0, I2C_SDA_GPIO_PIN, I2C_SCL_GPIO_PIN));
-        ESP_ERROR_CHECK(mcp9808_init(&_mcp));
+    if (self->i2c_device_found(I2C_ADDR_MCP9808)) {
+        self->_mcp = i2c_bus_add_device(I2C_ADDR_MCP9808, MCP9808_MAX_FREQ_HZ, I2C_BUS_PRIO_HIGH);
+        return temp_mcp9808_init(self->_mcp);
     }
+    return ESP_OK;
+}
 
+esp_err_t esper_aqm::boot_sen5x(void* arg)
+{
+    auto self = static_cast<esper_aqm*>(arg);
     // SEN55 Air Quality Sensor
-    if (i2c_device_found(I2C_ADDR_SEN5X)) {
-        struct esp32_i2c_config cfg;
-        cfg.freq = I2C_FREQ;
-        cfg.addr = I2C_ADDR_SEN5X;
-        cfg.port = I2C_NUM_0;
-        cfg.sda = I2C_SDA_GPIO_PIN;
-        cfg.scl = I2C_SCL_GPIO_PIN;
-        cfg.sda_pullup = true;
-        cfg.scl_pullup = true;
-        ESP_ERROR_CHECK(sensirion_i2c_config_esp32(&cfg));
-        sensirion_i2c_hal_init();
-        ESP_ERROR_CHECK(sensirion_i2c_esp32_ok());
-        ESP_ERROR_CHECK((esp_err_t)sen5x_device_reset());
+    if (self->i2c_device_found(I2C_ADDR_SEN5X)) {
+        sen5x_async_init(&self->_sen5x, i2c_bus_add_device(I2C_ADDR_SEN5X, SEN5X_MAX_FREQ_HZ, I2C_BUS_PRIO_HIGH));
+        if (sen5x_device_reset() != 0) {
+            return ESP_FAIL;
+        }
+        // Fan cleaning is scheduled by the health task for low-activity periods instead
+        sen5x_set_fan_auto_cleaning_interval(0);
     }
 
     unsigned char sen5x_name[32];
@@ -178,201 +308,431 @@ esp_err_t esper_aqm::init()
         sen5x_hw_min,
         sen5x_proto_maj,
         sen5x_proto_min);
-    ESP_ERROR_CHECK((esp_err_t)sen5x_start_measurement());
-
-    _rest->sys = _system;
-    http_server_start("/", _rest);
-
-    lcd_clear(_lcd);
-    lcd_cursor_pos(_lcd, 0, 0);
-
+    if (sen5x_start_measurement() != 0) {
+        return ESP_FAIL;
+    }
+    self->_sen5x_measuring = true;
+    self->_sen5x_on_usec = esp_timer_get_time();
     return ESP_OK;
 }
 
+esp_err_t esper_aqm::boot_http(void* arg)
+{
+    return http_server_start("/", static_cast<esper_aqm*>(arg)->_rest);
+}
+
 void esper_aqm::run()
 {
-    static unsigned int lcd_window = 0;
-    static int64_t usec_last = 0;
-    int aqi = 0;
-    float acc_pm10 = 0.0f;
-    float acc_pm25 = 0.0f;
-    float avg_pm10 = 0.0f;
-    float avg_pm25 = 0.0f;
-    uint64_t num_samples = 0;
+    task_plan_reset_stats((int64_t)_update_rate_msec * 1000);
+
+    // Subscribers are registered before the sampler publishes its first record
+    _report_sub = sample_bus_subscribe(&_bus, "reporter", xTaskGetCurrentTaskHandle());
+    if (_display != nullptr) {
+        TaskHandle_t display = nullptr;
+        xTaskCreatePinnedToCore(&esper_aqm::display_task, "aqm-display", AQM_STACK_DISPLAY, this,
+            AQM_PRIO_DISPLAY, &display, AQM_CORE_SAMPLER);
+        _display_sub = sample_bus_subscribe(&_bus, "display", display);
+    }
+    ESP_ERROR_CHECK(health_init(&_bus));
+    if (history_init(&_bus) != ESP_OK) {
+        ESP_LOGW(TAG, "History recording disabled");
+    }
+    if (stats_init(&_bus) != ESP_OK) {
+        ESP_LOGW(TAG, "Percentile statistics disabled");
+    }
+    if (telemetry_init(&_bus) != ESP_OK) {
+        ESP_LOGW(TAG, "Telemetry disabled");
+    }
+    xTaskCreatePinnedToCore(&esper_aqm::sampler_task, "aqm-sampler", AQM_STACK_SAMPLER, this,
+        AQM_PRIO_SAMPLER, NULL, AQM_CORE_SAMPLER);
+
+    // The calling task (app_main, pinned to core 0) becomes the reporter: it copies every sample
+    // off the bus, feeds the alert and fleet sinks and does all console logging.
+    vTaskPrioritySet(NULL, AQM_PRIO_REPORTER);
+    arena_watch_task("reporter");
     while (1) {
-        int64_t usec_now = esp_timer_get_time();
-        if (usec_now - usec_last >= 5000000) {
-            usec_last = usec_now;
-            lcd_window++;
-            if (lcd_window >= ASCII_LCD_MAX_WINDOWS) {
-                lcd_window = 0;
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        const sensor_data* sd;
+        while ((sd = sample_bus_next(&_bus, _report_sub)) != nullptr) {
+            // Only the copy is known to be intact, and only once the release confirms it
+            sensor_data copy = *sd;
+            if (sample_bus_release(&_bus, _report_sub)) {
+                alerts_evaluate(&copy);
+                fleet_update_local(&copy);
+                report(copy);
             }
-            ESP_LOGI(TAG, "lcd_window = %d", lcd_window);
         }
+        // A freshly updated image is kept only once it samples and is reachable
+        if (_system->wifi != NULL && _system->wifi->connected) {
+            ota_mark_healthy();
+        }
+        arena_mark_steady();
+    }
+}
+
+void esper_aqm::sampler_task(void* arg)
+{
+    static_cast<esper_aqm*>(arg)->sample();
+    vTaskDelete(NULL);
+}
+
+void esper_aqm::display_task(void* arg)
+{
+    static_cast<esper_aqm*>(arg)->display();
+    vTaskDelete(NULL);
+}
+
+// The LCD only ever shows the newest sample, so a slow refresh skips records rather than
+// holding up the sampler
+void esper_aqm::display()
+{
+    aqm_settings_t st;
+    settings_get(&st);
+    uint32_t gen = settings_generation();
+    int screen = LCD_SCREEN_TEMPERATURE;
+    int64_t usec_last = 0;
+    arena_watch_task("display");
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (settings_generation() != gen) {
+            gen = settings_generation();
+            settings_get(&st);
+        }
+        const sensor_data* sd = sample_bus_latest(&_bus, _display_sub);
+        if (sd == nullptr) {
+            continue;
+        }
+        sensor_data copy = *sd;
+        if (!sample_bus_release(&_bus, _display_sub)) {
+            continue;
+        }
+        lcd_layout_record(&_layout, &copy);
+        if (!(st.lcd_screens & (1 << screen))) {
+            screen = lcd_layout_next_screen(screen, st.lcd_screens);
+        }
+        if (copy.timestamp - usec_last >= (int64_t)st.lcd_window_msec * 1000) {
+            usec_last = copy.timestamp;
+            screen = lcd_layout_next_screen(screen, st.lcd_screens);
+        }
+        update_lcd(copy, screen);
+        arena_mark_steady();
+    }
+}
 
-        double duration = usec_to_sec(system_get_uptime(_system));
-        ESP_LOGI(TAG, "[%lldusec (+%.3fsec)] Reading sensors...", usec_now, duration);
+void esper_aqm::sample()
+{
+    int64_t usec_prev = 0;
+    uint32_t allocs_reported = 0;
+    TickType_t wake = xTaskGetTickCount();
+    arena_watch_task("sampler");
+    while (1) {
+        apply_settings();
 
+        int64_t usec_now = esp_timer_get_time();
+        int wait_msec = _update_rate_msec;
+        if (!sen5x_duty_cycle(usec_now, &wait_msec)) {
+            sleep_msec(wait_msec);
+            wake = xTaskGetTickCount();
+            usec_prev = 0;
+            continue;
+        }
+        if (usec_prev != 0) {
+            task_plan_record_period(usec_now - usec_prev);
+        }
+        usec_prev = usec_now;
+
+        if (health_take_clean_request()) {
+            sen5x_async_cancel(&_sen5x);
+            health_fan_cleaning_started(sen5x_start_fan_cleaning() == 0);
+        }
         read_sensors();
+        _sample.timestamp = usec_now;
+        _sample.interval_msec = sample_rate_update(&_rate, &_sample);
+        task_plan_set_target((int64_t)_sample.interval_msec * 1000);
+        update_aqi();
+        sample_bus_publish(&_bus, &_sample);
+        task_plan_record_busy(esp_timer_get_time() - usec_now);
+        boot_mark_first_sample();
+
+        // The first tick may allocate lazily (driver state, stdio buffers), none after it should
+        arena_mark_steady();
+        uint32_t allocs = arena_steady_allocs();
+        if (allocs != allocs_reported) {
+            ESP_LOGW(TAG, "Sampler made %u heap allocations in steady state", allocs);
+            allocs_reported = arena_steady_allocs();
+        }
+
+        power_record_tick(esp_timer_get_time() - usec_now);
+        vTaskDelayUntil(&wake, pdMS_TO_TICKS(_sample.interval_msec));
+    }
+}
+
+// Live settings are applied on the sampler task, which owns the sample cadence
+void esper_aqm::apply_settings()
+{
+    uint32_t gen = settings_generation();
+    if (gen == _settings_gen) {
+        return;
+    }
+    aqm_settings_t prev = _settings;
+    settings_get(&_settings);
+    _settings_gen = gen;
+
+    if (_settings.sample_rate_msec != prev.sample_rate_msec) {
+        _update_rate_msec = (int)_settings.sample_rate_msec;
+        reset_sample_rate();
+        task_plan_reset_stats((int64_t)_update_rate_msec * 1000);
+        ESP_LOGI(TAG, "Sample rate: %dmsec", _update_rate_msec);
+    }
+    if (_settings.i2c_freq_hz != prev.i2c_freq_hz) {
+        i2c_bus_set_freq_limit(_settings.i2c_freq_hz);
+    }
+    if (_settings.aqi_algorithm != prev.aqi_algorithm) {
+        _aqi->SetAlgorithm((AQI::Algorithm)_settings.aqi_algorithm);
+        ESP_LOGI(TAG, "AQI algorithm: %s", AQI::GetName(_aqi->GetAlgorithm()));
+    }
+}
 
-        if (lcd_window == 0) {
-            lcd_cursor_pos(_lcd, 0, 0);
-            char txt[16];
-            memset(&txt[0], ' ', 16);
-            sprintf(&txt[0], "MCP: %.2fC     ", _data.temperature_mcp9808);
-            lcd_printf(_lcd, &txt[0]);
-            lcd_cursor_pos(_lcd, 0, 1);
-            memset(&txt[0], ' ', 16);
-            sprintf(&txt[0], "SEN: %.2fC     ", _data.ambient_temperature);
-            lcd_printf(_lcd, &txt[0]);
-        } else if (lcd_window == 1) {
-            lcd_cursor_pos(_lcd, 0, 0);
-            char txt[16];
-            memset(&txt[0], ' ', 16);
-            sprintf(&txt[0], "RH: %.2f     ", _data.ambient_humidity);
-            lcd_printf(_lcd, &txt[0]);
-            lcd_cursor_pos(_lcd, 0, 1);
-            memset(&txt[0], ' ', 16);
-            sprintf(&txt[0], "AQI: %d     ", aqi);
-            lcd_printf(_lcd, &txt[0]);
-        } else if (lcd_window == 2) {
-            lcd_cursor_pos(_lcd, 0, 0);
-            char txt[16];
-            memset(&txt[0], ' ', 16);
-            sprintf(&txt[0], "PM10: %.2f     ", _data.mass_concentration_pm10p0);
-            lcd_printf(_lcd, &txt[0]);
-            lcd_cursor_pos(_lcd, 0, 1);
-            memset(&txt[0], ' ', 16);
-            sprintf(&txt[0], "PM2.5: %.1f     ", _data.mass_concentration_pm2p5);
-            lcd_printf(_lcd, &txt[0]);
+// The configured rate is the fastest interval; the adaptive sampler widens it up to the
+// Kconfig maximum, never past the history rollup period so each rollup gets a reading
+void esper_aqm::reset_sample_rate()
+{
+    uint32_t min_msec = (uint32_t)_update_rate_msec;
+#if CONFIG_AQM_SAMPLER_ADAPTIVE
+    uint32_t max_msec = CONFIG_AQM_SAMPLER_MAX_INTERVAL_SEC * 1000;
+    if (max_msec > CONFIG_AQM_HISTORY_ROLLUP_SEC * 1000) {
+        max_msec = CONFIG_AQM_HISTORY_ROLLUP_SEC * 1000;
+    }
+    sample_rate_init(&_rate, min_msec, max_msec, CONFIG_AQM_SAMPLER_CALM_HOLD_SEC * 1000);
+#else
+    sample_rate_init(&_rate, min_msec, min_msec, 0);
+#endif
+}
+
+void esper_aqm::update_aqi()
+{
+    // Averaged in integer space, each reading weighted by the time it stands for, and converted
+    // once for the breakpoint tables
+    AQI::Concentrations avg;
+    for (size_t i = 0; i < AQI::kNumPollutants; i++) {
+        int16_t v = _sample.sample.value[kAqiFields[i]];
+        if (v != SENSOR_NONE) {
+            _aqi_acc[i] += (int64_t)v * _sample.interval_msec;
+            _aqi_weight_msec[i] += _sample.interval_msec;
         }
+        avg[i] = _aqi_weight_msec[i]
+            ? (float)_aqi_acc[i] / (float)_aqi_weight_msec[i] / (float)sensor_scale(kAqiFields[i])
+            : NAN;
+    }
+    AQI::Indices sub;
+    AQI::Pollutant dominant;
+    _sample.aqi = (int16_t)_aqi->GetIndex(avg, &sub, &dominant);
+    memcpy(&_sample.aqi_sub[0], sub.data(), sizeof(_sample.aqi_sub));
+    _sample.aqi_dominant = (uint8_t)dominant;
+    _sample.aqi_algorithm = (uint8_t)_aqi->GetAlgorithm();
+}
 
-        printf("MCP9808 Temp: %.2f °C (%.2f °F)\n", _data.temperature_mcp9808, c_to_f(_data.temperature_mcp9808));
-
-        { // Sensirion readings
-            printf("Mass concentration pm1p0: %.1f µg/m³\n",
-                _data.mass_concentration_pm1p0);
-            printf("Mass concentration pm2p5: %.1f µg/m³\n",
-                _data.mass_concentration_pm2p5);
-            printf("Mass concentration pm4p0: %.1f µg/m³\n",
-                _data.mass_concentration_pm4p0);
-            printf("Mass concentration pm10p0: %.1f µg/m³\n",
-                _data.mass_concentration_pm10p0);
-            printf("Ambient humidity: %.1f %%RH\n",
-                _data.ambient_humidity);
-            printf("Ambient temperature: %.1f °C (%.1f °F)\n",
-                _data.ambient_temperature, c_to_f(_data.ambient_temperature));
-            if (_data.voc_index == 0x7fff) {
-                printf("Voc index: n/a\n");
-            } else {
-                printf("Voc index: %.1f\n", _data.voc_index / 10.0f);
-            }
-            if (_data.nox_index == 0x7fff) {
-                printf("Nox index: n/a\n");
-            } else {
-                printf("Nox index: %.1f\n", _data.nox_index / 10.0f);
-            }
+void esper_aqm::update_lcd(const sensor_data& sd, int screen)
+{
+    char banner[ALERT_EXPR_LEN];
+    if (alerts_get_banner(&banner[0], sizeof(banner))) {
+        // The banner replaces the screen until the alert clears and is redrawn only when it changes
+        if (strcmp(&banner[0], &_lcd_banner[0]) != 0) {
+            strlcpy(&_lcd_banner[0], &banner[0], sizeof(_lcd_banner));
+            display_clear(_display);
+            display_write(_display, 0, 0, "ALERT", 5);
+            display_write(_display, 0, 1, &banner[0], strlen(&banner[0]));
+            display_flush(_display);
+            lcd_layout_invalidate(&_layout);
+        }
+        return;
+    }
+    _lcd_banner[0] = '\0';
+    lcd_layout_show(&_layout, screen);
+    lcd_layout_render(&_layout, &sd);
+}
 
-            acc_pm10 += _data.mass_concentration_pm10p0;
-            acc_pm25 += _data.mass_concentration_pm2p5;
-            num_samples++;
-            avg_pm10 = acc_pm10 / (float)num_samples;
-            avg_pm25 = acc_pm25 / (float)num_samples;
-            float max_pm10 = _aqi->GetMaxConcentration(AQI::Pollutant::PM10);
-            float max_pm25 = _aqi->GetMaxConcentration(AQI::Pollutant::PM25);
-            if (avg_pm10 > max_pm10)
-                avg_pm10 = max_pm10;
-            if (avg_pm25 > max_pm25)
-                avg_pm25 = max_pm25;
-            AQI::Concentrations concentrations;
-            AQI::Concentration pm10;
-            AQI::Concentration pm25;
-            pm10.first = AQI::Pollutant::PM10;
-            pm10.second = avg_pm10;
-            pm25.first = AQI::Pollutant::PM25;
-            pm25.second = avg_pm25;
-            concentrations.push_back(pm10);
-            concentrations.push_back(pm25);
-            aqi = _aqi->GetIndex(concentrations);
-            printf("Air Quality Index: %d\n", aqi);
+void esper_aqm::report(const sensor_data& sd)
+{
+    double duration = usec_to_sec(sd.timestamp - _system->power_on_time);
+    ESP_LOGI(TAG, "[%lldusec (+%.3fsec)] Sensor readings", sd.timestamp, duration);
+
+    const int16_t* v = &sd.sample.value[0];
+    char c[SENSOR_FORMAT_MAX], f[SENSOR_FORMAT_MAX];
+    printf("MCP9808 Temp: %s °C (%s °F)\n",
+        fixed_text(&c[0], SENSOR_TEMPERATURE_MCP9808, v[SENSOR_TEMPERATURE_MCP9808], 2),
+        fixed_text(&f[0], SENSOR_TEMPERATURE_MCP9808, c_to_f(SENSOR_TEMPERATURE_MCP9808, v[SENSOR_TEMPERATURE_MCP9808]), 2));
+
+    { // Sensirion readings
+        static const char* const kPmNames[] = { "pm1p0", "pm2p5", "pm4p0", "pm10p0" };
+        for (int pm = SENSOR_PM1P0; pm <= SENSOR_PM10P0; pm++) {
+            printf("Mass concentration %s: %s µg/m³\n", kPmNames[pm - SENSOR_PM1P0], fixed_text(&c[0], pm, v[pm], 1));
         }
+        printf("Ambient humidity: %s %%RH\n", fixed_text(&c[0], SENSOR_HUMIDITY, v[SENSOR_HUMIDITY], 1));
+        printf("Ambient temperature: %s °C (%s °F)\n",
+            fixed_text(&c[0], SENSOR_TEMPERATURE, v[SENSOR_TEMPERATURE], 1),
+            fixed_text(&f[0], SENSOR_TEMPERATURE, c_to_f(SENSOR_TEMPERATURE, v[SENSOR_TEMPERATURE]), 1));
+        printf("Voc index: %s\n", fixed_text(&c[0], SENSOR_VOC_INDEX, v[SENSOR_VOC_INDEX], 1));
+        printf("Nox index: %s\n", fixed_text(&c[0], SENSOR_NOX_INDEX, v[SENSOR_NOX_INDEX], 1));
+    }
 
-        sleep_msec(_update_rate_msec);
+    printf("Air Quality Index (%s): %d\n", aqi_algorithm_name(sd.aqi_algorithm), sd.aqi);
+}
+
+// Returns true when a SEN5x reading should be taken this tick. In power-save mode the fan and
+// laser are idled between measurement windows, and wait_msec is set to the time until the
+// sensor is next warmed up.
+bool esper_aqm::sen5x_duty_cycle(int64_t usec_now, int* wait_msec)
+{
+#if CONFIG_AQM_POWER_SAVE
+    const int64_t period = CONFIG_AQM_DUTY_CYCLE_PERIOD_SEC * 1000000LL;
+    const int64_t warmup = CONFIG_AQM_DUTY_CYCLE_WARMUP_SEC * 1000000LL;
+    const int64_t window = warmup + (int64_t)CONFIG_AQM_DUTY_CYCLE_SAMPLES * _update_rate_msec * 1000LL;
+    int64_t phase = usec_now % period;
+    bool measure = phase < window;
+
+    if (measure != _sen5x_measuring) {
+        if (measure) {
+            ESP_LOGI(TAG, "SEN5x measurement window start");
+            sen5x_async_cancel(&_sen5x);
+            sen5x_start_measurement();
+            _sen5x_on_usec = usec_now;
+        } else {
+            ESP_LOGI(TAG, "SEN5x idle, avg active time per sample %lldusec, est. avg current %.1fmA",
+                power_avg_active_usec(), power_estimate_avg_current_ma());
+            sen5x_async_cancel(&_sen5x);
+            sen5x_stop_measurement();
+            power_record_sensor_on(usec_now - _sen5x_on_usec);
+        }
+        _sen5x_measuring = measure;
     }
+
+    if (!measure) {
+        *wait_msec = (int)((period - phase) / 1000);
+        return false;
+    }
+    if (phase < warmup) {
+        *wait_msec = (int)((warmup - phase) / 1000);
+        return false;
+    }
+#endif
+    return true;
 }
 
 void esper_aqm::read_sensors()
 {
-    _data.temperature_mcp9808 = 0.0;
-    ESP_ERROR_CHECK(mcp9808_get_temperature(&_mcp, &_data.temperature_mcp9808, NULL, NULL, NULL));
+#if CONFIG_AQM_SAMPLER_OVERLAP_IO
+    read_sensors_overlapped();
+#else
+    read_sensors_blocking();
+#endif
+}
+
+// Reference path through the Sensirion driver, which sleeps out each command delay
+void esper_aqm::read_sensors_blocking()
+{
+    int16_t* v = &_sample.sample.value[0];
+    v[SENSOR_TEMPERATURE_MCP9808] = SENSOR_NONE;
+    if (_mcp != nullptr) {
+        ESP_ERROR_CHECK(temp_mcp9808_read(_mcp, &v[SENSOR_TEMPERATURE_MCP9808]));
+    }
 
     uint32_t sen5x_status = 0;
     int16_t sen5x_err = sen5x_read_device_status(&sen5x_status);
-    if (!sen5x_err && !sen5x_status) {
-        uint16_t mass_concentration_pm1p0 = 0;
-        uint16_t mass_concentration_pm2p5 = 0;
-        uint16_t mass_concentration_pm4p0 = 0;
-        uint16_t mass_concentration_pm10p0 = 0;
-        int16_t  ambient_humidity = 0;
-        int16_t  ambient_temperature = 0;
-        sen5x_err = sen5x_read_measured_values(
-            &mass_concentration_pm1p0, &mass_concentration_pm2p5,
-            &mass_concentration_pm4p0, &mass_concentration_pm10p0,
-            &ambient_humidity, &ambient_temperature, &_data.voc_index, &_data.nox_index);
+    if (sen5x_err != _sample.sen5x_error || sen5x_status != _sample.sen5x_status) {
+        ESP_LOGW(TAG, "Sensirion device status: 0x%08x Error: %d", sen5x_status, sen5x_err);
+    }
+    _sample.sen5x_status = sen5x_status;
+    _sample.sen5x_error = sen5x_err;
+    // Warnings such as fan speed leave the readings usable, errors are decoded by the health task
+    if (!sen5x_err && !(sen5x_status & SEN5X_STATUS_PM_INVALID)) {
+        uint16_t pm[4] = {};
+        sen5x_err = sen5x_read_measured_values(&pm[0], &pm[1], &pm[2], &pm[3],
+            &v[SENSOR_HUMIDITY], &v[SENSOR_TEMPERATURE], &v[SENSOR_VOC_INDEX], &v[SENSOR_NOX_INDEX]);
         if (!sen5x_err) {
-            _data.mass_concentration_pm1p0 = (float)mass_concentration_pm1p0 / 10.0f;
-            _data.mass_concentration_pm2p5 = (float)mass_concentration_pm2p5 / 10.0f;
-            _data.mass_concentration_pm4p0 = (float)mass_concentration_pm4p0 / 10.0f;
-            _data.mass_concentration_pm10p0 = (float)mass_concentration_pm10p0 / 10.0f;
-            _data.ambient_humidity = (float)ambient_humidity / 100.0f;
-            _data.ambient_temperature = (float)ambient_temperature / 200.0f;
+            // Kept in the sensor's own fixed point, SENSOR_SCALE_* converts
+            for (int i = 0; i < 4; i++) {
+                v[SENSOR_PM1P0 + i] = pm_fixed(pm[i]);
+            }
+        } else {
+            _sample.sen5x_error = sen5x_err;
         }
-    } else {
-        ESP_LOGE(TAG, "Sensirion device status error! Status: %d Error: %d", sen5x_status, sen5x_err);
     }
 }
 
-esp_err_t esper_aqm::i2c_init()
+// The SEN5x device status command was sent at the end of the previous tick, so its response is
+// ready on arrival. The measured-values command delay then covers the MCP9808 transfer, and the
+// next status command goes out before returning. One 20ms delay per tick instead of two.
+void esper_aqm::read_sensors_overlapped()
 {
-    i2c_config_t config;
-    memset(&config, 0, sizeof(i2c_config_t));
-    config.mode = I2C_MODE_MASTER;
-    config.sda_io_num = I2C_SDA_GPIO_PIN;
-    config.scl_io_num = I2C_SCL_GPIO_PIN;
-    config.sda_pullup_en = GPIO_PULLUP_ENABLE;
-    config.scl_pullup_en = GPIO_PULLUP_ENABLE;
-    config.master.clk_speed = I2C_FREQ;
+    if (!sen5x_async_pending(&_sen5x, SEN5X_CMD_READ_DEVICE_STATUS)) {
+        sen5x_async_send(&_sen5x, SEN5X_CMD_READ_DEVICE_STATUS);
+    }
+    temp_mcp9808_read_t mcp;
+    if (_mcp != nullptr) {
+        ESP_ERROR_CHECK(temp_mcp9808_read_start(_mcp, &mcp));
+    }
 
-    i2c_enumerate(I2C_NUM_0, &config);
+    uint8_t data[SEN5X_MAX_WORDS * 2];
+    int16_t sen5x_err = sen5x_async_receive(&_sen5x, &data[0], 2);
+    uint32_t sen5x_status = sen5x_err ? 0 : sensirion_common_bytes_to_uint32_t(&data[0]);
+    if (sen5x_err != _sample.sen5x_error || sen5x_status != _sample.sen5x_status) {
+        ESP_LOGW(TAG, "Sensirion device status: 0x%08x Error: %d", sen5x_status, sen5x_err);
+    }
+    _sample.sen5x_status = sen5x_status;
+    _sample.sen5x_error = sen5x_err;
+    bool read_values = !sen5x_err && !(sen5x_status & SEN5X_STATUS_PM_INVALID);
+    if (read_values) {
+        sen5x_err = sen5x_async_send(&_sen5x, SEN5X_CMD_READ_MEASURED_VALUES);
+    }
 
-    ESP_ERROR_CHECK(gpio_set_direction(I2C_SDA_GPIO_PIN, GPIO_MODE_INPUT_OUTPUT_OD));
-    ESP_ERROR_CHECK(gpio_set_direction(I2C_SCL_GPIO_PIN, GPIO_MODE_INPUT_OUTPUT_OD));
-    ESP_ERROR_CHECK(gpio_pullup_en(I2C_SDA_GPIO_PIN));
-    ESP_ERROR_CHECK(gpio_pullup_en(I2C_SCL_GPIO_PIN));
+    _sample.sample.value[SENSOR_TEMPERATURE_MCP9808] = SENSOR_NONE;
+    if (_mcp != nullptr) {
+        ESP_ERROR_CHECK(temp_mcp9808_read_finish(&mcp, &_sample.sample.value[SENSOR_TEMPERATURE_MCP9808]));
+    }
 
-    ESP_LOGI(TAG, "Configured I2C on pins %d (sda) and %d (scl) at frequency %dHz", config.sda_io_num, config.scl_io_num, config.master.clk_speed);
+    if (read_values) {
+        if (!sen5x_err) {
+            sen5x_err = sen5x_async_receive(&_sen5x, &data[0], 8);
+        }
+        if (!sen5x_err) {
+            decode_sen5x_values(&data[0]);
+        } else {
+            _sample.sen5x_error = sen5x_err;
+        }
+    }
+    sen5x_async_send(&_sen5x, SEN5X_CMD_READ_DEVICE_STATUS);
+}
 
-    return ESP_OK;
+// Same layout as sen5x_read_measured_values(), kept in the sensor's fixed point
+void esper_aqm::decode_sen5x_values(const uint8_t* data)
+{
+    int16_t* v = &_sample.sample.value[0];
+    for (int i = 0; i < 4; i++) {
+        v[SENSOR_PM1P0 + i] = pm_fixed(sensirion_common_bytes_to_uint16_t(&data[i * 2]));
+    }
+    v[SENSOR_HUMIDITY] = sensirion_common_bytes_to_int16_t(&data[8]);
+    v[SENSOR_TEMPERATURE] = sensirion_common_bytes_to_int16_t(&data[10]);
+    v[SENSOR_VOC_INDEX] = sensirion_common_bytes_to_int16_t(&data[12]);
+    v[SENSOR_NOX_INDEX] = sensirion_common_bytes_to_int16_t(&data[14]);
 }
 
-void esper_aqm::i2c_enumerate(i2c_port_t port, i2c_config_t* cfg)
+esp_err_t esper_aqm::i2c_init()
 {
-    printf("Enumerating I2C devices...\n");
-    ESP_ERROR_CHECK(i2c_param_config(port, cfg));
-    ESP_ERROR_CHECK(i2c_driver_install(port, cfg->mode, 0, 0, 0));
-    for (uint8_t addr = 0; addr < I2C_MAX_DEVICES; addr++) {
-        i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-        ESP_ERROR_CHECK(i2c_master_start(cmd));
-        ESP_ERROR_CHECK(i2c_master_write_byte(cmd, (addr << 1) | I2C_MASTER_WRITE, true));
-        ESP_ERROR_CHECK(i2c_master_stop(cmd));
-        esp_err_t err = i2c_master_cmd_begin(port, cmd, 10 / portTICK_PERIOD_MS);
-        i2c_cmd_link_delete(cmd);
-        if (err == ESP_OK) {
-            printf("I2C device found at address 0x%02X\n", addr);
-            _i2c_found[addr] = true;
-        }
+    // The bus runs at the fastest clock every attached device supports, capped by the setting
+    esp_err_t err = i2c_bus_init(I2C_NUM_0, _settings.i2c_sda_pin, _settings.i2c_scl_pin, _settings.i2c_freq_hz);
+    if (err != ESP_OK && (_settings.i2c_sda_pin != SETTINGS_DEFAULT_SDA_PIN
+            || _settings.i2c_scl_pin != SETTINGS_DEFAULT_SCL_PIN)) {
+        // Saved pins that do not work must not stop the device from booting and being reconfigured
+        ESP_LOGE(TAG, "I2C on SDA %u, SCL %u failed (%s), using SDA %d, SCL %d", _settings.i2c_sda_pin,
+            _settings.i2c_scl_pin, esp_err_to_name(err), SETTINGS_DEFAULT_SDA_PIN, SETTINGS_DEFAULT_SCL_PIN);
+        err = i2c_bus_init(I2C_NUM_0, SETTINGS_DEFAULT_SDA_PIN, SETTINGS_DEFAULT_SCL_PIN, _settings.i2c_freq_hz);
     }
-    ESP_ERROR_CHECK(i2c_driver_delete(port));
+    if (err != ESP_OK) {
+        return err;
+    }
+    i2c_bus_scan(&_i2c_found[0]);
+    return ESP_OK;
 }
 
 bool esper_aqm::i2c_device_found(uint8_t addr)
@@ -388,7 +748,9 @@ bool esper_aqm::i2c_device_found(uint8_t addr)
 
 extern "C" void app_main(void)
 {
-    auto aqm = new esper_aqm(SENSOR_UPDATE_RATE);
+    void* mem = arena_alloc(sizeof(esper_aqm));
+    ESP_ERROR_CHECK(mem != nullptr ? ESP_OK : ESP_ERR_NO_MEM);
+    auto aqm = new (mem) esper_aqm();
 
     ESP_ERROR_CHECK(aqm->init());
 
@@ -396,7 +758,8 @@ extern "C" void app_main(void)
 
     printf("Esper AQM restart...\n");
     if (aqm != nullptr) {
-        delete aqm;
+        aqm->~esper_aqm();
+        arena_free(aqm);
         aqm = nullptr;
     }
 
@@ -0,0 +1,465 @@
+#include "ota.h"
+#include "task_plan.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_http_client.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "mbedtls/sha256.h"
+#include "sdkconfig.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+static const char* TAG = "aqm-ota";
+
+#define OTA_RESTART_DELAY_USEC 1000000
+#define OTA_RESUME_DELAY_MSEC 1000
+#define OTA_HTTP_TIMEOUT_MSEC 10000
+#define OTA_LOG_INTERVAL_BYTES (64 * 1024)
+#define OTA_VALIDATOR_MAX 96
+
+typedef struct ota_session {
+    esp_ota_handle_t handle;
+    const esp_partition_t* partition;
+    mbedtls_sha256_context sha;
+    uint8_t expected[32];
+    bool has_expected;
+    size_t next_log;
+    // ETag or Last-Modified of the response the written bytes came from, sent as If-Range on resume
+    char validator[OTA_VALIDATOR_MAX];
+    // Validators of the response being received, filled in from its headers
+    char etag[OTA_VALIDATOR_MAX];
+    char last_modified[OTA_VALIDATOR_MAX];
+    // First byte of a 206 body from its Content-Range, -1 without one
+    long range_start;
+} ota_session_t;
+
+static ota_status_t s_status;
+static ota_session_t s_session;
+static uint8_t s_chunk[OTA_CHUNK_SIZE];
+static char s_pull_url[OTA_URL_MAX];
+static esp_timer_handle_t s_health_timer = NULL;
+static esp_timer_handle_t s_restart_timer = NULL;
+
+static bool parse_sha256(const char* hex, uint8_t out[32])
+{
+    if (strlen(hex) != 64) {
+        return false;
+    }
+    for (int i = 0; i < 32; i++) {
+        unsigned int byte;
+        if (sscanf(&hex[i * 2], "%2x", &byte) != 1) {
+            return false;
+        }
+        out[i] = (uint8_t)byte;
+    }
+    return true;
+}
+
+static void update_throughput(void)
+{
+    int64_t now = esp_timer_get_time();
+    double elapsed = (double)(now - s_status.start_usec) / 1000000.0;
+    s_status.end_usec = now;
+    if (elapsed > 0.0) {
+        s_status.kbps = (float)((double)s_status.bytes_written / 1024.0 / elapsed);
+    }
+}
+
+static esp_err_t session_fail(const char* msg, esp_err_t err)
+{
+    ESP_LOGE(TAG, "OTA failed: %s (%s)", msg, esp_err_to_name(err));
+    if (s_session.handle != 0) {
+        esp_ota_abort(s_session.handle);
+        s_session.handle = 0;
+    }
+    mbedtls_sha256_free(&s_session.sha);
+    update_throughput();
+    strlcpy(s_status.error, msg, sizeof(s_status.error));
+    s_status.state = OTA_STATE_FAILED;
+    return err;
+}
+
+static esp_err_t session_open(void)
+{
+    esp_err_t err = esp_ota_begin(s_session.partition, OTA_WITH_SEQUENTIAL_WRITES, &s_session.handle);
+    if (err != ESP_OK) {
+        s_session.handle = 0;
+        return session_fail("esp_ota_begin failed", err);
+    }
+    mbedtls_sha256_init(&s_session.sha);
+    mbedtls_sha256_starts_ret(&s_session.sha, 0);
+    s_status.bytes_written = 0;
+    s_session.next_log = OTA_LOG_INTERVAL_BYTES;
+    s_session.validator[0] = '\0';
+    return ESP_OK;
+}
+
+static void session_reset(size_t image_size)
+{
+    memset(&s_status, 0, sizeof(ota_status_t));
+    memset(&s_session, 0, sizeof(ota_session_t));
+    s_status.state = OTA_STATE_RUNNING;
+    s_status.image_size = image_size;
+    s_status.start_usec = esp_timer_get_time();
+}
+
+static esp_err_t session_begin(size_t image_size, const char* sha256_hex)
+{
+    session_reset(image_size);
+
+    if (sha256_hex != NULL && sha256_hex[0] != '\0') {
+        if (!parse_sha256(sha256_hex, s_session.expected)) {
+            return session_fail("Invalid SHA-256 digest", ESP_ERR_INVALID_ARG);
+        }
+        s_session.has_expected = true;
+    }
+
+    s_session.partition = esp_ota_get_next_update_partition(NULL);
+    if (s_session.partition == NULL) {
+        return session_fail("No inactive OTA partition", ESP_ERR_NOT_FOUND);
+    }
+    if (image_size > s_session.partition->size) {
+        return session_fail("Image larger than OTA partition", ESP_ERR_INVALID_SIZE);
+    }
+    ESP_LOGI(TAG, "Writing image to partition %s at offset 0x%x",
+        s_session.partition->label, s_session.partition->address);
+
+    return session_open();
+}
+
+// The server ignored our Range request or the image changed, so the stream restarts at byte 0
+static esp_err_t session_restart(void)
+{
+    esp_ota_abort(s_session.handle);
+    s_session.handle = 0;
+    mbedtls_sha256_free(&s_session.sha);
+    return session_open();
+}
+
+static esp_err_t session_write(const uint8_t* buf, size_t len)
+{
+    mbedtls_sha256_update_ret(&s_session.sha, buf, len);
+    esp_err_t err = esp_ota_write(s_session.handle, buf, len);
+    if (err != ESP_OK) {
+        return session_fail("Flash write failed", err);
+    }
+    s_status.bytes_written += len;
+    update_throughput();
+    if (s_status.bytes_written >= s_session.next_log) {
+        s_session.next_log += OTA_LOG_INTERVAL_BYTES;
+        ESP_LOGI(TAG, "%u/%u bytes, %.1f KB/s",
+            s_status.bytes_written, s_status.image_size, s_status.kbps);
+    }
+    return ESP_OK;
+}
+
+static void restart_cb(void* arg)
+{
+    esp_restart();
+}
+
+static esp_err_t session_end(void)
+{
+    uint8_t digest[32];
+    mbedtls_sha256_finish_ret(&s_session.sha, digest);
+    mbedtls_sha256_free(&s_session.sha);
+    if (s_session.has_expected && memcmp(digest, s_session.expected, sizeof(digest)) != 0) {
+        return session_fail("SHA-256 mismatch", ESP_ERR_INVALID_CRC);
+    }
+
+    esp_err_t err = esp_ota_end(s_session.handle);
+    s_session.handle = 0;
+    if (err != ESP_OK) {
+        return session_fail("Image validation failed", err);
+    }
+    err = esp_ota_set_boot_partition(s_session.partition);
+    if (err != ESP_OK) {
+        return session_fail("esp_ota_set_boot_partition failed", err);
+    }
+
+    update_throughput();
+    s_status.state = OTA_STATE_SUCCESS;
+    ESP_LOGI(TAG, "OTA complete: %u bytes in %.1fsec (%.1f KB/s), restarting...",
+        s_status.bytes_written, (double)(s_status.end_usec - s_status.start_usec) / 1000000.0, s_status.kbps);
+
+    // Give the HTTP response a moment to go out before rebooting
+    if (s_restart_timer == NULL) {
+        esp_timer_create_args_t args = {
+            .callback = &restart_cb,
+            .name = "ota-restart"
+        };
+        esp_timer_create(&args, &s_restart_timer);
+    }
+    esp_timer_start_once(s_restart_timer, OTA_RESTART_DELAY_USEC);
+
+    return ESP_OK;
+}
+
+esp_err_t ota_push(httpd_req_t* req, const char* sha256_hex)
+{
+    if (s_status.state == OTA_STATE_RUNNING) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (req->content_len == 0) {
+        // Reported as a failed update so the status does not show the previous one's outcome
+        session_reset(0);
+        return session_fail("Empty request body", ESP_ERR_INVALID_ARG);
+    }
+
+    esp_err_t err = session_begin(req->content_len, sha256_hex);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    size_t remaining = req->content_len;
+    while (remaining > 0) {
+        int received = httpd_req_recv(req, (char*)&s_chunk[0], remaining < OTA_CHUNK_SIZE ? remaining : OTA_CHUNK_SIZE);
+        if (received == HTTPD_SOCK_ERR_TIMEOUT) {
+            continue;
+        }
+        if (received <= 0) {
+            return session_fail("Connection closed during upload", ESP_FAIL);
+        }
+        err = session_write(&s_chunk[0], received);
+        if (err != ESP_OK) {
+            return err;
+        }
+        remaining -= received;
+    }
+
+    return session_end();
+}
+
+// A value too long for the buffer is dropped rather than cut, as a cut validator never matches
+static void keep_header(char* dst, const char* value)
+{
+    if (strlcpy(dst, value, OTA_VALIDATOR_MAX) >= OTA_VALIDATOR_MAX) {
+        dst[0] = '\0';
+    }
+}
+
+static esp_err_t pull_event_handler(esp_http_client_event_t* evt)
+{
+    if (evt->event_id == HTTP_EVENT_ON_HEADER) {
+        if (strcasecmp(evt->header_key, "ETag") == 0) {
+            keep_header(s_session.etag, evt->header_value);
+        } else if (strcasecmp(evt->header_key, "Last-Modified") == 0) {
+            keep_header(s_session.last_modified, evt->header_value);
+        } else if (strcasecmp(evt->header_key, "Content-Range") == 0) {
+            long start;
+            s_session.range_start = sscanf(evt->header_value, "bytes %ld-", &start) == 1 ? start : -1;
+        }
+    }
+    return ESP_OK;
+}
+
+// Returns ESP_OK once the whole image has been written. Any other result with the session
+// still running means the transfer was interrupted and can be resumed.
+static esp_err_t pull_once(void)
+{
+    esp_http_client_config_t config = {
+        .url = s_pull_url,
+        .timeout_ms = OTA_HTTP_TIMEOUT_MSEC,
+        .event_handler = pull_event_handler,
+    };
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    if (client == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t err = ESP_OK;
+    size_t offset = s_status.bytes_written;
+    if (offset > 0 && s_session.validator[0] == '\0') {
+        // Without a validator the server cannot tell us the image changed under the written bytes
+        ESP_LOGW(TAG, "Server sent no ETag or Last-Modified, restarting download");
+        err = session_restart();
+        if (err != ESP_OK) {
+            goto cleanup;
+        }
+        offset = 0;
+    }
+    if (offset > 0) {
+        // If-Range makes the server send the whole image (200) instead of the rest if it changed
+        char range[32];
+        snprintf(range, sizeof(range), "bytes=%u-", offset);
+        esp_http_client_set_header(client, "Range", range);
+        esp_http_client_set_header(client, "If-Range", s_session.validator);
+    }
+    s_session.etag[0] = '\0';
+    s_session.last_modified[0] = '\0';
+    s_session.range_start = -1;
+
+    err = esp_http_client_open(client, 0);
+    if (err != ESP_OK) {
+        goto cleanup;
+    }
+
+    int content_length = esp_http_client_fetch_headers(client);
+    int status = esp_http_client_get_status_code(client);
+    if (offset > 0 && status == 200) {
+        ESP_LOGW(TAG, "Image changed or server does not support Range requests, restarting download");
+        err = session_restart();
+        if (err != ESP_OK) {
+            goto cleanup;
+        }
+        offset = 0;
+    } else if (status == 206 && s_session.range_start != (long)offset) {
+        // Appending a body that starts anywhere else would corrupt the image; the next attempt
+        // asks for all of it
+        ESP_LOGW(TAG, "Server sent a range from %ld instead of %u, restarting download", s_session.range_start, offset);
+        err = session_restart();
+        if (err == ESP_OK) {
+            err = ESP_FAIL;
+        }
+        goto cleanup;
+    } else if (status != 200 && status != 206) {
+        char msg[32];
+        snprintf(msg, sizeof(msg), "HTTP status %d", status);
+        err = session_fail(msg, ESP_FAIL);
+        goto cleanup;
+    }
+    if (status == 200) {
+        // The image starts here: take its size and the validator to resume it against.
+        // If-Range only accepts a strong ETag.
+        s_status.image_size = content_length > 0 ? content_length : 0;
+        if (s_session.etag[0] != '\0' && strncmp(s_session.etag, "W/", 2) != 0) {
+            strlcpy(s_session.validator, s_session.etag, sizeof(s_session.validator));
+        } else {
+            strlcpy(s_session.validator, s_session.last_modified, sizeof(s_session.validator));
+        }
+    } else if (s_status.image_size == 0 && content_length > 0) {
+        s_status.image_size = offset + content_length;
+    }
+
+    while (1) {
+        int len = esp_http_client_read(client, (char*)&s_chunk[0], OTA_CHUNK_SIZE);
+        if (len < 0) {
+            err = ESP_FAIL;
+            break;
+        }
+        if (len == 0) {
+            bool complete = s_status.image_size > 0 ? s_status.bytes_written >= s_status.image_size
+                                                    : esp_http_client_is_complete_data_received(client);
+            err = complete ? ESP_OK : ESP_FAIL;
+            break;
+        }
+        err = session_write(&s_chunk[0], len);
+        if (err != ESP_OK) {
+            break;
+        }
+    }
+
+cleanup:
+    esp_http_client_close(client);
+    esp_http_client_cleanup(client);
+    return err;
+}
+
+static void ota_pull_task(void* arg)
+{
+    esp_err_t err = ESP_FAIL;
+    while (s_status.state == OTA_STATE_RUNNING) {
+        err = pull_once();
+        if (err == ESP_OK || s_status.state != OTA_STATE_RUNNING) {
+            break;
+        }
+        if (s_status.resumes >= CONFIG_AQM_OTA_MAX_RESUMES) {
+            session_fail("Too many interrupted downloads", err);
+            break;
+        }
+        s_status.resumes++;
+        ESP_LOGW(TAG, "Download interrupted at %u bytes, resuming (%u/%d)",
+            s_status.bytes_written, s_status.resumes, CONFIG_AQM_OTA_MAX_RESUMES);
+        vTaskDelay(pdMS_TO_TICKS(OTA_RESUME_DELAY_MSEC));
+    }
+
+    if (err == ESP_OK && s_status.state == OTA_STATE_RUNNING) {
+        session_end();
+    }
+    vTaskDelete(NULL);
+}
+
+esp_err_t ota_pull_start(const char* url, const char* sha256_hex)
+{
+    if (url == NULL || strlen(url) >= OTA_URL_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_status.state == OTA_STATE_RUNNING) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    strlcpy(s_pull_url, url, sizeof(s_pull_url));
+    esp_err_t err = session_begin(0, sha256_hex);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    if (xTaskCreatePinnedToCore(&ota_pull_task, "aqm-ota", AQM_STACK_OTA, NULL,
+            AQM_PRIO_OTA, NULL, AQM_CORE_NET) != pdPASS) {
+        return session_fail("Failed to start download task", ESP_ERR_NO_MEM);
+    }
+    return ESP_OK;
+}
+
+static void health_timeout_cb(void* arg)
+{
+    ESP_LOGE(TAG, "Firmware did not report healthy within %ds, rolling back", CONFIG_AQM_OTA_HEALTH_TIMEOUT_SEC);
+    esp_ota_mark_app_invalid_rollback_and_reboot();
+}
+
+esp_err_t ota_init(void)
+{
+    memset(&s_status, 0, sizeof(ota_status_t));
+
+    const esp_partition_t* running = esp_ota_get_running_partition();
+    esp_ota_img_states_t state;
+    if (esp_ota_get_state_partition(running, &state) != ESP_OK || state != ESP_OTA_IMG_PENDING_VERIFY) {
+        return ESP_OK;
+    }
+
+    ESP_LOGW(TAG, "Running new firmware from %s, pending verification for %ds",
+        running->label, CONFIG_AQM_OTA_HEALTH_TIMEOUT_SEC);
+    esp_timer_create_args_t args = {
+        .callback = &health_timeout_cb,
+        .name = "ota-health"
+    };
+    esp_err_t err = esp_timer_create(&args, &s_health_timer);
+    if (err == ESP_OK) {
+        err = esp_timer_start_once(s_health_timer, (uint64_t)CONFIG_AQM_OTA_HEALTH_TIMEOUT_SEC * 1000000ULL);
+    }
+    return err;
+}
+
+void ota_mark_healthy(void)
+{
+    if (s_health_timer == NULL) {
+        return;
+    }
+    esp_timer_stop(s_health_timer);
+    esp_timer_delete(s_health_timer);
+    s_health_timer = NULL;
+    esp_ota_mark_app_valid_cancel_rollback();
+    ESP_LOGI(TAG, "Firmware marked healthy, rollback cancelled");
+}
+
+const ota_status_t* ota_get_status(void)
+{
+    return &s_status;
+}
+
+const char* ota_state_name(enum ota_state state)
+{
+    switch (state) {
+    case OTA_STATE_IDLE: return "idle";
+    case OTA_STATE_RUNNING: return "running";
+    case OTA_STATE_SUCCESS: return "success";
+    case OTA_STATE_FAILED: return "failed";
+    }
+    return "";
+}
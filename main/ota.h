@@ -0,0 +1,51 @@
+#pragma once
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OTA_CHUNK_SIZE 4096
+#define OTA_URL_MAX 256
+
+enum ota_state {
+    OTA_STATE_IDLE,
+    OTA_STATE_RUNNING,
+    OTA_STATE_SUCCESS,
+    OTA_STATE_FAILED
+};
+
+typedef struct ota_status {
+    enum ota_state state;
+    size_t image_size;      // 0 if unknown
+    size_t bytes_written;
+    uint32_t resumes;       // HTTP Range resumptions (pull mode)
+    int64_t start_usec;
+    int64_t end_usec;
+    float kbps;
+    char error[64];
+} ota_status_t;
+
+// Boot-time rollback guard: if the running image is pending verification, roll back unless
+// ota_mark_healthy() is called within CONFIG_AQM_OTA_HEALTH_TIMEOUT_SEC.
+esp_err_t ota_init(void);
+void ota_mark_healthy(void);
+
+// Stream an image from the body of an HTTP request (push mode). ESP_ERR_INVALID_ARG for a
+// malformed digest or an empty body, ESP_ERR_INVALID_SIZE when the image does not fit the slot.
+esp_err_t ota_push(httpd_req_t* req, const char* sha256_hex);
+// Download an image from url in a background task (pull mode)
+esp_err_t ota_pull_start(const char* url, const char* sha256_hex);
+
+const ota_status_t* ota_get_status(void);
+const char* ota_state_name(enum ota_state state);
+
+#ifdef __cplusplus
+}
+#endif
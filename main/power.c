@@ -0,0 +1,93 @@
+#include "power.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_pm.h"
+#include "sdkconfig.h"
+
+#include <string.h>
+
+static const char* TAG = "aqm-power";
+
+// Rough current draw figures used for the average-current estimate. These come from the
+// ESP32-S3 and SEN55 datasheets rather than measurement, so treat the result as a model.
+#define CURRENT_CPU_ACTIVE_MA  40.0f  // CPU running, Wi-Fi in modem sleep
+#define CURRENT_CPU_IDLE_MA    2.0f   // automatic light sleep, averaged over DTIM wake-ups
+#define CURRENT_SEN5X_ON_MA    70.0f  // SEN55 measurement mode (fan + laser)
+#define CURRENT_SEN5X_IDLE_MA  2.6f   // SEN55 idle mode
+
+static power_stats_t s_stats;
+
+esp_err_t power_init(void)
+{
+    memset(&s_stats, 0, sizeof(power_stats_t));
+    s_stats.start_usec = esp_timer_get_time();
+
+#if CONFIG_AQM_POWER_SAVE
+    esp_pm_config_esp32s3_t pm_config = {
+        .max_freq_mhz = CONFIG_AQM_PM_MAX_CPU_FREQ_MHZ,
+        .min_freq_mhz = CONFIG_AQM_PM_MIN_CPU_FREQ_MHZ,
+        .light_sleep_enable = true
+    };
+    esp_err_t err = esp_pm_configure(&pm_config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "esp_pm_configure failed: %s", esp_err_to_name(err));
+        return err;
+    }
+    ESP_LOGI(TAG, "Power save enabled: DFS %d-%dMHz, automatic light sleep",
+        CONFIG_AQM_PM_MIN_CPU_FREQ_MHZ, CONFIG_AQM_PM_MAX_CPU_FREQ_MHZ);
+#endif
+
+    return ESP_OK;
+}
+
+bool power_save_enabled(void)
+{
+#if CONFIG_AQM_POWER_SAVE
+    return true;
+#else
+    return false;
+#endif
+}
+
+void power_record_tick(int64_t active_usec)
+{
+    s_stats.num_samples++;
+    s_stats.active_usec += active_usec;
+    s_stats.last_tick_usec = active_usec;
+}
+
+void power_record_sensor_on(int64_t usec)
+{
+    s_stats.sensor_on_usec += usec;
+}
+
+const power_stats_t* power_get_stats(void)
+{
+    return &s_stats;
+}
+
+int64_t power_avg_active_usec(void)
+{
+    if (s_stats.num_samples == 0) {
+        return 0;
+    }
+    return s_stats.active_usec / s_stats.num_samples;
+}
+
+float power_estimate_avg_current_ma(void)
+{
+    int64_t elapsed = esp_timer_get_time() - s_stats.start_usec;
+    if (elapsed <= 0) {
+        return 0.0f;
+    }
+    float cpu_duty = (float)s_stats.active_usec / (float)elapsed;
+    float sen_duty = (float)s_stats.sensor_on_usec / (float)elapsed;
+    if (!power_save_enabled()) {
+        // Without light sleep the CPU never drops below its active draw, and the SEN5x never idles
+        cpu_duty = 1.0f;
+        sen_duty = 1.0f;
+    }
+    return CURRENT_CPU_ACTIVE_MA * cpu_duty + CURRENT_CPU_IDLE_MA * (1.0f - cpu_duty)
+         + CURRENT_SEN5X_ON_MA * sen_duty + CURRENT_SEN5X_IDLE_MA * (1.0f - sen_duty);
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "esp_err.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct power_stats {
+    uint32_t num_samples;
+    int64_t active_usec;        // time spent processing sample ticks
+    int64_t sensor_on_usec;     // time the SEN5x fan/laser were running
+    int64_t last_tick_usec;     // active time of the most recent tick
+    int64_t start_usec;
+} power_stats_t;
+
+esp_err_t power_init(void);
+bool power_save_enabled(void);
+void power_record_tick(int64_t active_usec);
+void power_record_sensor_on(int64_t usec);
+const power_stats_t* power_get_stats(void);
+int64_t power_avg_active_usec(void);
+float power_estimate_avg_current_ma(void);
+
+#ifdef __cplusplus
+}
+#endif
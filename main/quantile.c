@@ -0,0 +1,275 @@
+#include "quantile.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t next_random(quantile_sketch_t* sk)
+{
+    // xorshift32, the coin flips only need to be unbiased
+    uint32_t x = sk->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    sk->rng = x;
+    return x;
+}
+
+static uint16_t level_cap(int h, int num_levels)
+{
+    uint32_t cap = QUANTILE_K;
+    for (int d = num_levels - 1 - h; d > 0; d--) {
+        cap = cap * 2 / 3;
+    }
+    return cap < QUANTILE_MIN_LEVEL_CAP ? QUANTILE_MIN_LEVEL_CAP : (uint16_t)cap;
+}
+
+// New levels go on top, the front of the buffer, so no items move
+static void set_num_levels(quantile_sketch_t* sk, int num_levels)
+{
+    for (int h = sk->num_levels; h < num_levels; h++) {
+        sk->size[h] = 0;
+    }
+    sk->num_levels = (uint16_t)num_levels;
+    uint32_t capacity = 0;
+    for (int h = 0; h < num_levels; h++) {
+        capacity += level_cap(h, num_levels);
+    }
+    sk->capacity = (uint16_t)capacity;
+}
+
+static uint32_t level_offset(const quantile_sketch_t* sk, int h)
+{
+    uint32_t off = 0;
+    for (int l = sk->num_levels - 1; l > h; l--) {
+        off += sk->size[l];
+    }
+    return off;
+}
+
+static int compare_int16(const void* a, const void* b)
+{
+    return *(const int16_t*)a - *(const int16_t*)b;
+}
+
+// Halves level h into level h + 1. An odd item out, the smallest, stays behind.
+static void compact_level(quantile_sketch_t* sk, int h)
+{
+    if (h + 1 == sk->num_levels && sk->num_levels < QUANTILE_MAX_LEVELS) {
+        set_num_levels(sk, sk->num_levels + 1);
+    }
+    uint32_t off = level_offset(sk, h);
+    uint32_t s = sk->size[h];
+    int16_t* level = &sk->items[off];
+    if (h == 0) {
+        qsort(level, s, sizeof(int16_t), compare_int16);
+    }
+    uint32_t odd = s & 1;
+    uint32_t half = s / 2;
+    uint32_t flip = next_random(sk) & 1;
+    int16_t kept = level[0];
+    int16_t promoted[QUANTILE_CAPACITY / 2];
+    for (uint32_t i = 0; i < half; i++) {
+        promoted[i] = level[odd + 2 * i + flip];
+    }
+    uint32_t tail = sk->used - (off + s);
+
+    if (h + 1 == sk->num_levels) {
+        // Top of a sketch at full depth: the survivors stay here and the level loses half its
+        // weight. Only reached past 2^15 * K values.
+        memcpy(&level[odd], &promoted[0], half * sizeof(int16_t));
+        memmove(&level[odd + half], &level[s], tail * sizeof(int16_t));
+        sk->size[h] = (uint16_t)(odd + half);
+        sk->used -= half;
+        return;
+    }
+
+    // Merged from the back into the space of level h + 1, which sits right before level h
+    uint32_t s1 = sk->size[h + 1];
+    int16_t* upper = level - s1;
+    int32_t i = (int32_t)half - 1;
+    int32_t j = (int32_t)s1 - 1;
+    int32_t o = (int32_t)(s1 + half) - 1;
+    while (i >= 0) {
+        if (j >= 0 && upper[j] > promoted[i]) {
+            upper[o--] = upper[j--];
+        } else {
+            upper[o--] = promoted[i--];
+        }
+    }
+    if (odd) {
+        upper[s1 + half] = kept;
+    }
+    memmove(&upper[s1 + half + odd], &level[s], tail * sizeof(int16_t));
+    sk->size[h + 1] += (uint16_t)half;
+    sk->size[h] = (uint16_t)odd;
+    sk->used -= half;
+}
+
+// Makes room for one item by compacting the lowest level that is at its capacity
+static void make_room(quantile_sketch_t* sk)
+{
+    if (sk->used < sk->capacity) {
+        return;
+    }
+    for (int h = 0; h < sk->num_levels; h++) {
+        if (sk->size[h] >= level_cap(h, sk->num_levels)) {
+            compact_level(sk, h);
+            return;
+        }
+    }
+}
+
+static void append_level0(quantile_sketch_t* sk, int16_t value)
+{
+    make_room(sk);
+    sk->items[sk->used++] = value;
+    sk->size[0]++;
+}
+
+static void insert_sorted(quantile_sketch_t* sk, int h, int16_t value)
+{
+    make_room(sk);
+    uint32_t lo = level_offset(sk, h);
+    uint32_t hi = lo + sk->size[h];
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (sk->items[mid] <= value) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    memmove(&sk->items[lo + 1], &sk->items[lo], (sk->used - lo) * sizeof(int16_t));
+    sk->items[lo] = value;
+    sk->size[h]++;
+    sk->used++;
+}
+
+static void update_range(quantile_sketch_t* sk, int16_t min, int16_t max, uint32_t n)
+{
+    if (sk->n == 0 || min < sk->min) {
+        sk->min = min;
+    }
+    if (sk->n == 0 || max > sk->max) {
+        sk->max = max;
+    }
+    sk->n += n;
+}
+
+void quantile_init(quantile_sketch_t* sk, uint32_t seed)
+{
+    sk->n = 0;
+    sk->min = 0;
+    sk->max = 0;
+    sk->rng = seed != 0 ? seed : 1;
+    sk->used = 0;
+    sk->num_levels = 0;
+    set_num_levels(sk, 1);
+}
+
+void quantile_add(quantile_sketch_t* sk, int16_t value)
+{
+    append_level0(sk, value);
+    update_range(sk, value, value, 1);
+}
+
+void quantile_merge(quantile_sketch_t* dst, const quantile_sketch_t* src)
+{
+    if (src->n == 0) {
+        return;
+    }
+    if (src->num_levels > dst->num_levels) {
+        set_num_levels(dst, src->num_levels);
+    }
+    uint32_t off = 0;
+    for (int h = src->num_levels - 1; h >= 0; h--) {
+        for (uint32_t i = 0; i < src->size[h]; i++) {
+            if (h == 0) {
+                append_level0(dst, src->items[off + i]);
+            } else {
+                insert_sorted(dst, h, src->items[off + i]);
+            }
+        }
+        off += src->size[h];
+    }
+    update_range(dst, src->min, src->max, src->n);
+}
+
+// Total weight of the items at or below value
+static uint64_t rank_of(const quantile_sketch_t* sk, int16_t value)
+{
+    uint64_t rank = 0;
+    uint32_t off = 0;
+    for (int h = sk->num_levels - 1; h >= 0; h--) {
+        const int16_t* level = &sk->items[off];
+        uint32_t count = 0;
+        if (h == 0) {
+            for (uint32_t i = 0; i < sk->size[0]; i++) {
+                count += level[i] <= value;
+            }
+        } else {
+            uint32_t hi = sk->size[h];
+            while (count < hi) {
+                uint32_t mid = count + (hi - count) / 2;
+                if (level[mid] <= value) {
+                    count = mid + 1;
+                } else {
+                    hi = mid;
+                }
+            }
+        }
+        rank += (uint64_t)count << h;
+        off += sk->size[h];
+    }
+    return rank;
+}
+
+static uint64_t total_weight(const quantile_sketch_t* sk)
+{
+    uint64_t weight = 0;
+    for (int h = 0; h < sk->num_levels; h++) {
+        weight += (uint64_t)sk->size[h] << h;
+    }
+    return weight;
+}
+
+bool quantile_get(const quantile_sketch_t* const* sk, int num, float q, int16_t* out)
+{
+    uint64_t weight = 0;
+    int32_t lo = INT16_MAX;
+    int32_t hi = INT16_MIN;
+    for (int i = 0; i < num; i++) {
+        if (sk[i]->n == 0) {
+            continue;
+        }
+        weight += total_weight(sk[i]);
+        lo = sk[i]->min < lo ? sk[i]->min : lo;
+        hi = sk[i]->max > hi ? sk[i]->max : hi;
+    }
+    if (weight == 0) {
+        return false;
+    }
+    if (q <= 0.0f || q >= 1.0f) {
+        *out = (int16_t)(q <= 0.0f ? lo : hi);
+        return true;
+    }
+
+    uint64_t target = (uint64_t)ceil((double)q * (double)weight);
+    target = target < 1 ? 1 : target;
+    // The rank only steps at item values, so the smallest value reaching the target is an item
+    while (lo < hi) {
+        int32_t mid = lo + (hi - lo) / 2;
+        uint64_t rank = 0;
+        for (int i = 0; i < num; i++) {
+            rank += sk[i]->n > 0 ? rank_of(sk[i], (int16_t)mid) : 0;
+        }
+        if (rank >= target) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    *out = (int16_t)lo;
+    return true;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Accuracy parameter: the top level holds K items and a quantile's rank error is about 1.7/K
+// of the count. Overridable for the host benchmark.
+#ifndef QUANTILE_K
+#define QUANTILE_K 128
+#endif
+#define QUANTILE_MIN_LEVEL_CAP 8
+#define QUANTILE_MAX_LEVELS 16      // enough for 2^15 * K items without losing weight
+// The level capacities shrink by 2/3 per level below the top, never below the minimum
+#define QUANTILE_CAPACITY (3 * QUANTILE_K + QUANTILE_MIN_LEVEL_CAP * QUANTILE_MAX_LEVELS)
+
+// Streaming quantile sketch over int16 values (KLL, Karnin, Lang and Liberty 2016) in fixed
+// memory. Level h holds items of weight 2^h. When the buffer is full the lowest level over its
+// capacity is sorted and every other item, starting at a random offset, is promoted to the level
+// above. Sketches of the same K merge into one that answers for the union of their inputs.
+typedef struct quantile_sketch {
+    uint32_t n;                             // values added, including merged sketches
+    int16_t min;                            // exact, valid when n > 0
+    int16_t max;
+    uint32_t rng;
+    uint16_t used;                          // items held
+    uint16_t capacity;                      // items held before a compaction, for num_levels
+    uint16_t num_levels;
+    uint16_t size[QUANTILE_MAX_LEVELS];     // items per level
+    int16_t items[QUANTILE_CAPACITY];       // top level first, level 0 last; levels above 0 are sorted
+} quantile_sketch_t;
+
+void quantile_init(quantile_sketch_t* sk, uint32_t seed);
+void quantile_add(quantile_sketch_t* sk, int16_t value);
+// Adds src's items to dst at their weights and compacts dst as needed
+void quantile_merge(quantile_sketch_t* dst, const quantile_sketch_t* src);
+// The value at rank q (0..1) of the union of num sketches, without merging them: the smallest
+// value with at least ceil(q * n) values at or below it. False if the sketches are empty.
+bool quantile_get(const quantile_sketch_t* const* sk, int num, float q, int16_t* out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,125 @@
+#include "sample_bus.h"
+
+#include <string.h>
+
+#define MASK (SAMPLE_BUS_CAPACITY - 1)
+#define READ_RETRIES 3
+
+_Static_assert((SAMPLE_BUS_CAPACITY & MASK) == 0, "SAMPLE_BUS_CAPACITY must be a power of two");
+
+void sample_bus_init(sample_bus_t* bus)
+{
+    memset(bus, 0, sizeof(sample_bus_t));
+}
+
+sample_sub_t* sample_bus_subscribe(sample_bus_t* bus, const char* name, TaskHandle_t task)
+{
+    uint32_t n = __atomic_load_n(&bus->num_subs, __ATOMIC_RELAXED);
+    if (n == SAMPLE_BUS_MAX_SUBS) {
+        return NULL;
+    }
+    sample_sub_t* sub = &bus->subs[n];
+    memset(sub, 0, sizeof(sample_sub_t));
+    sub->name = name;
+    sub->task = task;
+    sub->cursor = __atomic_load_n(&bus->head, __ATOMIC_ACQUIRE) + 1;
+    __atomic_store_n(&bus->num_subs, n + 1, __ATOMIC_RELEASE);
+    return sub;
+}
+
+void sample_bus_publish(sample_bus_t* bus, const struct sensor_data* sd)
+{
+    uint32_t seq = bus->head + 1;
+    sample_record_t* rec = &bus->ring[seq & MASK];
+    __atomic_store_n(&rec->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(&rec->data, sd, sizeof(struct sensor_data));
+    __atomic_store_n(&rec->seq, seq, __ATOMIC_RELEASE);
+    __atomic_store_n(&bus->head, seq, __ATOMIC_RELEASE);
+
+    uint32_t n = __atomic_load_n(&bus->num_subs, __ATOMIC_ACQUIRE);
+    for (uint32_t i = 0; i < n; i++) {
+        if (bus->subs[i].task != NULL) {
+            xTaskNotifyGive(bus->subs[i].task);
+        }
+    }
+}
+
+static const struct sensor_data* read_at(sample_bus_t* bus, sample_sub_t* sub, uint32_t head)
+{
+    // The slot after head may already be under rewrite, so a lapped reader lands one past it
+    if (head - sub->cursor >= SAMPLE_BUS_CAPACITY - 1) {
+        uint32_t oldest = head - SAMPLE_BUS_CAPACITY + 2;
+        sub->skipped += oldest - sub->cursor;
+        sub->cursor = oldest;
+    }
+    const sample_record_t* rec = &bus->ring[sub->cursor & MASK];
+    if (__atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE) != sub->cursor) {
+        // Lapped between the head check and here, fall back to the newest record
+        sub->skipped += head - sub->cursor;
+        sub->cursor = head;
+        rec = &bus->ring[head & MASK];
+        if (__atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE) != head) {
+            return NULL;
+        }
+    }
+    return &rec->data;
+}
+
+const struct sensor_data* sample_bus_next(sample_bus_t* bus, sample_sub_t* sub)
+{
+    uint32_t head = __atomic_load_n(&bus->head, __ATOMIC_ACQUIRE);
+    if ((int32_t)(head - sub->cursor) < 0) {
+        return NULL;
+    }
+    return read_at(bus, sub, head);
+}
+
+const struct sensor_data* sample_bus_latest(sample_bus_t* bus, sample_sub_t* sub)
+{
+    uint32_t head = __atomic_load_n(&bus->head, __ATOMIC_ACQUIRE);
+    if ((int32_t)(head - sub->cursor) < 0) {
+        return NULL;
+    }
+    sub->skipped += head - sub->cursor;
+    sub->cursor = head;
+    return read_at(bus, sub, head);
+}
+
+bool sample_bus_release(sample_bus_t* bus, sample_sub_t* sub)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    bool intact = __atomic_load_n(&bus->ring[sub->cursor & MASK].seq, __ATOMIC_RELAXED) == sub->cursor;
+    if (intact) {
+        sub->delivered++;
+    } else {
+        sub->torn++;
+    }
+    sub->cursor++;
+    return intact;
+}
+
+bool sample_bus_read_latest(const sample_bus_t* bus, struct sensor_data* out)
+{
+    for (int i = 0; i < READ_RETRIES; i++) {
+        uint32_t head = __atomic_load_n(&bus->head, __ATOMIC_ACQUIRE);
+        if (head == 0) {
+            return false;
+        }
+        const sample_record_t* rec = &bus->ring[head & MASK];
+        if (__atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE) != head) {
+            continue;
+        }
+        memcpy(out, &rec->data, sizeof(struct sensor_data));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&rec->seq, __ATOMIC_RELAXED) == head) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t sample_bus_published(const sample_bus_t* bus)
+{
+    return __atomic_load_n(&bus->head, __ATOMIC_ACQUIRE);
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "sensor_data.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SAMPLE_BUS_CAPACITY 16  // power of two
+#define SAMPLE_BUS_MAX_SUBS 16
+
+// Broadcast ring of sample records. One producer publishes; any number of subscribers follow it
+// through their own cursor. The producer never waits: a subscriber that falls more than a ring
+// behind skips ahead to the oldest record still intact. Sequence numbers start at 1, a slot's seq
+// is 0 while it is being rewritten.
+//
+// Because the producer may overwrite a slot at any time, a subscriber copies each record out and
+// uses the copy only if sample_bus_release() confirms the slot was not rewritten meanwhile:
+//
+//     while ((sd = sample_bus_next(bus, sub)) != NULL) {
+//         struct sensor_data copy = *sd;
+//         if (sample_bus_release(bus, sub)) {
+//             ... use copy ...
+//         }
+//     }
+//
+// Records were meant to be handed out by reference, but reading in place could see a torn record
+// halfway through the work; copying costs one 56-byte struct per consumer per sample instead.
+typedef struct sample_record {
+    uint32_t seq;
+    struct sensor_data data;
+} sample_record_t;
+
+typedef struct sample_sub {
+    const char* name;
+    TaskHandle_t task;      // notified on every publish, may be NULL
+    uint32_t cursor;        // next sequence number to read, owned by the subscriber
+    uint32_t delivered;
+    uint32_t skipped;       // records the subscriber was lapped on
+    uint32_t torn;          // records overwritten while the subscriber held them
+} sample_sub_t;
+
+typedef struct sample_bus {
+    sample_record_t ring[SAMPLE_BUS_CAPACITY];
+    uint32_t head;          // sequence number of the newest record, 0 before the first publish
+    sample_sub_t subs[SAMPLE_BUS_MAX_SUBS];
+    uint32_t num_subs;
+} sample_bus_t;
+
+void sample_bus_init(sample_bus_t* bus);
+// Subscribers start at the next record published. Subscribe before the producer starts, or at
+// least from a single task; subscriptions cannot be removed.
+sample_sub_t* sample_bus_subscribe(sample_bus_t* bus, const char* name, TaskHandle_t task);
+// Producer only: copies the sample into the next slot and notifies the subscribers
+void sample_bus_publish(sample_bus_t* bus, const struct sensor_data* sd);
+
+// The oldest unread record, or NULL when the subscriber is caught up. The pointer is only good
+// for copying the record out before sample_bus_release(), never for reading it while working.
+const struct sensor_data* sample_bus_next(sample_bus_t* bus, sample_sub_t* sub);
+// Like sample_bus_next() but skips any backlog, for consumers that only show the current state
+const struct sensor_data* sample_bus_latest(sample_bus_t* bus, sample_sub_t* sub);
+// Ends the read started by sample_bus_next() or sample_bus_latest(). Returns false if the
+// producer rewrote the slot meanwhile; the copy is then torn and must be discarded.
+bool sample_bus_release(sample_bus_t* bus, sample_sub_t* sub);
+
+// Copies the newest record, for readers without a subscription such as request handlers
+bool sample_bus_read_latest(const sample_bus_t* bus, struct sensor_data* out);
+uint32_t sample_bus_published(const sample_bus_t* bus);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,107 @@
+#include "sample_rate.h"
+
+#include <math.h>
+#include <string.h>
+
+#define TAU_FAST_SEC 5.0f
+#define TAU_SLOW_SEC 30.0f
+#define CALM_FRACTION 0.5f          // of the thresholds, below which the interval may widen
+
+typedef struct sample_rate_driver {
+    uint8_t field;
+    float deviation;                // standard deviation that counts as busy, fixed point
+    float rate;                     // change per minute that counts as busy, fixed point
+} sample_rate_driver_t;
+
+// About twice the SEN5x readout noise, and changes a person would notice within minutes
+static const sample_rate_driver_t s_drivers[SAMPLE_RATE_NUM_DRIVERS] = {
+    { SENSOR_PM2P5, 20.0f, 30.0f },         // 2 µg/m³, 3 µg/m³ per minute
+    { SENSOR_VOC_INDEX, 50.0f, 100.0f },    // 5, 10 per minute
+    { SENSOR_NOX_INDEX, 20.0f, 50.0f },     // 2, 5 per minute
+    { SENSOR_HUMIDITY, 50.0f, 100.0f },     // 0.5 %RH, 1 %RH per minute
+};
+
+void sample_rate_init(sample_rate_t* sr, uint32_t min_msec, uint32_t max_msec, uint32_t hold_msec)
+{
+    memset(sr, 0, sizeof(sample_rate_t));
+    sr->min_msec = min_msec;
+    sr->max_msec = max_msec < min_msec ? min_msec : max_msec;
+    sr->hold_msec = hold_msec;
+    sr->interval_msec = min_msec;
+}
+
+// Activity of one driver: its deviation or rate against the thresholds, 1 or more is busy
+static float driver_update(sample_rate_t* sr, int i, int16_t value, float dt_sec)
+{
+    const sample_rate_driver_t* drv = &s_drivers[i];
+    float x = (float)value;
+    if (!sr->primed[i]) {
+        sr->fast[i] = x;
+        sr->slow[i] = x;
+        sr->var[i] = 0.0f;
+        sr->primed[i] = true;
+        return 0.0f;
+    }
+    float a_fast = 1.0f - expf(-dt_sec / TAU_FAST_SEC);
+    float a_slow = 1.0f - expf(-dt_sec / TAU_SLOW_SEC);
+    float d = x - sr->fast[i];
+    sr->fast[i] += a_fast * d;
+    sr->var[i] = (1.0f - a_fast) * (sr->var[i] + a_fast * d * d);
+    sr->slow[i] += a_slow * (x - sr->slow[i]);
+
+    // A ramp of r per second leaves the means r * tau behind it
+    float rate = (sr->fast[i] - sr->slow[i]) * 60.0f / (TAU_SLOW_SEC - TAU_FAST_SEC);
+    float deviation = sqrtf(sr->var[i]);
+    return fmaxf(deviation / drv->deviation, fabsf(rate) / drv->rate);
+}
+
+uint32_t sample_rate_update(sample_rate_t* sr, const struct sensor_data* sd)
+{
+    float dt_sec = sr->last_usec != 0 ? (float)(sd->timestamp - sr->last_usec) / 1e6f : 0.0f;
+    sr->last_usec = sd->timestamp;
+    if (sr->changed_usec == 0) {
+        sr->changed_usec = sd->timestamp;
+    }
+
+    float activity = 0.0f;
+    if (sd->sen5x_error == 0) {
+        for (int i = 0; i < SAMPLE_RATE_NUM_DRIVERS; i++) {
+            int16_t v = sd->sample.value[s_drivers[i].field];
+            if (v != SENSOR_NONE) {
+                activity = fmaxf(activity, driver_update(sr, i, v, dt_sec));
+            }
+        }
+    }
+    sr->activity = activity;
+
+    if (activity >= 1.0f) {
+        if (sr->interval_msec != sr->min_msec) {
+            sr->interval_msec = sr->min_msec;
+            sr->stats.tightened++;
+        }
+        sr->changed_usec = sd->timestamp;
+    } else if (activity >= CALM_FRACTION) {
+        sr->changed_usec = sd->timestamp;
+    } else if (sr->interval_msec < sr->max_msec
+        && sd->timestamp - sr->changed_usec >= (int64_t)sr->hold_msec * 1000) {
+        uint32_t next = sr->interval_msec * 2;
+        sr->interval_msec = next < sr->max_msec ? next : sr->max_msec;
+        sr->changed_usec = sd->timestamp;
+        sr->stats.widened++;
+    }
+
+    sr->stats.samples++;
+    sr->stats.sampled_msec += sr->interval_msec;
+    if (sr->interval_msec == sr->min_msec) {
+        sr->stats.fastest_msec += sr->interval_msec;
+    }
+    return sr->interval_msec;
+}
+
+float sample_rate_per_hour(const sample_rate_t* sr)
+{
+    if (sr->stats.sampled_msec == 0) {
+        return 0.0f;
+    }
+    return (float)sr->stats.samples * 3600000.0f / (float)sr->stats.sampled_msec;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "sensor_data.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SAMPLE_RATE_NUM_DRIVERS 4
+
+typedef struct sample_rate_stats {
+    uint32_t samples;
+    uint32_t tightened;             // switches back to the fastest interval
+    uint32_t widened;
+    uint64_t sampled_msec;          // time covered by the samples
+    uint64_t fastest_msec;          // of which at the fastest interval
+} sample_rate_stats_t;
+
+// Adaptive sampling interval. PM2.5, VOC, NOx and humidity each drive it through two
+// exponentially weighted means, a fast one with its variance and a slow one; their time constants
+// are in seconds, so irregular intervals filter the same as regular ones. The gap between the two
+// means gives the rate of change. A driver is busy when its standard deviation or rate of change
+// crosses the driver's threshold, and the interval then drops straight to the fastest one. Once
+// every driver has stayed under half its thresholds for the hold time the interval doubles, up to
+// the slowest one, and doubles again after each further hold.
+typedef struct sample_rate {
+    uint32_t min_msec;
+    uint32_t max_msec;
+    uint32_t hold_msec;
+    uint32_t interval_msec;         // until the next sample
+    int64_t last_usec;              // timestamp of the previous sample, 0 before the first
+    int64_t changed_usec;           // last change of the interval or the last busy sample
+    float fast[SAMPLE_RATE_NUM_DRIVERS];    // fixed-point units
+    float slow[SAMPLE_RATE_NUM_DRIVERS];
+    float var[SAMPLE_RATE_NUM_DRIVERS];     // around the fast mean
+    bool primed[SAMPLE_RATE_NUM_DRIVERS];   // the driver has had a reading
+    float activity;                 // largest deviation or rate against its threshold, last sample
+    sample_rate_stats_t stats;
+} sample_rate_t;
+
+// Fixed-rate mode when min_msec == max_msec
+void sample_rate_init(sample_rate_t* sr, uint32_t min_msec, uint32_t max_msec, uint32_t hold_msec);
+// Feeds the sample and returns the interval until the next one
+uint32_t sample_rate_update(sample_rate_t* sr, const struct sensor_data* sd);
+// Samples per hour over everything fed so far
+float sample_rate_per_hour(const sample_rate_t* sr);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,92 @@
+#include "sen5x_async.h"
+#include "sensirion_common.h"
+#include "sensirion_i2c.h"
+#include "utils.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include <string.h>
+
+static const char* TAG = "aqm-sen5x-async";
+
+#define SEN5X_BUS_ERROR -1      // what the HAL reports for a failed transfer
+
+// Runs on the bus worker: the delay counts from the end of the command write, not from
+// whenever the caller gets around to collecting it
+static void command_sent(i2c_bus_req_t* req, esp_err_t result, void* arg)
+{
+    sen5x_async_t* s = arg;
+    s->ready_usec = esp_timer_get_time() + SEN5X_CMD_DELAY_USEC;
+}
+
+void sen5x_async_init(sen5x_async_t* s, i2c_bus_dev_t* dev)
+{
+    memset(s, 0, sizeof(sen5x_async_t));
+    s->dev = dev;
+}
+
+int16_t sen5x_async_send(sen5x_async_t* s, uint16_t cmd)
+{
+    if (s->dev == NULL) {
+        return SEN5X_BUS_ERROR;
+    }
+    // A response that was never collected is simply dropped by the sensor
+    i2c_bus_wait(&s->req);
+    s->cmd_buf[0] = cmd >> 8;
+    s->cmd_buf[1] = cmd & 0xff;
+    s->ready_usec = INT64_MAX;
+    if (i2c_bus_write_async(s->dev, &s->req, &s->cmd_buf[0], 2, &command_sent, s) != ESP_OK) {
+        s->cmd = 0;
+        return SEN5X_BUS_ERROR;
+    }
+    s->cmd = cmd;
+    return NO_ERROR;
+}
+
+bool sen5x_async_pending(const sen5x_async_t* s, uint16_t cmd)
+{
+    return s->cmd != 0 && s->cmd == cmd;
+}
+
+void sen5x_async_cancel(sen5x_async_t* s)
+{
+    i2c_bus_wait(&s->req);
+    s->cmd = 0;
+}
+
+int16_t sen5x_async_receive(sen5x_async_t* s, uint8_t* data, uint16_t num_words)
+{
+    if (s->cmd == 0 || num_words > SEN5X_MAX_WORDS) {
+        return SEN5X_BUS_ERROR;
+    }
+    uint16_t cmd = s->cmd;
+    s->cmd = 0;
+    if (i2c_bus_wait(&s->req) != ESP_OK) {
+        ESP_LOGD(TAG, "Command 0x%04X not sent", cmd);
+        return SEN5X_BUS_ERROR;
+    }
+    int64_t remaining = s->ready_usec - esp_timer_get_time();
+    if (remaining > 0) {
+        sleep_usec((unsigned int)remaining);
+    }
+
+    uint16_t len = num_words * 3;
+    esp_err_t err = i2c_bus_read_async(s->dev, &s->req, &s->rx_buf[0], len, NULL, NULL);
+    if (err == ESP_OK) {
+        err = i2c_bus_wait(&s->req);
+    }
+    if (err != ESP_OK) {
+        return SEN5X_BUS_ERROR;
+    }
+    for (uint16_t i = 0; i < num_words; i++) {
+        const uint8_t* word = &s->rx_buf[i * 3];
+        if (sensirion_i2c_check_crc(word, 2, word[2]) != NO_ERROR) {
+            ESP_LOGD(TAG, "CRC error in response to 0x%04X", cmd);
+            return CRC_ERROR;
+        }
+        data[i * 2] = word[0];
+        data[i * 2 + 1] = word[1];
+    }
+    return NO_ERROR;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "i2c_bus.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SEN5X_CMD_READ_MEASURED_VALUES 0x03C4
+#define SEN5X_CMD_READ_DEVICE_STATUS 0xD206
+#define SEN5X_CMD_DELAY_USEC 20000      // command to response, for both reads above
+#define SEN5X_MAX_WORDS 8
+
+// SEN5x read commands split in two, so the sensor's command delay can overlap other work.
+// The Sensirion driver sleeps through that delay with the bus idle and the caller blocked;
+// here the command is queued and the response is collected later. The sensor keeps a response
+// until the next command, so any command sent through the blocking driver in between must be
+// followed by sen5x_async_cancel().
+typedef struct sen5x_async {
+    i2c_bus_dev_t* dev;
+    i2c_bus_req_t req;
+    uint16_t cmd;           // command whose response is outstanding, 0 if none
+    int64_t ready_usec;     // the response can be read from then on, set once the command is on the wire
+    uint8_t cmd_buf[2];
+    uint8_t rx_buf[SEN5X_MAX_WORDS * 3];
+} sen5x_async_t;
+
+void sen5x_async_init(sen5x_async_t* s, i2c_bus_dev_t* dev);
+// Queues the command and returns without waiting for the bus or the sensor
+int16_t sen5x_async_send(sen5x_async_t* s, uint16_t cmd);
+bool sen5x_async_pending(const sen5x_async_t* s, uint16_t cmd);
+void sen5x_async_cancel(sen5x_async_t* s);
+// Waits out what is left of the command delay, then reads and CRC-checks num_words words into
+// data (2 bytes each, big-endian as sent). Returns 0 or a Sensirion driver error code.
+int16_t sen5x_async_receive(sen5x_async_t* s, uint8_t* data, uint16_t num_words);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,49 @@
+#include "sensirion_i2c_hal.h"
+#include "sensirion_common.h"
+#include "i2c_bus.h"
+#include "utils.h"
+
+#include "esp_log.h"
+
+static const char* TAG = "aqm-sensirion-hal";
+
+// Sensirion HAL implementation on top of the shared bus manager. The bus owns the port and
+// its configuration, so init/free have nothing to do.
+
+int16_t sensirion_i2c_hal_select_bus(uint8_t bus_idx)
+{
+    return bus_idx == 0 ? NO_ERROR : NOT_IMPLEMENTED_ERROR;
+}
+
+void sensirion_i2c_hal_init(void)
+{
+}
+
+void sensirion_i2c_hal_free(void)
+{
+}
+
+int8_t sensirion_i2c_hal_read(uint8_t address, uint8_t* data, uint16_t count)
+{
+    i2c_bus_dev_t* dev = i2c_bus_find_device(address);
+    if (dev == NULL) {
+        ESP_LOGE(TAG, "Device 0x%02X not attached to the bus", address);
+        return -1;
+    }
+    return i2c_bus_read(dev, data, count) == ESP_OK ? NO_ERROR : -1;
+}
+
+int8_t sensirion_i2c_hal_write(uint8_t address, const uint8_t* data, uint16_t count)
+{
+    i2c_bus_dev_t* dev = i2c_bus_find_device(address);
+    if (dev == NULL) {
+        ESP_LOGE(TAG, "Device 0x%02X not attached to the bus", address);
+        return -1;
+    }
+    return i2c_bus_write(dev, data, count) == ESP_OK ? NO_ERROR : -1;
+}
+
+void sensirion_i2c_hal_sleep_usec(uint32_t useconds)
+{
+    sleep_usec(useconds);
+}
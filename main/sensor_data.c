@@ -0,0 +1,90 @@
+#include "sensor_data.h"
+
+#include <math.h>
+#include <string.h>
+
+static const int32_t s_pow10[] = { 1, 10, 100, 1000, 10000 };
+
+#define MAX_DECIMALS ((int)(sizeof(s_pow10) / sizeof(s_pow10[0])) - 1)
+
+float sensor_to_float(int field, int16_t value)
+{
+    if (value == SENSOR_NONE) {
+        return NAN;
+    }
+    return (float)value / (float)sensor_scale(field);
+}
+
+int16_t sensor_from_float(int field, float value)
+{
+    if (isnan(value)) {
+        return SENSOR_NONE;
+    }
+    float v = roundf(value * (float)sensor_scale(field));
+    if (v >= (float)(SENSOR_NONE - 1)) {
+        return SENSOR_NONE - 1;
+    }
+    if (v <= (float)INT16_MIN) {
+        return INT16_MIN;
+    }
+    return (int16_t)v;
+}
+
+int32_t sensor_rescale(int field, int16_t value, int decimals)
+{
+    if (decimals > MAX_DECIMALS) {
+        decimals = MAX_DECIMALS;
+    }
+    // 4 decimals keep INT16_MAX * 10^4 inside int32
+    int32_t scale = sensor_scale(field);
+    int32_t num = (int32_t)value * s_pow10[decimals];
+    return num >= 0 ? (num + scale / 2) / scale : (num - scale / 2) / scale;
+}
+
+size_t sensor_format_decimals(char* buf, size_t size, int field, int16_t value, int decimals)
+{
+    char tmp[SENSOR_FORMAT_MAX];
+    size_t n = 0;
+    if (value == SENSOR_NONE) {
+        memcpy(&tmp[0], "null", 4);
+        n = 4;
+    } else {
+        if (decimals > MAX_DECIMALS) {
+            decimals = MAX_DECIMALS;
+        }
+        int32_t v = sensor_rescale(field, value, decimals);
+        uint32_t mag = v < 0 ? (uint32_t)-v : (uint32_t)v;
+        // Digits least significant first, reversed below
+        for (int d = 0; d < decimals; d++) {
+            tmp[n++] = (char)('0' + mag % 10);
+            mag /= 10;
+        }
+        if (decimals > 0) {
+            tmp[n++] = '.';
+        }
+        do {
+            tmp[n++] = (char)('0' + mag % 10);
+            mag /= 10;
+        } while (mag > 0);
+        if (v < 0) {
+            tmp[n++] = '-';
+        }
+        for (size_t i = 0; i < n / 2; i++) {
+            char c = tmp[i];
+            tmp[i] = tmp[n - 1 - i];
+            tmp[n - 1 - i] = c;
+        }
+    }
+    if (size == 0) {
+        return n;
+    }
+    size_t len = n < size ? n : size - 1;
+    memcpy(buf, &tmp[0], len);
+    buf[len] = '\0';
+    return len;
+}
+
+size_t sensor_format(char* buf, size_t size, int field, int16_t value)
+{
+    return sensor_format_decimals(buf, size, field, value, sensor_decimals(field));
+}
@@ -1,28 +1,116 @@
 #pragma once
 
+#include "aqi.h"
+
+#include <stddef.h>
 #include <stdint.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Measurements stay in the sensors' own fixed-point units from the I2C read to the text output:
+// the value divided by the field's scale is the reading in engineering units. Filters, rollups
+// and the history store work on these integers; only AQI and alert thresholds convert to float.
+enum sensor_field {
+    SENSOR_TEMPERATURE_MCP9808,     // celsius
+    SENSOR_PM1P0,                   // µg/m³
+    SENSOR_PM2P5,
+    SENSOR_PM4P0,
+    SENSOR_PM10P0,
+    SENSOR_HUMIDITY,                // %RH
+    SENSOR_TEMPERATURE,             // celsius, SEN5x
+    SENSOR_VOC_INDEX,
+    SENSOR_NOX_INDEX,
+    SENSOR_NUM_FIELDS
+};
+
+#define SENSOR_SCALE_MCP9808 16         // MCP9808 register, 1/16 degree steps
+#define SENSOR_SCALE_PM 10              // SEN5x mass concentration
+#define SENSOR_SCALE_HUMIDITY 100       // SEN5x relative humidity
+#define SENSOR_SCALE_TEMPERATURE 200    // SEN5x ambient temperature
+#define SENSOR_SCALE_INDEX 10           // SEN5x VOC and NOx index
+#define SENSOR_NONE INT16_MAX           // no reading, also what the SEN5x sends for "unknown"
+#define SENSOR_FORMAT_MAX 12            // longest sensor_format() output with its terminator
+
+typedef struct sensor_sample {
+    int16_t value[SENSOR_NUM_FIELDS];
+} sensor_sample_t;
+
 struct sensor_data {
-    float    temperature_mcp9808;       // MCP9808 temperature in celsius
-    float    mass_concentration_pm1p0;  // PM1.0
-    float    mass_concentration_pm2p5;  // PM2.5
-    float    mass_concentration_pm4p0;  // PM4.0
-    float    mass_concentration_pm10p0; // PM10.0
-    float    ambient_humidity;          // SEN55 ambient humidity
-    float    ambient_temperature;       // SEN55 ambient temp in celsius
-    int16_t  voc_index;                 // SEN55 VOC index (volatile organic chemicals)
-    int16_t  nox_index;                 // SEN55 NOX index
+    int64_t  timestamp;                 // esp_timer time of the reading in usec
+    uint32_t interval_msec;             // until the next reading, the time this one stands for
+    sensor_sample_t sample;             // fixed-point readings, SENSOR_NONE where missing
+    int16_t  aqi;                       // overall AQI for the selected algorithm
+    int16_t  aqi_sub[AQI_NUM_POLLUTANTS]; // per-pollutant sub-indices, AQI_INVALID if unsupported
+    uint8_t  aqi_dominant;              // pollutant with the highest sub-index
+    uint8_t  aqi_algorithm;             // algorithm used to compute aqi
+    uint32_t sen5x_status;              // SEN5x device status register, SEN5X_STATUS_* in health.h
+    int16_t  sen5x_error;               // error reading the SEN5x, 0 if none
 };
 
+static inline int32_t sensor_scale(int field)
+{
+    switch (field) {
+    case SENSOR_TEMPERATURE_MCP9808: return SENSOR_SCALE_MCP9808;
+    case SENSOR_HUMIDITY: return SENSOR_SCALE_HUMIDITY;
+    case SENSOR_TEMPERATURE: return SENSOR_SCALE_TEMPERATURE;
+    case SENSOR_VOC_INDEX:
+    case SENSOR_NOX_INDEX: return SENSOR_SCALE_INDEX;
+    default: return SENSOR_SCALE_PM;
+    }
+}
+
+// Decimal places that show the field's full resolution exactly
+static inline int sensor_decimals(int field)
+{
+    switch (field) {
+    case SENSOR_TEMPERATURE_MCP9808: return 4;
+    case SENSOR_HUMIDITY: return 2;
+    case SENSOR_TEMPERATURE: return 3;
+    default: return 1;
+    }
+}
+
+// Mean of sum over n readings, rounded half away from zero, SENSOR_NONE if n is 0
+static inline int16_t sensor_mean(int64_t sum, uint32_t n)
+{
+    if (n == 0) {
+        return SENSOR_NONE;
+    }
+    int64_t half = (int64_t)(n / 2);
+    return (int16_t)(sum >= 0 ? (sum + half) / (int64_t)n : (sum - half) / (int64_t)n);
+}
+
 static inline void sensor_data_init(struct sensor_data* sd)
 {
-    sd->temperature_mcp9808 = 0.0f;
-    sd->mass_concentration_pm1p0 = 0.0f;
-    sd->mass_concentration_pm2p5 = 0.0f;
-    sd->mass_concentration_pm4p0 = 0.0f;
-    sd->mass_concentration_pm10p0 = 0.0f;
-    sd->ambient_humidity = 0.0f;
-    sd->ambient_temperature = 0.0f;
-    sd->voc_index = 0;
-    sd->nox_index = 0;
+    sd->timestamp = 0;
+    sd->interval_msec = 0;
+    for (int f = 0; f < SENSOR_NUM_FIELDS; f++) {
+        sd->sample.value[f] = SENSOR_NONE;
+    }
+    sd->aqi = AQI_INVALID;
+    for (int i = 0; i < AQI_NUM_POLLUTANTS; i++) {
+        sd->aqi_sub[i] = AQI_INVALID;
+    }
+    sd->aqi_dominant = 0;
+    sd->aqi_algorithm = 0;
+    sd->sen5x_status = 0;
+    sd->sen5x_error = 0;
+}
+
+// NAN for SENSOR_NONE
+float sensor_to_float(int field, int16_t value);
+// Nearest fixed-point value, SENSOR_NONE for NAN, saturated to the int16 range
+int16_t sensor_from_float(int field, float value);
+// value in units of 10^-decimals, rounded half away from zero, for fixed-width displays
+int32_t sensor_rescale(int field, int16_t value, int decimals);
+// Writes the reading as decimal text with sensor_decimals() places ("null" for SENSOR_NONE)
+// without going through float. Returns the length, size should be SENSOR_FORMAT_MAX.
+size_t sensor_format(char* buf, size_t size, int field, int16_t value);
+// Same, with the given number of decimal places
+size_t sensor_format_decimals(char* buf, size_t size, int field, int16_t value, int decimals);
+
+#ifdef __cplusplus
 }
+#endif
@@ -0,0 +1,343 @@
+#include "settings.h"
+#include "aqi.h"
+#include "lcd_layout.h"
+#include "wifi_credential.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "driver/gpio.h"
+#include "esp_log.h"
+#include "nvs.h"
+
+#include "cJSON.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static const char* TAG = "aqm-settings";
+
+#define SETTINGS_NVS_NAMESPACE "aqm"
+#define SETTINGS_NVS_KEY "settings"
+
+#define FIELD(key, type, member, min, max, flags) \
+    { key, type, offsetof(aqm_settings_t, member), sizeof(((aqm_settings_t*)0)->member), min, max, flags, NULL, NULL }
+#define ENUM_FIELD(key, member, max, flags, to_name, from_name) \
+    { key, SETTINGS_TYPE_ENUM, offsetof(aqm_settings_t, member), sizeof(((aqm_settings_t*)0)->member), 0, max, flags, to_name, from_name }
+
+static const settings_field_t s_fields[] = {
+    FIELD("sample_rate_msec", SETTINGS_TYPE_U32, sample_rate_msec, 100, 3600000, SETTINGS_FLAG_LIVE),
+    FIELD("i2c_freq_hz", SETTINGS_TYPE_U32, i2c_freq_hz, 10000, 400000, SETTINGS_FLAG_LIVE),
+    FIELD("i2c_sda_pin", SETTINGS_TYPE_U8, i2c_sda_pin, 0, 48, 0),
+    FIELD("i2c_scl_pin", SETTINGS_TYPE_U8, i2c_scl_pin, 0, 48, 0),
+    FIELD("lcd_screens", SETTINGS_TYPE_U8, lcd_screens, 1, LCD_SCREENS_ALL, SETTINGS_FLAG_LIVE),
+    FIELD("lcd_window_msec", SETTINGS_TYPE_U32, lcd_window_msec, 500, 600000, SETTINGS_FLAG_LIVE),
+    ENUM_FIELD("aqi_algorithm", aqi_algorithm, AQI_NUM_ALGORITHMS - 1, SETTINGS_FLAG_LIVE, aqi_algorithm_name, aqi_algorithm_from_name),
+    FIELD("wifi_ssid", SETTINGS_TYPE_STR, wifi_ssid, 1, 31, 0),
+    FIELD("wifi_pass", SETTINGS_TYPE_STR, wifi_pass, 0, 63, SETTINGS_FLAG_SECRET),
+};
+#define NUM_FIELDS (sizeof(s_fields) / sizeof(s_fields[0]))
+
+static aqm_settings_t s_settings;
+static uint32_t s_generation = 0;
+static SemaphoreHandle_t s_lock = NULL;
+static StaticSemaphore_t s_lock_buf;
+
+static void settings_defaults(aqm_settings_t* st)
+{
+    memset(st, 0, sizeof(aqm_settings_t));
+    st->version = SETTINGS_BLOB_VERSION;
+    st->sample_rate_msec = 1000;
+    st->i2c_freq_hz = 400000;  // upper limit, the bus runs at what the attached devices support
+    st->i2c_sda_pin = SETTINGS_DEFAULT_SDA_PIN;
+    st->i2c_scl_pin = SETTINGS_DEFAULT_SCL_PIN;
+    st->lcd_screens = LCD_SCREENS_ALL;
+    st->lcd_window_msec = 5000;
+    st->aqi_algorithm = 0;
+    strlcpy(&st->wifi_ssid[0], WIFI_SSID, sizeof(st->wifi_ssid));
+    strlcpy(&st->wifi_pass[0], WIFI_PASS, sizeof(st->wifi_pass));
+}
+
+static esp_err_t settings_save(const aqm_settings_t* st)
+{
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(SETTINGS_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_set_blob(nvs, SETTINGS_NVS_KEY, st, sizeof(aqm_settings_t));
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    return err;
+}
+
+esp_err_t settings_init(void)
+{
+    if (s_lock == NULL) {
+        s_lock = xSemaphoreCreateMutexStatic(&s_lock_buf);
+    }
+
+    settings_defaults(&s_settings);
+
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(SETTINGS_NVS_NAMESPACE, NVS_READONLY, &nvs);
+    if (err == ESP_OK) {
+        aqm_settings_t stored;
+        size_t size = sizeof(aqm_settings_t);
+        err = nvs_get_blob(nvs, SETTINGS_NVS_KEY, &stored, &size);
+        nvs_close(nvs);
+        // Version 1 stored a count of LCD windows where lcd_screens is now, the layout is otherwise unchanged
+        if (err == ESP_OK && size == sizeof(aqm_settings_t) && stored.version == 1) {
+            stored.version = SETTINGS_BLOB_VERSION;
+            stored.lcd_screens = (uint8_t)((1 << stored.lcd_screens) - 1) & LCD_SCREENS_ALL;
+            if (stored.lcd_screens == 0) {
+                stored.lcd_screens = LCD_SCREENS_ALL;
+            }
+        }
+        if (err == ESP_OK && size == sizeof(aqm_settings_t) && stored.version == SETTINGS_BLOB_VERSION) {
+            memcpy(&s_settings, &stored, sizeof(aqm_settings_t));
+            ESP_LOGI(TAG, "Loaded settings from NVS");
+            return ESP_OK;
+        }
+    }
+
+    ESP_LOGI(TAG, "Using default settings");
+    return ESP_OK;
+}
+
+void settings_get(aqm_settings_t* out)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    memcpy(out, &s_settings, sizeof(aqm_settings_t));
+    xSemaphoreGive(s_lock);
+}
+
+uint32_t settings_generation(void)
+{
+    return __atomic_load_n(&s_generation, __ATOMIC_ACQUIRE);
+}
+
+const settings_field_t* settings_fields(size_t* count)
+{
+    *count = NUM_FIELDS;
+    return &s_fields[0];
+}
+
+static int32_t field_get_int(const aqm_settings_t* st, const settings_field_t* f)
+{
+    const uint8_t* p = (const uint8_t*)st + f->offset;
+    if (f->type == SETTINGS_TYPE_U32) {
+        return (int32_t)*(const uint32_t*)p;
+    }
+    return *p;
+}
+
+static void field_set_int(aqm_settings_t* st, const settings_field_t* f, int32_t value)
+{
+    uint8_t* p = (uint8_t*)st + f->offset;
+    if (f->type == SETTINGS_TYPE_U32) {
+        *(uint32_t*)p = (uint32_t)value;
+    } else {
+        *p = (uint8_t)value;
+    }
+}
+
+static const char* type_name(enum settings_type type)
+{
+    switch (type) {
+    case SETTINGS_TYPE_U8:
+    case SETTINGS_TYPE_U32: return "integer";
+    case SETTINGS_TYPE_STR: return "string";
+    case SETTINGS_TYPE_ENUM: return "enum";
+    }
+    return "";
+}
+
+void settings_to_json(struct cJSON* root, bool with_schema)
+{
+    aqm_settings_t st;
+    settings_get(&st);
+
+    cJSON* values = cJSON_AddObjectToObject(root, "settings");
+    cJSON* schema = with_schema ? cJSON_AddObjectToObject(root, "schema") : NULL;
+    for (size_t i = 0; i < NUM_FIELDS; i++) {
+        const settings_field_t* f = &s_fields[i];
+        if (!(f->flags & SETTINGS_FLAG_SECRET)) {
+            switch (f->type) {
+            case SETTINGS_TYPE_U8:
+            case SETTINGS_TYPE_U32:
+                cJSON_AddNumberToObject(values, f->key, field_get_int(&st, f));
+                break;
+            case SETTINGS_TYPE_STR:
+                cJSON_AddStringToObject(values, f->key, (const char*)&st + f->offset);
+                break;
+            case SETTINGS_TYPE_ENUM:
+                cJSON_AddStringToObject(values, f->key, f->enum_name(field_get_int(&st, f)));
+                break;
+            }
+        }
+
+        if (schema != NULL) {
+            cJSON* entry = cJSON_AddObjectToObject(schema, f->key);
+            cJSON_AddStringToObject(entry, "type", type_name(f->type));
+            if (f->type == SETTINGS_TYPE_ENUM) {
+                cJSON* names = cJSON_AddArrayToObject(entry, "values");
+                for (int v = f->min; v <= f->max; v++) {
+                    cJSON_AddItemToArray(names, cJSON_CreateString(f->enum_name(v)));
+                }
+            } else {
+                cJSON_AddNumberToObject(entry, f->type == SETTINGS_TYPE_STR ? "min_length" : "min", f->min);
+                cJSON_AddNumberToObject(entry, f->type == SETTINGS_TYPE_STR ? "max_length" : "max", f->max);
+            }
+            cJSON_AddBoolToObject(entry, "live", f->flags & SETTINGS_FLAG_LIVE);
+        }
+    }
+}
+
+static const settings_field_t* find_field(const char* key)
+{
+    for (size_t i = 0; i < NUM_FIELDS; i++) {
+        if (strcmp(s_fields[i].key, key) == 0) {
+            return &s_fields[i];
+        }
+    }
+    return NULL;
+}
+
+static bool parse_field(aqm_settings_t* st, const settings_field_t* f, const cJSON* item, char* err, size_t err_size)
+{
+    switch (f->type) {
+    case SETTINGS_TYPE_U8:
+    case SETTINGS_TYPE_U32: {
+        if (!cJSON_IsNumber(item) || item->valuedouble != (double)item->valueint) {
+            snprintf(err, err_size, "%s: expected an integer", f->key);
+            return false;
+        }
+        if (item->valueint < f->min || item->valueint > f->max) {
+            snprintf(err, err_size, "%s: must be in [%d, %d]", f->key, f->min, f->max);
+            return false;
+        }
+        field_set_int(st, f, item->valueint);
+        return true;
+    }
+    case SETTINGS_TYPE_STR: {
+        if (!cJSON_IsString(item)) {
+            snprintf(err, err_size, "%s: expected a string", f->key);
+            return false;
+        }
+        size_t len = strlen(item->valuestring);
+        if (len < (size_t)f->min || len > (size_t)f->max) {
+            snprintf(err, err_size, "%s: length must be in [%d, %d]", f->key, f->min, f->max);
+            return false;
+        }
+        char* dst = (char*)st + f->offset;
+        memset(dst, 0, f->size);
+        memcpy(dst, item->valuestring, len);
+        return true;
+    }
+    case SETTINGS_TYPE_ENUM: {
+        int value = cJSON_IsString(item) ? f->enum_from_name(item->valuestring) : -1;
+        if (value < f->min || value > f->max) {
+            snprintf(err, err_size, "%s: unknown value", f->key);
+            return false;
+        }
+        field_set_int(st, f, value);
+        return true;
+    }
+    }
+    return false;
+}
+
+// I2C needs output-capable pins. The SPI flash pins (26-32) and the strapping pins (0, 3, 45, 46)
+// are refused too, as driving them can stop the chip from booting.
+static bool i2c_pin_usable(int pin)
+{
+    if (!GPIO_IS_VALID_OUTPUT_GPIO(pin)) {
+        return false;
+    }
+    if (pin >= 26 && pin <= 32) {
+        return false;
+    }
+    return pin != 0 && pin != 3 && pin != 45 && pin != 46;
+}
+
+// Checks that involve more than one field, run before anything is committed
+static bool validate(const aqm_settings_t* st, char* err, size_t err_size)
+{
+    if (!i2c_pin_usable(st->i2c_sda_pin)) {
+        snprintf(err, err_size, "i2c_sda_pin: GPIO%u cannot be used for I2C", st->i2c_sda_pin);
+        return false;
+    }
+    if (!i2c_pin_usable(st->i2c_scl_pin)) {
+        snprintf(err, err_size, "i2c_scl_pin: GPIO%u cannot be used for I2C", st->i2c_scl_pin);
+        return false;
+    }
+    if (st->i2c_sda_pin == st->i2c_scl_pin) {
+        snprintf(err, err_size, "i2c_sda_pin and i2c_scl_pin must differ");
+        return false;
+    }
+    return true;
+}
+
+// Saved before it is published, so a failed NVS write leaves the live settings untouched. The lock
+// is held across the write so two commits cannot land in NVS and in RAM in different orders.
+static esp_err_t settings_commit(const aqm_settings_t* st)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    esp_err_t err = settings_save(st);
+    if (err == ESP_OK) {
+        memcpy(&s_settings, st, sizeof(aqm_settings_t));
+    }
+    xSemaphoreGive(s_lock);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to save settings: %s", esp_err_to_name(err));
+        return err;
+    }
+    __atomic_add_fetch(&s_generation, 1, __ATOMIC_RELEASE);
+    return ESP_OK;
+}
+
+esp_err_t settings_update_json(const struct cJSON* root, bool* reboot_required, char* err, size_t err_size)
+{
+    if (!cJSON_IsObject(root)) {
+        snprintf(err, err_size, "expected a JSON object");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    aqm_settings_t st;
+    settings_get(&st);
+    *reboot_required = false;
+
+    // Validate everything against a copy first so a bad field leaves the settings untouched
+    const cJSON* item = NULL;
+    cJSON_ArrayForEach(item, root) {
+        const settings_field_t* f = find_field(item->string);
+        if (f == NULL) {
+            snprintf(err, err_size, "%s: unknown setting", item->string);
+            return ESP_ERR_INVALID_ARG;
+        }
+        if (!parse_field(&st, f, item, err, err_size)) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        if (!(f->flags & SETTINGS_FLAG_LIVE)) {
+            *reboot_required = true;
+        }
+    }
+    if (!validate(&st, err, err_size)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    return settings_commit(&st);
+}
+
+esp_err_t settings_set_aqi_algorithm(int algo)
+{
+    if (algo < 0 || algo >= AQI_NUM_ALGORITHMS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    aqm_settings_t st;
+    settings_get(&st);
+    st.aqi_algorithm = (uint8_t)algo;
+    return settings_commit(&st);
+}
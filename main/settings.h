@@ -0,0 +1,69 @@
+#pragma once
+
+#include "esp_err.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SETTINGS_BLOB_VERSION 2
+#define SETTINGS_DEFAULT_SDA_PIN 18
+#define SETTINGS_DEFAULT_SCL_PIN 17
+
+// Runtime configuration, persisted to NVS as a single blob
+typedef struct aqm_settings {
+    uint32_t version;
+    uint32_t sample_rate_msec;
+    uint32_t i2c_freq_hz;
+    uint8_t  i2c_sda_pin;
+    uint8_t  i2c_scl_pin;
+    uint8_t  lcd_screens;    // bit per enum lcd_screen_id, rotated in order
+    uint8_t  aqi_algorithm;
+    uint32_t lcd_window_msec;
+    char     wifi_ssid[32];
+    char     wifi_pass[64];
+} aqm_settings_t;
+
+enum settings_type {
+    SETTINGS_TYPE_U8,
+    SETTINGS_TYPE_U32,
+    SETTINGS_TYPE_STR,
+    SETTINGS_TYPE_ENUM,     // stored as uint8_t, exchanged as a name
+};
+
+#define SETTINGS_FLAG_LIVE      0x01    // applied without a reboot
+#define SETTINGS_FLAG_SECRET    0x02    // write-only, never reported
+
+typedef struct settings_field {
+    const char* key;
+    enum settings_type type;
+    uint16_t offset;
+    uint16_t size;
+    int32_t min;
+    int32_t max;
+    uint8_t flags;
+    const char* (*enum_name)(int value);
+    int (*enum_from_name)(const char* name);
+} settings_field_t;
+
+struct cJSON;
+
+esp_err_t settings_init(void);
+void settings_get(aqm_settings_t* out);
+uint32_t settings_generation(void);
+const settings_field_t* settings_fields(size_t* count);
+
+// Serialize current values (and the schema, if requested) into a JSON object
+void settings_to_json(struct cJSON* root, bool with_schema);
+// Validate and apply a partial update. On failure nothing is changed and err holds the reason.
+// reboot_required is set if any changed field only takes effect after a restart.
+esp_err_t settings_update_json(const struct cJSON* root, bool* reboot_required, char* err, size_t err_size);
+esp_err_t settings_set_aqi_algorithm(int algo);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,364 @@
+#include "stats.h"
+#include "alert_rules.h"
+#include "health.h"
+#include "quantile.h"
+#include "sample_bus.h"
+#include "task_plan.h"
+#include "utils.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "cJSON.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static const char* TAG = "aqm-stats";
+
+#define SEC_PER_HOUR 3600
+#define SEC_PER_DAY 86400
+#define WEIGHT_MSEC 1000            // sketch weight of a sample per this much time it stands for
+
+// Quantiles kept for completed windows
+static const float s_summary_q[] = { 0.5f, 0.9f, 0.95f, 0.99f };
+#define NUM_SUMMARY_Q (sizeof(s_summary_q) / sizeof(s_summary_q[0]))
+
+static const char* s_window_names[STATS_NUM_WINDOWS] = {
+    [STATS_WINDOW_HOUR] = "hour",
+    [STATS_WINDOW_DAY] = "day",
+};
+
+typedef struct stats_summary {
+    uint32_t start;                 // unix time the window began
+    uint32_t n;
+    int16_t min;                    // fixed point, SENSOR_NONE without samples
+    int16_t max;
+    int16_t mean;
+    int16_t q[NUM_SUMMARY_Q];
+} stats_summary_t;
+
+// Samples are weighted by the time they stand for, so the sketch's n and the sum are in
+// WEIGHT_MSEC units while samples counts readings.
+typedef struct stats_acc {
+    quantile_sketch_t sketch;
+    int64_t sum;
+    uint32_t samples;
+} stats_acc_t;
+
+// Samples only go into the hour's sketch. A closed hour is merged into the day, and the day in
+// progress is queried as the union of both.
+typedef struct stats_field {
+    stats_acc_t hour;
+    stats_acc_t day;
+    stats_summary_t hours[STATS_HOURS_KEPT];    // rings, newest at hour_next - 1
+    stats_summary_t days[STATS_DAYS_KEPT];
+} stats_field_t;
+
+static struct {
+    uint32_t hour_start;            // 0 until the first sample
+    uint32_t day_start;
+    uint32_t hours_kept;
+    uint32_t days_kept;
+    uint32_t hour_next;
+    uint32_t day_next;
+    stats_info_t info;
+    stats_field_t field[SENSOR_NUM_FIELDS];
+} s_stats;
+
+static sample_bus_t* s_bus = NULL;
+static sample_sub_t* s_sub = NULL;
+static SemaphoreHandle_t s_lock = NULL;
+static StaticSemaphore_t s_lock_buf;
+
+static void acc_reset(stats_acc_t* acc, uint32_t seed)
+{
+    quantile_init(&acc->sketch, seed);
+    acc->sum = 0;
+    acc->samples = 0;
+}
+
+static void summarize(const quantile_sketch_t* const* sk, int num, int64_t sum, uint32_t samples,
+    uint32_t start, stats_summary_t* out)
+{
+    out->start = start;
+    out->n = samples;
+    uint32_t weight = 0;
+    for (int i = 0; i < num; i++) {
+        weight += sk[i]->n;
+    }
+    out->mean = sensor_mean(sum, weight);
+    if (!quantile_get(sk, num, 0.0f, &out->min)) {
+        out->min = SENSOR_NONE;
+        out->max = SENSOR_NONE;
+        for (size_t i = 0; i < NUM_SUMMARY_Q; i++) {
+            out->q[i] = SENSOR_NONE;
+        }
+        return;
+    }
+    quantile_get(sk, num, 1.0f, &out->max);
+    for (size_t i = 0; i < NUM_SUMMARY_Q; i++) {
+        quantile_get(sk, num, s_summary_q[i], &out->q[i]);
+    }
+}
+
+static void close_hour(uint32_t next_start)
+{
+    int64_t start = esp_timer_get_time();
+    for (int f = 0; f < SENSOR_NUM_FIELDS; f++) {
+        stats_field_t* sf = &s_stats.field[f];
+        const quantile_sketch_t* hour[] = { &sf->hour.sketch };
+        summarize(&hour[0], 1, sf->hour.sum, sf->hour.samples, s_stats.hour_start,
+            &sf->hours[s_stats.hour_next]);
+        quantile_merge(&sf->day.sketch, &sf->hour.sketch);
+        sf->day.sum += sf->hour.sum;
+        sf->day.samples += sf->hour.samples;
+        acc_reset(&sf->hour, next_start ^ (uint32_t)f);
+    }
+    s_stats.hour_next = (s_stats.hour_next + 1) % STATS_HOURS_KEPT;
+    if (s_stats.hours_kept < STATS_HOURS_KEPT) {
+        s_stats.hours_kept++;
+    }
+    s_stats.info.hours_closed++;
+    uint32_t usec = (uint32_t)(esp_timer_get_time() - start);
+    s_stats.info.last_close_usec = usec;
+    if (usec > s_stats.info.max_close_usec) {
+        s_stats.info.max_close_usec = usec;
+    }
+}
+
+static void close_day(uint32_t next_start)
+{
+    for (int f = 0; f < SENSOR_NUM_FIELDS; f++) {
+        stats_field_t* sf = &s_stats.field[f];
+        const quantile_sketch_t* day[] = { &sf->day.sketch };
+        summarize(&day[0], 1, sf->day.sum, sf->day.samples, s_stats.day_start,
+            &sf->days[s_stats.day_next]);
+        acc_reset(&sf->day, ~next_start ^ (uint32_t)f);
+    }
+    s_stats.day_next = (s_stats.day_next + 1) % STATS_DAYS_KEPT;
+    if (s_stats.days_kept < STATS_DAYS_KEPT) {
+        s_stats.days_kept++;
+    }
+    s_stats.info.days_closed++;
+    ESP_LOGI(TAG, "Closed the day starting at %u", s_stats.day_start);
+}
+
+static void add_sample(const struct sensor_data* sd)
+{
+    uint32_t now = wall_time_sec();
+    if (now == 0) {
+        return;
+    }
+    int64_t start = esp_timer_get_time();
+    uint32_t hour = now / SEC_PER_HOUR * SEC_PER_HOUR;
+    uint32_t day = now / SEC_PER_DAY * SEC_PER_DAY;
+    if (s_stats.hour_start == 0) {
+        s_stats.hour_start = hour;
+        s_stats.day_start = day;
+    }
+    // A clock that steps backwards keeps the open windows rather than closing them out of order
+    if (hour > s_stats.hour_start) {
+        close_hour(hour);
+        s_stats.hour_start = hour;
+    }
+    if (day > s_stats.day_start) {
+        close_day(day);
+        s_stats.day_start = day;
+    }
+
+    // A reading the adaptive sampler let stand for 8 seconds counts as 8 one-second readings
+    uint32_t w = (sd->interval_msec + WEIGHT_MSEC / 2) / WEIGHT_MSEC;
+    w = w > 0 ? w : 1;
+    for (int f = 0; f < SENSOR_NUM_FIELDS; f++) {
+        if (health_field_valid(sd, f)) {
+            stats_acc_t* acc = &s_stats.field[f].hour;
+            int16_t v = sd->sample.value[f];
+            for (uint32_t i = 0; i < w; i++) {
+                quantile_add(&acc->sketch, v);
+            }
+            acc->sum += (int64_t)v * w;
+            acc->samples++;
+        }
+    }
+    s_stats.info.samples++;
+    uint32_t usec = (uint32_t)(esp_timer_get_time() - start);
+    s_stats.info.last_update_usec = usec;
+    if (usec > s_stats.info.max_update_usec) {
+        s_stats.info.max_update_usec = usec;
+    }
+}
+
+static void stats_task(void* arg)
+{
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        const struct sensor_data* sd;
+        while ((sd = sample_bus_next(s_bus, s_sub)) != NULL) {
+            struct sensor_data copy = *sd;
+            if (sample_bus_release(s_bus, s_sub)) {
+                xSemaphoreTake(s_lock, portMAX_DELAY);
+                add_sample(&copy);
+                xSemaphoreGive(s_lock);
+            }
+        }
+    }
+}
+
+esp_err_t stats_init(struct sample_bus* bus)
+{
+    if (s_lock == NULL) {
+        s_lock = xSemaphoreCreateMutexStatic(&s_lock_buf);
+    }
+    for (int f = 0; f < SENSOR_NUM_FIELDS; f++) {
+        acc_reset(&s_stats.field[f].hour, 2 * (uint32_t)f + 1);
+        acc_reset(&s_stats.field[f].day, 2 * (uint32_t)f + 2);
+    }
+
+    TaskHandle_t task = NULL;
+    if (xTaskCreatePinnedToCore(&stats_task, "aqm-stats", AQM_STACK_STATS, NULL,
+            AQM_PRIO_STATS, &task, AQM_CORE_NET) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_bus = bus;
+    s_sub = sample_bus_subscribe(bus, "stats", task);
+    ESP_LOGI(TAG, "%u bytes of sketches and summaries, K=%d", sizeof(s_stats), QUANTILE_K);
+    return s_sub != NULL ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+const char* stats_window_name(int window)
+{
+    return (window >= 0 && window < STATS_NUM_WINDOWS) ? s_window_names[window] : "unknown";
+}
+
+int stats_window_from_name(const char* name)
+{
+    for (int w = 0; w < STATS_NUM_WINDOWS; w++) {
+        if (strcmp(name, s_window_names[w]) == 0) {
+            return w;
+        }
+    }
+    return -1;
+}
+
+int stats_field_from_name(const char* name)
+{
+    for (int f = 0; f < SENSOR_NUM_FIELDS; f++) {
+        if (strcmp(name, alert_field_name(f)) == 0) {
+            return f;
+        }
+    }
+    return -1;
+}
+
+static void add_value(cJSON* obj, const char* key, int field, int16_t value)
+{
+    char buf[SENSOR_FORMAT_MAX];
+    sensor_format(&buf[0], sizeof(buf), field, value);
+    cJSON_AddRawToObject(obj, key, &buf[0]);
+}
+
+// "p50", "p99.9"
+static void quantile_key(char* buf, size_t size, float q)
+{
+    snprintf(buf, size, "p%g", (double)(q * 100.0f));
+}
+
+static void summary_to_json(cJSON* obj, int field, const stats_summary_t* s)
+{
+    char key[16];
+    cJSON_AddNumberToObject(obj, "start", s->start);
+    cJSON_AddNumberToObject(obj, "n", s->n);
+    add_value(obj, "min", field, s->min);
+    add_value(obj, "max", field, s->max);
+    add_value(obj, "mean", field, s->mean);
+    for (size_t i = 0; i < NUM_SUMMARY_Q; i++) {
+        quantile_key(&key[0], sizeof(key), s_summary_q[i]);
+        add_value(obj, &key[0], field, s->q[i]);
+    }
+}
+
+esp_err_t stats_field_to_json(struct cJSON* root, int field, int window, const float* q, int num_q)
+{
+    if (s_lock == NULL || field < 0 || field >= SENSOR_NUM_FIELDS || window < 0 || window >= STATS_NUM_WINDOWS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (q == NULL || num_q == 0) {
+        q = &s_summary_q[0];
+        num_q = NUM_SUMMARY_Q;
+    }
+    num_q = num_q > STATS_MAX_QUANTILES ? STATS_MAX_QUANTILES : num_q;
+
+    cJSON_AddStringToObject(root, "field", alert_field_name(field));
+    cJSON_AddStringToObject(root, "window", stats_window_name(window));
+    cJSON_AddNumberToObject(root, "k", QUANTILE_K);
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    const stats_field_t* sf = &s_stats.field[field];
+    const quantile_sketch_t* sk[2] = { &sf->hour.sketch, &sf->day.sketch };
+    int num_sk = window == STATS_WINDOW_DAY ? 2 : 1;
+    int64_t sum = sf->hour.sum + (window == STATS_WINDOW_DAY ? sf->day.sum : 0);
+    uint32_t n = sf->hour.samples + (window == STATS_WINDOW_DAY ? sf->day.samples : 0);
+    uint32_t weight = sk[0]->n + (window == STATS_WINDOW_DAY ? sk[1]->n : 0);
+
+    cJSON* current = cJSON_AddObjectToObject(root, "current");
+    cJSON_AddNumberToObject(current, "start", window == STATS_WINDOW_DAY ? s_stats.day_start : s_stats.hour_start);
+    cJSON_AddNumberToObject(current, "n", n);
+    int16_t v = SENSOR_NONE;
+    bool any = quantile_get(&sk[0], num_sk, 0.0f, &v);
+    add_value(current, "min", field, v);
+    if (any) {
+        quantile_get(&sk[0], num_sk, 1.0f, &v);
+    }
+    add_value(current, "max", field, v);
+    add_value(current, "mean", field, sensor_mean(sum, weight));
+    char key[16];
+    for (int i = 0; i < num_q; i++) {
+        v = SENSOR_NONE;
+        if (any) {
+            quantile_get(&sk[0], num_sk, q[i], &v);
+        }
+        quantile_key(&key[0], sizeof(key), q[i]);
+        add_value(current, &key[0], field, v);
+    }
+
+    cJSON* completed = cJSON_AddArrayToObject(root, "completed");
+    const stats_summary_t* ring = window == STATS_WINDOW_DAY ? &sf->days[0] : &sf->hours[0];
+    uint32_t ring_size = window == STATS_WINDOW_DAY ? STATS_DAYS_KEPT : STATS_HOURS_KEPT;
+    uint32_t kept = window == STATS_WINDOW_DAY ? s_stats.days_kept : s_stats.hours_kept;
+    uint32_t next = window == STATS_WINDOW_DAY ? s_stats.day_next : s_stats.hour_next;
+    for (uint32_t i = 1; i <= kept; i++) {
+        cJSON* entry = cJSON_CreateObject();
+        summary_to_json(entry, field, &ring[(next + ring_size - i) % ring_size]);
+        cJSON_AddItemToArray(completed, entry);
+    }
+    xSemaphoreGive(s_lock);
+    return ESP_OK;
+}
+
+const stats_info_t* stats_get_info(void)
+{
+    return &s_stats.info;
+}
+
+void stats_to_json(struct cJSON* root)
+{
+    if (s_lock == NULL) {
+        cJSON_AddBoolToObject(root, "enabled", false);
+        return;
+    }
+    const stats_info_t* info = &s_stats.info;
+    cJSON_AddBoolToObject(root, "enabled", true);
+    cJSON_AddNumberToObject(root, "sketch_k", QUANTILE_K);
+    cJSON_AddNumberToObject(root, "bytes", sizeof(s_stats));
+    cJSON_AddNumberToObject(root, "samples", info->samples);
+    cJSON_AddNumberToObject(root, "hours_closed", info->hours_closed);
+    cJSON_AddNumberToObject(root, "days_closed", info->days_closed);
+    cJSON_AddNumberToObject(root, "last_update_usec", info->last_update_usec);
+    cJSON_AddNumberToObject(root, "max_update_usec", info->max_update_usec);
+    cJSON_AddNumberToObject(root, "last_close_usec", info->last_close_usec);
+    cJSON_AddNumberToObject(root, "max_close_usec", info->max_close_usec);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "esp_err.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define STATS_HOURS_KEPT 24         // completed hours reported per field
+#define STATS_DAYS_KEPT 7
+#define STATS_MAX_QUANTILES 8       // per query of the window in progress
+
+enum stats_window {
+    STATS_WINDOW_HOUR,              // UTC hours
+    STATS_WINDOW_DAY,               // UTC days
+    STATS_NUM_WINDOWS
+};
+
+typedef struct stats_info {
+    uint32_t samples;
+    uint32_t hours_closed;
+    uint32_t days_closed;
+    uint32_t last_update_usec;      // adding one sample to every field's sketch
+    uint32_t max_update_usec;
+    uint32_t last_close_usec;       // summarizing an hour and merging it into the day
+    uint32_t max_close_usec;
+} stats_info_t;
+
+struct sample_bus;
+struct cJSON;
+
+// Subscribes the stats task to the sample bus. Like the history, samples only count once SNTP
+// has set the clock, as windows are aligned to wall time.
+esp_err_t stats_init(struct sample_bus* bus);
+
+const char* stats_window_name(int window);
+int stats_window_from_name(const char* name);
+int stats_field_from_name(const char* name);
+
+// Adds the window in progress of field (count, min, max, mean and the num_q quantiles q) and
+// the completed windows newest first, each with p50/p90/p95/p99. Values are in engineering units.
+esp_err_t stats_field_to_json(struct cJSON* root, int field, int window, const float* q, int num_q);
+const stats_info_t* stats_get_info(void);
+void stats_to_json(struct cJSON* root);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,118 @@
+#include "swinging_door.h"
+
+#include <string.h>
+
+void swinging_door_init(swinging_door_t* sd, uint32_t channels, const int16_t* dev, uint32_t max_gap_sec)
+{
+    memset(sd, 0, sizeof(swinging_door_t));
+    sd->channels = channels;
+    memcpy(&sd->dev[0], dev, sizeof(sd->dev));
+    sd->max_gap_sec = max_gap_sec;
+}
+
+static void open_door(swinging_door_t* sd, const history_row_t* anchor)
+{
+    sd->anchor = *anchor;
+    sd->has_anchor = true;
+    sd->has_prev = false;
+    sd->split = false;
+    for (int ch = 0; ch < HISTORY_NUM_CHANNELS; ch++) {
+        sd->lo[ch] = -1e30f;
+        sd->hi[ch] = 1e30f;
+    }
+}
+
+// Narrows the door to pass within the deviation of row, which becomes a dropped row
+static void narrow(swinging_door_t* sd, const history_row_t* row)
+{
+    float t = (float)(row->time - sd->anchor.time);
+    for (int ch = 0; ch < HISTORY_NUM_CHANNELS; ch++) {
+        int16_t a = sd->anchor.value[ch];
+        int16_t x = row->value[ch];
+        if (!(sd->channels & (1u << ch)) || a == HISTORY_NO_VALUE || x == HISTORY_NO_VALUE) {
+            continue;
+        }
+        float lo = ((float)x - (float)sd->dev[ch] - (float)a) / t;
+        float hi = ((float)x + (float)sd->dev[ch] - (float)a) / t;
+        sd->lo[ch] = lo > sd->lo[ch] ? lo : sd->lo[ch];
+        sd->hi[ch] = hi < sd->hi[ch] ? hi : sd->hi[ch];
+    }
+}
+
+// Whether the line from the anchor to row stays inside the door on every channel
+static bool inside(const swinging_door_t* sd, const history_row_t* row)
+{
+    float t = (float)(row->time - sd->anchor.time);
+    for (int ch = 0; ch < HISTORY_NUM_CHANNELS; ch++) {
+        int16_t a = sd->anchor.value[ch];
+        int16_t x = row->value[ch];
+        if (!(sd->channels & (1u << ch))) {
+            continue;
+        }
+        if ((a == HISTORY_NO_VALUE) != (x == HISTORY_NO_VALUE)) {
+            return false;
+        }
+        if (a == HISTORY_NO_VALUE) {
+            continue;
+        }
+        float slope = ((float)x - (float)a) / t;
+        if (slope < sd->lo[ch] || slope > sd->hi[ch]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool mismatched(const swinging_door_t* sd, const history_row_t* row)
+{
+    for (int ch = 0; ch < HISTORY_NUM_CHANNELS; ch++) {
+        if ((sd->channels & (1u << ch))
+            && (sd->anchor.value[ch] == HISTORY_NO_VALUE) != (row->value[ch] == HISTORY_NO_VALUE)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool swinging_door_push(swinging_door_t* sd, const history_row_t* row, history_row_t* out)
+{
+    sd->rows_in++;
+    if (!sd->has_anchor) {
+        open_door(sd, row);
+        *out = *row;
+        sd->rows_out++;
+        return true;
+    }
+
+    bool kept = false;
+    if (sd->has_prev) {
+        bool gap = row->time - sd->prev.time > sd->max_gap_sec;
+        if (!sd->split && !gap) {
+            narrow(sd, &sd->prev);
+        }
+        if (sd->split || gap || !inside(sd, row)) {
+            *out = sd->prev;
+            sd->rows_out++;
+            kept = true;
+            open_door(sd, &sd->prev);
+        }
+    }
+    // Nothing lies between the anchor and the row right after it, so the door is always open to
+    // that row; it is kept anyway when a gap or a lost reading separates the two
+    bool first = !sd->has_prev || kept;
+    sd->split = first && (row->time - sd->anchor.time > sd->max_gap_sec || mismatched(sd, row));
+    sd->prev = *row;
+    sd->has_prev = true;
+    return kept;
+}
+
+bool swinging_door_finish(swinging_door_t* sd, history_row_t* out)
+{
+    if (!sd->has_prev) {
+        return false;
+    }
+    *out = sd->prev;
+    sd->rows_out++;
+    sd->has_prev = false;
+    return true;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "history_codec.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Swinging-door compression of history rows (Bristol 1990). A row is dropped when the line
+// between the rows kept on either side passes within the channel's deviation of every dropped
+// value, so linear interpolation between the kept rows reproduces the series to that deviation.
+// The door from the last kept row is the range of slopes that still passes every row since; a
+// row outside it closes the door and the row before it is kept. Channels share the kept rows.
+// Rows on either side of a gap longer than max_gap_sec and changes between a reading and no
+// reading are always kept.
+typedef struct swinging_door {
+    uint32_t channels;                      // bit per channel compressed, the others are ignored
+    int16_t dev[HISTORY_NUM_CHANNELS];      // fixed point
+    uint32_t max_gap_sec;
+    history_row_t anchor;                   // last kept row
+    history_row_t prev;                     // last row seen, kept if the next one closes the door
+    bool has_anchor;
+    bool has_prev;
+    bool split;                             // prev must be kept whatever follows
+    float lo[HISTORY_NUM_CHANNELS];         // slopes from the anchor, per second
+    float hi[HISTORY_NUM_CHANNELS];
+    uint32_t rows_in;
+    uint32_t rows_out;
+} swinging_door_t;
+
+void swinging_door_init(swinging_door_t* sd, uint32_t channels, const int16_t* dev, uint32_t max_gap_sec);
+// Feeds the next row; returns true with *out set when a row is kept
+bool swinging_door_push(swinging_door_t* sd, const history_row_t* row, history_row_t* out);
+// After the last row: returns true with *out set to the row still held back
+bool swinging_door_finish(swinging_door_t* sd, history_row_t* out);
+
+#ifdef __cplusplus
+}
+#endif
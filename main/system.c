@@ -1,13 +1,12 @@
 #include "system.h"
 #include "wifi.h"
-#include "wifi_credential.h"
+#include "arena.h"
 
 #include "freertos/FreeRTOS.h"
 #include "esp_log.h"
 #include "esp_timer.h"
 #include "nvs_flash.h"
 
-#include <i2cdev.h>
 #include <string.h>
 
 static const char *TAG = "aqm-system";
@@ -48,8 +47,10 @@ system_t* system_init(void)
 {
     ESP_LOGD(TAG, "system_init");
 
-    system_t *sys = malloc(sizeof(system_t));
-    memset(sys, 0, sizeof(system_t));
+    system_t *sys = arena_alloc(sizeof(system_t));
+    if (sys == NULL) {
+        return NULL;
+    }
 
     sys->power_on_time = esp_timer_get_time();
 
@@ -62,24 +63,20 @@ system_t* system_init(void)
         }
     }
 
-    if (err == ESP_OK) {
-        err = i2cdev_init();
-    }
-
     if (err == ESP_OK) {
         ESP_LOGD(TAG, "system_init OK");
     } else {
         ESP_LOGE(TAG, "system_init FAIL");
-        free(sys);
+        arena_free(sys);
         sys = NULL;
     }
 
     return sys;
 }
 
-esp_err_t system_wifi_init(system_t* sys)
+esp_err_t system_wifi_init(system_t* sys, const char* ssid, const char* pass)
 {
-    sys->wifi = wifi_init(WIFI_SSID, WIFI_PASS, WIFI_AUTH_OPEN);
+    sys->wifi = wifi_init(ssid, pass, WIFI_AUTH_OPEN);
     if (sys->wifi != NULL) {
         char ip_addr[16];
         sprintf(&ip_addr[0], IPSTR, IP2STR(&sys->wifi->ip.ip));
@@ -103,7 +100,7 @@ void system_shutdown(system_t* sys)
 {
     ESP_LOGD(TAG, "system_shutdown");
     if (sys != NULL) {
-        free(sys);
+        arena_free(sys);
         sys = NULL;
     }
 }
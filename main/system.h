@@ -21,7 +21,7 @@ typedef struct system_s {
 } system_t;
 
 system_t* system_init(void);
-esp_err_t system_wifi_init(system_t* sys);
+esp_err_t system_wifi_init(system_t* sys, const char* ssid, const char* pass);
 void system_shutdown(system_t* sys);
 esp_err_t system_get_info(system_t* sys);
 esp_err_t system_print_info(system_t* sys);
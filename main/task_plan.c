@@ -0,0 +1,87 @@
+#include "task_plan.h"
+
+#include "sdkconfig.h"
+
+#include <string.h>
+
+static sampler_stats_t s_stats;
+
+void task_plan_reset_stats(int64_t target_usec)
+{
+    memset(&s_stats, 0, sizeof(sampler_stats_t));
+    s_stats.target_usec = target_usec;
+    s_stats.min_period_usec = INT64_MAX;
+}
+
+void task_plan_set_target(int64_t target_usec)
+{
+    s_stats.target_usec = target_usec;
+}
+
+void task_plan_record_period(int64_t period_usec)
+{
+    int64_t jitter = period_usec - s_stats.target_usec;
+    if (jitter < 0) {
+        jitter = -jitter;
+    }
+    s_stats.num_periods++;
+    s_stats.sum_abs_jitter_usec += jitter;
+    if (jitter > s_stats.max_abs_jitter_usec) {
+        s_stats.max_abs_jitter_usec = jitter;
+    }
+    if (period_usec < s_stats.min_period_usec) {
+        s_stats.min_period_usec = period_usec;
+    }
+    if (period_usec > s_stats.max_period_usec) {
+        s_stats.max_period_usec = period_usec;
+    }
+}
+
+void task_plan_record_busy(int64_t busy_usec)
+{
+    s_stats.num_ticks++;
+    s_stats.last_busy_usec = busy_usec;
+    s_stats.sum_busy_usec += busy_usec;
+    if (busy_usec > s_stats.max_busy_usec) {
+        s_stats.max_busy_usec = busy_usec;
+    }
+}
+
+const sampler_stats_t* task_plan_get_stats(void)
+{
+    return &s_stats;
+}
+
+int64_t task_plan_avg_abs_jitter_usec(void)
+{
+    if (s_stats.num_periods == 0) {
+        return 0;
+    }
+    return s_stats.sum_abs_jitter_usec / s_stats.num_periods;
+}
+
+int64_t task_plan_avg_busy_usec(void)
+{
+    if (s_stats.num_ticks == 0) {
+        return 0;
+    }
+    return s_stats.sum_busy_usec / s_stats.num_ticks;
+}
+
+bool task_plan_overlap_io_enabled(void)
+{
+#if CONFIG_AQM_SAMPLER_OVERLAP_IO
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool task_plan_adaptive_enabled(void)
+{
+#if CONFIG_AQM_SAMPLER_ADAPTIVE
+    return true;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Core affinity and priority plan.
+// Core 0 (PRO): Wi-Fi, LwIP, HTTP server, MQTT, console logging and reporting.
+// Core 1 (APP): sensor sampling, filtering and AQI, the I2C bus worker that runs the sampler's
+// transfers and the LCD refresh below them. Nothing else is pinned here, so the sampler is not
+// delayed by network bursts.
+// Samples reach every consumer through the sample_bus_t broadcast ring only.
+#define AQM_CORE_NET            PRO_CPU_NUM
+#define AQM_CORE_SAMPLER        APP_CPU_NUM
+
+#define AQM_PRIO_I2C_BUS        11
+#define AQM_PRIO_SAMPLER        10
+#define AQM_PRIO_HTTP           5
+#define AQM_PRIO_MQTT           5
+#define AQM_PRIO_DISPLAY        4
+#define AQM_PRIO_REPORTER       3
+#define AQM_PRIO_BOOT           3
+#define AQM_PRIO_ALERTS         2
+#define AQM_PRIO_FLEET          2
+#define AQM_PRIO_TELEMETRY      2
+#define AQM_PRIO_OTA            2
+#define AQM_PRIO_HEALTH         1
+#define AQM_PRIO_HISTORY        1
+#define AQM_PRIO_STATS          1
+
+#define AQM_STACK_SAMPLER       6144
+#define AQM_STACK_I2C_BUS       3072
+#define AQM_STACK_REPORTER      4096
+#define AQM_STACK_HTTP          6144
+#define AQM_STACK_DISPLAY       3072
+#define AQM_STACK_OTA           6144
+#define AQM_STACK_ALERTS        6144
+#define AQM_STACK_FLEET         6144
+#define AQM_STACK_TELEMETRY     4096
+#define AQM_STACK_HEALTH        4096
+#define AQM_STACK_HISTORY       4096
+#define AQM_STACK_STATS         3072
+#define AQM_STACK_BOOT          4096
+
+typedef struct sampler_stats {
+    uint32_t num_periods;
+    int64_t target_usec;
+    int64_t min_period_usec;
+    int64_t max_period_usec;
+    int64_t sum_abs_jitter_usec;
+    int64_t max_abs_jitter_usec;
+    uint32_t num_ticks;
+    int64_t last_busy_usec;     // tick start to publish, including waits on the sensors
+    int64_t sum_busy_usec;
+    int64_t max_busy_usec;
+} sampler_stats_t;
+
+void task_plan_reset_stats(int64_t target_usec);
+// Period the next one is measured against, without clearing the counters
+void task_plan_set_target(int64_t target_usec);
+void task_plan_record_period(int64_t period_usec);
+void task_plan_record_busy(int64_t busy_usec);
+const sampler_stats_t* task_plan_get_stats(void);
+int64_t task_plan_avg_abs_jitter_usec(void);
+int64_t task_plan_avg_busy_usec(void);
+bool task_plan_overlap_io_enabled(void);
+bool task_plan_adaptive_enabled(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,119 @@
+#include "telemetry.h"
+#include "deadband.h"
+#include "sample_bus.h"
+#include "task_plan.h"
+#include "utils.h"
+
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "mqtt_client.h"
+
+#include "cJSON.h"
+
+#include <string.h>
+
+static const char* TAG = "aqm-telemetry";
+
+static deadband_t s_deadband;       // telemetry task only, read racily for stats
+static telemetry_stats_t s_stats;
+static esp_mqtt_client_handle_t s_mqtt = NULL;
+static sample_bus_t* s_bus = NULL;
+static sample_sub_t* s_sub = NULL;
+
+static bool deadband_enabled(void)
+{
+#if CONFIG_AQM_TELEMETRY_DEADBAND
+    return true;
+#else
+    return false;
+#endif
+}
+
+static uint32_t heartbeat_msec(void)
+{
+#if CONFIG_AQM_TELEMETRY_DEADBAND
+    return CONFIG_AQM_TELEMETRY_HEARTBEAT_SEC * 1000;
+#else
+    return 0;
+#endif
+}
+
+static void publish(const struct sensor_data* sd)
+{
+    uint32_t mask = deadband_check(&s_deadband, sd);
+    if (mask == 0) {
+        return;
+    }
+    char json[DEADBAND_JSON_MAX];
+    size_t len = deadband_format_json(&json[0], sizeof(json), wall_time_sec(), sd, mask);
+    if (esp_mqtt_client_publish(s_mqtt, CONFIG_AQM_TELEMETRY_TOPIC, &json[0], (int)len, 1, 0) >= 0) {
+        s_stats.sent++;
+        s_stats.bytes += len;
+    } else {
+        s_stats.errors++;
+    }
+}
+
+static void telemetry_task(void* arg)
+{
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        const struct sensor_data* sd;
+        while ((sd = sample_bus_next(s_bus, s_sub)) != NULL) {
+            struct sensor_data copy = *sd;
+            if (sample_bus_release(s_bus, s_sub)) {
+                publish(&copy);
+            }
+        }
+    }
+}
+
+esp_err_t telemetry_init(struct sample_bus* bus)
+{
+    if (CONFIG_AQM_TELEMETRY_MQTT_URI[0] == '\0') {
+        return ESP_OK;
+    }
+    deadband_init(&s_deadband, deadband_enabled(), heartbeat_msec());
+
+    esp_mqtt_client_config_t config = {
+        .uri = CONFIG_AQM_TELEMETRY_MQTT_URI,
+        .task_prio = AQM_PRIO_MQTT,
+    };
+    s_mqtt = esp_mqtt_client_init(&config);
+    if (s_mqtt == NULL || esp_mqtt_client_start(s_mqtt) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start MQTT client for %s", CONFIG_AQM_TELEMETRY_MQTT_URI);
+        return ESP_FAIL;
+    }
+
+    TaskHandle_t task = NULL;
+    if (xTaskCreatePinnedToCore(&telemetry_task, "aqm-telemetry", AQM_STACK_TELEMETRY, NULL,
+            AQM_PRIO_TELEMETRY, &task, AQM_CORE_NET) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_bus = bus;
+    s_sub = sample_bus_subscribe(bus, "telemetry", task);
+    ESP_LOGI(TAG, "Publishing to %s%s", CONFIG_AQM_TELEMETRY_TOPIC,
+        deadband_enabled() ? " on change" : "");
+    return s_sub != NULL ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+void telemetry_to_json(struct cJSON* root)
+{
+    cJSON_AddBoolToObject(root, "enabled", s_sub != NULL);
+    if (s_sub == NULL) {
+        return;
+    }
+    const deadband_stats_t* ds = &s_deadband.stats;
+    cJSON_AddStringToObject(root, "topic", CONFIG_AQM_TELEMETRY_TOPIC);
+    cJSON_AddBoolToObject(root, "deadband", s_deadband.enabled);
+    cJSON_AddNumberToObject(root, "heartbeat_sec", s_deadband.heartbeat_msec / 1000);
+    cJSON_AddNumberToObject(root, "samples", ds->samples);
+    cJSON_AddNumberToObject(root, "reports", ds->reports);
+    cJSON_AddNumberToObject(root, "heartbeats", ds->heartbeats);
+    cJSON_AddNumberToObject(root, "fields_sent", ds->fields_sent);
+    cJSON_AddNumberToObject(root, "sent", s_stats.sent);
+    cJSON_AddNumberToObject(root, "errors", s_stats.errors);
+    cJSON_AddNumberToObject(root, "bytes", s_stats.bytes);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "esp_err.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct telemetry_stats {
+    uint32_t sent;
+    uint32_t errors;
+    uint64_t bytes;                 // payload bytes handed to the MQTT client
+} telemetry_stats_t;
+
+struct sample_bus;
+struct cJSON;
+
+// Publishes samples to CONFIG_AQM_TELEMETRY_MQTT_URI, one compact JSON object per message with
+// the unix time (0 until SNTP has set the clock) and readings in engineering units. With
+// CONFIG_AQM_TELEMETRY_DEADBAND only the fields that left their deadband are sent, plus every
+// field after CONFIG_AQM_TELEMETRY_HEARTBEAT_SEC of silence. Does nothing without a broker.
+esp_err_t telemetry_init(struct sample_bus* bus);
+void telemetry_to_json(struct cJSON* root);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,83 @@
+#include "temp_mcp9808.h"
+
+#include "esp_log.h"
+
+static const char* TAG = "aqm-mcp9808";
+
+#define CHECK_ARG(VAL) do { if (!(VAL)) return ESP_ERR_INVALID_ARG; } while (0)
+
+#define REG_CONFIG 0x01
+#define REG_TEMP 0x05
+#define REG_MANUFACTURER_ID 0x06
+#define REG_DEVICE_ID 0x07
+#define REG_RESOLUTION 0x08
+#define RESOLUTION_0P0625 0x03
+
+static esp_err_t read_reg16(i2c_bus_dev_t* dev, uint8_t reg, uint16_t* val)
+{
+    uint8_t buf[2];
+    esp_err_t err = i2c_bus_write_read(dev, &reg, 1, &buf[0], 2);
+    if (err == ESP_OK) {
+        *val = ((uint16_t)buf[0] << 8) | buf[1];
+    }
+    return err;
+}
+
+esp_err_t temp_mcp9808_init(i2c_bus_dev_t* dev)
+{
+    CHECK_ARG(dev);
+    uint16_t manufacturer = 0;
+    uint16_t device = 0;
+    esp_err_t err = read_reg16(dev, REG_MANUFACTURER_ID, &manufacturer);
+    if (err == ESP_OK) {
+        err = read_reg16(dev, REG_DEVICE_ID, &device);
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (manufacturer != MCP9808_MANUFACTURER_ID || (device >> 8) != MCP9808_DEVICE_ID) {
+        ESP_LOGE(TAG, "Unexpected manufacturer 0x%04X / device 0x%04X", manufacturer, device);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    // Continuous conversion, full resolution
+    const uint8_t config[3] = { REG_CONFIG, 0x00, 0x00 };
+    err = i2c_bus_write(dev, &config[0], sizeof(config));
+    if (err == ESP_OK) {
+        const uint8_t res[2] = { REG_RESOLUTION, RESOLUTION_0P0625 };
+        err = i2c_bus_write(dev, &res[0], sizeof(res));
+    }
+    ESP_LOGI(TAG, "MCP9808 rev %d", device & 0xff);
+    return err;
+}
+
+esp_err_t temp_mcp9808_read_start(i2c_bus_dev_t* dev, temp_mcp9808_read_t* rd)
+{
+    CHECK_ARG(dev && rd);
+    rd->reg = REG_TEMP;
+    return i2c_bus_write_read_async(dev, &rd->req, &rd->reg, 1, &rd->buf[0], 2, NULL, NULL);
+}
+
+esp_err_t temp_mcp9808_read_finish(temp_mcp9808_read_t* rd, int16_t* sixteenths)
+{
+    CHECK_ARG(rd && sixteenths);
+    esp_err_t err = i2c_bus_wait(&rd->req);
+    if (err != ESP_OK) {
+        return err;
+    }
+    // 13-bit two's complement in 1/16 degree steps, the top three bits are alert flags
+    uint16_t raw = ((uint16_t)rd->buf[0] << 8) | rd->buf[1];
+    *sixteenths = (int16_t)(raw << 3) >> 3;
+    return ESP_OK;
+}
+
+esp_err_t temp_mcp9808_read(i2c_bus_dev_t* dev, int16_t* sixteenths)
+{
+    CHECK_ARG(dev && sixteenths);
+    temp_mcp9808_read_t rd;
+    esp_err_t err = temp_mcp9808_read_start(dev, &rd);
+    if (err != ESP_OK) {
+        return err;
+    }
+    return temp_mcp9808_read_finish(&rd, sixteenths);
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "esp_err.h"
+#include "i2c_bus.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MCP9808_MAX_FREQ_HZ I2C_BUS_FREQ_FAST
+#define MCP9808_MANUFACTURER_ID 0x0054
+#define MCP9808_DEVICE_ID 0x04
+
+esp_err_t temp_mcp9808_init(i2c_bus_dev_t* dev);
+// Temperature in the register's 1/16 degree steps (SENSOR_SCALE_MCP9808)
+esp_err_t temp_mcp9808_read(i2c_bus_dev_t* dev, int16_t* sixteenths);
+
+// A temperature read in flight, for callers that overlap it with other bus work
+typedef struct temp_mcp9808_read {
+    i2c_bus_req_t req;
+    uint8_t reg;
+    uint8_t buf[2];
+} temp_mcp9808_read_t;
+
+esp_err_t temp_mcp9808_read_start(i2c_bus_dev_t* dev, temp_mcp9808_read_t* rd);
+esp_err_t temp_mcp9808_read_finish(temp_mcp9808_read_t* rd, int16_t* sixteenths);
+
+#ifdef __cplusplus
+}
+#endif
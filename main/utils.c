@@ -2,27 +2,34 @@
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "esp_timer.h"
+#include "esp_rom_sys.h"
 
-#define NOP() asm volatile ("nop")
+#include <sys/time.h>
+
+#define USEC_PER_TICK (1000000 / configTICK_RATE_HZ)
+#define MIN_VALID_TIME 1672531200   // 2023-01-01, anything earlier means SNTP has not synced
 
 void sleep_usec(unsigned int usec)
 {
-    uint64_t m = (uint64_t)esp_timer_get_time();
-    if (usec) {
-        uint64_t e = (m + usec);
-        if (m > e) { //overflow
-            while ((uint64_t)esp_timer_get_time() > e) {
-                NOP();
-            }
-        }
-        while ((uint64_t)esp_timer_get_time() < e) {
-            NOP();
-        }
+    // Waits shorter than a tick (HD44780 enable pulses, etc.) are too short to yield on.
+    // Anything longer blocks on the tick timer so the idle task can clock down or light sleep.
+    // vTaskDelay(n) may return up to a tick early, since the call lands partway through the
+    // current tick, so one extra tick keeps the wait from ever falling short of usec.
+    if (usec < USEC_PER_TICK) {
+        esp_rom_delay_us(usec);
+        return;
     }
+    vTaskDelay((usec + USEC_PER_TICK - 1) / USEC_PER_TICK + 1);
 }
 
 void sleep_msec(unsigned int msec)
 {
-    vTaskDelay(msec / portTICK_PERIOD_MS);
+    vTaskDelay(pdMS_TO_TICKS(msec));
+}
+
+uint32_t wall_time_sec(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec < MIN_VALID_TIME ? 0 : (uint32_t)tv.tv_sec;
 }
@@ -1,11 +1,15 @@
 #pragma once
 
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 void sleep_usec(unsigned int usec);
 void sleep_msec(unsigned int msec);
+// Unix time in seconds, 0 until SNTP has set the clock
+uint32_t wall_time_sec(void);
 
 #ifdef __cplusplus
 }
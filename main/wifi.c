@@ -1,4 +1,5 @@
 #include "wifi.h"
+#include "arena.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -10,6 +11,8 @@
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
 
 #include "lwip/err.h"
 #include "lwip/sys.h"
@@ -44,10 +47,42 @@ static EventGroupHandle_t s_wifi_event_group;
 #define WIFI_CONNECTED_BIT BIT0
 #define WIFI_FAIL_BIT      BIT1
 
+#define WIFI_NVS_NAMESPACE "aqm"
+#define WIFI_NVS_KEY "wifi"
+#define WIFI_CACHE_VERSION 1
+
 static const char *TAG = "aqm-wifi";
 
 static int s_retry_num = 0;
 
+// Posted by the backoff timer so the retry runs on the event loop task like every other event
+ESP_EVENT_DEFINE_BASE(AQM_WIFI_EVENT);
+#define AQM_WIFI_EVENT_RETRY 0
+
+// AP that last gave us an IP, tried first on the next connect
+typedef struct wifi_cache {
+    uint32_t version;
+    char ssid[32];
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint8_t reserved;
+} wifi_cache_t;
+
+// Only touched from the event loop task once wifi_init_sta() has started the driver
+static struct {
+    wifi_t* wifi;
+    wifi_config_t config;
+    wifi_cache_t cache;
+    bool cache_valid;
+    bool fast;                  // connecting to the cached BSSID/channel without a scan
+    bool roaming;               // disconnect was requested to move to a better AP
+    int64_t connect_usec;       // start of the current connect, 0 when connected
+    esp_timer_handle_t retry_timer;
+    uint32_t backoff_sec;       // delay before the next retry once the quick retries are used up
+    uint32_t backoff_attempts;
+    wifi_stats_t stats;
+} s_conn;
+
 static void print_auth_mode(int authmode)
 {
     switch (authmode) {
@@ -132,24 +167,240 @@ static void print_cipher_type(int pairwise_cipher, int group_cipher)
     }
 }
 
+static void cache_load(const char* ssid)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(WIFI_NVS_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK) {
+        wifi_cache_t stored;
+        size_t size = sizeof(wifi_cache_t);
+        esp_err_t err = nvs_get_blob(nvs, WIFI_NVS_KEY, &stored, &size);
+        nvs_close(nvs);
+        // A cached AP is only valid for the SSID it was learned on
+        if (err == ESP_OK && size == sizeof(wifi_cache_t) && stored.version == WIFI_CACHE_VERSION
+            && strncmp(&stored.ssid[0], ssid, sizeof(stored.ssid)) == 0 && stored.channel != 0) {
+            memcpy(&s_conn.cache, &stored, sizeof(wifi_cache_t));
+            s_conn.cache_valid = true;
+        }
+    }
+}
+
+static void cache_save(const uint8_t* bssid, uint8_t channel)
+{
+    if (s_conn.cache_valid && s_conn.cache.channel == channel && memcmp(&s_conn.cache.bssid[0], bssid, 6) == 0) {
+        return; // unchanged, spare the flash
+    }
+    memset(&s_conn.cache, 0, sizeof(wifi_cache_t));
+    s_conn.cache.version = WIFI_CACHE_VERSION;
+    strncpy(&s_conn.cache.ssid[0], (const char*)&s_conn.config.sta.ssid[0], sizeof(s_conn.cache.ssid));
+    memcpy(&s_conn.cache.bssid[0], bssid, 6);
+    s_conn.cache.channel = channel;
+
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(WIFI_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(nvs, WIFI_NVS_KEY, &s_conn.cache, sizeof(wifi_cache_t));
+        if (err == ESP_OK) {
+            err = nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+    if (err == ESP_OK) {
+        s_conn.cache_valid = true;
+    } else {
+        ESP_LOGE(TAG, "Failed to save Wi-Fi cache: %s", esp_err_to_name(err));
+    }
+}
+
+// Points the station at one AP: the channel is probed directly instead of scanned
+static void config_target(const uint8_t* bssid, uint8_t channel)
+{
+    wifi_sta_config_t* sta = &s_conn.config.sta;
+    if (bssid != NULL) {
+        memcpy(&sta->bssid[0], bssid, 6);
+        sta->bssid_set = true;
+        sta->channel = channel;
+        sta->scan_method = WIFI_FAST_SCAN;
+    } else {
+        sta->bssid_set = false;
+        sta->channel = 0;
+        sta->scan_method = WIFI_ALL_CHANNEL_SCAN;
+    }
+    esp_wifi_set_config(WIFI_IF_STA, &s_conn.config);
+}
+
+static void connect_begin(void)
+{
+    if (s_conn.connect_usec == 0) {
+        s_conn.connect_usec = esp_timer_get_time();
+    }
+    esp_wifi_connect();
+}
+
+static void connect_done(void)
+{
+    wifi_stats_t* st = &s_conn.stats;
+    if (s_conn.connect_usec == 0) {
+        // A new address while associated (DHCP renewed with another lease), not a connect
+        return;
+    }
+    uint32_t usec = (uint32_t)(esp_timer_get_time() - s_conn.connect_usec);
+    s_conn.connect_usec = 0;
+    st->connects++;
+    if (s_conn.fast) {
+        st->fast_connects++;
+    }
+    st->last_time_to_ip_usec = usec;
+    st->sum_time_to_ip_usec += usec;
+    if (st->min_time_to_ip_usec == 0 || usec < st->min_time_to_ip_usec) {
+        st->min_time_to_ip_usec = usec;
+    }
+    if (usec > st->max_time_to_ip_usec) {
+        st->max_time_to_ip_usec = usec;
+    }
+
+    wifi_ap_record_t ap;
+    if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK) {
+        memcpy(&st->bssid[0], &ap.bssid[0], 6);
+        st->channel = ap.primary;
+        st->rssi = ap.rssi;
+        cache_save(&ap.bssid[0], ap.primary);
+    }
+    ESP_LOGI(TAG, "Time to IP %ums (%s connect, channel %u, RSSI %d)", usec / 1000,
+        s_conn.fast ? "fast" : "scanned", st->channel, st->rssi);
+    // Ask the driver to tell us when the link gets weak enough to look for a better AP
+    esp_wifi_set_rssi_threshold(CONFIG_AQM_WIFI_ROAM_RSSI);
+}
+
+static void retry_timer_cb(void* arg)
+{
+    esp_event_post(AQM_WIFI_EVENT, AQM_WIFI_EVENT_RETRY, NULL, 0, 0);
+}
+
+// After WIFI_MAX_RETRY quick retries the AP is likely down: keep trying with a doubling delay so
+// the station comes back on its own, scanning all channels every few attempts in case it moved
+static void backoff_schedule(void)
+{
+    s_conn.backoff_sec = s_conn.backoff_sec == 0 ? CONFIG_AQM_WIFI_BACKOFF_MIN_SEC : s_conn.backoff_sec * 2;
+    if (s_conn.backoff_sec > CONFIG_AQM_WIFI_BACKOFF_MAX_SEC) {
+        s_conn.backoff_sec = CONFIG_AQM_WIFI_BACKOFF_MAX_SEC;
+    }
+    ESP_LOGI(TAG, "Retrying in %us", s_conn.backoff_sec);
+    esp_timer_start_once(s_conn.retry_timer, (uint64_t)s_conn.backoff_sec * 1000000ULL);
+}
+
+static void backoff_retry(void)
+{
+    s_conn.backoff_attempts++;
+    s_conn.stats.backoff_retries++;
+    if (s_conn.cache_valid && s_conn.backoff_attempts % CONFIG_AQM_WIFI_BACKOFF_SCAN_EVERY != 0) {
+        s_conn.fast = true;
+        config_target(&s_conn.cache.bssid[0], s_conn.cache.channel);
+    } else {
+        s_conn.fast = false;
+        config_target(NULL, 0);
+    }
+    // Time to IP counts from the attempt that succeeds, not from the first failure
+    s_conn.connect_usec = esp_timer_get_time();
+    esp_wifi_connect();
+}
+
+static void on_disconnected(const wifi_event_sta_disconnected_t* event)
+{
+    bool was_connected = s_conn.connect_usec == 0;
+    if (s_conn.wifi != NULL) {
+        s_conn.wifi->connected = false;
+    }
+    if (was_connected) {
+        s_conn.stats.disconnects++;
+    }
+
+    if (s_conn.roaming) {
+        // config_target() already points at the new AP
+        s_conn.roaming = false;
+        s_conn.fast = true;
+        connect_begin();
+        return;
+    }
+    if (!was_connected && s_retry_num >= WIFI_MAX_RETRY) {
+        // A backoff attempt failed; it already chose between the cached AP and a scan
+        ESP_LOGI(TAG, "connect to the AP fail, reason %u", event->reason);
+        backoff_schedule();
+        return;
+    }
+    if (!was_connected && s_conn.fast) {
+        // The cached AP is gone or moved channel: fall back to a full scan without using a retry
+        ESP_LOGW(TAG, "Fast connect failed (reason %u), scanning", event->reason);
+        s_conn.stats.fast_fallbacks++;
+        s_conn.fast = false;
+        config_target(NULL, 0);
+        connect_begin();
+        return;
+    }
+    if (was_connected && s_conn.cache_valid) {
+        // Reconnect straight to the AP we just lost before paying for a scan
+        s_conn.fast = true;
+        config_target(&s_conn.cache.bssid[0], s_conn.cache.channel);
+    }
+
+    if (s_retry_num < WIFI_MAX_RETRY) {
+        connect_begin();
+        s_retry_num++;
+        ESP_LOGI(TAG, "retry to connect to the AP");
+    } else {
+        // Boot stops waiting here, the backoff timer keeps trying
+        s_retry_num = WIFI_MAX_RETRY;
+        xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
+        backoff_schedule();
+    }
+    ESP_LOGI(TAG, "connect to the AP fail, reason %u", event->reason);
+}
+
+static void on_roam_scan_done(void)
+{
+    wifi_ap_record_t best;
+    wifi_ap_record_t current;
+    if (!wifi_scan((const char*)&s_conn.config.sta.ssid[0], &best) || esp_wifi_sta_get_ap_info(&current) != ESP_OK) {
+        esp_wifi_set_rssi_threshold(CONFIG_AQM_WIFI_ROAM_RSSI);
+        return;
+    }
+    s_conn.stats.rssi = current.rssi;
+    if (memcmp(&best.bssid[0], &current.bssid[0], 6) == 0
+        || best.rssi < current.rssi + CONFIG_AQM_WIFI_ROAM_HYSTERESIS_DB) {
+        // Nothing better in range, wait for the next low-RSSI event
+        esp_wifi_set_rssi_threshold(CONFIG_AQM_WIFI_ROAM_RSSI);
+        return;
+    }
+    ESP_LOGI(TAG, "Roaming to " MACSTR " on channel %u (RSSI %d -> %d)", MAC2STR(best.bssid), best.primary,
+        current.rssi, best.rssi);
+    s_conn.stats.roams++;
+    s_conn.roaming = true;
+    config_target(&best.bssid[0], best.primary);
+    esp_wifi_disconnect();
+}
+
 void event_handler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data)
 {
     wifi_t *wifi = (wifi_t*)arg;
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
-        esp_wifi_connect();
+        connect_begin();
+    } else if (event_base == AQM_WIFI_EVENT && event_id == AQM_WIFI_EVENT_RETRY) {
+        backoff_retry();
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
-        if (s_retry_num < WIFI_MAX_RETRY) {
-            esp_wifi_connect();
-            s_retry_num++;
-            ESP_LOGI(TAG, "retry to connect to the AP");
-        } else {
-            xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
+        on_disconnected((const wifi_event_sta_disconnected_t*)event_data);
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_BSS_RSSI_LOW) {
+        const wifi_event_bss_rssi_low_t* event = (const wifi_event_bss_rssi_low_t*)event_data;
+        ESP_LOGI(TAG, "RSSI %d below %d, scanning for a better AP", event->rssi, CONFIG_AQM_WIFI_ROAM_RSSI);
+        s_conn.stats.rssi = event->rssi;
+        s_conn.stats.roam_scans++;
+        wifi_scan_config_t scan = {
+            .ssid = &s_conn.config.sta.ssid[0],
+            .show_hidden = true,
+        };
+        if (esp_wifi_scan_start(&scan, false) != ESP_OK) {
+            esp_wifi_set_rssi_threshold(CONFIG_AQM_WIFI_ROAM_RSSI);
         }
-        
-        if (wifi != NULL) {
-            wifi->connected = false;
-        }
-        ESP_LOGI(TAG,"connect to the AP fail");
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_SCAN_DONE) {
+        on_roam_scan_done();
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
         ESP_LOGI(TAG, "got ip: " IPSTR, IP2STR(&event->ip_info.ip));
@@ -157,37 +408,80 @@ void event_handler(void* arg, esp_event_base_t event_base, int32_t event_id, voi
             memcpy(&wifi->ip, &event->ip_info, sizeof(esp_netif_ip_info_t));
             wifi->connected = true;
         }
+        connect_done();
         s_retry_num = 0;
+        s_conn.backoff_sec = 0;
+        s_conn.backoff_attempts = 0;
+        xEventGroupClearBits(s_wifi_event_group, WIFI_FAIL_BIT);
         xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
     }
 }
 
+// Skips DHCP when CONFIG_AQM_WIFI_STATIC_IP is set; the netif then reports the address as soon
+// as the station associates
+static void apply_static_ip(esp_netif_t* netif)
+{
+    if (strlen(CONFIG_AQM_WIFI_STATIC_IP) == 0) {
+        return;
+    }
+    esp_netif_ip_info_t ip = { 0 };
+    ip.ip.addr = esp_ip4addr_aton(CONFIG_AQM_WIFI_STATIC_IP);
+    ip.netmask.addr = esp_ip4addr_aton(CONFIG_AQM_WIFI_STATIC_NETMASK);
+    ip.gw.addr = esp_ip4addr_aton(CONFIG_AQM_WIFI_STATIC_GATEWAY);
+    esp_netif_dhcpc_stop(netif);
+    ESP_ERROR_CHECK(esp_netif_set_ip_info(netif, &ip));
+    if (strlen(CONFIG_AQM_WIFI_STATIC_DNS) != 0) {
+        esp_netif_dns_info_t dns = { 0 };
+        dns.ip.type = ESP_IPADDR_TYPE_V4;
+        dns.ip.u_addr.ip4.addr = esp_ip4addr_aton(CONFIG_AQM_WIFI_STATIC_DNS);
+        esp_netif_set_dns_info(netif, ESP_NETIF_DNS_MAIN, &dns);
+    }
+    s_conn.stats.static_ip = true;
+    ESP_LOGI(TAG, "Static IP %s, gateway %s", CONFIG_AQM_WIFI_STATIC_IP, CONFIG_AQM_WIFI_STATIC_GATEWAY);
+}
+
 void wifi_init_sta(wifi_t *wifi)
 {
     ESP_LOGI(TAG, "ESP_WIFI_MODE_STA");
 
     s_wifi_event_group = xEventGroupCreate();
+    s_conn.wifi = wifi;
 
     ESP_ERROR_CHECK(esp_netif_init());
 
     ESP_ERROR_CHECK(esp_event_loop_create_default());
-    esp_netif_create_default_wifi_sta();
+    esp_netif_t* netif = esp_netif_create_default_wifi_sta();
+    apply_static_ip(netif);
 
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
+    // The cache below replaces the driver's own copy of the config in NVS
+    ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_RAM));
 
+    // Kept registered for reconnects and roaming
     esp_event_handler_instance_t instance_any_id;
     esp_event_handler_instance_t instance_got_ip;
     ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT,
                                                         ESP_EVENT_ANY_ID,
                                                         &event_handler,
-                                                        NULL,
+                                                        wifi,
                                                         &instance_any_id));
     ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT,
                                                         IP_EVENT_STA_GOT_IP,
                                                         &event_handler,
                                                         wifi,
                                                         &instance_got_ip));
+    esp_event_handler_instance_t instance_retry;
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(AQM_WIFI_EVENT,
+                                                        AQM_WIFI_EVENT_RETRY,
+                                                        &event_handler,
+                                                        wifi,
+                                                        &instance_retry));
+    const esp_timer_create_args_t retry_args = {
+        .callback = &retry_timer_cb,
+        .name = "wifi-retry",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&retry_args, &s_conn.retry_timer));
 
     wifi_config_t wifi_config = {
         .sta = {
@@ -196,16 +490,35 @@ void wifi_init_sta(wifi_t *wifi)
              * doesn't support WPA2, these mode can be enabled by commenting below line */
 	     .threshold.authmode = wifi->auth_mode,
 	     .sae_pwe_h2e = WPA3_SAE_PWE_BOTH,
+             // A full scan picks the strongest AP carrying the SSID rather than the first one found
+             .scan_method = WIFI_ALL_CHANNEL_SCAN,
+             .sort_method = WIFI_CONNECT_AP_BY_SIGNAL,
         },
     };
     if (wifi->ssid != NULL)
         strncpy((char*)&wifi_config.sta.ssid[0], &wifi->ssid[0], 32);
     if (wifi->pass != NULL)
         strncpy((char*)&wifi_config.sta.password[0], &wifi->pass[0], 64);
+#if CONFIG_AQM_POWER_SAVE
+    // Wake only for every Nth DTIM beacon; buffered frames are fetched then
+    wifi_config.sta.listen_interval = CONFIG_AQM_WIFI_LISTEN_INTERVAL;
+#endif
+    memcpy(&s_conn.config, &wifi_config, sizeof(wifi_config_t));
 
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA) );
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config) );
+    cache_load(&wifi->ssid[0]);
+    if (s_conn.cache_valid) {
+        ESP_LOGI(TAG, "Fast connect to " MACSTR " on channel %u", MAC2STR(s_conn.cache.bssid), s_conn.cache.channel);
+        s_conn.fast = true;
+        config_target(&s_conn.cache.bssid[0], s_conn.cache.channel);
+    } else {
+        ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &s_conn.config) );
+    }
+    s_conn.connect_usec = esp_timer_get_time();
     ESP_ERROR_CHECK(esp_wifi_start() );
+#if CONFIG_AQM_POWER_SAVE
+    ESP_ERROR_CHECK(esp_wifi_set_ps(WIFI_PS_MAX_MODEM));
+#endif
 
     ESP_LOGI(TAG, "wifi_init_sta finished.");
 
@@ -228,49 +541,49 @@ void wifi_init_sta(wifi_t *wifi)
     } else {
         ESP_LOGE(TAG, "UNEXPECTED EVENT");
     }
-
-    /* The event will not be processed after unregister */
-    ESP_ERROR_CHECK(esp_event_handler_instance_unregister(IP_EVENT, IP_EVENT_STA_GOT_IP, instance_got_ip));
-    ESP_ERROR_CHECK(esp_event_handler_instance_unregister(WIFI_EVENT, ESP_EVENT_ANY_ID, instance_any_id));
-    vEventGroupDelete(s_wifi_event_group);
 }
 
-void wifi_scan(void)
+bool wifi_scan(const char* ssid, wifi_ap_record_t* best)
 {
-    ESP_ERROR_CHECK(esp_netif_init());
-    ESP_ERROR_CHECK(esp_event_loop_create_default());
-    esp_netif_t *sta_netif = esp_netif_create_default_wifi_sta();
-    assert(sta_netif);
-
-    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
-    ESP_ERROR_CHECK(esp_wifi_init(&cfg));
-
     uint16_t number = EXAMPLE_ESP_DEFAULT_SCAN_LIST_SIZE;
     wifi_ap_record_t ap_info[EXAMPLE_ESP_DEFAULT_SCAN_LIST_SIZE];
     uint16_t ap_count = 0;
     memset(ap_info, 0, sizeof(ap_info));
 
-    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-    ESP_ERROR_CHECK(esp_wifi_start());
-    esp_wifi_scan_start(NULL, true);
-    ESP_ERROR_CHECK(esp_wifi_scan_get_ap_records(&number, ap_info));
+    if (esp_wifi_scan_get_ap_records(&number, ap_info) != ESP_OK) {
+        return false;
+    }
     ESP_ERROR_CHECK(esp_wifi_scan_get_ap_num(&ap_count));
     ESP_LOGI(TAG, "Total APs scanned = %u", ap_count);
-    for (int i = 0; (i < EXAMPLE_ESP_DEFAULT_SCAN_LIST_SIZE) && (i < ap_count); i++) {
+    bool found = false;
+    for (int i = 0; (i < EXAMPLE_ESP_DEFAULT_SCAN_LIST_SIZE) && (i < number); i++) {
         ESP_LOGI(TAG, "SSID \t\t%s", ap_info[i].ssid);
+        ESP_LOGI(TAG, "BSSID \t\t" MACSTR, MAC2STR(ap_info[i].bssid));
         ESP_LOGI(TAG, "RSSI \t\t%d", ap_info[i].rssi);
         print_auth_mode(ap_info[i].authmode);
         if (ap_info[i].authmode != WIFI_AUTH_WEP) {
             print_cipher_type(ap_info[i].pairwise_cipher, ap_info[i].group_cipher);
         }
         ESP_LOGI(TAG, "Channel \t\t%d\n", ap_info[i].primary);
+        if (strncmp((const char*)&ap_info[i].ssid[0], ssid, 32) == 0 && (!found || ap_info[i].rssi > best->rssi)) {
+            memcpy(best, &ap_info[i], sizeof(wifi_ap_record_t));
+            found = true;
+        }
     }
+    return found;
+}
+
+const wifi_stats_t* wifi_get_stats(void)
+{
+    return &s_conn.stats;
 }
 
 wifi_t* wifi_init(const char *ssid, const char *pass, wifi_auth_mode_t auth_mode)
 {
-    wifi_t *wifi = malloc(sizeof(wifi_t));
-    memset(wifi, 0, sizeof(wifi_t));
+    wifi_t *wifi = arena_alloc(sizeof(wifi_t));
+    if (wifi == NULL) {
+        return NULL;
+    }
     if (ssid != NULL && pass != NULL) {
         wifi->auth_mode = auth_mode;
         strncpy(&wifi->ssid[0], ssid, 32);
@@ -283,7 +596,7 @@ wifi_t* wifi_init(const char *ssid, const char *pass, wifi_auth_mode_t auth_mode
 void wifi_free(wifi_t *wifi)
 {
     if (wifi != NULL) {
-        free(wifi);
+        arena_free(wifi);
         wifi = NULL;
     }
 }
@@ -17,10 +17,30 @@ typedef struct wifi_s {
     bool connected;
 } wifi_t;
 
+typedef struct wifi_stats {
+    uint32_t connects;              // IP acquired, including reconnects and roams
+    uint32_t fast_connects;         // ...straight to the cached BSSID/channel, no scan
+    uint32_t fast_fallbacks;        // cached AP failed, fell back to a full scan
+    uint32_t backoff_retries;       // attempts after the quick retries ran out
+    uint32_t disconnects;
+    uint32_t roam_scans;            // scans started by a low-RSSI event
+    uint32_t roams;
+    uint32_t last_time_to_ip_usec;  // connect start to IP_EVENT_STA_GOT_IP
+    uint32_t min_time_to_ip_usec;
+    uint32_t max_time_to_ip_usec;
+    uint64_t sum_time_to_ip_usec;
+    uint8_t bssid[6];
+    uint8_t channel;
+    int8_t rssi;                    // at connect or at the last roam check
+    bool static_ip;
+} wifi_stats_t;
+
 // esp32 stuff
 void event_handler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data);
 void wifi_init_sta(wifi_t *wifi);
-void wifi_scan(void);
+// Picks the strongest AP carrying ssid from the last scan's results
+bool wifi_scan(const char* ssid, wifi_ap_record_t* best);
+const wifi_stats_t* wifi_get_stats(void);
 
 // our stuff
 wifi_t* wifi_init(const char *ssid, const char *pass, wifi_auth_mode_t auth_mode);
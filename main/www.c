@@ -0,0 +1,122 @@
+#include "www.h"
+
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_spi_flash.h"
+
+#include <string.h>
+
+static const char* TAG = "aqm-www";
+
+static struct {
+    const uint8_t* base;
+    const www_image_header_t* header;
+    const www_entry_t* entries;
+    spi_flash_mmap_handle_t handle;
+    www_stats_t stats;              // only touched from the HTTP server task
+} s_www;
+
+esp_err_t www_init(void)
+{
+    const esp_partition_t* part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+        WWW_PARTITION_LABEL);
+    if (part == NULL) {
+        ESP_LOGW(TAG, "No '%s' partition, dashboard disabled", WWW_PARTITION_LABEL);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    const void* ptr = NULL;
+    esp_err_t err = esp_partition_mmap(part, 0, part->size, SPI_FLASH_MMAP_DATA, &ptr, &s_www.handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to map '%s': %s", WWW_PARTITION_LABEL, esp_err_to_name(err));
+        return err;
+    }
+
+    const www_image_header_t* header = (const www_image_header_t*)ptr;
+    if (header->magic != WWW_IMAGE_MAGIC || header->version != WWW_IMAGE_VERSION || header->size > part->size
+        || sizeof(www_image_header_t) + (size_t)header->count * sizeof(www_entry_t) > header->size) {
+        ESP_LOGW(TAG, "No dashboard image in '%s', flash one built by tools/pack_www.py", WWW_PARTITION_LABEL);
+        spi_flash_munmap(s_www.handle);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    s_www.base = (const uint8_t*)ptr;
+    s_www.header = header;
+    s_www.entries = (const www_entry_t*)(s_www.base + sizeof(www_image_header_t));
+    s_www.stats.files = header->count;
+    s_www.stats.image_bytes = header->size;
+    ESP_LOGI(TAG, "Dashboard image mapped: %u files, %u bytes", header->count, header->size);
+    return ESP_OK;
+}
+
+bool www_mounted(void)
+{
+    return s_www.header != NULL;
+}
+
+const www_entry_t* www_find(const char* path)
+{
+    if (s_www.header == NULL) {
+        return NULL;
+    }
+    int lo = 0;
+    int hi = (int)s_www.header->count - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        const www_entry_t* e = &s_www.entries[mid];
+        int cmp = strncmp(path, &e->path[0], WWW_PATH_MAX);
+        if (cmp == 0) {
+            return (e->offset + e->size <= s_www.header->size) ? e : NULL;
+        }
+        if (cmp < 0) {
+            hi = mid - 1;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return NULL;
+}
+
+const uint8_t* www_data(const www_entry_t* entry)
+{
+    return s_www.base + entry->offset;
+}
+
+void www_begin_response(void)
+{
+    s_www.stats.requests++;
+    s_www.stats.active++;
+    if (s_www.stats.active > s_www.stats.max_active) {
+        s_www.stats.max_active = s_www.stats.active;
+    }
+}
+
+void www_end_response(uint32_t bytes, uint32_t ttfb_usec, uint32_t heap_bytes, bool not_modified)
+{
+    www_stats_t* st = &s_www.stats;
+    st->active--;
+    if (not_modified) {
+        st->not_modified++;
+        return;
+    }
+    st->bytes_sent += bytes;
+    st->last_ttfb_usec = ttfb_usec;
+    st->sum_ttfb_usec += ttfb_usec;
+    if (ttfb_usec > st->max_ttfb_usec) {
+        st->max_ttfb_usec = ttfb_usec;
+    }
+    st->last_heap_bytes = heap_bytes;
+    if (heap_bytes > st->max_heap_bytes) {
+        st->max_heap_bytes = heap_bytes;
+    }
+}
+
+void www_count_not_found(void)
+{
+    s_www.stats.not_found++;
+}
+
+const www_stats_t* www_get_stats(void)
+{
+    return &s_www.stats;
+}
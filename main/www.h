@@ -0,0 +1,69 @@
+#pragma once
+
+#include "esp_err.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WWW_PARTITION_LABEL "www"
+#define WWW_IMAGE_MAGIC 0x574d5141  // "AQMW"
+#define WWW_IMAGE_VERSION 1
+#define WWW_PATH_MAX 60
+
+#define WWW_FLAG_GZIP       0x1     // stored gzipped, sent with Content-Encoding: gzip
+#define WWW_FLAG_IMMUTABLE  0x2     // referenced with a ?v=<hash> suffix, safe to cache for a year
+
+// Image layout written by tools/pack_www.py
+typedef struct www_image_header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t count;
+    uint32_t size;
+    uint32_t reserved;
+} www_image_header_t;
+
+typedef struct www_entry {
+    char path[WWW_PATH_MAX];    // sorted, starts with '/'
+    char mime[32];
+    char etag[20];              // quoted strong ETag
+    uint32_t offset;            // from the start of the image
+    uint32_t size;              // stored bytes
+    uint32_t flags;
+    uint32_t reserved;
+} www_entry_t;
+
+typedef struct www_stats {
+    uint32_t files;
+    uint32_t image_bytes;
+    uint32_t requests;
+    uint32_t not_modified;      // answered 304 from If-None-Match
+    uint32_t not_found;
+    uint32_t active;            // responses in progress
+    uint32_t max_active;
+    uint64_t bytes_sent;
+    uint32_t last_ttfb_usec;    // handler entry to the first body chunk handed to the socket
+    uint32_t max_ttfb_usec;
+    uint64_t sum_ttfb_usec;
+    uint32_t last_heap_bytes;   // heap taken while a download was in flight
+    uint32_t max_heap_bytes;
+} www_stats_t;
+
+// Memory-maps the www partition; files are served directly from the mapping
+esp_err_t www_init(void);
+bool www_mounted(void);
+const www_entry_t* www_find(const char* path);
+const uint8_t* www_data(const www_entry_t* entry);
+
+// Bookkeeping for the static file handler
+void www_begin_response(void);
+void www_end_response(uint32_t bytes, uint32_t ttfb_usec, uint32_t heap_bytes, bool not_modified);
+void www_count_not_found(void);
+const www_stats_t* www_get_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,270 @@
+// Host benchmark for the adaptive sampling interval against fixed-rate sampling on a replayed
+// day: samples per hour, bytes per day on the I2C bus and to a client that fetches every new
+// sample from /api/v1/sensor, the error of the time-weighted one-minute means the history stores,
+// and how long the sampler takes to return to the fastest interval after an event starts.
+//
+//     cc -O2 -Imain -o /tmp/bench_adaptive tools/bench_adaptive.c main/sample_rate.c main/sensor_data.c -lm
+//     /tmp/bench_adaptive                          # synthetic day at 1 Hz
+//     /tmp/bench_adaptive trace.txt [step_sec]     # recorded trace
+//
+// A trace has one line per step_sec (default 1) with PM2.5, VOC index, NOx index and humidity in
+// engineering units; each line is held until the next. Settings match the Kconfig defaults:
+// 1 s fastest interval, 15 s slowest, 60 s hold.
+
+#include "sample_rate.h"
+#include "sensor_data.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DAY_SEC 86400
+#define ROLLUP_SEC 60
+#define MIN_MSEC 1000
+#define MAX_MSEC 15000
+#define HOLD_MSEC 60000
+#define MAX_EVENTS 16
+
+// Per tick: SEN5x measured values (command, 8 words with CRC) and device status (command,
+// 2 words), MCP9808 temperature (pointer, 1 word), each transfer with its address bytes
+#define I2C_BYTES_PER_SAMPLE ((1 + 2 + 1 + 24) + (1 + 2 + 1 + 6) + (1 + 1 + 1 + 2))
+
+enum { PM, VOC, NOX, RH, NUM_CHANNELS };
+
+static const int s_fields[NUM_CHANNELS] = {
+    SENSOR_PM2P5, SENSOR_VOC_INDEX, SENSOR_NOX_INDEX, SENSOR_HUMIDITY
+};
+
+typedef struct trace {
+    int16_t value[NUM_CHANNELS][DAY_SEC];
+    int num_sec;
+    int event_sec[MAX_EVENTS];
+    int num_events;
+} trace_t;
+
+static double noise(double amplitude)
+{
+    return amplitude * ((rand() % 2001) - 1000) / 1000.0;
+}
+
+static void add_event(trace_t* t, int sec)
+{
+    if (t->num_events < MAX_EVENTS) {
+        t->event_sec[t->num_events++] = sec;
+    }
+}
+
+// An indoor day: slow PM2.5 and VOC backgrounds with readout noise, three cooking events that
+// raise PM2.5, VOC and NOx for tens of minutes, and two showers that raise the humidity
+static void make_trace(trace_t* t)
+{
+    static const int cooking[] = { 7 * 3600 + 1800, 12 * 3600 + 1800, 18 * 3600 + 1800 };
+    static const int showers[] = { 7 * 3600, 21 * 3600 };
+    srand(11);
+    memset(t, 0, sizeof(trace_t));
+    double pm_bg = 6.0, voc_bg = 100.0;
+    double pm_ev = 0.0, voc_ev = 0.0, nox_ev = 0.0, rh_ev = 0.0;
+    double pm_src = 0.0, rh_src = 0.0;
+    for (int s = 0; s < DAY_SEC; s++) {
+        for (size_t i = 0; i < sizeof(cooking) / sizeof(cooking[0]); i++) {
+            if (s == cooking[i]) {
+                pm_src = 600.0;
+                add_event(t, s);
+            }
+        }
+        for (size_t i = 0; i < sizeof(showers) / sizeof(showers[0]); i++) {
+            if (s == showers[i]) {
+                rh_src = 600.0;
+                add_event(t, s);
+            }
+        }
+        // Sources run for ten minutes and decay with the room's air exchange
+        pm_ev += pm_src > 0.0 ? 0.1 : 0.0;
+        voc_ev += pm_src > 0.0 ? 0.4 : 0.0;
+        nox_ev += pm_src > 0.0 ? 0.03 : 0.0;
+        rh_ev += rh_src > 0.0 ? 0.05 : 0.0;
+        pm_src = pm_src > 0.0 ? pm_src - 1.0 : 0.0;
+        rh_src = rh_src > 0.0 ? rh_src - 1.0 : 0.0;
+        pm_ev *= 1.0 - 1.0 / 1200.0;
+        voc_ev *= 1.0 - 1.0 / 1800.0;
+        nox_ev *= 1.0 - 1.0 / 900.0;
+        rh_ev *= 1.0 - 1.0 / 900.0;
+        pm_bg += noise(0.01);
+        pm_bg = pm_bg < 2.0 ? 2.0 : pm_bg > 15.0 ? 15.0 : pm_bg;
+        voc_bg += noise(0.02);
+        voc_bg = voc_bg < 80.0 ? 80.0 : voc_bg > 120.0 ? 120.0 : voc_bg;
+
+        t->value[PM][s] = (int16_t)lround(fmax(0.0, pm_bg + pm_ev + noise(0.5)) * SENSOR_SCALE_PM);
+        t->value[VOC][s] = (int16_t)lround((voc_bg + voc_ev + noise(1.0)) * SENSOR_SCALE_INDEX);
+        t->value[NOX][s] = (int16_t)lround((1.0 + nox_ev) * SENSOR_SCALE_INDEX);
+        t->value[RH][s] = (int16_t)lround((45.0 + rh_ev + noise(0.1)) * SENSOR_SCALE_HUMIDITY);
+    }
+    t->num_sec = DAY_SEC;
+}
+
+static int load_trace(trace_t* t, const char* path, int step_sec)
+{
+    FILE* f = fopen(path, "r");
+    if (f == NULL) {
+        perror(path);
+        return -1;
+    }
+    memset(t, 0, sizeof(trace_t));
+    char line[128];
+    while (t->num_sec < DAY_SEC && fgets(&line[0], sizeof(line), f) != NULL) {
+        double v[NUM_CHANNELS];
+        if (sscanf(&line[0], "%lf %lf %lf %lf", &v[PM], &v[VOC], &v[NOX], &v[RH]) != NUM_CHANNELS) {
+            continue;
+        }
+        for (int k = 0; k < step_sec && t->num_sec < DAY_SEC; k++, t->num_sec++) {
+            for (int ch = 0; ch < NUM_CHANNELS; ch++) {
+                t->value[ch][t->num_sec] = sensor_from_float(s_fields[ch], (float)v[ch]);
+            }
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
+// Size of the /api/v1/sensor body as cJSON_Print lays it out
+static size_t sensor_json_bytes(const trace_t* t, int s)
+{
+    static const char* const keys[] = {
+        "temperature_mcp9808", "mass_concentration_pm1p0", "mass_concentration_pm2p5",
+        "mass_concentration_pm4p0", "mass_concentration_pm10p0", "ambient_humidity",
+        "ambient_temperature",
+    };
+    char text[SENSOR_FORMAT_MAX];
+    size_t n = 2 + 2;   // braces and their newlines
+    for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) {
+        int16_t v = t->value[PM][s];
+        if (i == SENSOR_HUMIDITY) {
+            v = t->value[RH][s];
+        } else if (i == SENSOR_TEMPERATURE_MCP9808) {
+            v = 22 * SENSOR_SCALE_MCP9808;
+        } else if (i == SENSOR_TEMPERATURE) {
+            v = 23 * SENSOR_SCALE_TEMPERATURE;
+        }
+        n += 1 + strlen(keys[i]) + 4 + sensor_format(&text[0], sizeof(text), (int)i, v) + 2;
+    }
+    n += 1 + strlen("\"voc_index\":\t") + (size_t)snprintf(&text[0], sizeof(text), "%d", t->value[VOC][s]) + 2;
+    n += 1 + strlen("\"nox_index\":\t") + (size_t)snprintf(&text[0], sizeof(text), "%d", t->value[NOX][s]) + 2;
+    n += 1 + strlen("\"aqi\":\t") + 2 + 2;
+    n += 1 + strlen("\"aqi_algorithm\":\t\"EPA\"") + 1;
+    return n;
+}
+
+typedef struct result {
+    int samples;
+    uint64_t json_bytes;
+    double sum_abs_err[NUM_CHANNELS];   // one-minute means against the 1 Hz truth, fixed point
+    double max_abs_err[NUM_CHANNELS];
+    int rollups;
+    int max_latency_sec;                // event start to the fastest interval
+    double sum_latency_sec;
+    double fastest_fraction;
+} result_t;
+
+static void replay(const trace_t* t, uint32_t max_msec, result_t* r)
+{
+    sample_rate_t sr;
+    sample_rate_init(&sr, MIN_MSEC, max_msec, HOLD_MSEC);
+    memset(r, 0, sizeof(result_t));
+
+    int64_t sum[NUM_CHANNELS] = { 0 };
+    uint32_t weight = 0;
+    int rollup = 0;
+    int next_event = 0;
+    int event_start = -1;
+    int s = 0;
+    while (s < t->num_sec) {
+        struct sensor_data sd;
+        sensor_data_init(&sd);
+        sd.timestamp = (int64_t)s * 1000000 + 1;
+        for (int ch = 0; ch < NUM_CHANNELS; ch++) {
+            sd.sample.value[s_fields[ch]] = t->value[ch][s];
+        }
+        uint32_t interval = sample_rate_update(&sr, &sd);
+        r->samples++;
+        r->json_bytes += sensor_json_bytes(t, s);
+
+        while (next_event < t->num_events && t->event_sec[next_event] <= s) {
+            event_start = event_start < 0 ? t->event_sec[next_event] : event_start;
+            next_event++;
+        }
+        if (event_start >= 0 && interval == MIN_MSEC) {
+            int latency = s - event_start;
+            r->sum_latency_sec += latency;
+            r->max_latency_sec = latency > r->max_latency_sec ? latency : r->max_latency_sec;
+            event_start = -1;
+        }
+
+        // Time-weighted rollups as in history.c, closed when a sample lands in a later minute
+        if (s / ROLLUP_SEC != rollup) {
+            if (weight > 0) {
+                for (int ch = 0; ch < NUM_CHANNELS; ch++) {
+                    int64_t exact = 0;
+                    for (int k = rollup * ROLLUP_SEC; k < (rollup + 1) * ROLLUP_SEC; k++) {
+                        exact += t->value[ch][k];
+                    }
+                    double err = fabs((double)sensor_mean(sum[ch], weight) - (double)exact / ROLLUP_SEC);
+                    r->sum_abs_err[ch] += err;
+                    r->max_abs_err[ch] = err > r->max_abs_err[ch] ? err : r->max_abs_err[ch];
+                }
+                r->rollups++;
+            }
+            memset(&sum[0], 0, sizeof(sum));
+            weight = 0;
+            rollup = s / ROLLUP_SEC;
+        }
+        for (int ch = 0; ch < NUM_CHANNELS; ch++) {
+            sum[ch] += (int64_t)t->value[ch][s] * interval;
+        }
+        weight += interval;
+        s += (int)(interval / 1000);
+    }
+    r->fastest_fraction = (double)sr.stats.fastest_msec / (double)sr.stats.sampled_msec;
+}
+
+static void print_result(const char* name, const result_t* r, int num_sec, int num_events)
+{
+    double days = num_sec / (double)DAY_SEC;
+    printf("%-9s %7.0f samples/h  %6.0f KB/day JSON  %6.0f KB/day I2C  fastest %3.0f%% of the time\n",
+        name, r->samples * 3600.0 / num_sec, r->json_bytes / days / 1024.0,
+        r->samples * (double)I2C_BYTES_PER_SAMPLE / days / 1024.0, 100.0 * r->fastest_fraction);
+    printf("          1-min mean error avg/max: PM2.5 %.2f/%.2f ug/m3  VOC %.2f/%.2f  NOx %.2f/%.2f  RH %.3f/%.3f %%\n",
+        r->sum_abs_err[PM] / r->rollups / SENSOR_SCALE_PM, r->max_abs_err[PM] / SENSOR_SCALE_PM,
+        r->sum_abs_err[VOC] / r->rollups / SENSOR_SCALE_INDEX, r->max_abs_err[VOC] / SENSOR_SCALE_INDEX,
+        r->sum_abs_err[NOX] / r->rollups / SENSOR_SCALE_INDEX, r->max_abs_err[NOX] / SENSOR_SCALE_INDEX,
+        r->sum_abs_err[RH] / r->rollups / SENSOR_SCALE_HUMIDITY, r->max_abs_err[RH] / SENSOR_SCALE_HUMIDITY);
+    if (num_events > 0) {
+        printf("          event to fastest interval avg/max: %.1f/%d s over %d events\n",
+            r->sum_latency_sec / num_events, r->max_latency_sec, num_events);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    static trace_t trace;
+    if (argc > 1) {
+        if (load_trace(&trace, argv[1], argc > 2 ? atoi(argv[2]) : 1) != 0) {
+            return 1;
+        }
+    } else {
+        make_trace(&trace);
+    }
+    if (trace.num_sec < 2 * ROLLUP_SEC) {
+        fprintf(stderr, "Need at least %d seconds of readings\n", 2 * ROLLUP_SEC);
+        return 1;
+    }
+
+    result_t fixed, adaptive;
+    replay(&trace, MIN_MSEC, &fixed);
+    replay(&trace, MAX_MSEC, &adaptive);
+    printf("%d s replayed, %d events, %d I2C bytes per sample\n", trace.num_sec, trace.num_events,
+        I2C_BYTES_PER_SAMPLE);
+    print_result("fixed", &fixed, trace.num_sec, 0);
+    print_result("adaptive", &adaptive, trace.num_sec, trace.num_events);
+    return 0;
+}
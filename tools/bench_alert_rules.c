@@ -0,0 +1,151 @@
+// Host benchmark for alert rule evaluation. 100 rules of the three kinds (level, level held
+// "for" a time, "rises/falls by ... in ...") over every field are compiled once, then a day of
+// 1 Hz indoor readings is replayed through alert_rule_eval() the way alerts_evaluate() does it:
+// each rule reads its field from the sample and updates its own state. Reports ns per sample for
+// all 100 rules and per rule evaluation, and for comparison the cost when every rule is parsed
+// again on each sample. Exits with 1 if a rule does not compile or the two replays disagree.
+//
+//     cc -O2 -Imain -o /tmp/bench_alert_rules tools/bench_alert_rules.c main/alert_rules.c main/sensor_data.c -lm
+//     /tmp/bench_alert_rules
+
+#include "alert_rules.h"
+#include "sensor_data.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define NUM_RULES 100
+#define NUM_SAMPLES 86400
+
+static struct sensor_data s_trace[NUM_SAMPLES];
+static char s_exprs[NUM_RULES][64];
+static alert_rule_t s_rules[NUM_RULES];
+static alert_state_t s_states[NUM_RULES];
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double noise(double amplitude)
+{
+    return amplitude * ((rand() % 2001) - 1000) / 1000.0;
+}
+
+static void make_trace(void)
+{
+    srand(32);
+    double pm = 6.0, rh = 42.0, voc = 100.0, nox = 1.0;
+    for (int s = 0; s < NUM_SAMPLES; s++) {
+        double hour = s / 3600.0;
+        bool cooking = (hour >= 7.5 && hour < 8.0) || (hour >= 19.0 && hour < 19.75);
+        pm += ((cooking ? 80.0 : 6.0) - pm) / (cooking ? 120.0 : 900.0) + noise(0.3);
+        pm = fmax(pm, 0.0);
+        rh += ((cooking ? 55.0 : 42.0) - rh) / 600.0 + noise(0.05);
+        voc += ((cooking ? 300.0 : 100.0) - voc) / 300.0 + noise(1.0);
+        nox += ((cooking ? 50.0 : 1.0) - nox) / 300.0 + noise(0.2);
+        nox = fmax(nox, 1.0);
+        double t = 21.0 + 1.5 * sin(2.0 * M_PI * (hour - 9.0) / 24.0) + noise(0.03);
+        struct sensor_data* sd = &s_trace[s];
+        sensor_data_init(sd);
+        sd->timestamp = (int64_t)(s + 1) * 1000000;
+        sd->sample.value[SENSOR_TEMPERATURE_MCP9808] = sensor_from_float(SENSOR_TEMPERATURE_MCP9808, (float)t);
+        sd->sample.value[SENSOR_PM1P0] = sensor_from_float(SENSOR_PM1P0, (float)(pm * 0.7));
+        sd->sample.value[SENSOR_PM2P5] = sensor_from_float(SENSOR_PM2P5, (float)pm);
+        sd->sample.value[SENSOR_PM4P0] = sensor_from_float(SENSOR_PM4P0, (float)(pm * 1.1));
+        sd->sample.value[SENSOR_PM10P0] = sensor_from_float(SENSOR_PM10P0, (float)(pm * 1.2));
+        sd->sample.value[SENSOR_HUMIDITY] = sensor_from_float(SENSOR_HUMIDITY, (float)rh);
+        sd->sample.value[SENSOR_TEMPERATURE] = sensor_from_float(SENSOR_TEMPERATURE, (float)(t + 0.8));
+        sd->sample.value[SENSOR_VOC_INDEX] = sensor_from_float(SENSOR_VOC_INDEX, (float)voc);
+        sd->sample.value[SENSOR_NOX_INDEX] = sensor_from_float(SENSOR_NOX_INDEX, (float)nox);
+        sd->aqi = (int16_t)lround(pm <= 9.0 ? pm * 50.0 / 9.0 : 51.0 + (pm - 9.1) * 49.0 / 26.3);
+    }
+}
+
+// Rules cycle through the fields and kinds, with thresholds spread around each field's range
+static void make_rules(void)
+{
+    static const struct {
+        const char* field;
+        float level;
+        float step;
+    } fields[] = {
+        { "pm2p5", 12, 5 }, { "pm10p0", 20, 8 }, { "aqi", 50, 10 }, { "humidity", 45, 2 },
+        { "temperature", 21, 0.5f }, { "voc_index", 150, 20 }, { "nox_index", 10, 5 },
+    };
+    const int num_fields = sizeof(fields) / sizeof(fields[0]);
+    for (int r = 0; r < NUM_RULES; r++) {
+        const char* f = fields[r % num_fields].field;
+        float level = fields[r % num_fields].level + fields[r % num_fields].step * (r / num_fields % 4);
+        float change = fields[r % num_fields].step * 2;
+        char* e = &s_exprs[r][0];
+        switch (r % 6) {
+        case 0: snprintf(e, sizeof(s_exprs[r]), "%s > %g", f, level); break;
+        case 1: snprintf(e, sizeof(s_exprs[r]), "%s >= %g for 60s", f, level); break;
+        case 2: snprintf(e, sizeof(s_exprs[r]), "%s < %g clear %g", f, level, level * 1.05f); break;
+        case 3: snprintf(e, sizeof(s_exprs[r]), "%s <= %g for 5m", f, level); break;
+        case 4: snprintf(e, sizeof(s_exprs[r]), "%s rises by %g in 5m", f, change); break;
+        case 5: snprintf(e, sizeof(s_exprs[r]), "%s falls by %g in 15m", f, change); break;
+        }
+    }
+}
+
+static bool compile_all(void)
+{
+    for (int r = 0; r < NUM_RULES; r++) {
+        char err[64];
+        if (!alert_rule_compile(&s_exprs[r][0], &s_rules[r], &err[0], sizeof(err))) {
+            printf("'%s' did not compile: %s\n", &s_exprs[r][0], &err[0]);
+            return false;
+        }
+        alert_state_reset(&s_states[r]);
+    }
+    return true;
+}
+
+int main(void)
+{
+    make_trace();
+    make_rules();
+    if (!compile_all()) {
+        return 1;
+    }
+
+    uint32_t transitions = 0;
+    double start = now_sec();
+    for (int s = 0; s < NUM_SAMPLES; s++) {
+        const struct sensor_data* sd = &s_trace[s];
+        for (int r = 0; r < NUM_RULES; r++) {
+            const alert_rule_t* rule = &s_rules[r];
+            transitions += alert_rule_eval(rule, &s_states[r], alert_field_value(sd, rule->field), sd->timestamp);
+        }
+    }
+    double compiled = (now_sec() - start) / NUM_SAMPLES * 1e9;
+
+    // The same replay, parsing every rule again on each sample
+    uint32_t reparsed_transitions = 0;
+    for (int r = 0; r < NUM_RULES; r++) {
+        alert_state_reset(&s_states[r]);
+    }
+    start = now_sec();
+    for (int s = 0; s < NUM_SAMPLES; s++) {
+        const struct sensor_data* sd = &s_trace[s];
+        for (int r = 0; r < NUM_RULES; r++) {
+            alert_rule_t rule;
+            char err[64];
+            alert_rule_compile(&s_exprs[r][0], &rule, &err[0], sizeof(err));
+            reparsed_transitions += alert_rule_eval(&rule, &s_states[r], alert_field_value(sd, rule.field),
+                sd->timestamp);
+        }
+    }
+    double reparsed = (now_sec() - start) / NUM_SAMPLES * 1e9;
+
+    printf("%d rules, %d samples at 1 Hz, %u alert transitions\n", NUM_RULES, NUM_SAMPLES, transitions);
+    printf("  compiled  %8.1f ns/sample  %6.2f ns/rule\n", compiled, compiled / NUM_RULES);
+    printf("  reparsed  %8.1f ns/sample  %6.2f ns/rule\n", reparsed, reparsed / NUM_RULES);
+    return transitions != reparsed_transitions;
+}
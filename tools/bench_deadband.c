@@ -0,0 +1,252 @@
+// Host benchmark for report-by-exception telemetry and swinging-door history export: messages and
+// bytes per day against publishing every sample, and rows and bytes of a day's history export
+// against the uncompressed rows, with the largest interpolation error of the compressed export.
+//
+//     cc -O2 -Imain -o /tmp/bench_deadband tools/bench_deadband.c main/deadband.c main/swinging_door.c main/alert_rules.c main/sensor_data.c -lm
+//     /tmp/bench_deadband                  # synthetic office and factory days at 1 Hz
+//     /tmp/bench_deadband trace.txt        # recorded trace
+//
+// A trace has one line per second with the nine sensor fields in sensor_data.h order, in
+// engineering units. MQTT bytes add the PUBLISH header, topic and packet id and the PUBACK of
+// QoS 1; TCP/IP framing is left out.
+
+#include "deadband.h"
+#include "swinging_door.h"
+#include "sensor_data.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DAY_SEC 86400
+#define ROLLUP_SEC 60
+#define HEARTBEAT_MSEC 300000
+#define TOPIC "esper-aqm/samples"
+#define MQTT_OVERHEAD (2 + 2 + (int)sizeof(TOPIC) - 1 + 2 + 4)
+
+static sensor_sample_t s_trace[DAY_SEC];
+
+static double noise(double amplitude)
+{
+    return amplitude * ((rand() % 2001) - 1000) / 1000.0;
+}
+
+static void set(sensor_sample_t* s, double temp, double pm, double rh, double voc, double nox)
+{
+    s->value[SENSOR_TEMPERATURE_MCP9808] = sensor_from_float(SENSOR_TEMPERATURE_MCP9808, (float)(temp + noise(0.06)));
+    s->value[SENSOR_PM1P0] = sensor_from_float(SENSOR_PM1P0, (float)fmax(0.0, pm * 0.7 + noise(0.3)));
+    s->value[SENSOR_PM2P5] = sensor_from_float(SENSOR_PM2P5, (float)fmax(0.0, pm + noise(0.4)));
+    s->value[SENSOR_PM4P0] = sensor_from_float(SENSOR_PM4P0, (float)fmax(0.0, pm * 1.1 + noise(0.5)));
+    s->value[SENSOR_PM10P0] = sensor_from_float(SENSOR_PM10P0, (float)fmax(0.0, pm * 1.2 + noise(0.6)));
+    s->value[SENSOR_HUMIDITY] = sensor_from_float(SENSOR_HUMIDITY, (float)(rh + noise(0.1)));
+    s->value[SENSOR_TEMPERATURE] = sensor_from_float(SENSOR_TEMPERATURE, (float)(temp + 0.8 + noise(0.02)));
+    s->value[SENSOR_VOC_INDEX] = sensor_from_float(SENSOR_VOC_INDEX, (float)round(voc + noise(0.6)));
+    s->value[SENSOR_NOX_INDEX] = sensor_from_float(SENSOR_NOX_INDEX, (float)round(nox));
+}
+
+// Office: HVAC holding 21.5 °C with a 20-minute cycle, occupancy from 8 to 18 raising VOC and
+// CO2-driven ventilation, low PM and a lunch peak
+static void make_office(void)
+{
+    srand(21);
+    double pm = 4.0, voc = 100.0, rh = 40.0;
+    for (int s = 0; s < DAY_SEC; s++) {
+        double hour = s / 3600.0;
+        bool occupied = hour >= 8.0 && hour < 18.0;
+        double hvac = 0.3 * sin(2.0 * M_PI * s / 1200.0);
+        double lunch = hour >= 12.0 && hour < 13.0 ? 6.0 : 0.0;
+        pm += (3.0 + lunch + (occupied ? 2.0 : 0.0) - pm) / 900.0 + noise(0.01);
+        voc += ((occupied ? 170.0 : 100.0) - voc) / 1800.0;
+        rh += ((occupied ? 44.0 : 38.0) - rh) / 3600.0;
+        set(&s_trace[s], 21.5 + hvac, pm, rh, voc, 1.0);
+    }
+}
+
+// Factory floor: two shifts from 6 to 22, machines cycling every 90 seconds with PM bursts,
+// forklift NOx, warm and drifting temperature
+static void make_factory(void)
+{
+    srand(22);
+    double pm = 15.0, voc = 150.0, nox = 5.0, temp = 24.0;
+    for (int s = 0; s < DAY_SEC; s++) {
+        double hour = s / 3600.0;
+        bool shift = hour >= 6.0 && hour < 22.0;
+        double burst = shift && (s % 90) < 20 ? 25.0 : 0.0;
+        pm += ((shift ? 35.0 : 12.0) + burst - pm) / 40.0 + noise(0.3);
+        voc += ((shift ? 260.0 : 150.0) - voc) / 600.0 + noise(1.0);
+        nox += ((shift && rand() % 400 == 0 ? 60.0 : shift ? 12.0 : 3.0) - nox) / 120.0;
+        temp += ((shift ? 27.0 : 22.0) - temp) / 5400.0;
+        set(&s_trace[s], temp, pm, 50.0 + 3.0 * sin(2.0 * M_PI * s / DAY_SEC), voc, nox);
+    }
+}
+
+static int load_trace(const char* path)
+{
+    FILE* f = fopen(path, "r");
+    if (f == NULL) {
+        perror(path);
+        return 0;
+    }
+    int n = 0;
+    char line[256];
+    while (n < DAY_SEC && fgets(&line[0], sizeof(line), f) != NULL) {
+        char* p = &line[0];
+        int fields = 0;
+        for (; fields < SENSOR_NUM_FIELDS; fields++) {
+            char* end;
+            double v = strtod(p, &end);
+            if (end == p) {
+                break;
+            }
+            s_trace[n].value[fields] = sensor_from_float(fields, (float)v);
+            p = end;
+        }
+        n += fields == SENSOR_NUM_FIELDS;
+    }
+    fclose(f);
+    return n;
+}
+
+typedef struct telemetry_result {
+    uint32_t messages;
+    uint64_t payload;
+    uint64_t wire;
+    uint32_t heartbeats;
+    uint32_t fields;
+} telemetry_result_t;
+
+static void publish_day(int n, bool enabled, telemetry_result_t* r)
+{
+    deadband_t db;
+    deadband_init(&db, enabled, HEARTBEAT_MSEC);
+    memset(r, 0, sizeof(telemetry_result_t));
+    char json[DEADBAND_JSON_MAX];
+    for (int s = 0; s < n; s++) {
+        struct sensor_data sd;
+        sensor_data_init(&sd);
+        sd.timestamp = (int64_t)(s + 1) * 1000000;
+        sd.sample = s_trace[s];
+        uint32_t mask = deadband_check(&db, &sd);
+        if (mask != 0) {
+            size_t len = deadband_format_json(&json[0], sizeof(json), 1700000000u + (uint32_t)s, &sd, mask);
+            r->messages++;
+            r->payload += len;
+            r->wire += len + MQTT_OVERHEAD;
+        }
+    }
+    r->heartbeats = db.stats.heartbeats;
+    r->fields = db.stats.fields_sent;
+}
+
+// Length of a row as GET /api/v1/history writes it with every field
+static size_t row_bytes(const history_row_t* row)
+{
+    char text[SENSOR_FORMAT_MAX];
+    size_t len = (size_t)snprintf(&text[0], sizeof(text), "%u", row->time) + 4;
+    for (int ch = 0; ch < HISTORY_NUM_CHANNELS; ch++) {
+        len += 1 + sensor_format(&text[0], sizeof(text), ch, row->value[ch]);
+    }
+    return len;
+}
+
+static double interpolate(const history_row_t* a, const history_row_t* b, uint32_t t, int ch)
+{
+    if (b->time == a->time) {
+        return a->value[ch];
+    }
+    double f = (double)(t - a->time) / (double)(b->time - a->time);
+    return a->value[ch] + f * (b->value[ch] - a->value[ch]);
+}
+
+static void export_day(int n)
+{
+    static history_row_t rows[DAY_SEC / ROLLUP_SEC];
+    static history_row_t kept[DAY_SEC / ROLLUP_SEC];
+    int num_rows = n / ROLLUP_SEC;
+    size_t raw_bytes = 0;
+    for (int r = 0; r < num_rows; r++) {
+        rows[r].time = 1700000000u + (uint32_t)(r * ROLLUP_SEC);
+        for (int ch = 0; ch < HISTORY_NUM_CHANNELS; ch++) {
+            int64_t sum = 0;
+            for (int s = r * ROLLUP_SEC; s < (r + 1) * ROLLUP_SEC; s++) {
+                sum += s_trace[s].value[ch];
+            }
+            rows[r].value[ch] = sensor_mean(sum, ROLLUP_SEC);
+        }
+        raw_bytes += row_bytes(&rows[r]);
+    }
+
+    int16_t dev[HISTORY_NUM_CHANNELS];
+    for (int ch = 0; ch < HISTORY_NUM_CHANNELS; ch++) {
+        dev[ch] = deadband_abs(ch);
+    }
+    swinging_door_t door;
+    swinging_door_init(&door, (1u << HISTORY_NUM_CHANNELS) - 1, &dev[0], 2 * ROLLUP_SEC);
+    int num_kept = 0;
+    for (int r = 0; r < num_rows; r++) {
+        if (swinging_door_push(&door, &rows[r], &kept[num_kept])) {
+            num_kept++;
+        }
+    }
+    if (swinging_door_finish(&door, &kept[num_kept])) {
+        num_kept++;
+    }
+    size_t sdt_bytes = 0;
+    for (int k = 0; k < num_kept; k++) {
+        sdt_bytes += row_bytes(&kept[k]);
+    }
+
+    // Worst error in units of each channel's deviation
+    double worst = 0.0;
+    int k = 0;
+    for (int r = 0; r < num_rows; r++) {
+        while (k + 1 < num_kept && kept[k + 1].time <= rows[r].time) {
+            k++;
+        }
+        const history_row_t* b = &kept[k + 1 < num_kept ? k + 1 : k];
+        for (int ch = 0; ch < HISTORY_NUM_CHANNELS; ch++) {
+            double err = fabs(interpolate(&kept[k], b, rows[r].time, ch) - rows[r].value[ch]) / dev[ch];
+            worst = err > worst ? err : worst;
+        }
+    }
+    printf("  history  %5d rows %7zu bytes -> sdt %5d rows %7zu bytes (%.1fx), max error %.2f of the deviation\n",
+        num_rows, raw_bytes, num_kept, sdt_bytes, (double)raw_bytes / sdt_bytes, worst);
+}
+
+static void run(const char* name, int n)
+{
+    double days = n / (double)DAY_SEC;
+    telemetry_result_t every, change;
+    publish_day(n, false, &every);
+    publish_day(n, true, &change);
+    printf("%s (%d s)\n", name, n);
+    printf("  every sample  %6.0f msgs/day %7.0f KB/day payload %7.0f KB/day MQTT\n",
+        every.messages / days, every.payload / days / 1024.0, every.wire / days / 1024.0);
+    printf("  on change     %6.0f msgs/day %7.0f KB/day payload %7.0f KB/day MQTT"
+        "  (%.1fx fewer msgs, %.1fx fewer bytes; %u heartbeats, %.1f fields/msg)\n",
+        change.messages / days, change.payload / days / 1024.0, change.wire / days / 1024.0,
+        (double)every.messages / change.messages, (double)every.wire / change.wire,
+        change.heartbeats, (double)change.fields / change.messages);
+    if (n >= 2 * ROLLUP_SEC) {
+        export_day(n);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1) {
+        int n = load_trace(argv[1]);
+        if (n == 0) {
+            fprintf(stderr, "No readings in %s\n", argv[1]);
+            return 1;
+        }
+        run(argv[1], n);
+        return 0;
+    }
+    make_office();
+    run("office", DAY_SEC);
+    make_factory();
+    run("factory", DAY_SEC);
+    return 0;
+}
@@ -0,0 +1,119 @@
+// Host benchmark for I2C bytes per display refresh on each backend. The real HD44780 and
+// SSD1306/SH1106 drivers write to a bus stub that only counts. 5000 samples of a noisy 1 Hz
+// indoor trace are drawn through the layouts, cycling all screens every 5 s as the display task
+// does by default. Refreshes are split into steady ones and screen switches, and compared with
+// rewriting the whole panel: every character cell on an HD44780, every page of the OLED.
+//
+//     cc -O2 -Itools/host -Imain -o /tmp/bench_display tools/bench_display.c main/lcd_layout.c main/lcd_glyphs.c main/lcd_graph.c main/display.c main/display_hd44780.c main/display_ssd1306.c main/lcd_ascii.c main/alert_rules.c main/sensor_data.c tools/host/host_stubs.c -lm
+//     /tmp/bench_display
+
+#include "host_stubs.h"
+#include "lcd_ascii.h"
+#include "lcd_layout.h"
+#include "sensor_data.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define NUM_SAMPLES 5000
+#define WINDOW_SEC 5
+#define HD44780_CHAR_BYTES 4                    // two nibbles, each strobed with E high then low
+#define OLED_FULL_BYTES (8 * (4 + 1 + 128))     // per page: address commands, data control byte, 128 columns
+
+static struct sensor_data s_trace[NUM_SAMPLES];
+
+static double noise(double amplitude)
+{
+    return amplitude * ((rand() % 2001) - 1000) / 1000.0;
+}
+
+// Indoor readings with a cooking episode in the middle
+static void make_trace(void)
+{
+    srand(37);
+    double pm = 6.0, rh = 42.0;
+    for (int s = 0; s < NUM_SAMPLES; s++) {
+        bool cooking = s >= 2000 && s < 2600;
+        pm += ((cooking ? 60.0 : 6.0) - pm) / (cooking ? 120.0 : 600.0) + noise(0.2);
+        pm = fmax(pm, 0.0);
+        rh += (42.0 - rh) / 900.0 + noise(0.03);
+        double t = 21.5 + 0.3 * sin(2.0 * M_PI * s / 1200.0) + noise(0.03);
+        struct sensor_data* sd = &s_trace[s];
+        sensor_data_init(sd);
+        sd->timestamp = (int64_t)(s + 1) * 1000000;
+        sd->sample.value[SENSOR_TEMPERATURE_MCP9808] = sensor_from_float(SENSOR_TEMPERATURE_MCP9808, (float)t);
+        sd->sample.value[SENSOR_TEMPERATURE] = sensor_from_float(SENSOR_TEMPERATURE, (float)(t + 0.8));
+        sd->sample.value[SENSOR_HUMIDITY] = sensor_from_float(SENSOR_HUMIDITY, (float)rh);
+        sd->sample.value[SENSOR_PM1P0] = sensor_from_float(SENSOR_PM1P0, (float)(pm * 0.7));
+        sd->sample.value[SENSOR_PM2P5] = sensor_from_float(SENSOR_PM2P5, (float)pm);
+        sd->sample.value[SENSOR_PM4P0] = sensor_from_float(SENSOR_PM4P0, (float)(pm * 1.1));
+        sd->sample.value[SENSOR_PM10P0] = sensor_from_float(SENSOR_PM10P0, (float)(pm * 1.2));
+        sd->sample.value[SENSOR_VOC_INDEX] = sensor_from_float(SENSOR_VOC_INDEX, 100.0f);
+        sd->sample.value[SENSOR_NOX_INDEX] = sensor_from_float(SENSOR_NOX_INDEX, 1.0f);
+        sd->aqi = (int16_t)lround(pm <= 9.0 ? pm * 50.0 / 9.0 : 51.0 + (pm - 9.1) * 49.0 / 26.3);
+    }
+}
+
+static void run(const char* name, display_t* disp, uint32_t create_bytes, uint32_t full_bytes)
+{
+    static lcd_layout_t layout;
+    lcd_layout_init(&layout, disp);
+    uint64_t steady_bytes = 0, switch_bytes = 0;
+    uint32_t steady = 0, switches = 0, steady_max = 0, switch_max = 0;
+    int screen = LCD_SCREEN_TEMPERATURE;
+    for (int s = 0; s < NUM_SAMPLES; s++) {
+        lcd_layout_record(&layout, &s_trace[s]);
+        bool switching = s % WINDOW_SEC == 0;
+        if (switching) {
+            screen = s == 0 ? screen : lcd_layout_next_screen(screen, LCD_SCREENS_ALL);
+        }
+        lcd_layout_show(&layout, screen);
+        lcd_layout_render(&layout, &s_trace[s]);
+        uint32_t bytes = disp->stats.last_refresh_bytes;
+        if (switching) {
+            switches++;
+            switch_bytes += bytes;
+            switch_max = bytes > switch_max ? bytes : switch_max;
+        } else {
+            steady++;
+            steady_bytes += bytes;
+            steady_max = bytes > steady_max ? bytes : steady_max;
+        }
+    }
+    printf("  %-13s %4u B   %7.1f B %4u B   %7.1f B %4u B   %5u B\n", name, create_bytes,
+        (double)steady_bytes / steady, steady_max, (double)switch_bytes / switches, switch_max, full_bytes);
+    display_free(disp);
+}
+
+static void run_hd44780(i2c_bus_dev_t* dev, uint8_t rows, uint8_t cols)
+{
+    char name[16];
+    snprintf(&name[0], sizeof(name), "HD44780 %ux%u", cols, rows);
+    uint64_t start = host_i2c_bytes_written();
+    display_t* disp = display_hd44780_create(dev, rows, cols);
+    run(&name[0], disp, (uint32_t)(host_i2c_bytes_written() - start),
+        rows * (HD44780_CHAR_BYTES + cols * HD44780_CHAR_BYTES));
+}
+
+static void run_oled(i2c_bus_dev_t* dev, bool sh1106)
+{
+    uint64_t start = host_i2c_bytes_written();
+    display_t* disp = display_ssd1306_create(dev, sh1106);
+    run(sh1106 ? "SH1106" : "SSD1306", disp, (uint32_t)(host_i2c_bytes_written() - start), OLED_FULL_BYTES);
+}
+
+int main(void)
+{
+    i2c_bus_dev_t* lcd = i2c_bus_add_device(0x27, LCD_PCF8574_MAX_FREQ_HZ, I2C_BUS_PRIO_LOW);
+    i2c_bus_dev_t* oled = i2c_bus_add_device(0x3c, I2C_BUS_FREQ_FAST, I2C_BUS_PRIO_LOW);
+    make_trace();
+    printf("%d samples at 1 Hz, all %d screens every %d s; per refresh:\n", NUM_SAMPLES, LCD_NUM_SCREENS,
+        WINDOW_SEC);
+    printf("  %-13s %6s   %-14s   %-14s   %s\n", "", "init", "steady avg max", "switch avg max", "whole panel");
+    run_hd44780(lcd, 2, 16);
+    run_hd44780(lcd, 4, 20);
+    run_oled(oled, false);
+    run_oled(oled, true);
+    return 0;
+}
@@ -0,0 +1,193 @@
+// Host benchmark for the fixed-point sample path against the float path it replaced.
+//
+//     cc -O2 -Imain -o /tmp/bench_fixed tools/bench_fixed.c main/sensor_data.c main/history_codec.c -lm
+//     /tmp/bench_fixed
+//
+// Measures formatting a sample as text (snprintf("%.*f") vs sensor_format()), averaging a rollup
+// period (float sums plus power-of-two quantization vs integer sums), and the history codec on a
+// synthetic indoor-air trace: bytes per row and encode time. Numbers are for the host CPU; the
+// ESP32-S3 FPU makes float adds cheap, but printf's float path and soft double math are not.
+
+#include "sensor_data.h"
+#include "history_codec.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define NUM_SAMPLES 100000
+#define ROLLUP 60
+
+// Layout of struct sensor_data before the fixed-point change, for the size comparison
+struct legacy_sensor_data {
+    int64_t timestamp;
+    float temperature_mcp9808;
+    float pm[4];
+    float humidity;
+    float temperature;
+    int16_t voc_index;
+    int16_t nox_index;
+    int16_t aqi;
+    int16_t aqi_sub[AQI_NUM_POLLUTANTS];
+    uint8_t aqi_dominant;
+    uint8_t aqi_algorithm;
+    uint32_t sen5x_status;
+    int16_t sen5x_error;
+};
+
+struct legacy_history_row {
+    uint32_t time;
+    float value[HISTORY_NUM_CHANNELS];
+};
+
+static const int s_legacy_decimals[SENSOR_NUM_FIELDS] = { 2, 1, 1, 1, 1, 1, 1, 1, 1 };
+static const int s_legacy_shift[SENSOR_NUM_FIELDS] = { 4, 4, 4, 4, 4, 4, 6, 0, 0 };
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Slowly drifting readings with sensor noise, in fixed point
+static void make_trace(sensor_sample_t* trace, int n)
+{
+    srand(1);
+    double pm = 8.0, rh = 45.0, t = 22.0, voc = 100.0;
+    for (int i = 0; i < n; i++) {
+        pm += ((rand() % 201) - 100) / 1000.0;
+        pm = pm < 0.5 ? 0.5 : pm;
+        rh += ((rand() % 201) - 100) / 5000.0;
+        t += ((rand() % 201) - 100) / 20000.0;
+        voc += ((rand() % 201) - 100) / 500.0;
+        int16_t* v = &trace[i].value[0];
+        v[SENSOR_TEMPERATURE_MCP9808] = (int16_t)lround((t - 0.4) * SENSOR_SCALE_MCP9808);
+        v[SENSOR_PM1P0] = (int16_t)lround(pm * 0.7 * SENSOR_SCALE_PM);
+        v[SENSOR_PM2P5] = (int16_t)lround(pm * SENSOR_SCALE_PM);
+        v[SENSOR_PM4P0] = (int16_t)lround(pm * 1.1 * SENSOR_SCALE_PM);
+        v[SENSOR_PM10P0] = (int16_t)lround(pm * 1.2 * SENSOR_SCALE_PM);
+        v[SENSOR_HUMIDITY] = (int16_t)lround(rh * SENSOR_SCALE_HUMIDITY + (rand() % 5 - 2));
+        v[SENSOR_TEMPERATURE] = (int16_t)lround(t * SENSOR_SCALE_TEMPERATURE + (rand() % 5 - 2));
+        v[SENSOR_VOC_INDEX] = (int16_t)lround(voc * SENSOR_SCALE_INDEX);
+        v[SENSOR_NOX_INDEX] = 10;
+    }
+}
+
+static void bench_format(const sensor_sample_t* trace)
+{
+    float floats[SENSOR_NUM_FIELDS];
+    char buf[SENSOR_FORMAT_MAX];
+    size_t total = 0;
+
+    double start = now_sec();
+    for (int i = 0; i < NUM_SAMPLES; i++) {
+        for (int f = 0; f < SENSOR_NUM_FIELDS; f++) {
+            floats[f] = sensor_to_float(f, trace[i].value[f]);
+            total += (size_t)snprintf(&buf[0], sizeof(buf), "%.*f", s_legacy_decimals[f], floats[f]);
+        }
+    }
+    double t_float = now_sec() - start;
+
+    start = now_sec();
+    for (int i = 0; i < NUM_SAMPLES; i++) {
+        for (int f = 0; f < SENSOR_NUM_FIELDS; f++) {
+            total += sensor_format_decimals(&buf[0], sizeof(buf), f, trace[i].value[f], s_legacy_decimals[f]);
+        }
+    }
+    double t_fixed = now_sec() - start;
+
+    double per = 1e9 / ((double)NUM_SAMPLES * SENSOR_NUM_FIELDS);
+    printf("format     float snprintf %6.1f ns/value   fixed %6.1f ns/value   (%.1fx)   [%zu chars]\n",
+        t_float * per, t_fixed * per, t_float / t_fixed, total);
+}
+
+static void bench_rollup(const sensor_sample_t* trace)
+{
+    volatile float fsink = 0.0f;
+    volatile int32_t isink = 0;
+
+    double start = now_sec();
+    for (int i = 0; i + ROLLUP <= NUM_SAMPLES; i += ROLLUP) {
+        for (int f = 0; f < SENSOR_NUM_FIELDS; f++) {
+            float sum = 0.0f;
+            for (int k = 0; k < ROLLUP; k++) {
+                sum += (float)trace[i + k].value[f] / (float)sensor_scale(f);
+            }
+            float mean = sum / ROLLUP;
+            fsink = ldexpf(roundf(ldexpf(mean, s_legacy_shift[f])), -s_legacy_shift[f]);
+        }
+    }
+    double t_float = now_sec() - start;
+
+    start = now_sec();
+    for (int i = 0; i + ROLLUP <= NUM_SAMPLES; i += ROLLUP) {
+        for (int f = 0; f < SENSOR_NUM_FIELDS; f++) {
+            int32_t sum = 0;
+            for (int k = 0; k < ROLLUP; k++) {
+                sum += trace[i + k].value[f];
+            }
+            isink = sensor_mean(sum, ROLLUP);
+        }
+    }
+    double t_fixed = now_sec() - start;
+    (void)fsink;
+    (void)isink;
+
+    double per = 1e9 / (double)NUM_SAMPLES;
+    printf("rollup     float %6.1f ns/sample   fixed %6.1f ns/sample   (%.1fx)\n",
+        t_float * per, t_fixed * per, t_float / t_fixed);
+}
+
+static void bench_history(const sensor_sample_t* trace)
+{
+    static uint8_t buf[4096 - 128];
+    uint32_t rows = 0, bytes = 0;
+    history_encoder_t enc;
+    history_encoder_init(&enc, &buf[0], sizeof(buf));
+
+    double start = now_sec();
+    for (int i = 0; i + ROLLUP <= NUM_SAMPLES; i += ROLLUP) {
+        history_row_t row;
+        row.time = 1700000000u + (uint32_t)i;
+        for (int f = 0; f < SENSOR_NUM_FIELDS; f++) {
+            int32_t sum = 0;
+            for (int k = 0; k < ROLLUP; k++) {
+                sum += trace[i + k].value[f];
+            }
+            row.value[f] = sensor_mean(sum, ROLLUP);
+        }
+        if (!history_encoder_append(&enc, &row)) {
+            bytes += history_encoder_bytes(&enc);
+            history_encoder_init(&enc, &buf[0], sizeof(buf));
+            history_encoder_append(&enc, &row);
+        }
+        rows++;
+    }
+    bytes += history_encoder_bytes(&enc);
+    double elapsed = now_sec() - start;
+
+    printf("history    %u rows, %.2f bytes/row compressed, %.0f ns/row encode\n",
+        rows, (double)bytes / rows, elapsed * 1e9 / rows);
+}
+
+int main(void)
+{
+    sensor_sample_t* trace = malloc(sizeof(sensor_sample_t) * NUM_SAMPLES);
+    if (trace == NULL) {
+        return 1;
+    }
+    make_trace(trace, NUM_SAMPLES);
+
+    printf("sizes      sensor_data %zu -> %zu bytes, history_row %zu -> %zu bytes\n",
+        sizeof(struct legacy_sensor_data), sizeof(struct sensor_data),
+        sizeof(struct legacy_history_row), sizeof(history_row_t));
+    bench_format(trace);
+    bench_rollup(trace);
+    bench_history(trace);
+
+    free(trace);
+    return 0;
+}
@@ -0,0 +1,238 @@
+// Host mock-bus test for the CGRAM glyph cache and the trend graphs. The real lcd_ascii driver
+// talks to an emulated PCF8574/HD44780 that decodes the 4-bit bus into DDRAM and CGRAM. A day of
+// 1 Hz PM2.5 and AQI readings is drawn on each trend screen, then on both alternating every 5 s. After every
+// refresh the emulated panel is compared, pixel for pixel, with a second panel on which the same
+// frame was drawn from a cold glyph cache; any difference is a slot reused under a visible
+// character. It reports I2C bytes per frame that redrew the graphs, split into frames where a
+// trend gained a point and screen switches (which also clear the panel and draw the text), against
+// uploading every glyph the frame uses and rewriting all 8 slots. Exits with 1 on a mismatch.
+//
+//     cc -O2 -Itools/host -Imain -o /tmp/bench_glyphs tools/bench_glyphs.c main/lcd_layout.c main/lcd_glyphs.c main/lcd_graph.c main/display.c main/display_hd44780.c main/display_ssd1306.c main/lcd_ascii.c main/alert_rules.c main/sensor_data.c tools/host/host_stubs.c -lm
+//     /tmp/bench_glyphs
+
+#include "host_stubs.h"
+#include "lcd_ascii.h"
+#include "lcd_layout.h"
+#include "sensor_data.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DAY_SEC 86400
+#define WINDOW_SEC 5
+#define ROWS 2
+#define COLS 16
+#define GLYPH_UPLOAD_BYTES (4 + LCD_GLYPH_ROWS * 4)     // address command and 8 rows, 4 bus bytes each
+
+typedef struct hd44780_emu {
+    bool four_bit;
+    bool have_high;
+    uint8_t high;
+    uint8_t prev;
+    bool cgram_mode;
+    uint8_t addr;
+    uint8_t ddram[128];
+    uint8_t cgram[64];
+} hd44780_emu_t;
+
+static void emu_reset(hd44780_emu_t* emu)
+{
+    memset(emu, 0, sizeof(hd44780_emu_t));
+    memset(&emu->ddram[0], ' ', sizeof(emu->ddram));
+}
+
+static void emu_execute(hd44780_emu_t* emu, uint8_t val, bool rs)
+{
+    if (rs) {
+        if (emu->cgram_mode) {
+            emu->cgram[emu->addr & 0x3f] = val & 0x1f;
+        } else {
+            emu->ddram[emu->addr & 0x7f] = val;
+        }
+        emu->addr++;
+    } else if (val & LCD_SETDDRAMADDR) {
+        emu->addr = val & 0x7f;
+        emu->cgram_mode = false;
+    } else if (val & LCD_SETCGRAMADDR) {
+        emu->addr = val & 0x3f;
+        emu->cgram_mode = true;
+    } else if (val == LCD_CLEARDISPLAY) {
+        memset(&emu->ddram[0], ' ', sizeof(emu->ddram));
+        emu->addr = 0;
+        emu->cgram_mode = false;
+    } else if ((val & 0xfe) == LCD_RETURNHOME) {
+        emu->addr = 0;
+        emu->cgram_mode = false;
+    }
+}
+
+// The PCF8574 drives D7-D4 from bits 7-4, RS from bit 0 and E from bit 2; the controller latches
+// on the falling edge of E
+static void emu_write(i2c_bus_dev_t* dev, const uint8_t* data, size_t len, void* arg)
+{
+    hd44780_emu_t* emu = *(hd44780_emu_t**)arg;
+    for (size_t i = 0; i < len; i++) {
+        uint8_t b = data[i];
+        if ((emu->prev & ENABLE_BIT) && !(b & ENABLE_BIT)) {
+            uint8_t nibble = emu->prev & 0xf0;
+            bool rs = emu->prev & REG_SELECT_BIT;
+            if (!emu->four_bit) {
+                // Only the function set matters before the interface is 4 bits wide
+                emu->four_bit = nibble == (LCD_FUNCTIONSET & 0xf0);
+            } else if (!emu->have_high) {
+                emu->high = nibble;
+                emu->have_high = true;
+            } else {
+                emu->have_high = false;
+                emu_execute(emu, emu->high | (nibble >> 4), rs);
+            }
+        }
+        emu->prev = b;
+    }
+}
+
+// Compares what the two panels show: characters, and the pixels of custom glyphs
+static bool emu_same_image(const hd44780_emu_t* a, const hd44780_emu_t* b)
+{
+    static const uint8_t row_offsets[] = { 0x00, 0x40, 0x14, 0x54 };
+    for (int row = 0; row < ROWS; row++) {
+        for (int col = 0; col < COLS; col++) {
+            uint8_t ca = a->ddram[row_offsets[row] + col];
+            uint8_t cb = b->ddram[row_offsets[row] + col];
+            bool ga = ca < 16;
+            bool gb = cb < 16;
+            if (ga != gb || (!ga && ca != cb)) {
+                return false;
+            }
+            if (ga && memcmp(&a->cgram[(ca & 7) * 8], &b->cgram[(cb & 7) * 8], 8) != 0) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static struct sensor_data s_trace[DAY_SEC];
+
+static double noise(double amplitude)
+{
+    return amplitude * ((rand() % 2001) - 1000) / 1000.0;
+}
+
+// Background PM2.5 with cooking episodes at breakfast and dinner, and a night with no readings
+static void make_trace(void)
+{
+    srand(36);
+    double pm = 5.0;
+    for (int s = 0; s < DAY_SEC; s++) {
+        double hour = s / 3600.0;
+        bool cooking = (hour >= 7.5 && hour < 8.0) || (hour >= 19.0 && hour < 19.75);
+        bool off = hour >= 2.0 && hour < 2.5;
+        pm += ((cooking ? 85.0 : 5.0) - pm) / (cooking ? 120.0 : 900.0) + noise(0.3);
+        pm = fmax(pm, 0.0);
+        struct sensor_data* sd = &s_trace[s];
+        sensor_data_init(sd);
+        sd->timestamp = (int64_t)(s + 1) * 1000000;
+        if (!off) {
+            sd->sample.value[SENSOR_PM2P5] = sensor_from_float(SENSOR_PM2P5, (float)pm);
+            sd->sample.value[SENSOR_PM10P0] = sensor_from_float(SENSOR_PM10P0, (float)(pm * 1.2));
+            sd->aqi = (int16_t)lround(pm <= 9.0 ? pm * 50.0 / 9.0 : 51.0 + (pm - 9.1) * 49.0 / 26.3);
+        }
+    }
+}
+
+static hd44780_emu_t s_emu_a, s_emu_b;
+static hd44780_emu_t* s_target = &s_emu_a;
+
+typedef struct frame_bytes {
+    uint32_t frames;
+    uint64_t bytes;
+    uint64_t lookups;
+    uint32_t max;
+} frame_bytes_t;
+
+static void add_frame(frame_bytes_t* fb, uint32_t bytes, uint32_t lookups)
+{
+    fb->frames++;
+    fb->bytes += bytes;
+    fb->lookups += lookups;
+    fb->max = bytes > fb->max ? bytes : fb->max;
+}
+
+static void print_frames(const char* what, const frame_bytes_t* fb)
+{
+    if (fb->frames == 0) {
+        return;
+    }
+    printf("  %-16s %6u frames %6.1f B average %4u B max; uploading every glyph used %6.1f B\n", what, fb->frames,
+        (double)fb->bytes / fb->frames, fb->max, (double)fb->lookups / fb->frames * GLYPH_UPLOAD_BYTES);
+}
+
+// first and second are the screens to alternate between every WINDOW_SEC, or the same one
+static int run(i2c_bus_dev_t* dev, int first, int second)
+{
+    static lcd_layout_t layout, cold;
+    s_target = &s_emu_a;
+    emu_reset(&s_emu_a);
+    display_t* disp = display_hd44780_create(dev, ROWS, COLS);
+    lcd_layout_init(&layout, disp);
+
+    int screen = second;
+    uint32_t mismatches = 0;
+    frame_bytes_t steady = { 0 }, switched = { 0 };
+    for (int s = 0; s < DAY_SEC; s++) {
+        const struct sensor_data* sd = &s_trace[s];
+        lcd_layout_record(&layout, sd);
+        bool switching = s % WINDOW_SEC == 0 && first != second;
+        if (s % WINDOW_SEC == 0) {
+            screen = screen == first ? second : first;
+        }
+        lcd_layout_show(&layout, screen);
+        s_target = &s_emu_a;
+        lcd_glyph_stats_t before = layout.glyphs.stats;
+        lcd_layout_render(&layout, sd);
+        uint32_t lookups = (layout.glyphs.stats.hits - before.hits) + (layout.glyphs.stats.misses - before.misses);
+        if (lookups > 0) {
+            add_frame(switching ? &switched : &steady, disp->stats.last_refresh_bytes, lookups);
+        }
+
+        // Same frame from a cold cache on a fresh panel
+        s_target = &s_emu_b;
+        emu_reset(&s_emu_b);
+        display_t* fresh = display_hd44780_create(dev, ROWS, COLS);
+        cold = layout;
+        cold.disp = fresh;
+        lcd_glyphs_init(&cold.glyphs, fresh);
+        lcd_layout_invalidate(&cold);
+        lcd_layout_render(&cold, sd);
+        display_free(fresh);
+        if (!emu_same_image(&s_emu_a, &s_emu_b) && mismatches++ < 5) {
+            printf("  mismatch at %d s on %s\n", s, layout.screen->name);
+        }
+    }
+
+    const lcd_glyph_stats_t* st = &layout.glyphs.stats;
+    printf("%s%s%s: %u mismatches against a cold-cache render\n", layout.screens[first].name,
+        first != second ? " / " : "", first != second ? layout.screens[second].name : "", mismatches);
+    print_frames("graph update", &steady);
+    print_frames("screen switch", &switched);
+    printf("  glyph cache      %u hits, %u misses, %u full; %.0f%% of rows on a reused slot already matched\n",
+        st->hits, st->misses, st->full, 100.0 * st->rows_skipped / (st->rows_skipped + st->rows_written));
+    display_free(disp);
+    return mismatches != 0;
+}
+
+int main(void)
+{
+    host_i2c_set_writer(emu_write, &s_target);
+    i2c_bus_dev_t* dev = i2c_bus_add_device(0x27, LCD_PCF8574_MAX_FREQ_HZ, I2C_BUS_PRIO_LOW);
+    make_trace();
+    printf("a day at 1 Hz, all 8 slots rewritten would be %d B\n", LCD_GLYPH_SLOTS * GLYPH_UPLOAD_BYTES);
+    int failed = 0;
+    failed += run(dev, LCD_SCREEN_PM2P5_TREND, LCD_SCREEN_PM2P5_TREND);
+    failed += run(dev, LCD_SCREEN_AQI_TREND, LCD_SCREEN_AQI_TREND);
+    failed += run(dev, LCD_SCREEN_PM2P5_TREND, LCD_SCREEN_AQI_TREND);
+    return failed != 0;
+}
@@ -0,0 +1,154 @@
+// Host benchmark for the history codec on a synthetic year of 1-minute rows: diurnal temperature
+// and humidity, cooking episodes in PM and NOx, power cuts that leave gaps in time, and the odd
+// failed read stored as no value. Rows are packed into blocks as history.c does (payload of one
+// 4KB sector, at most one tally bit per row) and every block is decoded again. Reports bytes per
+// row, the ratio against raw rows, blocks for the year against the partition, encode and decode
+// throughput in raw row bytes, and whether the round trip is bit-exact. Exits with 1 if it is not.
+//
+//     cc -O2 -Imain -o /tmp/bench_history tools/bench_history.c main/history_codec.c main/sensor_data.c -lm
+//     /tmp/bench_history
+
+#include "history_codec.h"
+#include "sensor_data.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define YEAR_ROWS (365 * 24 * 60)
+#define BLOCK_SIZE 4096
+#define BLOCK_PAYLOAD (BLOCK_SIZE - 128)    // HISTORY_PAYLOAD_SIZE: the sector less the block head and seal
+#define BLOCK_MAX_ROWS 512                  // HISTORY_MAX_ROWS, one tally bit per row
+#define PARTITION_SIZE 0x8e0000             // "history" in partitions.csv
+#define LEGACY_ROW_BYTES 40                 // time and nine floats, before the fixed-point rows
+
+static history_row_t s_rows[YEAR_ROWS];
+static history_row_t s_decoded[YEAR_ROWS];
+static uint8_t s_blocks[YEAR_ROWS / 64][BLOCK_PAYLOAD];
+static uint32_t s_block_rows[YEAR_ROWS / 64];
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double noise(double amplitude)
+{
+    return amplitude * ((rand() % 2001) - 1000) / 1000.0;
+}
+
+static int make_year(void)
+{
+    srand(39);
+    uint32_t t = 1704067200u;               // 2024-01-01
+    double pm = 6.0, nox = 1.0, voc = 100.0;
+    int n = 0;
+    for (int m = 0; m < YEAR_ROWS && n < YEAR_ROWS; m++, t += 60) {
+        // A power cut of up to six hours about once a month
+        if (rand() % 43200 == 0) {
+            int gap = 1 + rand() % 360;
+            m += gap;
+            t += 60u * gap;
+            continue;
+        }
+        double day = (m % 1440) / 1440.0;
+        double season = sin(2.0 * M_PI * m / YEAR_ROWS);
+        int minute = m % 1440;
+        bool cooking = (minute >= 450 && minute < 480) || (minute >= 1140 && minute < 1185);
+        pm += ((cooking ? 70.0 : 6.0) - pm) / (cooking ? 4.0 : 20.0) + noise(0.4);
+        pm = fmax(pm, 0.0);
+        nox += ((cooking ? 40.0 : 1.0) - nox) / (cooking ? 3.0 : 15.0) + noise(0.2);
+        nox = fmax(nox, 1.0);
+        voc += ((cooking ? 250.0 : 100.0) - voc) / 10.0 + noise(2.0);
+        double temp = 21.0 + 1.5 * season + 1.2 * sin(2.0 * M_PI * (day - 0.3)) + noise(0.05);
+        double rh = 45.0 - 8.0 * season - 4.0 * sin(2.0 * M_PI * (day - 0.3)) + (cooking ? 6.0 : 0.0) + noise(0.3);
+
+        history_row_t* row = &s_rows[n++];
+        row->time = t;
+        row->value[SENSOR_TEMPERATURE_MCP9808] = sensor_from_float(SENSOR_TEMPERATURE_MCP9808, (float)temp);
+        row->value[SENSOR_PM1P0] = sensor_from_float(SENSOR_PM1P0, (float)(pm * 0.7));
+        row->value[SENSOR_PM2P5] = sensor_from_float(SENSOR_PM2P5, (float)pm);
+        row->value[SENSOR_PM4P0] = sensor_from_float(SENSOR_PM4P0, (float)(pm * 1.1));
+        row->value[SENSOR_PM10P0] = sensor_from_float(SENSOR_PM10P0, (float)(pm * 1.2));
+        row->value[SENSOR_HUMIDITY] = sensor_from_float(SENSOR_HUMIDITY, (float)rh);
+        row->value[SENSOR_TEMPERATURE] = sensor_from_float(SENSOR_TEMPERATURE, (float)(temp + 0.8 + noise(0.02)));
+        row->value[SENSOR_VOC_INDEX] = sensor_from_float(SENSOR_VOC_INDEX, (float)voc);
+        row->value[SENSOR_NOX_INDEX] = sensor_from_float(SENSOR_NOX_INDEX, (float)nox);
+        // A failed read of one sensor now and then
+        if (rand() % 5000 == 0) {
+            row->value[SENSOR_TEMPERATURE_MCP9808] = SENSOR_NONE;
+        }
+        if (rand() % 5000 == 0) {
+            for (int ch = SENSOR_PM1P0; ch <= SENSOR_NOX_INDEX; ch++) {
+                if (ch != SENSOR_TEMPERATURE_MCP9808) {
+                    row->value[ch] = SENSOR_NONE;
+                }
+            }
+        }
+    }
+    return n;
+}
+
+static uint32_t encode(int rows, uint64_t* payload_bytes)
+{
+    history_encoder_t enc;
+    uint32_t blocks = 0;
+    *payload_bytes = 0;
+    history_encoder_init(&enc, &s_blocks[0][0], BLOCK_PAYLOAD);
+    for (int i = 0; i < rows; i++) {
+        if (enc.count >= BLOCK_MAX_ROWS || !history_encoder_append(&enc, &s_rows[i])) {
+            s_block_rows[blocks] = enc.count;
+            *payload_bytes += history_encoder_bytes(&enc);
+            blocks++;
+            history_encoder_init(&enc, &s_blocks[blocks][0], BLOCK_PAYLOAD);
+            history_encoder_append(&enc, &s_rows[i]);
+        }
+    }
+    s_block_rows[blocks] = enc.count;
+    *payload_bytes += history_encoder_bytes(&enc);
+    return blocks + 1;
+}
+
+static int decode(uint32_t blocks)
+{
+    int n = 0;
+    for (uint32_t b = 0; b < blocks; b++) {
+        history_decoder_t dec;
+        history_decoder_init(&dec, &s_blocks[b][0], BLOCK_PAYLOAD, s_block_rows[b]);
+        while (history_decoder_next(&dec, &s_decoded[n])) {
+            n++;
+        }
+    }
+    return n;
+}
+
+int main(void)
+{
+    int rows = make_year();
+    uint64_t payload = 0;
+    double start = now_sec();
+    uint32_t blocks = encode(rows, &payload);
+    double encode_sec = now_sec() - start;
+
+    memset(&s_decoded[0], 0, sizeof(s_decoded));
+    start = now_sec();
+    int decoded = decode(blocks);
+    double decode_sec = now_sec() - start;
+    bool exact = decoded == rows && memcmp(&s_rows[0], &s_decoded[0], rows * sizeof(history_row_t)) == 0;
+
+    double raw_mb = (double)rows * sizeof(history_row_t) / 1e6;
+    double per_row = (double)payload / rows;
+    printf("%d rows in %u blocks, %.2f B/row payload, %.2f B/row including block overhead\n", rows, blocks, per_row,
+        (double)blocks * BLOCK_SIZE / rows);
+    printf("ratio %.2fx against %zu B rows, %.2fx against %d B float rows\n", sizeof(history_row_t) / per_row,
+        sizeof(history_row_t), LEGACY_ROW_BYTES / per_row, LEGACY_ROW_BYTES);
+    printf("a year uses %.2f MB of the %.2f MB partition (%u of %u blocks)\n", blocks * (double)BLOCK_SIZE / 1e6,
+        PARTITION_SIZE / 1e6, blocks, PARTITION_SIZE / BLOCK_SIZE);
+    printf("encode %.0f MB/s, decode %.0f MB/s of raw rows\n", raw_mb / encode_sec, raw_mb / decode_sec);
+    printf("round trip %s (%d of %d rows)\n", exact ? "bit-exact" : "MISMATCH", decoded, rows);
+    return !exact;
+}
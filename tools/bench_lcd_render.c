@@ -0,0 +1,164 @@
+// Host benchmark for the declarative LCD screens against the sprintf rows they replaced. Each
+// 16x2 text screen is rendered once per sample, either through lcd_layout_render() or by
+// formatting both rows with snprintf("%.2f") and rewriting all 32 characters as the old
+// update_lcd() did. It reports time per render and characters sent to the display, for a
+// steady reading and for a noisy 1 Hz indoor trace. The display is a stub that only counts,
+// so the times are the CPU cost of deciding what to write, not the I2C transfer.
+//
+//     cc -O2 -Itools/host -Imain -o /tmp/bench_lcd_render tools/bench_lcd_render.c main/lcd_layout.c main/lcd_glyphs.c main/lcd_graph.c main/display.c main/display_hd44780.c main/display_ssd1306.c main/lcd_ascii.c main/alert_rules.c main/sensor_data.c tools/host/host_stubs.c -lm
+//     /tmp/bench_lcd_render
+
+#include "lcd_layout.h"
+#include "alert_rules.h"
+#include "sensor_data.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define NUM_SAMPLES 200000
+#define ROW_CHARS 16
+
+typedef struct counting_display {
+    display_t base;
+    uint64_t chars;
+} counting_display_t;
+
+static esp_err_t count_clear(display_t* disp)
+{
+    return ESP_OK;
+}
+
+static esp_err_t count_write(display_t* disp, uint8_t col, uint8_t row, const char* text, size_t len)
+{
+    ((counting_display_t*)disp)->chars += len;
+    return ESP_OK;
+}
+
+static esp_err_t count_define_glyph(display_t* disp, uint8_t slot, uint8_t first_row, const uint8_t* rows, size_t count)
+{
+    return ESP_OK;
+}
+
+static esp_err_t count_flush(display_t* disp)
+{
+    return ESP_OK;
+}
+
+static void count_free(display_t* disp)
+{
+}
+
+static const display_ops_t s_count_ops = {
+    .clear = count_clear,
+    .write = count_write,
+    .define_glyph = count_define_glyph,
+    .flush = count_flush,
+    .free = count_free,
+};
+
+static struct sensor_data s_trace[NUM_SAMPLES];
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double noise(double amplitude)
+{
+    return amplitude * ((rand() % 2001) - 1000) / 1000.0;
+}
+
+static void make_trace(bool steady)
+{
+    srand(35);
+    double pm = 6.0, rh = 42.0, temp = 21.5;
+    for (int s = 0; s < NUM_SAMPLES; s++) {
+        struct sensor_data* sd = &s_trace[s];
+        sensor_data_init(sd);
+        sd->timestamp = (int64_t)(s + 1) * 1000000;
+        if (!steady) {
+            pm += (6.0 - pm) / 600.0 + noise(0.2);
+            rh += (42.0 - rh) / 900.0 + noise(0.03);
+            temp = 21.5 + 0.3 * sin(2.0 * M_PI * s / 1200.0);
+        }
+        double t = temp + (steady ? 0.0 : noise(0.03));
+        sd->sample.value[SENSOR_TEMPERATURE_MCP9808] = sensor_from_float(SENSOR_TEMPERATURE_MCP9808, (float)t);
+        sd->sample.value[SENSOR_TEMPERATURE] = sensor_from_float(SENSOR_TEMPERATURE, (float)(t + 0.8));
+        sd->sample.value[SENSOR_HUMIDITY] = sensor_from_float(SENSOR_HUMIDITY, (float)rh);
+        sd->sample.value[SENSOR_PM1P0] = sensor_from_float(SENSOR_PM1P0, (float)fmax(0.0, pm * 0.7));
+        sd->sample.value[SENSOR_PM2P5] = sensor_from_float(SENSOR_PM2P5, (float)fmax(0.0, pm));
+        sd->sample.value[SENSOR_PM4P0] = sensor_from_float(SENSOR_PM4P0, (float)fmax(0.0, pm * 1.1));
+        sd->sample.value[SENSOR_PM10P0] = sensor_from_float(SENSOR_PM10P0, (float)fmax(0.0, pm * 1.2));
+        sd->sample.value[SENSOR_VOC_INDEX] = sensor_from_float(SENSOR_VOC_INDEX, 100.0f);
+        sd->sample.value[SENSOR_NOX_INDEX] = sensor_from_float(SENSOR_NOX_INDEX, 1.0f);
+        sd->aqi = (int16_t)lround(pm * 50.0 / 9.0);
+    }
+}
+
+// The rows update_lcd() wrote before the layouts, with its float formatting
+static void render_sprintf(display_t* disp, const struct sensor_data* sd, int screen)
+{
+    static const char* const fmt[3][2] = {
+        { "MCP: %.2fC", "SEN: %.2fC" },
+        { "RH: %.2f", "AQI: %.0f" },
+        { "PM10: %.2f", "PM2.5: %.1f" },
+    };
+    static const int field[3][2] = {
+        { ALERT_FIELD_TEMPERATURE_MCP9808, ALERT_FIELD_TEMPERATURE },
+        { ALERT_FIELD_HUMIDITY, ALERT_FIELD_AQI },
+        { ALERT_FIELD_PM10P0, ALERT_FIELD_PM2P5 },
+    };
+    for (int row = 0; row < 2; row++) {
+        char txt[ROW_CHARS + 1];
+        int len = snprintf(&txt[0], sizeof(txt), fmt[screen][row], alert_field_value(sd, field[screen][row]));
+        if (len < ROW_CHARS) {
+            memset(&txt[len], ' ', ROW_CHARS - len);
+        }
+        display_write(disp, 0, (uint8_t)row, &txt[0], ROW_CHARS);
+    }
+    display_flush(disp);
+}
+
+static void run(const char* name, bool steady)
+{
+    static const int screens[3] = { LCD_SCREEN_TEMPERATURE, LCD_SCREEN_HUMIDITY_AQI, LCD_SCREEN_PM };
+    make_trace(steady);
+    printf("%s\n", name);
+    for (int i = 0; i < 3; i++) {
+        counting_display_t layout_disp = { .base = { .ops = &s_count_ops, .rows = 2, .cols = ROW_CHARS } };
+        counting_display_t sprintf_disp = layout_disp;
+        static lcd_layout_t layout;
+        lcd_layout_init(&layout, &layout_disp.base);
+        lcd_layout_show(&layout, screens[i]);
+        lcd_layout_render(&layout, &s_trace[0]);
+        layout_disp.chars = 0;
+
+        double start = now_sec();
+        for (int s = 1; s < NUM_SAMPLES; s++) {
+            lcd_layout_render(&layout, &s_trace[s]);
+        }
+        double layout_usec = (now_sec() - start) / (NUM_SAMPLES - 1) * 1e6;
+
+        start = now_sec();
+        for (int s = 1; s < NUM_SAMPLES; s++) {
+            render_sprintf(&sprintf_disp.base, &s_trace[s], i);
+        }
+        double sprintf_usec = (now_sec() - start) / (NUM_SAMPLES - 1) * 1e6;
+
+        printf("  %-13s layout %6.3f us %6.2f chars   sprintf %6.3f us %6.2f chars\n", layout.screen->name,
+            layout_usec, (double)layout_disp.chars / (NUM_SAMPLES - 1), sprintf_usec,
+            (double)sprintf_disp.chars / (NUM_SAMPLES - 1));
+    }
+}
+
+int main(void)
+{
+    run("steady reading", true);
+    run("noisy indoor trace", false);
+    return 0;
+}
@@ -0,0 +1,198 @@
+// Host benchmark for the streaming quantile sketch: update cost per sample, the cost of merging
+// hourly sketches into a daily one, and accuracy against the exact quantiles of a trace.
+//
+//     cc -O2 -Imain -o /tmp/bench_quantile tools/bench_quantile.c main/quantile.c -lm
+//     /tmp/bench_quantile                      # synthetic day of PM2.5 at 1 Hz
+//     /tmp/bench_quantile trace.txt [scale]    # recorded trace, one reading per line
+//
+// A recorded trace can be pulled from the device with
+//     curl -s 'http://<ip-address>/api/v1/history?fields=pm2p5' | jq -r '.rows[][1] // empty' > trace.txt
+// Readings are converted to fixed point with scale (10 for PM, see sensor_data.h). Add
+// -DQUANTILE_K=<k> to the build to try another accuracy parameter.
+
+#include "quantile.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DAY_SAMPLES 86400
+#define HOUR_SAMPLES 3600
+#define NUM_SEEDS 20
+
+static const float s_quantiles[] = { 0.5f, 0.9f, 0.95f, 0.99f };
+#define NUM_QUANTILES (int)(sizeof(s_quantiles) / sizeof(s_quantiles[0]))
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Indoor PM2.5 in 1/10 ug/m3: a slow background with sensor noise and a few cooking events that
+// decay over tens of minutes, so the upper percentiles sit in a long tail
+static int make_trace(int16_t* trace)
+{
+    srand(7);
+    double background = 60.0;
+    double event = 0.0;
+    for (int i = 0; i < DAY_SAMPLES; i++) {
+        background += ((rand() % 201) - 100) / 400.0;
+        background = background < 20.0 ? 20.0 : background > 150.0 ? 150.0 : background;
+        if (rand() % 12000 == 0) {
+            event += 500.0 + rand() % 2500;
+        }
+        event *= 0.9985;
+        double v = background + event + (rand() % 21 - 10);
+        trace[i] = (int16_t)(v < 0.0 ? 0.0 : v);
+    }
+    return DAY_SAMPLES;
+}
+
+static int load_trace(const char* path, float scale, int16_t* trace, int max)
+{
+    FILE* f = fopen(path, "r");
+    if (f == NULL) {
+        perror(path);
+        return 0;
+    }
+    int n = 0;
+    char line[64];
+    while (n < max && fgets(&line[0], sizeof(line), f) != NULL) {
+        char* end;
+        double v = strtod(&line[0], &end);
+        if (end != &line[0]) {
+            v = round(v * scale);
+            trace[n++] = (int16_t)(v > INT16_MAX - 1 ? INT16_MAX - 1 : v < INT16_MIN ? INT16_MIN : v);
+        }
+    }
+    fclose(f);
+    return n;
+}
+
+static int compare_int16(const void* a, const void* b)
+{
+    return *(const int16_t*)a - *(const int16_t*)b;
+}
+
+// Distance of q from the ranks the value covers in the sorted data, as a fraction of n
+static double rank_error(const int16_t* sorted, int n, float q, int16_t v)
+{
+    int below = 0;
+    int at_or_below = 0;
+    for (int i = 0; i < n; i++) {
+        below += sorted[i] < v;
+        at_or_below += sorted[i] <= v;
+    }
+    double target = ceil((double)q * n);
+    if (target < below + 1) {
+        return (below + 1 - target) / n;
+    }
+    if (target > at_or_below) {
+        return (target - at_or_below) / n;
+    }
+    return 0.0;
+}
+
+typedef struct accuracy {
+    double max_rank_err[NUM_QUANTILES];
+    double sum_rank_err[NUM_QUANTILES];
+    double max_value_err[NUM_QUANTILES];
+    int runs;
+} accuracy_t;
+
+static void check(accuracy_t* acc, const quantile_sketch_t* sk, const int16_t* sorted, int n)
+{
+    const quantile_sketch_t* one[] = { sk };
+    for (int i = 0; i < NUM_QUANTILES; i++) {
+        int16_t v;
+        quantile_get(&one[0], 1, s_quantiles[i], &v);
+        int idx = (int)ceil((double)s_quantiles[i] * n) - 1;
+        double err = rank_error(sorted, n, s_quantiles[i], v);
+        double verr = fabs((double)v - sorted[idx < 0 ? 0 : idx]);
+        acc->max_rank_err[i] = err > acc->max_rank_err[i] ? err : acc->max_rank_err[i];
+        acc->sum_rank_err[i] += err;
+        acc->max_value_err[i] = verr > acc->max_value_err[i] ? verr : acc->max_value_err[i];
+    }
+    acc->runs++;
+}
+
+static void print_accuracy(const char* name, const accuracy_t* acc, float scale)
+{
+    printf("%-18s", name);
+    for (int i = 0; i < NUM_QUANTILES; i++) {
+        printf("  p%-4g %.2f%%/%.2f%% (%.1f)", s_quantiles[i] * 100.0f,
+            100.0 * acc->sum_rank_err[i] / acc->runs, 100.0 * acc->max_rank_err[i], acc->max_value_err[i] / scale);
+    }
+    printf("\n");
+}
+
+int main(int argc, char** argv)
+{
+    static int16_t trace[DAY_SAMPLES];
+    static int16_t sorted[DAY_SAMPLES];
+    static quantile_sketch_t hours[DAY_SAMPLES / HOUR_SAMPLES];
+    static quantile_sketch_t day;
+    static quantile_sketch_t merged;
+    float scale = argc > 2 ? strtof(argv[2], NULL) : 10.0f;
+    int n = argc > 1 ? load_trace(argv[1], scale, &trace[0], DAY_SAMPLES) : make_trace(&trace[0]);
+    if (n < HOUR_SAMPLES) {
+        fprintf(stderr, "Need at least %d readings\n", HOUR_SAMPLES);
+        return 1;
+    }
+    int num_hours = n / HOUR_SAMPLES;
+    n = num_hours * HOUR_SAMPLES;
+    memcpy(&sorted[0], &trace[0], n * sizeof(int16_t));
+    qsort(&sorted[0], n, sizeof(int16_t), compare_int16);
+
+    printf("K=%d, %d readings, sketch %zu bytes\n", QUANTILE_K, n, sizeof(quantile_sketch_t));
+
+    accuracy_t acc_day = { 0 };
+    accuracy_t acc_merged = { 0 };
+    accuracy_t acc_hour = { 0 };
+    double t_update = 0.0;
+    double t_merge = 0.0;
+    for (int seed = 1; seed <= NUM_SEEDS; seed++) {
+        quantile_init(&day, (uint32_t)seed * 7919u);
+        double start = now_sec();
+        for (int i = 0; i < n; i++) {
+            quantile_add(&day, trace[i]);
+        }
+        t_update += now_sec() - start;
+        check(&acc_day, &day, &sorted[0], n);
+
+        quantile_init(&merged, (uint32_t)seed * 104729u);
+        for (int h = 0; h < num_hours; h++) {
+            quantile_init(&hours[h], (uint32_t)(seed * 100 + h));
+            for (int i = 0; i < HOUR_SAMPLES; i++) {
+                quantile_add(&hours[h], trace[h * HOUR_SAMPLES + i]);
+            }
+            start = now_sec();
+            quantile_merge(&merged, &hours[h]);
+            t_merge += now_sec() - start;
+
+            int16_t hour_sorted[HOUR_SAMPLES];
+            memcpy(&hour_sorted[0], &trace[h * HOUR_SAMPLES], sizeof(hour_sorted));
+            qsort(&hour_sorted[0], HOUR_SAMPLES, sizeof(int16_t), compare_int16);
+            check(&acc_hour, &hours[h], &hour_sorted[0], HOUR_SAMPLES);
+        }
+        check(&acc_merged, &merged, &sorted[0], n);
+    }
+
+    printf("update             %.1f ns/sample\n", t_update * 1e9 / ((double)n * NUM_SEEDS));
+    printf("merge hour->day    %.1f us/hour\n", t_merge * 1e6 / ((double)num_hours * NUM_SEEDS));
+    printf("rank error mean/max over %d seeds (max value error in units)\n", NUM_SEEDS);
+    print_accuracy("hourly sketches", &acc_hour, scale);
+    print_accuracy("daily, direct", &acc_day, scale);
+    print_accuracy("daily, merged", &acc_merged, scale);
+    printf("exact day         ");
+    for (int i = 0; i < NUM_QUANTILES; i++) {
+        int idx = (int)ceil((double)s_quantiles[i] * n) - 1;
+        printf("  p%-4g %.1f", s_quantiles[i] * 100.0f, sorted[idx] / scale);
+    }
+    printf("\n");
+    return 0;
+}
@@ -0,0 +1,265 @@
+// Host benchmark for the broadcast sample bus against fanning samples out through one copying
+// SPSC queue per consumer, as the reporter queue did before it. Reports the cost per published
+// sample and the memory for 1 to 16 subscribers. It then checks a read lapped by the producer
+// and a subscriber falling a ring behind, step by step. Finally it runs a producer thread against
+// reader threads that use the release check, and counts records a reader accepted although the
+// producer overwrote them mid-read (must be 0). Mid-read overwrites only happen on a multi-core
+// host. Exits with 1 when a check fails.
+//
+//     cc -O2 -pthread -Itools/host -Imain -o /tmp/bench_sample_bus tools/bench_sample_bus.c main/sample_bus.c
+//     /tmp/bench_sample_bus
+
+#include "sample_bus.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define QUEUE_LEN SAMPLE_BUS_CAPACITY
+#define ROUNDS 2000000
+#define STRESS_MSEC 2000
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Every field is derived from one counter, so a record mixing two writes is detectable
+static void fill(struct sensor_data* sd, uint32_t n)
+{
+    sd->timestamp = (int64_t)n * 1000000;
+    sd->interval_msec = n;
+    for (int f = 0; f < SENSOR_NUM_FIELDS; f++) {
+        sd->sample.value[f] = (int16_t)(n + f);
+    }
+    sd->aqi = (int16_t)n;
+    for (int p = 0; p < AQI_NUM_POLLUTANTS; p++) {
+        sd->aqi_sub[p] = (int16_t)(n - p);
+    }
+    sd->aqi_dominant = (uint8_t)n;
+    sd->aqi_algorithm = 0;
+    sd->sen5x_status = n;
+    sd->sen5x_error = 0;
+}
+
+static bool consistent(const struct sensor_data* sd)
+{
+    struct sensor_data ref;
+    memset(&ref, 0, sizeof(ref));
+    fill(&ref, sd->interval_msec);
+    return memcmp(sd, &ref, sizeof(ref)) == 0;
+}
+
+// Copying single-producer single-consumer ring, one per consumer
+typedef struct copy_queue {
+    struct sensor_data slots[QUEUE_LEN];
+    uint32_t head;
+    uint32_t tail;
+} copy_queue_t;
+
+static bool queue_push(copy_queue_t* q, const struct sensor_data* sd)
+{
+    uint32_t head = q->head;
+    if (head - __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE) == QUEUE_LEN) {
+        return false;
+    }
+    memcpy(&q->slots[head % QUEUE_LEN], sd, sizeof(struct sensor_data));
+    __atomic_store_n(&q->head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+static bool queue_pop(copy_queue_t* q, struct sensor_data* out)
+{
+    uint32_t tail = q->tail;
+    if (__atomic_load_n(&q->head, __ATOMIC_ACQUIRE) == tail) {
+        return false;
+    }
+    memcpy(out, &q->slots[tail % QUEUE_LEN], sizeof(struct sensor_data));
+    __atomic_store_n(&q->tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+static sample_bus_t s_bus;
+static copy_queue_t s_queues[SAMPLE_BUS_MAX_SUBS];
+static volatile uint32_t s_sink;
+
+// Each consumer takes its own copy of the record, as the reporter, stats and history tasks do
+static double run_bus(int subs)
+{
+    sample_sub_t* sub[SAMPLE_BUS_MAX_SUBS];
+    sample_bus_init(&s_bus);
+    for (int s = 0; s < subs; s++) {
+        sub[s] = sample_bus_subscribe(&s_bus, "bench", NULL);
+    }
+    struct sensor_data sd, copy;
+    double start = now_sec();
+    for (uint32_t n = 1; n <= ROUNDS; n++) {
+        fill(&sd, n);
+        sample_bus_publish(&s_bus, &sd);
+        for (int s = 0; s < subs; s++) {
+            const struct sensor_data* rec;
+            while ((rec = sample_bus_next(&s_bus, sub[s])) != NULL) {
+                copy = *rec;
+                if (sample_bus_release(&s_bus, sub[s])) {
+                    s_sink += copy.interval_msec;
+                }
+            }
+        }
+    }
+    return (now_sec() - start) / ROUNDS * 1e9;
+}
+
+static double run_queues(int subs)
+{
+    memset(&s_queues[0], 0, sizeof(s_queues));
+    struct sensor_data sd, copy;
+    double start = now_sec();
+    for (uint32_t n = 1; n <= ROUNDS; n++) {
+        fill(&sd, n);
+        for (int s = 0; s < subs; s++) {
+            queue_push(&s_queues[s], &sd);
+        }
+        for (int s = 0; s < subs; s++) {
+            while (queue_pop(&s_queues[s], &copy)) {
+                s_sink += copy.interval_msec;
+            }
+        }
+    }
+    return (now_sec() - start) / ROUNDS * 1e9;
+}
+
+static int check(bool ok, const char* what)
+{
+    printf("  %-4s %s\n", ok ? "ok" : "FAIL", what);
+    return !ok;
+}
+
+static int check_lapping(void)
+{
+    struct sensor_data sd;
+    int failed = 0;
+    sample_bus_init(&s_bus);
+    sample_sub_t* sub = sample_bus_subscribe(&s_bus, "check", NULL);
+
+    // The producer laps a record the subscriber is holding
+    fill(&sd, 1);
+    sample_bus_publish(&s_bus, &sd);
+    const struct sensor_data* rec = sample_bus_next(&s_bus, sub);
+    for (uint32_t n = 2; n <= 1 + SAMPLE_BUS_CAPACITY; n++) {
+        fill(&sd, n);
+        sample_bus_publish(&s_bus, &sd);
+    }
+    failed += check(rec != NULL && !sample_bus_release(&s_bus, sub) && sub->torn == 1, "record lapped mid-read is torn");
+
+    // A subscriber a ring behind skips to the oldest intact record and then reads in order
+    uint32_t head = sample_bus_published(&s_bus);
+    for (uint32_t n = head + 1; n <= head + 3 * SAMPLE_BUS_CAPACITY; n++) {
+        fill(&sd, n);
+        sample_bus_publish(&s_bus, &sd);
+    }
+    head = sample_bus_published(&s_bus);
+    uint32_t expect = head - SAMPLE_BUS_CAPACITY + 2;
+    uint32_t read = 0;
+    bool in_order = true;
+    while ((rec = sample_bus_next(&s_bus, sub)) != NULL) {
+        in_order &= rec->interval_msec == expect + read;
+        sample_bus_release(&s_bus, sub);
+        read++;
+    }
+    failed += check(in_order && read == SAMPLE_BUS_CAPACITY - 1 && sub->skipped == expect - 2,
+        "lagging subscriber skips ahead and reads the rest in order");
+
+    rec = sample_bus_latest(&s_bus, sub);
+    failed += check(rec == NULL, "caught-up subscriber gets nothing");
+    return failed;
+}
+
+typedef struct reader {
+    pthread_t thread;
+    sample_sub_t* sub;
+    bool latest;            // reads like the display task, newest record only
+    uint64_t accepted;
+    uint64_t corrupt;       // accepted by release but mixing two records
+} reader_t;
+
+static volatile bool s_stop;
+
+static void* reader_main(void* arg)
+{
+    reader_t* r = arg;
+    while (!s_stop) {
+        const struct sensor_data* rec;
+        while ((rec = r->latest ? sample_bus_latest(&s_bus, r->sub) : sample_bus_next(&s_bus, r->sub)) != NULL) {
+            struct sensor_data copy = *rec;
+            if (sample_bus_release(&s_bus, r->sub)) {
+                r->accepted++;
+                r->corrupt += !consistent(&copy);
+            }
+        }
+    }
+    return NULL;
+}
+
+static int stress(int subs)
+{
+    reader_t readers[SAMPLE_BUS_MAX_SUBS];
+    memset(&readers[0], 0, sizeof(readers));
+    sample_bus_init(&s_bus);
+    s_stop = false;
+    for (int s = 0; s < subs; s++) {
+        readers[s].sub = sample_bus_subscribe(&s_bus, "stress", NULL);
+        readers[s].latest = s == 0;
+        pthread_create(&readers[s].thread, NULL, reader_main, &readers[s]);
+    }
+    struct sensor_data sd;
+    uint32_t n = 0;
+    double end = now_sec() + STRESS_MSEC / 1000.0;
+    while (now_sec() < end) {
+        // Bursts of a few records, so readers both keep up and get lapped
+        for (int i = 0; i < 1 + (int)(n % 7); i++) {
+            fill(&sd, ++n);
+            sample_bus_publish(&s_bus, &sd);
+        }
+        sched_yield();
+    }
+    s_stop = true;
+
+    uint64_t accepted = 0, corrupt = 0, torn = 0, skipped = 0;
+    for (int s = 0; s < subs; s++) {
+        pthread_join(readers[s].thread, NULL);
+        accepted += readers[s].accepted;
+        corrupt += readers[s].corrupt;
+        torn += readers[s].sub->torn;
+        skipped += readers[s].sub->skipped;
+    }
+    printf("  %2d readers  %9u published  %10llu accepted  %8llu torn  %10llu skipped  %llu corrupt\n", subs, n,
+        (unsigned long long)accepted, (unsigned long long)torn, (unsigned long long)skipped,
+        (unsigned long long)corrupt);
+    return corrupt != 0;
+}
+
+int main(void)
+{
+    static const int counts[] = { 1, 2, 4, 8, 16 };
+    printf("per published sample, every subscriber copying it out (%zu-byte record)\n", sizeof(struct sensor_data));
+    for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+        int subs = counts[i];
+        double bus = run_bus(subs);
+        double queues = run_queues(subs);
+        printf("  %2d subs  bus %6.1f ns  %6zu B   queues %6.1f ns  %6zu B\n", subs, bus, sizeof(sample_bus_t),
+            queues, subs * sizeof(copy_queue_t));
+    }
+
+    printf("lapping\n");
+    int failed = check_lapping();
+
+    printf("producer against reader threads for %d ms each\n", STRESS_MSEC);
+    failed += stress(1);
+    failed += stress(3);
+    failed += stress(8);
+    return failed != 0;
+}
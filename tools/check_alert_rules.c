@@ -0,0 +1,98 @@
+// Host check for the alert rule compiler and evaluator: each case compiles an expression and feeds
+// it a sequence of readings one second apart, comparing when the alert fires and clears with the
+// expected states. Exits with 1 when any case fails.
+//
+//     cc -O2 -Imain -o /tmp/check_alert_rules tools/check_alert_rules.c main/alert_rules.c main/sensor_data.c -lm
+//     /tmp/check_alert_rules
+
+#include "alert_rules.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_STEPS 8
+
+typedef struct eval_case {
+    const char* expr;
+    int num_steps;
+    float value[MAX_STEPS];
+    bool active[MAX_STEPS];     // expected state after each reading
+} eval_case_t;
+
+static const eval_case_t s_eval_cases[] = {
+    // The boundary value itself only triggers the inclusive operators
+    { "aqi > 100", 3, { 99, 100, 101 }, { false, false, true } },
+    { "aqi >= 100", 3, { 99, 100, 101 }, { false, true, true } },
+    { "humidity < 30", 3, { 31, 30, 29 }, { false, false, true } },
+    { "humidity <= 30", 3, { 31, 30, 29 }, { false, true, true } },
+    // Default hysteresis is 10% of the threshold; the clear level itself does not clear
+    { "aqi >= 100", 4, { 100, 95, 90, 89.9f }, { true, true, true, false } },
+    { "humidity <= 30", 4, { 30, 32, 33, 33.1f }, { true, true, true, false } },
+    { "pm2p5 >= 35 clear 35", 3, { 35, 35, 34.9f }, { true, true, false } },
+    // The hold time starts at the first reading on the boundary
+    { "pm2p5 >= 35 for 2s", 4, { 35, 35, 35, 36 }, { false, false, true, true } },
+    { "pm2p5 >= 35 for 2s", 4, { 35, 34, 35, 35 }, { false, false, false, false } },
+    // A change of exactly the threshold triggers a rate rule
+    { "aqi rises by 50 in 5m", 3, { 50, 80, 100 }, { false, false, true } },
+    { "aqi falls by 50 in 5m", 3, { 100, 60, 51 }, { false, false, false } },
+    { "aqi falls by 50 in 5m", 4, { 100, 60, 50, 80 }, { false, false, true, false } },
+};
+
+static const char* s_syntax_errors[] = {
+    "aqi => 100",
+    "aqi == 100",
+    "aqi >=",
+    "aqi >= 100 clear 120",
+    "humidity <= 30 clear 20",
+    "aqi rises 50 in 5m",
+    "aqi rises by 0 in 5m",
+    "ozone > 10",
+};
+
+static int check_eval(const eval_case_t* c)
+{
+    alert_rule_t rule;
+    alert_state_t st;
+    char err[64];
+    if (!alert_rule_compile(c->expr, &rule, &err[0], sizeof(err))) {
+        printf("FAIL  '%s' did not compile: %s\n", c->expr, &err[0]);
+        return 1;
+    }
+    alert_state_reset(&st);
+    for (int i = 0; i < c->num_steps; i++) {
+        alert_rule_eval(&rule, &st, c->value[i], (int64_t)(i + 1) * 1000000);
+        if (st.active != c->active[i]) {
+            printf("FAIL  '%s' at %g (reading %d): %s, expected %s\n", c->expr, c->value[i], i + 1,
+                st.active ? "active" : "clear", c->active[i] ? "active" : "clear");
+            return 1;
+        }
+    }
+    printf("ok    '%s'\n", c->expr);
+    return 0;
+}
+
+static int check_syntax_error(const char* expr)
+{
+    alert_rule_t rule;
+    char err[64];
+    if (alert_rule_compile(expr, &rule, &err[0], sizeof(err))) {
+        printf("FAIL  '%s' compiled\n", expr);
+        return 1;
+    }
+    printf("ok    '%s': %s\n", expr, &err[0]);
+    return 0;
+}
+
+int main(void)
+{
+    int failed = 0;
+    for (size_t i = 0; i < sizeof(s_eval_cases) / sizeof(s_eval_cases[0]); i++) {
+        failed += check_eval(&s_eval_cases[i]);
+    }
+    for (size_t i = 0; i < sizeof(s_syntax_errors) / sizeof(s_syntax_errors[0]); i++) {
+        failed += check_syntax_error(s_syntax_errors[i]);
+    }
+    printf("%d failed\n", failed);
+    return failed != 0;
+}
@@ -0,0 +1,149 @@
+// Host check of the AQI breakpoint tables against reference values: both edges of every segment,
+// plus points inside segments where the standards' rounding rules differ. The expected values are
+// the ones the official calculators give (AirNow AQI calculator for EPA, the HJ 633-2012 formula
+// rounded up for MEP, the published CAQI grid, DAQI bands and the CPCB NAQI calculator). Exits
+// with 1 when any vector fails.
+//
+//     c++ -O2 -std=c++17 -Imain -o /tmp/check_aqi tools/check_aqi.cpp main/aqi.cpp
+//     /tmp/check_aqi
+
+#include "aqi.h"
+
+#include <math.h>
+#include <stdio.h>
+
+struct Vector {
+    AQI::Algorithm algo;
+    AQI::Pollutant pollutant;
+    float concentration;
+    int expected;
+};
+
+using A = AQI::Algorithm;
+using P = AQI::Pollutant;
+
+const Vector kVectors[] = {
+    // EPA 2024, PM2.5: truncated to 0.1 µg/m³, rounded to the nearest integer
+    { A::EPA, P::PM25, 0.0f, 0 },
+    { A::EPA, P::PM25, 9.0f, 50 },
+    { A::EPA, P::PM25, 9.1f, 51 },
+    { A::EPA, P::PM25, 12.0f, 56 },
+    { A::EPA, P::PM25, 35.4f, 100 },
+    { A::EPA, P::PM25, 35.45f, 100 },
+    { A::EPA, P::PM25, 35.5f, 101 },
+    { A::EPA, P::PM25, 55.4f, 150 },
+    { A::EPA, P::PM25, 55.5f, 151 },
+    { A::EPA, P::PM25, 125.4f, 200 },
+    { A::EPA, P::PM25, 125.5f, 201 },
+    { A::EPA, P::PM25, 225.4f, 300 },
+    { A::EPA, P::PM25, 225.5f, 301 },
+    { A::EPA, P::PM25, 325.4f, 500 },
+    { A::EPA, P::PM25, 600.0f, 500 },
+    // EPA PM10: truncated to 1 µg/m³
+    { A::EPA, P::PM10, 54.0f, 50 },
+    { A::EPA, P::PM10, 54.9f, 50 },
+    { A::EPA, P::PM10, 55.0f, 51 },
+    { A::EPA, P::PM10, 100.0f, 73 },
+    { A::EPA, P::PM10, 154.0f, 100 },
+    { A::EPA, P::PM10, 155.0f, 101 },
+    { A::EPA, P::PM10, 254.0f, 150 },
+    { A::EPA, P::PM10, 255.0f, 151 },
+    { A::EPA, P::PM10, 354.0f, 200 },
+    { A::EPA, P::PM10, 355.0f, 201 },
+    { A::EPA, P::PM10, 424.0f, 300 },
+    { A::EPA, P::PM10, 425.0f, 301 },
+    { A::EPA, P::PM10, 604.0f, 500 },
+    // MEP HJ 633-2012: contiguous segments, IAQI rounded up
+    { A::MEP, P::PM25, 35.0f, 50 },
+    { A::MEP, P::PM25, 36.0f, 52 },
+    { A::MEP, P::PM25, 75.0f, 100 },
+    { A::MEP, P::PM25, 115.0f, 150 },
+    { A::MEP, P::PM25, 150.0f, 200 },
+    { A::MEP, P::PM25, 250.0f, 300 },
+    { A::MEP, P::PM25, 350.0f, 400 },
+    { A::MEP, P::PM25, 500.0f, 500 },
+    { A::MEP, P::PM10, 50.0f, 50 },
+    { A::MEP, P::PM10, 60.0f, 55 },
+    { A::MEP, P::PM10, 150.0f, 100 },
+    { A::MEP, P::PM10, 351.0f, 202 },
+    { A::MEP, P::PM10, 420.0f, 300 },
+    { A::MEP, P::PM10, 600.0f, 500 },
+    // EU CAQI hourly grid, capped at 100
+    { A::CAQI, P::PM25, 15.0f, 25 },
+    { A::CAQI, P::PM25, 30.0f, 50 },
+    { A::CAQI, P::PM25, 55.0f, 75 },
+    { A::CAQI, P::PM25, 110.0f, 100 },
+    { A::CAQI, P::PM25, 200.0f, 100 },
+    { A::CAQI, P::PM10, 25.0f, 25 },
+    { A::CAQI, P::PM10, 50.0f, 50 },
+    { A::CAQI, P::PM10, 90.0f, 75 },
+    { A::CAQI, P::PM10, 180.0f, 100 },
+    // UK DAQI bands, integer µg/m³ edges
+    { A::DAQI, P::PM25, 11.0f, 1 },
+    { A::DAQI, P::PM25, 12.0f, 2 },
+    { A::DAQI, P::PM25, 35.0f, 3 },
+    { A::DAQI, P::PM25, 36.0f, 4 },
+    { A::DAQI, P::PM25, 70.0f, 9 },
+    { A::DAQI, P::PM25, 71.0f, 10 },
+    { A::DAQI, P::PM10, 16.0f, 1 },
+    { A::DAQI, P::PM10, 17.0f, 2 },
+    { A::DAQI, P::PM10, 100.0f, 9 },
+    { A::DAQI, P::PM10, 101.0f, 10 },
+    // India NAQI
+    { A::NAQI, P::PM25, 30.0f, 50 },
+    { A::NAQI, P::PM25, 31.0f, 51 },
+    { A::NAQI, P::PM25, 60.0f, 100 },
+    { A::NAQI, P::PM25, 61.0f, 101 },
+    { A::NAQI, P::PM25, 90.0f, 200 },
+    { A::NAQI, P::PM25, 91.0f, 201 },
+    { A::NAQI, P::PM25, 250.0f, 400 },
+    { A::NAQI, P::PM25, 251.0f, 401 },
+    { A::NAQI, P::PM25, 380.0f, 500 },
+    { A::NAQI, P::PM10, 50.0f, 50 },
+    { A::NAQI, P::PM10, 51.0f, 51 },
+    { A::NAQI, P::PM10, 100.0f, 100 },
+    { A::NAQI, P::PM10, 101.0f, 101 },
+    { A::NAQI, P::PM10, 430.0f, 400 },
+    { A::NAQI, P::PM10, 431.0f, 401 },
+    // No standard defines these, and invalid readings stay invalid
+    { A::EPA, P::PM1, 10.0f, AQI_INVALID },
+    { A::EPA, P::PM4, 10.0f, AQI_INVALID },
+    { A::EPA, P::VOC, 100.0f, AQI_INVALID },
+    { A::EPA, P::NOX, 1.0f, AQI_INVALID },
+    { A::EPA, P::PM25, -1.0f, AQI_INVALID },
+    { A::EPA, P::PM25, NAN, AQI_INVALID },
+};
+
+int main()
+{
+    int failed = 0;
+    int count = 0;
+    AQI aqi;
+    for (const Vector& v : kVectors) {
+        aqi.SetAlgorithm(v.algo);
+        int got = aqi.GetIntermediateIndex(v.pollutant, v.concentration);
+        count++;
+        if (got != v.expected) {
+            printf("FAIL  %-4s %-9s %7.2f: %d, expected %d\n", AQI::GetName(v.algo),
+                aqi_pollutant_name(static_cast<int>(v.pollutant)), v.concentration, got, v.expected);
+            failed++;
+        }
+    }
+
+    // The overall index is the worst sub-index, and names its pollutant
+    aqi.SetAlgorithm(A::EPA);
+    AQI::Concentrations con = { 40.0f, 35.5f, 50.0f, 155.0f, 300.0f, 20.0f };
+    AQI::Indices sub;
+    AQI::Pollutant dominant = P::Count;
+    int idx = aqi.GetIndex(con, &sub, &dominant);
+    count++;
+    if (idx != 101 || dominant != P::PM25 || sub[static_cast<size_t>(P::PM10)] != 101
+        || sub[static_cast<size_t>(P::VOC)] != AQI_INVALID) {
+        printf("FAIL  epa overall: %d (%s), expected 101 (pm2p5)\n", idx,
+            dominant < P::Count ? aqi_pollutant_name(static_cast<int>(dominant)) : "none");
+        failed++;
+    }
+
+    printf("%d of %d vectors failed\n", failed, count);
+    return failed != 0;
+}
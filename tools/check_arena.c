@@ -0,0 +1,209 @@
+// Host check for the static arena and the steady-state allocation hook. arena.c is built with
+// CONFIG_AQM_STATIC_ALLOC and CONFIG_AQM_ALLOC_TRACKING and linked with the same --wrap flags as
+// the firmware, so every malloc/calloc/realloc below goes through its counters. Tasks are
+// simulated by switching the handle xTaskGetCurrentTaskHandle() returns. A watched task runs the
+// sampler and reporter hot path (publish and copy off the sample bus, alert rules, formatting,
+// history encoding), marks itself steady after the first pass and must not allocate after that.
+// A control task allocates on purpose to show the hook is live. Exits with 1 when a check fails.
+//
+//     cc -O2 -DCONFIG_AQM_STATIC_ALLOC=1 -DCONFIG_AQM_ARENA_SIZE=1024 -DCONFIG_AQM_ALLOC_TRACKING=1 -Itools/host -Imain -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc -o /tmp/check_arena tools/check_arena.c main/arena.c main/sample_bus.c main/alert_rules.c main/sensor_data.c main/history_codec.c -lm
+//     /tmp/check_arena
+
+#include "arena.h"
+#include "alert_rules.h"
+#include "history_codec.h"
+#include "sample_bus.h"
+#include "sensor_data.h"
+
+#include "cJSON.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STEADY_ITERATIONS 20000
+
+static int s_tasks[3];
+static TaskHandle_t s_current = &s_tasks[0];
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return s_current;
+}
+
+// arena_to_json() reports one object per watched task; keep the steady_allocs of each
+static const char* s_json_task;
+static struct {
+    const char* name;
+    double steady_allocs;
+} s_json[ARENA_MAX_WATCHED];
+static int s_json_count;
+
+cJSON* cJSON_AddObjectToObject(cJSON* object, const char* name)
+{
+    s_json_task = name;
+    return (cJSON*)&s_json_task;
+}
+
+cJSON* cJSON_AddNumberToObject(cJSON* object, const char* name, double number)
+{
+    if (strcmp(name, "steady_allocs") == 0 && s_json_count < ARENA_MAX_WATCHED) {
+        s_json[s_json_count].name = s_json_task;
+        s_json[s_json_count].steady_allocs = number;
+        s_json_count++;
+    }
+    return NULL;
+}
+
+cJSON* cJSON_AddBoolToObject(cJSON* object, const char* name, bool boolean)
+{
+    return NULL;
+}
+
+static int check(bool ok, const char* what)
+{
+    printf("  %-4s %s\n", ok ? "ok" : "FAIL", what);
+    return !ok;
+}
+
+static int check_arena(void)
+{
+    int failed = 0;
+    size_t before = arena_used();
+    uint8_t* a = arena_alloc(5);
+    uint8_t* b = arena_alloc(16);
+    bool zeroed = a != NULL && b != NULL;
+    for (int i = 0; zeroed && i < 16; i++) {
+        zeroed = (i >= 5 || a[i] == 0) && b[i] == 0;
+    }
+    failed += check(a != NULL && b != NULL && ((uintptr_t)a % 8) == 0 && b == a + 8 && zeroed,
+        "allocations are zeroed and padded to 8 bytes");
+    failed += check(arena_used() == before + 24, "arena_used() counts the padding");
+    arena_free(a);
+    failed += check(arena_used() == before + 24, "arena_free() leaves arena memory in place");
+    failed += check(arena_alloc(arena_size()) == NULL, "an allocation larger than what is left fails");
+    return failed;
+}
+
+// One pass of the sampler and reporter work that has to run without the heap
+static void hot_path(sample_bus_t* bus, sample_sub_t* sub, const alert_rule_t* rules, alert_state_t* states,
+    int num_rules, history_encoder_t* enc, uint8_t* block, uint32_t block_size, uint32_t n)
+{
+    struct sensor_data sd;
+    sensor_data_init(&sd);
+    sd.timestamp = (int64_t)n * 1000000;
+    for (int f = 0; f < SENSOR_NUM_FIELDS; f++) {
+        sd.sample.value[f] = (int16_t)(100 + (n * 7 + f * 13) % 50);
+    }
+    sd.aqi = (int16_t)(n % 150);
+    sample_bus_publish(bus, &sd);
+
+    const struct sensor_data* rec;
+    while ((rec = sample_bus_next(bus, sub)) != NULL) {
+        struct sensor_data copy = *rec;
+        if (!sample_bus_release(bus, sub)) {
+            continue;
+        }
+        for (int r = 0; r < num_rules; r++) {
+            alert_rule_eval(&rules[r], &states[r], alert_field_value(&copy, rules[r].field), copy.timestamp);
+        }
+        char text[SENSOR_FORMAT_MAX];
+        for (int f = 0; f < SENSOR_NUM_FIELDS; f++) {
+            sensor_format(&text[0], sizeof(text), f, copy.sample.value[f]);
+        }
+        history_row_t row;
+        row.time = (uint32_t)(copy.timestamp / 1000000);
+        memcpy(&row.value[0], &copy.sample.value[0], sizeof(row.value));
+        if (!history_encoder_append(enc, &row)) {
+            history_encoder_init(enc, block, block_size);
+            history_encoder_append(enc, &row);
+        }
+    }
+}
+
+static int check_steady(void)
+{
+    static const char* exprs[] = {
+        "aqi >= 100 for 30s",
+        "pm2p5 > 35",
+        "humidity <= 30",
+        "aqi rises by 50 in 5m",
+    };
+    enum { NUM_RULES = sizeof(exprs) / sizeof(exprs[0]) };
+    static sample_bus_t bus;
+    static uint8_t block[4096];
+    alert_rule_t rules[NUM_RULES];
+    alert_state_t states[NUM_RULES];
+    history_encoder_t enc;
+    int failed = 0;
+
+    s_current = &s_tasks[0];
+    arena_watch_task("sampler");
+    sample_bus_init(&bus);
+    sample_sub_t* sub = sample_bus_subscribe(&bus, "reporter", NULL);
+    for (int r = 0; r < NUM_RULES; r++) {
+        char err[64];
+        if (!alert_rule_compile(exprs[r], &rules[r], &err[0], sizeof(err))) {
+            printf("  FAIL '%s' did not compile: %s\n", exprs[r], &err[0]);
+            return 1;
+        }
+        alert_state_reset(&states[r]);
+    }
+    history_encoder_init(&enc, &block[0], sizeof(block));
+
+    // Warm-up allocations are allowed and counted, but not as steady
+    free(malloc(64));
+    hot_path(&bus, sub, &rules[0], &states[0], NUM_RULES, &enc, &block[0], sizeof(block), 1);
+    arena_mark_steady();
+    for (uint32_t n = 2; n <= STEADY_ITERATIONS; n++) {
+        hot_path(&bus, sub, &rules[0], &states[0], NUM_RULES, &enc, &block[0], sizeof(block), n);
+    }
+    uint32_t steady = arena_steady_allocs();
+    printf("  %u steady-state allocations in %d passes of the hot path\n", steady, STEADY_ITERATIONS - 1);
+    failed += check(steady == 0, "sampler and reporter hot path does not allocate once steady");
+    return failed;
+}
+
+static void* volatile s_keep;
+
+static int check_hook(void)
+{
+    int failed = 0;
+    s_current = &s_tasks[1];
+    arena_watch_task("control");
+    failed += check(arena_steady_allocs() == 0, "nothing counts as steady before arena_mark_steady()");
+    arena_mark_steady();
+    s_keep = malloc(32);
+    s_keep = realloc(s_keep, 64);
+    free(s_keep);
+    s_keep = calloc(4, 8);
+    free(s_keep);
+    failed += check(arena_steady_allocs() == 3, "malloc, realloc and calloc after steady are counted");
+
+    // Allocations of a task that is not watched do not land on another task's count
+    s_current = &s_tasks[2];
+    s_keep = malloc(16);
+    free(s_keep);
+    failed += check(arena_steady_allocs() == 0, "an unwatched task reports 0");
+    s_current = &s_tasks[1];
+    failed += check(arena_steady_allocs() == 3, "other tasks' allocations are not counted");
+
+    arena_to_json(NULL);
+    bool reported = s_json_count == 2 && strcmp(s_json[0].name, "sampler") == 0 && s_json[0].steady_allocs == 0
+        && strcmp(s_json[1].name, "control") == 0 && s_json[1].steady_allocs == 3;
+    failed += check(reported, "arena_to_json() reports steady_allocs per task");
+    return failed;
+}
+
+int main(void)
+{
+    int failed = 0;
+    printf("arena\n");
+    failed += check_arena();
+    printf("steady state\n");
+    failed += check_steady();
+    printf("allocation hook\n");
+    failed += check_hook();
+    printf("%d failed\n", failed);
+    return failed != 0;
+}
@@ -0,0 +1,108 @@
+#!/usr/bin/env python3
+"""Simulate a room full of monitors for testing gateway mode.
+
+Starts N HTTP servers on consecutive ports, each serving /api/v1/sensor with a random walk of
+readings in the same JSON format as the firmware. Point a gateway at them with
+CONFIG_AQM_FLEET_PEERS (the script prints the value to use), then watch /api/v1/fleet.
+
+    python tools/fleet_sim.py --count 32 --port 8100
+"""
+
+import argparse
+import json
+import random
+import socket
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+
+class Monitor:
+    def __init__(self, seed):
+        self.rng = random.Random(seed)
+        self.pm2p5 = self.rng.uniform(3.0, 40.0)
+        self.voc = self.rng.uniform(80.0, 200.0)
+        self.lock = threading.Lock()
+        self.requests = 0
+
+    def sample(self):
+        with self.lock:
+            self.requests += 1
+            self.pm2p5 = max(0.0, self.pm2p5 + self.rng.gauss(0.0, 1.5))
+            self.voc = min(500.0, max(1.0, self.voc + self.rng.gauss(0.0, 5.0)))
+            pm2p5 = round(self.pm2p5, 1)
+            return {
+                "temperature_mcp9808": round(21.0 + self.rng.uniform(-0.5, 0.5), 2),
+                "mass_concentration_pm1p0": round(pm2p5 * 0.7, 1),
+                "mass_concentration_pm2p5": pm2p5,
+                "mass_concentration_pm4p0": round(pm2p5 * 1.1, 1),
+                "mass_concentration_pm10p0": round(pm2p5 * 1.3, 1),
+                "ambient_humidity": round(40.0 + self.rng.uniform(-2.0, 2.0), 1),
+                "ambient_temperature": round(21.5 + self.rng.uniform(-0.5, 0.5), 1),
+                "voc_index": int(self.voc * 10),
+                "nox_index": 10,
+                "aqi": int(min(500, pm2p5 * 3.0)),
+                "aqi_algorithm": "epa",
+            }
+
+
+def make_handler(monitor):
+    class Handler(BaseHTTPRequestHandler):
+        def do_GET(self):
+            if self.path != "/api/v1/sensor":
+                self.send_error(404)
+                return
+            body = json.dumps(monitor.sample()).encode()
+            self.send_response(200)
+            self.send_header("Content-Type", "application/json")
+            self.send_header("Content-Length", str(len(body)))
+            self.end_headers()
+            self.wfile.write(body)
+
+        def log_message(self, fmt, *args):
+            pass
+
+    return Handler
+
+
+def local_ip():
+    s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    try:
+        s.connect(("10.255.255.255", 1))
+        return s.getsockname()[0]
+    except OSError:
+        return "127.0.0.1"
+    finally:
+        s.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--count", type=int, default=8, help="number of simulated monitors")
+    parser.add_argument("--port", type=int, default=8100, help="first port")
+    parser.add_argument("--bind", default="0.0.0.0")
+    args = parser.parse_args()
+
+    monitors = []
+    for i in range(args.count):
+        monitor = Monitor(i)
+        server = ThreadingHTTPServer((args.bind, args.port + i), make_handler(monitor))
+        threading.Thread(target=server.serve_forever, daemon=True).start()
+        monitors.append(monitor)
+
+    ip = local_ip()
+    peers = ",".join("%s:%d" % (ip, args.port + i) for i in range(args.count))
+    print("CONFIG_AQM_FLEET_PEERS=\"%s\"" % peers)
+
+    start = time.time()
+    try:
+        while True:
+            time.sleep(10)
+            total = sum(m.requests for m in monitors)
+            print("%d requests, %.1f req/s" % (total, total / (time.time() - start)))
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
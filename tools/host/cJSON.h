@@ -0,0 +1,12 @@
+#pragma once
+
+// Host stand-in for the cJSON calls the *_to_json() reporters make. The tool linking such a
+// module defines these, e.g. to capture the numbers it reports.
+
+#include <stdbool.h>
+
+typedef struct cJSON cJSON;
+
+cJSON* cJSON_AddObjectToObject(cJSON* object, const char* name);
+cJSON* cJSON_AddNumberToObject(cJSON* object, const char* name, double number);
+cJSON* cJSON_AddBoolToObject(cJSON* object, const char* name, bool boolean);
@@ -0,0 +1,3 @@
+#pragma once
+
+typedef int i2c_port_t;
@@ -0,0 +1,17 @@
+#pragma once
+
+// Host stand-in for the FreeRTOS types the benchmarked modules use. Nothing here schedules.
+
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef void* TaskHandle_t;
+typedef void* SemaphoreHandle_t;
+typedef struct { void* unused; } StaticSemaphore_t;
+typedef struct { int unused; } portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED { 0 }
+#define portENTER_CRITICAL(mux) ((void)(mux))
+#define portEXIT_CRITICAL(mux) ((void)(mux))
+#define portMAX_DELAY UINT32_MAX
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+// Benchmarks subscribe without a task handle, so notifications are never sent
+#define xTaskNotifyGive(task) ((void)(task))
+
+// Defined by the tool that needs task identity, e.g. to switch between simulated tasks
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
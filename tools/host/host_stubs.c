@@ -0,0 +1,90 @@
+#include "host_stubs.h"
+
+#include "arena.h"
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "utils.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static i2c_bus_dev_t s_devs[I2C_BUS_MAX_DEVICES];
+static int s_num_devs;
+static host_i2c_write_fn s_writer;
+static void* s_writer_arg;
+static uint8_t s_read_value;
+static uint64_t s_bytes_written;
+
+void host_i2c_set_writer(host_i2c_write_fn fn, void* arg)
+{
+    s_writer = fn;
+    s_writer_arg = arg;
+}
+
+void host_i2c_set_read_value(uint8_t value)
+{
+    s_read_value = value;
+}
+
+uint64_t host_i2c_bytes_written(void)
+{
+    return s_bytes_written;
+}
+
+i2c_bus_dev_t* i2c_bus_add_device(uint8_t addr, uint32_t max_freq_hz, enum i2c_bus_prio prio)
+{
+    if (s_num_devs == I2C_BUS_MAX_DEVICES) {
+        return NULL;
+    }
+    i2c_bus_dev_t* dev = &s_devs[s_num_devs++];
+    dev->addr = addr;
+    dev->max_freq_hz = max_freq_hz;
+    dev->prio = prio;
+    return dev;
+}
+
+esp_err_t i2c_bus_write(i2c_bus_dev_t* dev, const uint8_t* data, size_t len)
+{
+    s_bytes_written += len;
+    if (s_writer != NULL) {
+        s_writer(dev, data, len, s_writer_arg);
+    }
+    return ESP_OK;
+}
+
+esp_err_t i2c_bus_read(i2c_bus_dev_t* dev, uint8_t* data, size_t len)
+{
+    memset(data, s_read_value, len);
+    return ESP_OK;
+}
+
+void* arena_alloc(size_t size)
+{
+    return calloc(1, size);
+}
+
+void arena_free(void* ptr)
+{
+    free(ptr);
+}
+
+void sleep_usec(unsigned int usec)
+{
+}
+
+void sleep_msec(unsigned int msec)
+{
+}
+
+int64_t esp_timer_get_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+const char* esp_err_to_name(esp_err_t err)
+{
+    return err == ESP_OK ? "ESP_OK" : "ESP_FAIL";
+}
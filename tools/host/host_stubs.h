@@ -0,0 +1,18 @@
+#pragma once
+
+// Host replacements for the ESP-IDF and board services the display and bus modules call:
+// arena allocation from the heap, sleeps that return at once, and an I2C bus that records
+// every write instead of sending it. Link tools/host/host_stubs.c into the benchmark.
+
+#include "i2c_bus.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef void (*host_i2c_write_fn)(i2c_bus_dev_t* dev, const uint8_t* data, size_t len, void* arg);
+
+// Called for every i2c_bus_write; NULL just counts
+void host_i2c_set_writer(host_i2c_write_fn fn, void* arg);
+// The byte i2c_bus_read returns, e.g. an OLED status register
+void host_i2c_set_read_value(uint8_t value);
+uint64_t host_i2c_bytes_written(void);
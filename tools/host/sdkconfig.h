@@ -0,0 +1,6 @@
+#pragma once
+
+// The defaults from main/Kconfig.projbuild that the host-built modules read
+#define CONFIG_AQM_LCD_ROWS 2
+#define CONFIG_AQM_LCD_COLS 16
+#define CONFIG_AQM_LCD_TREND_MINUTES 30
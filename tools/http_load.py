@@ -0,0 +1,143 @@
+#!/usr/bin/env python3
+"""Polling load generator for the monitor's HTTP server.
+
+Simulates dashboards that poll the API: every client loops over the given paths for the given
+time, reusing one keep-alive connection (or opening a new one per request with --no-keepalive).
+Reports sustained requests/sec, latency percentiles and errors, then the server's own
+connection stats from /api/v1/system.
+
+    python tools/http_load.py 192.168.1.50 --clients 12 --duration 30
+    python tools/http_load.py 192.168.1.50 --clients 12 --no-keepalive --path /api/v1/sensor
+
+Run it once against a build with the stock HTTPD_DEFAULT_CONFIG() and once against the tuned
+server to compare.
+"""
+
+import argparse
+import http.client
+import json
+import threading
+import time
+
+DEFAULT_PATHS = ["/api/v1/sensor", "/api/v1/aqi"]
+
+
+class Client(threading.Thread):
+    def __init__(self, host, port, paths, deadline, keepalive, interval, timeout):
+        super().__init__(daemon=True)
+        self.host = host
+        self.port = port
+        self.paths = paths
+        self.deadline = deadline
+        self.keepalive = keepalive
+        self.interval = interval
+        self.timeout = timeout
+        self.latencies = []
+        self.errors = {}
+        self.connects = 0
+
+    def error(self, kind):
+        self.errors[kind] = self.errors.get(kind, 0) + 1
+
+    def run(self):
+        conn = None
+        i = 0
+        while time.monotonic() < self.deadline:
+            path = self.paths[i % len(self.paths)]
+            i += 1
+            start = time.monotonic()
+            try:
+                if conn is None:
+                    conn = http.client.HTTPConnection(self.host, self.port, timeout=self.timeout)
+                    self.connects += 1
+                headers = {} if self.keepalive else {"Connection": "close"}
+                conn.request("GET", path, headers=headers)
+                resp = conn.getresponse()
+                resp.read()
+                if resp.status != 200:
+                    self.error("http %d" % resp.status)
+                else:
+                    self.latencies.append(time.monotonic() - start)
+                if not self.keepalive or resp.will_close:
+                    conn.close()
+                    conn = None
+            except (OSError, http.client.HTTPException) as e:
+                self.error(type(e).__name__)
+                if conn is not None:
+                    conn.close()
+                conn = None
+            if self.interval > 0:
+                time.sleep(max(0.0, self.interval - (time.monotonic() - start)))
+        if conn is not None:
+            conn.close()
+
+
+def percentile(sorted_values, p):
+    if not sorted_values:
+        return float("nan")
+    k = min(len(sorted_values) - 1, int(round(p / 100.0 * (len(sorted_values) - 1))))
+    return sorted_values[k]
+
+
+def server_stats(host, port, timeout):
+    try:
+        conn = http.client.HTTPConnection(host, port, timeout=timeout)
+        conn.request("GET", "/api/v1/system")
+        resp = conn.getresponse()
+        body = resp.read()
+        conn.close()
+        return json.loads(body).get("http")
+    except (OSError, ValueError, http.client.HTTPException):
+        return None
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("host", help="monitor address")
+    parser.add_argument("--port", type=int, default=80)
+    parser.add_argument("--clients", type=int, default=10, help="concurrent dashboards")
+    parser.add_argument("--duration", type=float, default=20.0, help="seconds")
+    parser.add_argument("--interval", type=float, default=0.0,
+                        help="seconds between one client's requests, 0 to poll back-to-back")
+    parser.add_argument("--path", action="append", help="path to poll, repeatable (default: sensor and aqi)")
+    parser.add_argument("--no-keepalive", dest="keepalive", action="store_false",
+                        help="open a new connection for every request")
+    parser.add_argument("--timeout", type=float, default=5.0)
+    args = parser.parse_args()
+
+    paths = args.path or DEFAULT_PATHS
+    deadline = time.monotonic() + args.duration
+    clients = [Client(args.host, args.port, paths, deadline, args.keepalive, args.interval, args.timeout)
+               for _ in range(args.clients)]
+    start = time.monotonic()
+    for c in clients:
+        c.start()
+    for c in clients:
+        c.join()
+    elapsed = time.monotonic() - start
+
+    latencies = sorted(l for c in clients for l in c.latencies)
+    errors = {}
+    for c in clients:
+        for kind, n in c.errors.items():
+            errors[kind] = errors.get(kind, 0) + n
+    connects = sum(c.connects for c in clients)
+
+    print("%d clients, %.1fs, %s" % (args.clients, elapsed, "keep-alive" if args.keepalive else "new connection per request"))
+    print("requests   %d ok, %d failed, %d connections opened" % (len(latencies), sum(errors.values()), connects))
+    print("throughput %.1f req/s" % (len(latencies) / elapsed))
+    print("latency    p50 %.1fms  p90 %.1fms  p99 %.1fms  max %.1fms" % (
+        percentile(latencies, 50) * 1000, percentile(latencies, 90) * 1000,
+        percentile(latencies, 99) * 1000, (latencies[-1] if latencies else float("nan")) * 1000))
+    for kind, n in sorted(errors.items()):
+        print("error      %s: %d" % (kind, n))
+
+    stats = server_stats(args.host, args.port, args.timeout)
+    if stats is not None:
+        print("server     accepted %d, reused %d of %d requests, idle closed %d, peak open %d/%d" % (
+            stats.get("accepted", 0), stats.get("reused", 0), stats.get("requests", 0),
+            stats.get("idle_closed", 0), stats.get("peak_open", 0), stats.get("max_sockets", 0)))
+
+
+if __name__ == "__main__":
+    main()
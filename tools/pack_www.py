@@ -0,0 +1,140 @@
+#!/usr/bin/env python3
+"""Pack the dashboard into a flash image for the www partition.
+
+Every file is gzipped at build time (kept as-is when that does not make it smaller) and gets a
+strong ETag from the hash of the stored bytes. The firmware memory-maps the partition and sends
+files straight from flash, so the layout here must match www.h:
+
+    header  magic "AQMW", u16 version, u16 count, u32 image size, u32 reserved
+    entries count x 128 bytes, sorted by path:
+            char path[60], char mime[32], char etag[20], u32 offset, u32 size, u32 flags, u32 reserved
+    data    file contents, 4-byte aligned
+
+References to other packed files in HTML get a ?v=<etag> suffix, so those files can be cached for
+a year and still change on the next flash. HTML itself is always revalidated.
+
+    python tools/pack_www.py www build/www.bin --size 0x100000
+"""
+
+import argparse
+import gzip
+import hashlib
+import os
+import re
+import struct
+import sys
+
+MAGIC = 0x574D5141  # "AQMW"
+VERSION = 1
+HEADER = struct.Struct("<IHHII")
+ENTRY = struct.Struct("<60s32s20sIIII")
+FLAG_GZIP = 0x1
+FLAG_IMMUTABLE = 0x2
+
+MIME_TYPES = {
+    ".html": "text/html",
+    ".js": "application/javascript",
+    ".css": "text/css",
+    ".json": "application/json",
+    ".svg": "image/svg+xml",
+    ".png": "image/png",
+    ".ico": "image/x-icon",
+    ".txt": "text/plain",
+}
+
+
+def collect(root):
+    files = {}
+    for dirpath, _, names in os.walk(root):
+        for name in names:
+            full = os.path.join(dirpath, name)
+            path = "/" + os.path.relpath(full, root).replace(os.sep, "/")
+            with open(full, "rb") as f:
+                files[path] = f.read()
+    return files
+
+
+def short_hash(data):
+    return hashlib.sha256(data).hexdigest()[:16]
+
+
+def version_references(files):
+    """Appends ?v=<hash> to references from HTML files, returns the paths that were referenced."""
+    referenced = set()
+    hashes = {path: short_hash(data) for path, data in files.items() if not path.endswith(".html")}
+    for path, data in files.items():
+        if not path.endswith(".html"):
+            continue
+        base = path.rsplit("/", 1)[0] + "/"
+        text = data.decode("utf-8")
+
+        def repl(m):
+            ref = m.group(2)
+            target = ref if ref.startswith("/") else base + ref
+            if target not in hashes:
+                return m.group(0)
+            referenced.add(target)
+            return '%s="%s?v=%s"' % (m.group(1), ref, hashes[target][:8])
+
+        files[path] = re.sub(r'\b(src|href)="([^"?#:]+)"', repl, text).encode("utf-8")
+    return referenced
+
+
+def pack(root, size_limit):
+    files = collect(root)
+    immutable = version_references(files)
+    entries = []
+    for path in sorted(files):
+        if len(path.encode()) >= 60:
+            sys.exit("path too long: %s" % path)
+        raw = files[path]
+        packed = gzip.compress(raw, compresslevel=9, mtime=0)
+        flags = 0
+        if len(packed) < len(raw):
+            data = packed
+            flags |= FLAG_GZIP
+        else:
+            data = raw
+        if path in immutable:
+            flags |= FLAG_IMMUTABLE
+        ext = os.path.splitext(path)[1].lower()
+        mime = MIME_TYPES.get(ext, "application/octet-stream")
+        etag = '"%s"' % short_hash(data)
+        entries.append((path, mime, etag, data, flags, len(raw)))
+
+    offset = HEADER.size + ENTRY.size * len(entries)
+    table = b""
+    blob = b""
+    for path, mime, etag, data, flags, _ in entries:
+        pad = (-(offset + len(blob))) % 4
+        blob += b"\0" * pad
+        table += ENTRY.pack(path.encode(), mime.encode(), etag.encode(), offset + len(blob), len(data), flags, 0)
+        blob += data
+    image_size = offset + len(blob)
+    image = HEADER.pack(MAGIC, VERSION, len(entries), image_size, 0) + table + blob
+    if size_limit and len(image) > size_limit:
+        sys.exit("image is %d bytes, partition holds %d" % (len(image), size_limit))
+    return image, entries
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("root", help="directory with the dashboard files")
+    parser.add_argument("output", help="image file to write")
+    parser.add_argument("--size", type=lambda s: int(s, 0), default=0, help="partition size to check against")
+    parser.add_argument("--quiet", action="store_true")
+    args = parser.parse_args()
+
+    image, entries = pack(args.root, args.size)
+    with open(args.output, "wb") as f:
+        f.write(image)
+    if not args.quiet:
+        total_raw = sum(e[5] for e in entries)
+        for path, mime, etag, data, flags, raw_len in entries:
+            print("%-32s %7d -> %7d %s%s" % (path, raw_len, len(data), "gzip " if flags & FLAG_GZIP else "",
+                                              "immutable" if flags & FLAG_IMMUTABLE else ""))
+        print("%d files, %d bytes raw, image %d bytes" % (len(entries), total_raw, len(image)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,90 @@
+"use strict";
+
+const $ = (id) => document.getElementById(id);
+
+function fmt(v, digits) {
+  return v === null || v === undefined || Number.isNaN(v) ? "-" : Number(v).toFixed(digits);
+}
+
+async function getJson(url) {
+  const res = await fetch(url, { cache: "no-store" });
+  if (!res.ok) {
+    throw new Error(url + ": " + res.status);
+  }
+  return res.json();
+}
+
+async function refreshSensor() {
+  const sd = await getJson("/api/v1/sensor");
+  $("aqi").textContent = sd.aqi;
+  $("aqi_algorithm").textContent = sd.aqi_algorithm;
+  $("pm2p5").textContent = fmt(sd.mass_concentration_pm2p5, 1);
+  $("pm10p0").textContent = fmt(sd.mass_concentration_pm10p0, 1);
+  $("temperature").textContent = fmt(sd.ambient_temperature, 1);
+  $("humidity").textContent = fmt(sd.ambient_humidity, 0);
+  $("voc_nox").textContent = fmt(sd.voc_index / 10, 0) + " / " + fmt(sd.nox_index / 10, 0);
+}
+
+async function refreshHealth() {
+  const h = await getJson("/api/v1/health");
+  const badge = $("status");
+  badge.textContent = h.status;
+  badge.className = "badge " + h.status;
+  const active = Object.entries(h.flags || {}).filter(([, f]) => f.active).map(([name]) => name);
+  const clean = h.fan_cleaning || {};
+  $("health").innerHTML =
+    "<h2>Sensor health</h2><dl>" +
+    "<dt>Operating hours</dt><dd>" + fmt(h.operating_hours, 1) + "</dd>" +
+    "<dt>Active flags</dt><dd>" + (active.length ? active.join(", ") : "none") + "</dd>" +
+    "<dt>Fan cleanings</dt><dd>" + (clean.count || 0) + ", last " + fmt(clean.hours_since, 0) + " h ago</dd>" +
+    "</dl>";
+}
+
+function drawChart(rows) {
+  const canvas = $("history");
+  const ctx = canvas.getContext("2d");
+  const w = canvas.width, h = canvas.height, pad = 32;
+  ctx.clearRect(0, 0, w, h);
+  const pts = rows.filter((r) => r[1] !== null);
+  if (pts.length < 2) {
+    ctx.fillStyle = "#8b98a5";
+    ctx.fillText("No history yet", w / 2 - 30, h / 2);
+    return;
+  }
+  const t0 = pts[0][0], t1 = pts[pts.length - 1][0];
+  let lo = Math.min(...pts.map((r) => r[1])), hi = Math.max(...pts.map((r) => r[1]));
+  if (hi - lo < 1) {
+    hi = lo + 1;
+  }
+  const x = (t) => pad + ((t - t0) / (t1 - t0 || 1)) * (w - 2 * pad);
+  const y = (v) => h - pad - ((v - lo) / (hi - lo)) * (h - 2 * pad);
+  ctx.strokeStyle = "#2d333b";
+  ctx.fillStyle = "#8b98a5";
+  ctx.beginPath();
+  ctx.moveTo(pad, h - pad);
+  ctx.lineTo(w - pad, h - pad);
+  ctx.stroke();
+  ctx.fillText(fmt(hi, 1), 2, pad);
+  ctx.fillText(fmt(lo, 1), 2, h - pad);
+  ctx.strokeStyle = "#3fb950";
+  ctx.beginPath();
+  pts.forEach((r, i) => (i ? ctx.lineTo(x(r[0]), y(r[1])) : ctx.moveTo(x(r[0]), y(r[1]))));
+  ctx.stroke();
+}
+
+async function refreshHistory() {
+  const field = $("field").value;
+  const from = Math.floor(Date.now() / 1000) - 86400;
+  const data = await getJson("/api/v1/history?fields=" + field + "&from=" + from);
+  drawChart(data.rows);
+}
+
+function poll(fn, msec) {
+  const run = () => fn().catch((e) => console.warn(e)).finally(() => setTimeout(run, msec));
+  run();
+}
+
+$("field").addEventListener("change", () => refreshHistory().catch((e) => console.warn(e)));
+poll(refreshSensor, 5000);
+poll(refreshHealth, 30000);
+poll(refreshHistory, 60000);